@@ -0,0 +1,29 @@
+;; capture and escape
+(define (escape-loop i n)
+  (if (< i n)
+      (escape-loop (+ i (call/cc (lambda (k) (k 1)))) n)
+      i))
+
+;; capture and return without invoking the continuation
+(define (capture-loop i n)
+  (if (< i n)
+      (capture-loop (+ i (call/cc (lambda (k) 1))) n)
+      i))
+
+;; resume a continuation whose call/cc has already returned
+(define (resume-loop n)
+  (let ((k #f)
+        (i 0))
+    (set! i (+ (call/cc (lambda (c) (set! k c) 0)) i))
+    (if (< i n)
+        (k 1)
+        i)))
+
+(write (escape-loop 0 100000))
+(newline)
+(write (capture-loop 0 100000))
+(newline)
+(if (not (provided? "nested-continuation-only"))
+    (begin
+      (write (resume-loop 100000))
+      (newline)))
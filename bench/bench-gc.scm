@@ -0,0 +1,32 @@
+;; A large live set with short-lived garbage, as a server holding its state
+;; while handling requests.
+(define *live-size* 300000)
+(define *requests* 2000)
+
+(define (make-live n)
+  (let loop ((i 0) (res '()))
+    (if (< i n)
+        (loop (+ i 1) (cons (make-vector 2 i) res))
+        res)))
+
+(define *live* (make-live *live-size*))
+(define *table* (make-vector 1024 '()))
+
+(define (handle i)
+  (let loop ((j 0) (acc '()))
+    (if (< j 200)
+        (loop (+ j 1) (cons (cons i j) acc))
+        (let ((k (remainder i 1024)))
+          ;; a few results are kept in the old table
+          (vector-set! *table* k (car acc))
+          (length acc)))))
+
+(define (run i)
+  (if (< i *requests*)
+      (begin
+        (handle i)
+        (run (+ i 1)))
+      (length *live*)))
+
+(write (run 0))
+(newline)
@@ -1,6 +1,7 @@
 #!/bin/sh
 
-SSCM="src/sscm --system-load-path $PWD/lib"
+# extra arguments such as '--engine interpreter' are passed to sscm
+SSCM="src/sscm --system-load-path $PWD/lib $*"
 
 for bench in bench/bench-*.scm
 do
@@ -0,0 +1,3043 @@
+/*===========================================================================
+ *  Filename : compiler.c
+ *  About    : Pre-analysis of closure bodies into executable node trees
+ *
+ *  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of authors nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ *  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================*/
+
+/*
+ * The body of a closure is analyzed once on its first call and translated
+ * into a tree of nodes. A node is an ordinary pair whose car is a C function
+ * of type syntax_variadic_tailrec_0 (the handler) and whose cdr holds the
+ * operands prepared by the analyzer:
+ *
+ *   (<handler> . <operands>)
+ *
+ * Since such a node is also a valid function call form, it is executable by
+ * the plain call() of eval.c. Tail positions are returned to scm_eval() as
+ * SCM_VALTYPE_NEED_EVAL in the same way as the ordinary tail-recursive
+ * syntaxes do, and the GC marks the nodes as ordinary objects. scm_eval() only
+ * takes a shortcut to invoke the handler directly.
+ *
+ * A variable bound by a frame that compiled code creates is referred by its
+ * lexical address (frame depth, position in the formals), which is resolved
+ * at the analysis. Other variables such as the ones of the environment in
+ * which the closure has been created, wrapped identifiers of hygienic macros
+ * and the variables referred from 'interp' forms (including 'eval' on
+ * (the-environment)) are looked up by name as usual.
+ *
+ * Self-evaluating objects are left as is. Forms that are not handled natively
+ * (macro uses, 'delay', malformed forms and so on)
+ * are wrapped into an 'interp' node that hands the original form back to the
+ * interpreter. So the analysis never changes the semantics or the timing of
+ * errors of such forms.
+ *
+ * Syntactic keywords are resolved at the analysis. The node of a form whose
+ * keyword is bound at the toplevel is guarded by the identity of the syntax
+ * held by the variable, so that the original form is handed to the
+ * interpreter once the keyword has been redefined. Conversely, the call node
+ * of an operator turned into a syntax after the compilation does the same.
+ *
+ * A compiled closure holds a code object as its SCM_CLOSURE_EXP() in place of
+ * the original (<formals> . <body>). The source is kept for the writer and
+ * the debugging procedures.
+ *
+ *   (<code tag> <formals> <body node> <stack frame?> . (<formals> . <body>))
+ *
+ * <stack frame?> is the result of an escape analysis of the body. If the body
+ * contains no lambda, named let or interp node, nothing can capture the env
+ * of an activation of the code. With SCM_USE_STACK_FRAME, the frame of such
+ * an activation is pushed onto a stack of frames and reused by later calls
+ * after scm_eval() of the activation returns (or the activation makes a
+ * tail call into another stack frame). An operator turned into a syntax after
+ * the compilation may capture the env though, so that all the frames on the
+ * stack are dropped into the heap in that case, as well as the ones above a
+ * continuation which is being returned to.
+ *
+ * Once the whole body of a closure has been analyzed, each lambda in it
+ * whose body looks up no variable of the compiled frames by name (no interp
+ * node nor wrapped identifier) is converted into a flat closure. Instead of
+ * the env of its creation, a flat closure holds a frame of only the variables
+ * it refers from the enclosing compiled frames, followed by the env of the
+ * closure being compiled:
+ *
+ *   (<flat-lambda> <code> <frame count> <slot formals> . <capture nodes>)
+ *
+ * A variable that is never assigned is copied into a slot and referred by its
+ * index. A variable that may be assigned (by set!, letrec, internal
+ * definitions or an interp node that can see it) is shared through its
+ * defining frame, which is stored in a slot as the box of the variable and
+ * accessed by cref and cset nodes. The lexical addresses in the lambda and
+ * the capture nodes of inner flat closures are rewritten in place, innermost
+ * lambda first. An operator turned into a syntax after the compilation can
+ * only see the captured variables of a flat closure.
+ *
+ * With SCM_USE_SEALED_BUILTINS, a call of a toplevel variable that holds one
+ * of the basic builtins such as + and car is compiled into a prim node. As
+ * long as the variable holds the builtin, the fast path of the builtin for
+ * fixnums and pairs is performed inline, and the builtin itself is called
+ * only for the other cases including the errors. A call whose operands are
+ * all constant is folded into its value at the analysis, and the value is
+ * used while the builtins involved are unmodified. Once a builtin is
+ * replaced by define or set!, the nodes fall back to an ordinary call.
+ *
+ * A 'case' whose data are all symbols, characters or fixnums is dispatched
+ * by a table built at the analysis instead of testing the clauses in order:
+ * a vector indexed by the key for a dense range of fixnums, or otherwise an
+ * open addressing hash table keyed by the identity of symbols and the values
+ * of characters and fixnums.
+ *
+ * A 'do' loop, and a named let whose name is only called in tail positions of
+ * its body, iterate without allocation by updating the values of the frame of
+ * the loop variables in place, unless something in the loop may capture the
+ * frame. If an operator turned into a syntax after the compilation is met,
+ * or a re-entrant continuation is captured or reentered, the loops in
+ * progress switch to fresh frames for the next iteration.
+ *
+ * A quasiquote template is analyzed into a plan of the lists and vectors to
+ * be constructed: each element is a constant datum, a node of an unquoted
+ * expression or a node to be spliced. The constant rest of a list after its
+ * last unquotation is shared by the results as the interpreter does, and a
+ * vector without splicing is allocated at its length at once. Templates
+ * that are malformed or contain wrapped identifiers are left to the
+ * interpreter.
+ */
+
+#include <config.h>
+
+#include "sigscheme.h"
+#include "sigschemeinternal.h"
+
+/*=======================================
+  File Local Macro Definitions
+=======================================*/
+#define MAKE_NODE(handler, operands) (CONS((handler), (operands)))
+
+#if SCM_USE_STACK_FRAME
+#define STACK_FRAME_MAX      256
+/* larger frames are left to the GC */
+#define POOLED_FRAME_LEN_MAX 8
+#endif
+
+#define SYNTAX_CFUNCP(obj, func)                                             \
+    (SCM_FUNC_CFUNC(obj) == (ScmFuncType)(func))
+
+/* C procedure that takes only mandatory args and returns a value as is */
+#define FIXED_CPROCEDUREP(obj)                                               \
+    (FUNCP(obj)                                                              \
+     && (SCM_FUNC_TYPECODE(obj) & ~SCM_FUNCTYPE_MAND_MASK)                   \
+         == SCM_PROCEDURE_FIXED)
+
+/* Record of a lambda in the closure being compiled:
+ *
+ *   (<lambda node> <frame count> <enclosing record> <flat?> . <free refs>)
+ *
+ * <frame count> is the number of the compiled frames outside of the lambda.
+ * A free ref (<node> <frame position> . <formals>) is a node that refers a
+ * variable or the frame at <frame position> counted from the outermost
+ * compiled frame, which is outside of the lambda. */
+#define LAMBDA_NODE(rec)            (CAR(rec))
+#define LAMBDA_BASE(rec)            (SCM_INT_VALUE(CADR(rec)))
+#define LAMBDA_PARENT(rec)          (CAR(CDDR(rec)))
+#define LAMBDA_FLATP(rec)           (CAR(CDR(CDDR(rec))))
+#define LAMBDA_REFS(rec)            (CDR(CDR(CDDR(rec))))
+#define LAMBDA_SET_NODE(rec, node)  (SET_CAR((rec), (node)))
+#define LAMBDA_SET_FLATP(rec, flat) (SET_CAR(CDR(CDDR(rec)), (flat)))
+#define LAMBDA_ADD_REF(rec, node, pos, formals)                              \
+    (SET_CDR(CDR(CDDR(rec)),                                                 \
+             CONS(CONS((node), CONS(MAKE_INT(pos), (formals))),              \
+                  LAMBDA_REFS(rec))))
+#define FREE_REF_POS(ref)           (SCM_INT_VALUE(CADR(ref)))
+#define FREE_REF_FORMALS(ref)       (CDDR(ref))
+
+/* A fixnum 'case' is dispatched by a vector indexed by the key if the range
+ * of the data is not much wider than the number of them. */
+#define CASE_DENSE_SPAN_MAX   1024
+#define CASE_DENSE_SPANP(span, n)                                            \
+    ((span) < CASE_DENSE_SPAN_MAX && (span) < (scm_uint_t)(2 * (n) + 8))
+#define CASE_DATUMP(obj)      (SYMBOLP(obj) || CHARP(obj) || INTP(obj))
+
+/* the step values of a loop are evaluated into a buffer of this size */
+#define LOOP_VARS_MAX         16
+
+/* An element of a compiled quasiquote template is (<kind> . <node>), where
+ * the node of a constant is a quote node. */
+#define QQ_CONSTANT           0
+#define QQ_VALUE              1
+#define QQ_SPLICE             2
+#define MAKE_QQ_ELM(kind, node) (CONS(MAKE_INT(kind), (node)))
+#define QQ_ELM_KIND(elm)      (SCM_INT_VALUE(CAR(elm)))
+#define QQ_ELM_NODE(elm)      (CDR(elm))
+
+/*=======================================
+  File Local Type Definitions
+=======================================*/
+#if SCM_USE_SEALED_BUILTINS
+enum prim_op {
+    PRIM_ADD,
+    PRIM_SUBTRACT,
+    PRIM_MULTIPLY,
+    PRIM_EQUAL,
+    PRIM_LESS,
+    PRIM_LESS_EQUAL,
+    PRIM_GREATER,
+    PRIM_GREATER_EQUAL,
+    PRIM_ZEROP,
+    PRIM_CAR,
+    PRIM_CDR,
+    PRIM_CONS,
+    PRIM_EQP,
+    PRIM_NULLP,
+    PRIM_PAIRP,
+    PRIM_NOT,
+
+    PRIM_NONE
+};
+
+struct prim_info {
+    ScmFuncType func;
+    int argc;
+    scm_bool foldablep;  /* fixnum operation */
+};
+#endif /* SCM_USE_SEALED_BUILTINS */
+
+/* State shared by the whole analysis of a closure. LAMBDAS holds the records
+ * of the lambdas in the order of completion, so that inner ones come first.
+ * ASSIGNED is a list of the formals of the frames whose variables may be
+ * assigned. LOOPS is an alist of the frames of the names of the named lets
+ * being compiled and the nodes that refer the names. */
+typedef struct {
+    ScmObj lambdas;
+    ScmQueue lambdaq;
+    ScmObj assigned;
+    ScmObj loops;
+} compile_unit;
+
+/* Compile-time view of the environment. FRAMES is a list of the formals of
+ * the frames that compiled code creates at runtime, recentmost first. ENV is
+ * the environment of the closure being compiled, which is opaque to the
+ * compiler. LAMBDA is the record of the innermost lambda or #f. */
+typedef struct {
+    ScmObj frames;
+    ScmObj env;
+    ScmObj lambda;
+    compile_unit *unit;
+} compile_scope;
+
+/*=======================================
+  Variable Definitions
+=======================================*/
+SCM_DEFINE_EXPORTED_VARS(compiler);
+
+SCM_GLOBAL_VARS_BEGIN(static_compiler);
+#define static
+static ScmObj l_sym_else, l_sym_yields, l_sym_define, l_sym_begin;
+static ScmObj l_sym_frame;
+static ScmObj l_syn_lambda;
+static ScmObj l_node_quote, l_node_ref, l_node_lref, l_node_gref;
+static ScmObj l_node_set, l_node_lset, l_node_setg;
+static ScmObj l_node_if, l_node_seq, l_node_and, l_node_or;
+static ScmObj l_node_let, l_node_letrec, l_node_defines, l_node_named_let;
+static ScmObj l_node_loop, l_node_recur, l_node_do;
+static ScmObj l_node_lambda, l_node_flat_lambda;
+static ScmObj l_node_fref, l_node_cref, l_node_cset;
+static ScmObj l_node_call, l_node_gcall, l_node_cond_yield, l_node_case;
+static ScmObj l_node_qq_list, l_node_qq_vector;
+static ScmObj l_node_body, l_node_interp, l_node_keyword;
+#if SCM_USE_SEALED_BUILTINS
+static ScmObj l_node_prim, l_node_folded;
+#endif
+#if SCM_USE_STACK_FRAME
+static ScmObj l_stack_frames, l_frame_pool;
+#endif
+static scm_int_t l_env_captures;
+#undef static
+SCM_GLOBAL_VARS_END(static_compiler);
+#define l_sym_else        SCM_GLOBAL_VAR(static_compiler, l_sym_else)
+#define l_sym_yields      SCM_GLOBAL_VAR(static_compiler, l_sym_yields)
+#define l_sym_define      SCM_GLOBAL_VAR(static_compiler, l_sym_define)
+#define l_sym_begin       SCM_GLOBAL_VAR(static_compiler, l_sym_begin)
+#define l_sym_frame       SCM_GLOBAL_VAR(static_compiler, l_sym_frame)
+#define l_syn_lambda      SCM_GLOBAL_VAR(static_compiler, l_syn_lambda)
+#define l_node_quote      SCM_GLOBAL_VAR(static_compiler, l_node_quote)
+#define l_node_ref        SCM_GLOBAL_VAR(static_compiler, l_node_ref)
+#define l_node_lref       SCM_GLOBAL_VAR(static_compiler, l_node_lref)
+#define l_node_gref       SCM_GLOBAL_VAR(static_compiler, l_node_gref)
+#define l_node_set        SCM_GLOBAL_VAR(static_compiler, l_node_set)
+#define l_node_lset       SCM_GLOBAL_VAR(static_compiler, l_node_lset)
+#define l_node_setg       SCM_GLOBAL_VAR(static_compiler, l_node_setg)
+#define l_node_if         SCM_GLOBAL_VAR(static_compiler, l_node_if)
+#define l_node_seq        SCM_GLOBAL_VAR(static_compiler, l_node_seq)
+#define l_node_and        SCM_GLOBAL_VAR(static_compiler, l_node_and)
+#define l_node_or         SCM_GLOBAL_VAR(static_compiler, l_node_or)
+#define l_node_let        SCM_GLOBAL_VAR(static_compiler, l_node_let)
+#define l_node_letrec     SCM_GLOBAL_VAR(static_compiler, l_node_letrec)
+#define l_node_defines    SCM_GLOBAL_VAR(static_compiler, l_node_defines)
+#define l_node_named_let  SCM_GLOBAL_VAR(static_compiler, l_node_named_let)
+#define l_node_loop       SCM_GLOBAL_VAR(static_compiler, l_node_loop)
+#define l_node_recur      SCM_GLOBAL_VAR(static_compiler, l_node_recur)
+#define l_node_do         SCM_GLOBAL_VAR(static_compiler, l_node_do)
+#define l_node_lambda     SCM_GLOBAL_VAR(static_compiler, l_node_lambda)
+#define l_node_flat_lambda SCM_GLOBAL_VAR(static_compiler, l_node_flat_lambda)
+#define l_node_fref       SCM_GLOBAL_VAR(static_compiler, l_node_fref)
+#define l_node_cref       SCM_GLOBAL_VAR(static_compiler, l_node_cref)
+#define l_node_cset       SCM_GLOBAL_VAR(static_compiler, l_node_cset)
+#define l_node_call       SCM_GLOBAL_VAR(static_compiler, l_node_call)
+#define l_node_gcall      SCM_GLOBAL_VAR(static_compiler, l_node_gcall)
+#define l_node_cond_yield SCM_GLOBAL_VAR(static_compiler, l_node_cond_yield)
+#define l_node_case       SCM_GLOBAL_VAR(static_compiler, l_node_case)
+#define l_node_qq_list    SCM_GLOBAL_VAR(static_compiler, l_node_qq_list)
+#define l_node_qq_vector  SCM_GLOBAL_VAR(static_compiler, l_node_qq_vector)
+#define l_node_body       SCM_GLOBAL_VAR(static_compiler, l_node_body)
+#define l_node_interp     SCM_GLOBAL_VAR(static_compiler, l_node_interp)
+#define l_node_keyword    SCM_GLOBAL_VAR(static_compiler, l_node_keyword)
+#if SCM_USE_SEALED_BUILTINS
+#define l_node_prim       SCM_GLOBAL_VAR(static_compiler, l_node_prim)
+#define l_node_folded     SCM_GLOBAL_VAR(static_compiler, l_node_folded)
+#endif
+#if SCM_USE_STACK_FRAME
+#define l_stack_frames    SCM_GLOBAL_VAR(static_compiler, l_stack_frames)
+#define l_frame_pool      SCM_GLOBAL_VAR(static_compiler, l_frame_pool)
+#endif
+#define l_env_captures    SCM_GLOBAL_VAR(static_compiler, l_env_captures)
+SCM_DEFINE_STATIC_VARS(static_compiler);
+
+#if SCM_USE_SEALED_BUILTINS
+/* indexed by enum prim_op */
+static const struct prim_info prim_table[] = {
+    {(ScmFuncType)scm_p_add,           2, scm_true},
+    {(ScmFuncType)scm_p_subtract,      2, scm_true},
+    {(ScmFuncType)scm_p_multiply,      2, scm_true},
+    {(ScmFuncType)scm_p_equal,         2, scm_true},
+    {(ScmFuncType)scm_p_less,          2, scm_true},
+    {(ScmFuncType)scm_p_less_equal,    2, scm_true},
+    {(ScmFuncType)scm_p_greater,       2, scm_true},
+    {(ScmFuncType)scm_p_greater_equal, 2, scm_true},
+    {(ScmFuncType)scm_p_zerop,         1, scm_true},
+    {(ScmFuncType)scm_p_car,           1, scm_false},
+    {(ScmFuncType)scm_p_cdr,           1, scm_false},
+    {(ScmFuncType)scm_p_cons,          2, scm_false},
+    {(ScmFuncType)scm_p_eqp,           2, scm_false},
+    {(ScmFuncType)scm_p_nullp,         1, scm_false},
+    {(ScmFuncType)scm_p_pairp,         1, scm_false},
+    {(ScmFuncType)scm_p_not,           1, scm_false}
+};
+#endif /* SCM_USE_SEALED_BUILTINS */
+
+/*=======================================
+  File Local Function Declarations
+=======================================*/
+static void init_node(ScmObj *node, ScmFuncType handler);
+
+static ScmObj node_quote(ScmObj datum, ScmEvalState *eval_state);
+static ScmObj node_ref(ScmObj var, ScmEvalState *eval_state);
+static ScmObj node_lref(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_gref(ScmObj sym, ScmEvalState *eval_state);
+static ScmObj node_set(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_lset(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_setg(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_if(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_seq(ScmObj nodes, ScmEvalState *eval_state);
+static ScmObj node_and(ScmObj nodes, ScmEvalState *eval_state);
+static ScmObj node_or(ScmObj nodes, ScmEvalState *eval_state);
+static ScmObj node_let(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_letrec(ScmObj operands, ScmEvalState *eval_state);
+#if SCM_USE_INTERNAL_DEFINITIONS
+static ScmObj node_defines(ScmObj operands, ScmEvalState *eval_state);
+#endif
+static ScmObj node_named_let(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_loop(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_recur(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_do(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_lambda(ScmObj code, ScmEvalState *eval_state);
+static ScmObj node_flat_lambda(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_fref(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_cref(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_cset(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_call(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_gcall(ScmObj operands, ScmEvalState *eval_state);
+#if SCM_USE_SEALED_BUILTINS
+static ScmObj node_prim(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_folded(ScmObj operands, ScmEvalState *eval_state);
+static scm_bool prim_fixnum(enum prim_op op, ScmObj left, ScmObj right,
+                           ScmObj *result);
+static ScmObj prim_call(ScmObj proc, ScmObj left, ScmObj right);
+#endif
+static ScmObj node_cond_yield(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj node_case(ScmObj operands, ScmEvalState *eval_state);
+static scm_uint_t case_hash(ScmObj datum);
+static scm_bool case_eqvp(ScmObj datum, ScmObj key);
+static ScmObj node_qq_list(ScmObj operands, ScmEvalState *eval_state);
+#if SCM_USE_VECTOR
+static ScmObj node_qq_vector(ScmObj operands, ScmEvalState *eval_state);
+#endif
+static ScmObj qq_value(ScmObj elm, ScmObj env);
+static void qq_splice(ScmQueue *q, ScmObj lst);
+static ScmObj node_body(ScmObj body, ScmEvalState *eval_state);
+static ScmObj node_interp(ScmObj form, ScmEvalState *eval_state);
+static ScmObj node_keyword(ScmObj operands, ScmEvalState *eval_state);
+static ScmObj extend_by_nodes(ScmObj formals, ScmObj nodes, ScmObj eval_env,
+                              ScmObj env);
+static ScmObj extend_unassigned(ScmObj formals, ScmObj env);
+static ScmObj extend_by_values(ScmObj formals, const ScmObj *vals,
+                               scm_int_t n, ScmObj env);
+static void update_frame(ScmObj env, const ScmObj *vals, scm_int_t n);
+static ScmObj eval_nodes(ScmObj nodes, ScmObj env);
+#if SCM_USE_STACK_FRAME
+static void release_frame(ScmObj frame);
+#endif
+static scm_bool frame_escapesp(ScmObj node);
+
+static scm_bool scope_lookup(ScmObj var, const compile_scope *scope,
+                             scm_int_t *depth, scm_int_t *index);
+static scm_bool scope_boundp(ScmObj var, const compile_scope *scope);
+static void add_free_ref(ScmObj node, scm_int_t depth,
+                         const compile_scope *scope);
+static void mark_assigned(ScmObj formals, const compile_scope *scope);
+static void add_loop_ref(ScmObj node, scm_int_t depth,
+                         const compile_scope *scope);
+static ScmObj opaque_node(ScmObj handler, ScmObj obj,
+                          const compile_scope *scope);
+static void flatten_lambdas(compile_unit *unit);
+static void flatten_lambda(ScmObj rec, compile_unit *unit);
+static scm_int_t capture_slot(ScmQueue *slotq, ScmObj *slots, scm_int_t pos,
+                              ScmObj index, ScmObj formals, ScmObj var);
+static ScmObj frame_formals(ScmObj formals);
+static ScmObj compile(ScmObj exp, const compile_scope *scope);
+static ScmObj compile_list(ScmObj exps, const compile_scope *scope);
+static ScmObj compile_ref(ScmObj var, const compile_scope *scope);
+static ScmObj compile_form(ScmObj form, const compile_scope *scope);
+static ScmObj compile_syntax(ScmObj syn, ScmObj form,
+                             const compile_scope *scope);
+#if SCM_USE_SEALED_BUILTINS
+static ScmObj compile_prim(ScmObj form, ScmObj nodes);
+#endif
+static ScmObj compile_quote(ScmObj form, const compile_scope *scope);
+static ScmObj compile_if(ScmObj form, const compile_scope *scope);
+static ScmObj compile_setx(ScmObj form, const compile_scope *scope);
+static ScmObj compile_lambda(ScmObj form, ScmObj formals, ScmObj body,
+                             const compile_scope *scope);
+static ScmObj compile_code(ScmObj formals, ScmObj body,
+                           const compile_scope *scope);
+static ScmObj compile_seq(ScmObj form, ScmObj exps,
+                          const compile_scope *scope);
+static ScmObj compile_and_or(ScmObj node, ScmObj form,
+                             const compile_scope *scope);
+static ScmObj compile_cond(ScmObj form, const compile_scope *scope);
+static ScmObj compile_cond_clauses(ScmObj clauses,
+                                   const compile_scope *scope);
+static ScmObj compile_case(ScmObj form, const compile_scope *scope);
+static ScmObj case_table(ScmObj clauses, ScmObj bodies, scm_int_t n);
+static ScmObj compile_quasiquote(ScmObj form, const compile_scope *scope);
+static scm_bool qq_compilablep(ScmObj tmpl, scm_int_t nest);
+static ScmObj compile_qq(ScmObj tmpl, scm_int_t nest,
+                         const compile_scope *scope);
+static ScmObj compile_let(ScmObj form, const compile_scope *scope);
+static ScmObj compile_letstar(ScmObj form, const compile_scope *scope);
+static ScmObj compile_letstar_bindings(ScmObj formals, ScmObj inits,
+                                       ScmObj body,
+                                       const compile_scope *scope);
+static ScmObj compile_loop(ScmObj name_formals, ScmObj formals, ScmObj code,
+                           ScmObj inits, ScmObj refs);
+static void find_tail_calls(ScmObj node, ScmObj refs, ScmQueue *callq);
+static ScmObj compile_do(ScmObj form, const compile_scope *scope);
+static ScmObj compile_letrec(ScmObj form, const compile_scope *scope);
+static scm_bool parse_bindings(ScmObj bindings, scm_bool uniquep,
+                               ScmObj *formals, ScmObj *inits);
+static ScmObj compile_body(ScmObj body, const compile_scope *scope);
+#if SCM_USE_INTERNAL_DEFINITIONS
+static ScmObj scan_definitions(ScmObj body, ScmQueue *varq, ScmQueue *expq);
+#endif
+
+/*=======================================
+  Function Definitions
+=======================================*/
+SCM_EXPORT void
+scm_init_compiler(void)
+{
+    SCM_GLOBAL_VARS_INIT(compiler);
+    SCM_GLOBAL_VARS_INIT(static_compiler);
+
+    /* closures are compiled unless --engine interpreter is specified */
+    scm_compiler_enabled = scm_true;
+
+    /* unique marker of compiled code objects */
+    scm_gc_protect_with_init(&scm_compiled_code_tag,
+                             CONS(SCM_FALSE, SCM_FALSE));
+
+    l_sym_else   = scm_intern("else");
+    l_sym_yields = scm_intern("=>");
+    l_sym_define = scm_intern("define");
+    l_sym_begin  = scm_intern("begin");
+    /* uninterned name of the slots that hold frames */
+    scm_gc_protect_with_init(&l_sym_frame,
+                             MAKE_SYMBOL(scm_strdup("(frame)"), SCM_UNBOUND));
+    scm_gc_protect_with_init(&l_syn_lambda,
+                             scm_symbol_value(scm_intern("lambda"),
+                                              SCM_INTERACTION_ENV));
+
+    init_node(&l_node_quote,      (ScmFuncType)node_quote);
+    init_node(&l_node_ref,        (ScmFuncType)node_ref);
+    init_node(&l_node_lref,       (ScmFuncType)node_lref);
+    init_node(&l_node_gref,       (ScmFuncType)node_gref);
+    init_node(&l_node_set,        (ScmFuncType)node_set);
+    init_node(&l_node_lset,       (ScmFuncType)node_lset);
+    init_node(&l_node_setg,       (ScmFuncType)node_setg);
+    init_node(&l_node_if,         (ScmFuncType)node_if);
+    init_node(&l_node_seq,        (ScmFuncType)node_seq);
+    init_node(&l_node_and,        (ScmFuncType)node_and);
+    init_node(&l_node_or,         (ScmFuncType)node_or);
+    init_node(&l_node_let,        (ScmFuncType)node_let);
+    init_node(&l_node_letrec,     (ScmFuncType)node_letrec);
+#if SCM_USE_INTERNAL_DEFINITIONS
+    init_node(&l_node_defines,    (ScmFuncType)node_defines);
+#endif
+    init_node(&l_node_named_let,  (ScmFuncType)node_named_let);
+    init_node(&l_node_loop,       (ScmFuncType)node_loop);
+    init_node(&l_node_recur,      (ScmFuncType)node_recur);
+    init_node(&l_node_do,         (ScmFuncType)node_do);
+    init_node(&l_node_lambda,     (ScmFuncType)node_lambda);
+    init_node(&l_node_flat_lambda, (ScmFuncType)node_flat_lambda);
+    init_node(&l_node_fref,       (ScmFuncType)node_fref);
+    init_node(&l_node_cref,       (ScmFuncType)node_cref);
+    init_node(&l_node_cset,       (ScmFuncType)node_cset);
+    init_node(&l_node_call,       (ScmFuncType)node_call);
+    init_node(&l_node_gcall,      (ScmFuncType)node_gcall);
+    init_node(&l_node_cond_yield, (ScmFuncType)node_cond_yield);
+    init_node(&l_node_case,       (ScmFuncType)node_case);
+    init_node(&l_node_qq_list,    (ScmFuncType)node_qq_list);
+#if SCM_USE_VECTOR
+    init_node(&l_node_qq_vector,  (ScmFuncType)node_qq_vector);
+#endif
+    init_node(&l_node_body,       (ScmFuncType)node_body);
+    init_node(&l_node_interp,     (ScmFuncType)node_interp);
+    init_node(&l_node_keyword,    (ScmFuncType)node_keyword);
+#if SCM_USE_SEALED_BUILTINS
+    init_node(&l_node_prim,       (ScmFuncType)node_prim);
+    init_node(&l_node_folded,     (ScmFuncType)node_folded);
+#endif
+    l_env_captures = 0;
+
+#if SCM_USE_STACK_FRAME
+    scm_stack_frame_sp = 0;
+    scm_gc_protect_with_init(&l_stack_frames,
+                             scm_p_make_vector(MAKE_INT(STACK_FRAME_MAX),
+                                               LIST_1(SCM_FALSE)));
+    /* free lists of the frames indexed by the number of the values */
+    scm_gc_protect_with_init(&l_frame_pool,
+                             scm_p_make_vector(MAKE_INT(POOLED_FRAME_LEN_MAX),
+                                               LIST_1(SCM_NULL)));
+#endif
+}
+
+static void
+init_node(ScmObj *node, ScmFuncType handler)
+{
+    scm_gc_protect_with_init(node,
+                             MAKE_FUNC(SCM_SYNTAX_VARIADIC_TAILREC_0, handler));
+}
+
+/* Replace the (<formals> . <body>) of CLOSURE with compiled code if not yet
+ * compiled, and return the code. */
+SCM_EXPORT ScmObj
+scm_compile_closure(ScmObj closure)
+{
+    compile_unit unit;
+    compile_scope scope;
+    ScmObj exp;
+
+    SCM_ASSERT(CLOSUREP(closure));
+
+    exp = SCM_CLOSURE_EXP(closure);
+    if (!COMPILED_CODEP(exp)) {
+        unit.lambdas = unit.assigned = unit.loops = SCM_NULL;
+        SCM_QUEUE_POINT_TO(unit.lambdaq, unit.lambdas);
+        scope.frames = SCM_NULL;
+        scope.env = SCM_CLOSURE_ENV(closure);
+        scope.lambda = SCM_FALSE;
+        scope.unit = &unit;
+        exp = compile_code(CAR(exp), CDR(exp), &scope);
+        flatten_lambdas(&unit);
+        SCM_CLOSURE_SET_EXP(closure, exp);
+    }
+
+    return exp;
+}
+
+/* Make the loops in progress switch to fresh frames for the next
+ * iteration, since their current frames may have been captured. */
+SCM_EXPORT void
+scm_invalidate_loop_frames(void)
+{
+    l_env_captures = (l_env_captures + 1) & SCM_INT_MAX;
+}
+
+#if SCM_USE_STACK_FRAME
+/*===========================================================================
+  Stack Frames
+===========================================================================*/
+/* Make a vector frame for an activation of code whose frame does not
+ * escape. The frame is pushed onto the stack of frames to be reused after
+ * the activation. */
+SCM_EXPORT ScmObj
+scm_make_stack_frame(ScmObj formals, scm_int_t len)
+{
+    ScmObj frame, *pool;
+
+    pool = SCM_VECTOR_VEC(l_frame_pool);
+    if (len < POOLED_FRAME_LEN_MAX && !NULLP(pool[len])) {
+        /* pooled frames are chained by the formals and already unbound */
+        frame = pool[len];
+        pool[len] = VECTOR_FRAME_FORMALS(frame);
+        VECTOR_FRAME_FORMALS(frame) = formals;
+    } else {
+        frame = scm_make_vector_frame(formals, len);
+    }
+
+    /* the frames over the capacity are left to the GC */
+    if (scm_stack_frame_sp < STACK_FRAME_MAX)
+        SCM_VECTOR_VEC(l_stack_frames)[scm_stack_frame_sp++] = frame;
+
+    return frame;
+}
+
+/* Release the frames above SP into the pool. They must not be referred from
+ * anywhere. */
+SCM_EXPORT void
+scm_release_stack_frames(scm_int_t sp)
+{
+    ScmObj *frames;
+
+    frames = SCM_VECTOR_VEC(l_stack_frames);
+    while (scm_stack_frame_sp > sp)
+        release_frame(frames[--scm_stack_frame_sp]);
+}
+
+/* Same as scm_release_stack_frames() except that the top frame is kept as
+ * the one just above SP. */
+SCM_EXPORT void
+scm_release_stack_frames_but_top(scm_int_t sp)
+{
+    ScmObj *frames, top;
+
+    frames = SCM_VECTOR_VEC(l_stack_frames);
+    top = frames[--scm_stack_frame_sp];
+    scm_release_stack_frames(sp);
+    frames[scm_stack_frame_sp++] = top;
+}
+
+SCM_EXPORT scm_bool
+scm_top_stack_framep(ScmObj frame)
+{
+    ScmObj *frames;
+
+    frames = SCM_VECTOR_VEC(l_stack_frames);
+    return (scm_stack_frame_sp && EQ(frame, frames[scm_stack_frame_sp - 1]));
+}
+
+/* Forget the frames above SP without reusing them, since they may be still
+ * referred. */
+SCM_EXPORT void
+scm_drop_stack_frames(scm_int_t sp)
+{
+    if (scm_stack_frame_sp > sp)
+        scm_stack_frame_sp = sp;
+}
+
+static void
+release_frame(ScmObj frame)
+{
+    ScmObj *pool, *vals;
+    scm_int_t len, i;
+
+    len = VECTOR_FRAME_LEN(frame);
+    if (len < POOLED_FRAME_LEN_MAX) {
+        /* unbind the values to not retain them */
+        vals = VECTOR_FRAME_VALUES(frame);
+        for (i = 0; i < len; i++)
+            vals[i] = SCM_UNBOUND;
+
+        pool = SCM_VECTOR_VEC(l_frame_pool);
+        VECTOR_FRAME_FORMALS(frame) = pool[len];
+        pool[len] = frame;
+    }
+}
+#endif /* SCM_USE_STACK_FRAME */
+
+/*===========================================================================
+  Nodes
+===========================================================================*/
+/* (<quote> . <datum>) */
+static ScmObj
+node_quote(ScmObj datum, ScmEvalState *eval_state)
+{
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return datum;
+}
+
+/* (<ref> . <identifier>): variable looked up by name */
+static ScmObj
+node_ref(ScmObj var, ScmEvalState *eval_state)
+{
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return scm_symbol_value(var, eval_state->env);
+}
+
+/* (<lref> <depth> <index> . <symbol>): variable of a frame created by
+ * compiled code */
+static ScmObj
+node_lref(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj val;
+    DECLARE_INTERNAL_FUNCTION("scm_symbol_value");
+
+    val = DEREF(scm_lookup_lexical(SCM_INT_VALUE(CAR(operands)),
+                                   SCM_INT_VALUE(CADR(operands)),
+                                   eval_state->env));
+    /* unassigned variable of letrec or internal definitions */
+    if (EQ(val, SCM_UNBOUND))
+        ERR_OBJ("unbound variable", CDDR(operands));
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return val;
+}
+
+/* (<gref> . <symbol>): toplevel variable */
+static ScmObj
+node_gref(ScmObj sym, ScmEvalState *eval_state)
+{
+    ScmObj val;
+    DECLARE_INTERNAL_FUNCTION("scm_symbol_value");
+
+    val = SCM_SYMBOL_VCELL(sym);
+    if (EQ(val, SCM_UNBOUND))
+        ERR_OBJ("unbound variable", sym);
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return val;
+}
+
+/* (<set> <identifier> . <exp node>) */
+static ScmObj
+node_set(ScmObj operands, ScmEvalState *eval_state)
+{
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return scm_s_setx(CAR(operands), CDR(operands), eval_state->env);
+}
+
+/* (<lset> <depth> <index> <symbol> . <exp node>) */
+static ScmObj
+node_lset(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env, val;
+    ScmRef ref;
+    scm_int_t depth, index;
+    DECLARE_INTERNAL_FUNCTION("set!");
+
+    env = eval_state->env;
+    depth = SCM_INT_VALUE(CAR(operands));
+    operands = CDR(operands);
+    index = SCM_INT_VALUE(CAR(operands));
+    operands = CDR(operands);
+    val = EVAL(CDR(operands), env);
+    CHECK_VALID_EVALED_VALUE(val);
+    ref = scm_lookup_lexical(depth, index, env);
+    /* the variables of letrec are not visible until assigned */
+    if (EQ(DEREF(ref), SCM_UNBOUND))
+        ERR_OBJ("unbound variable", CAR(operands));
+    SET(ref, val);
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+#if SCM_STRICT_R5RS
+    return SCM_UNDEF;
+#else
+    return val;
+#endif
+}
+
+/* (<setg> <symbol> . <exp node>) */
+static ScmObj
+node_setg(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj sym, val;
+    DECLARE_INTERNAL_FUNCTION("set!");
+
+    sym = CAR(operands);
+    val = EVAL(CDR(operands), eval_state->env);
+    CHECK_VALID_EVALED_VALUE(val);
+    if (!SCM_SYMBOL_BOUNDP(sym))
+        ERR_OBJ("unbound variable", sym);
+    SCM_SYMBOL_SET_VCELL(sym, val);
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+#if SCM_STRICT_R5RS
+    return SCM_UNDEF;
+#else
+    return val;
+#endif
+}
+
+/* (<if> <test node> <consequent node> . <alternate node>) */
+static ScmObj
+node_if(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj test;
+    DECLARE_INTERNAL_FUNCTION("if");
+
+    test = EVAL(CAR(operands), eval_state->env);
+    CHECK_VALID_EVALED_VALUE(test);
+    operands = CDR(operands);
+
+    return (TRUEP(test)) ? CAR(operands) : CDR(operands);
+}
+
+/* (<seq> <node> ...) */
+static ScmObj
+node_seq(ScmObj nodes, ScmEvalState *eval_state)
+{
+    ScmObj env, node, val;
+    DECLARE_INTERNAL_FUNCTION("begin");
+
+    env = eval_state->env;
+    FOR_EACH_BUTLAST (node, nodes) {
+        val = EVAL(node, env);
+        CHECK_VALID_EVALED_VALUE(val);
+    }
+
+    return node;
+}
+
+/* (<and> <node> ...) */
+static ScmObj
+node_and(ScmObj nodes, ScmEvalState *eval_state)
+{
+    ScmObj env, node, val;
+    DECLARE_INTERNAL_FUNCTION("and");
+
+    env = eval_state->env;
+    FOR_EACH_BUTLAST (node, nodes) {
+        val = EVAL(node, env);
+        CHECK_VALID_EVALED_VALUE(val);
+        if (FALSEP(val)) {
+            eval_state->ret_type = SCM_VALTYPE_AS_IS;
+            return SCM_FALSE;
+        }
+    }
+
+    return node;
+}
+
+/* (<or> <node> ...) */
+static ScmObj
+node_or(ScmObj nodes, ScmEvalState *eval_state)
+{
+    ScmObj env, node, val;
+    DECLARE_INTERNAL_FUNCTION("or");
+
+    env = eval_state->env;
+    FOR_EACH_BUTLAST (node, nodes) {
+        val = EVAL(node, env);
+        CHECK_VALID_EVALED_VALUE(val);
+        if (TRUEP(val)) {
+            eval_state->ret_type = SCM_VALTYPE_AS_IS;
+            return val;
+        }
+    }
+
+    return node;
+}
+
+/* (<let> <formals> <init nodes> . <body node>) */
+static ScmObj
+node_let(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj formals, inits;
+    DECLARE_INTERNAL_FUNCTION("let");
+
+    formals = POP(operands);
+    inits = POP(operands);
+    eval_state->env = extend_by_nodes(formals, inits, eval_state->env,
+                                      eval_state->env);
+
+    return operands;
+}
+
+/* (<letrec> <formals> <init nodes> . <body node>)
+ *
+ * Same as scm_s_letrec_internal(), the inits are evaluated in the env
+ * extended by a placeholder frame. The variables are bound but unassigned in
+ * the frame to keep the lexical addresses of the inits valid. */
+static ScmObj
+node_letrec(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env, formals, actuals;
+    DECLARE_INTERNAL_FUNCTION("letrec");
+
+    formals = POP(operands);
+    env = extend_unassigned(formals, eval_state->env);
+    actuals = eval_nodes(POP(operands), env);
+    eval_state->env = scm_update_environment(actuals, env);
+
+    return operands;
+}
+
+#if SCM_USE_INTERNAL_DEFINITIONS
+/* (<defines> <formals> <init nodes> . <body node>)
+ *
+ * Internal definitions of a body. Same as scm_s_body(), the inits are
+ * evaluated in the env in which the variables are bound but unassigned. */
+static ScmObj
+node_defines(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env, formals, inits, actuals;
+    DECLARE_INTERNAL_FUNCTION("(body)");
+
+    formals = POP(operands);
+    inits = POP(operands);
+
+    env = extend_unassigned(formals, eval_state->env);
+
+    actuals = eval_nodes(inits, env);
+    eval_state->env = scm_update_environment(actuals, env);
+
+    return operands;
+}
+#endif /* SCM_USE_INTERNAL_DEFINITIONS */
+
+/* (<named-let> (<name>) <code> . <init nodes>) */
+static ScmObj
+node_named_let(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj name_formals, code, env, proc;
+    DECLARE_INTERNAL_FUNCTION("let");
+
+    name_formals = POP(operands);
+    code = POP(operands);
+
+    env = extend_unassigned(name_formals, eval_state->env);
+    proc = MAKE_CLOSURE(code, env);
+    env = scm_update_environment(LIST_1(proc), env);
+    SCM_CLOSURE_SET_ENV(proc, env);
+
+    /* enter the loop as if the closure is called. The frame of the name is
+     * not visible from the inits. */
+    eval_state->env = extend_by_nodes(CODE_FORMALS(code), operands,
+                                      eval_state->env, env);
+
+    return CODE_BODY(code);
+}
+
+/* (<loop> <name formals> <formals> <body node> . <init nodes>)
+ *
+ * Named let whose name is only called by the recur nodes in its body. The
+ * frame of the name is kept to not change the lexical addresses, and holds
+ * (<l_env_captures at the last fresh frame> . <operands>) for the recur
+ * nodes. */
+static ScmObj
+node_loop(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env;
+
+    env = extend_unassigned(CAR(operands), eval_state->env);
+    SET(scm_lookup_lexical(0, 0, env),
+        CONS(MAKE_INT(l_env_captures), operands));
+    eval_state->env = extend_by_nodes(CADR(operands), CDR(CDDR(operands)),
+                                      eval_state->env, env);
+
+    return CAR(CDDR(operands));
+}
+
+/* (<recur> <depth> . <arg nodes>): call of the name of a loop node in a tail
+ * position. <depth> is the number of the frames above the frame of the loop
+ * variables. */
+static ScmObj
+node_recur(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env, arg, state, loop, vals[LOOP_VARS_MAX];
+    scm_int_t depth, n;
+    DECLARE_INTERNAL_FUNCTION("let");
+
+    env = eval_state->env;
+    depth = SCM_INT_VALUE(POP(operands));
+    n = 0;
+    FOR_EACH (arg, operands) {
+        vals[n] = EVAL(arg, env);
+        CHECK_VALID_EVALED_VALUE(vals[n]);
+        n++;
+    }
+
+    for (; depth; depth--)
+        env = CDR(env);
+    state = DEREF(scm_lookup_lexical(1, 0, env));
+    loop = CDR(state);
+    if (SCM_INT_VALUE(CAR(state)) == l_env_captures) {
+        update_frame(env, vals, n);
+    } else {
+        /* the frame may have been captured */
+        env = extend_by_values(CADR(loop), vals, n, CDR(env));
+        SET_CAR(state, MAKE_INT(l_env_captures));
+    }
+    eval_state->env = env;
+
+    return CAR(CDDR(loop));
+}
+
+/* (<do> <formals> <init nodes> <in place?> <test node> <exit node>
+ *  <step nodes> . <command nodes>) */
+static ScmObj
+node_do(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj outer_env, env, formals, test, exit, steps, rest, node;
+    ScmObj vals[LOOP_VARS_MAX];
+    scm_int_t captures, n;
+    scm_bool in_placep;
+    DECLARE_INTERNAL_FUNCTION("do");
+
+    outer_env = eval_state->env;
+    formals = POP(operands);
+    env = extend_by_nodes(formals, POP(operands), outer_env, outer_env);
+    in_placep = TRUEP(POP(operands));
+    test = POP(operands);
+    exit = POP(operands);
+    steps = POP(operands);
+
+    captures = l_env_captures;
+    while (FALSEP(EVAL(test, env))) {
+        rest = operands;
+        FOR_EACH (node, rest)
+            EVAL(node, env);
+
+        if (!in_placep) {
+            /* the frame of each iteration may be captured */
+            env = extend_by_nodes(formals, steps, env, outer_env);
+            continue;
+        }
+        n = 0;
+        rest = steps;
+        FOR_EACH (node, rest) {
+            vals[n] = EVAL(node, env);
+            CHECK_VALID_EVALED_VALUE(vals[n]);
+            n++;
+        }
+        if (captures == l_env_captures) {
+            update_frame(env, vals, n);
+        } else {
+            env = extend_by_values(formals, vals, n, outer_env);
+            captures = l_env_captures;
+        }
+    }
+    eval_state->env = env;
+
+    return exit;
+}
+
+/* (<lambda> . <code>) */
+static ScmObj
+node_lambda(ScmObj code, ScmEvalState *eval_state)
+{
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return MAKE_CLOSURE(code, eval_state->env);
+}
+
+/* (<flat-lambda> <code> <frame count> <slot formals> . <capture nodes>) */
+static ScmObj
+node_flat_lambda(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj code, formals, env;
+    scm_int_t i;
+    DECLARE_INTERNAL_FUNCTION("lambda");
+
+    code = POP(operands);
+    i = SCM_INT_VALUE(POP(operands));
+    formals = POP(operands);
+
+    /* skip the compiled frames */
+    for (env = eval_state->env; i; i--)
+        env = CDR(env);
+    if (!NULLP(formals))
+        env = extend_by_nodes(formals, operands, eval_state->env, env);
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return MAKE_CLOSURE(code, env);
+}
+
+/* (<fref> <depth> . <formals>): frame to be captured by a flat closure */
+static ScmObj
+node_fref(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env;
+    scm_int_t depth;
+
+    env = eval_state->env;
+    for (depth = SCM_INT_VALUE(CAR(operands)); depth; depth--)
+        env = CDR(env);
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return CAR(env);
+}
+
+/* (<cref> <depth> <slot> <index> . <symbol>): variable of a frame captured
+ * by a flat closure */
+static ScmObj
+node_cref(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj frame, val;
+    DECLARE_INTERNAL_FUNCTION("scm_symbol_value");
+
+    frame = DEREF(scm_lookup_lexical(SCM_INT_VALUE(CAR(operands)),
+                                     SCM_INT_VALUE(CADR(operands)),
+                                     eval_state->env));
+    operands = CDDR(operands);
+    val = DEREF(scm_lookup_frame_lexical(SCM_INT_VALUE(CAR(operands)),
+                                         frame));
+    if (EQ(val, SCM_UNBOUND))
+        ERR_OBJ("unbound variable", CDR(operands));
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return val;
+}
+
+/* (<cset> <depth> <slot> <index> <symbol> . <exp node>) */
+static ScmObj
+node_cset(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env, frame, val;
+    ScmRef ref;
+    scm_int_t depth, slot, index;
+    DECLARE_INTERNAL_FUNCTION("set!");
+
+    env = eval_state->env;
+    depth = SCM_INT_VALUE(POP(operands));
+    slot = SCM_INT_VALUE(POP(operands));
+    index = SCM_INT_VALUE(POP(operands));
+    val = EVAL(CDR(operands), env);
+    CHECK_VALID_EVALED_VALUE(val);
+    frame = DEREF(scm_lookup_lexical(depth, slot, env));
+    ref = scm_lookup_frame_lexical(index, frame);
+    if (EQ(DEREF(ref), SCM_UNBOUND))
+        ERR_OBJ("unbound variable", CAR(operands));
+    SET(ref, val);
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+#if SCM_STRICT_R5RS
+    return SCM_UNDEF;
+#else
+    return val;
+#endif
+}
+
+/* (<call> <form> <operator node> . <operand nodes>) */
+static ScmObj
+node_call(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj form, proc;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    form = POP(operands);
+    proc = EVAL(POP(operands), eval_state->env);
+
+    /* The operator has been turned into a syntax or macro after the
+     * compilation. Let the interpreter process the original form. */
+    if (SYNTACTIC_OBJECTP(proc)) {
+        /* the form may capture the env */
+        scm_invalidate_loop_frames();
+#if SCM_USE_STACK_FRAME
+        scm_drop_stack_frames(0);
+#endif
+        return scm_tailcall(proc, CDR(form), eval_state,
+                            SCM_VALTYPE_NEED_EVAL);
+    }
+
+    /* PROC must not be evaluated again by call() */
+    if (!PROCEDUREP(proc))
+        ERR_OBJ("procedure or syntax required but got", proc);
+
+    /* the operand nodes are evaluated by call() as ordinary expressions */
+    return scm_tailcall(proc, operands, eval_state, SCM_VALTYPE_NEED_EVAL);
+}
+
+/* (<gcall> <cached proc> <form> <gref node> . <operand nodes>): call of a
+ * toplevel variable with a monomorphic inline cache. While the variable holds
+ * the cached C procedure, whose arity is known to match the operands, it is
+ * invoked directly without the type dispatch of call(). The cache is
+ * validated by the identity of the value, so that define and set! of the
+ * variable need not invalidate it. */
+static ScmObj
+node_gcall(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj proc, env, args, argbuf[SCM_FUNCTYPE_MAND_MAX];
+    ScmObj (*func)();
+    int mand_count, i;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    args = CDR(CDR(operands));
+    proc = SCM_SYMBOL_VCELL(CDR(CAR(args)));
+    if (!EQ(proc, CAR(operands))) {
+        if (!FIXED_CPROCEDUREP(proc)
+            || (scm_length(CDR(args))
+                != (SCM_FUNC_TYPECODE(proc) & SCM_FUNCTYPE_MAND_MASK)))
+            return node_call(CDR(operands), eval_state);
+        SET_CAR(operands, proc);
+    }
+
+    env = eval_state->env;
+    args = CDR(args);
+    mand_count = SCM_FUNC_TYPECODE(proc) & SCM_FUNCTYPE_MAND_MASK;
+    for (i = 0; i < mand_count; i++) {
+        argbuf[i] = EVAL(POP(args), env);
+        CHECK_VALID_EVALED_VALUE(argbuf[i]);
+    }
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    func = SCM_FUNC_CFUNC(proc);
+    switch (mand_count) {
+    case 0:
+        return (*func)();
+    case 1:
+        return (*func)(argbuf[0]);
+    case 2:
+        return (*func)(argbuf[0], argbuf[1]);
+#if SCM_FUNCTYPE_MAND_MAX >= 3
+    case 3:
+        return (*func)(argbuf[0], argbuf[1], argbuf[2]);
+#endif
+#if SCM_FUNCTYPE_MAND_MAX >= 4
+    case 4:
+        return (*func)(argbuf[0], argbuf[1], argbuf[2], argbuf[3]);
+#endif
+#if SCM_FUNCTYPE_MAND_MAX >= 5
+    case 5:
+        return (*func)(argbuf[0], argbuf[1], argbuf[2], argbuf[3], argbuf[4]);
+#endif
+    default:
+        SCM_NOTREACHED;
+    }
+}
+
+#if SCM_USE_SEALED_BUILTINS
+/* (<prim> (<builtin> . <prim op>) <form> <gref node> . <operand nodes>):
+ * inlined call of a builtin. The number of the operand nodes matches the
+ * prim op. */
+static ScmObj
+node_prim(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj proc, args, env, left, right, ret;
+    enum prim_op op;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    proc = CAR(CAR(operands));
+    args = CDR(CDR(operands));
+    /* deoptimized */
+    if (!EQ(SCM_SYMBOL_VCELL(CDR(CAR(args))), proc))
+        return node_call(CDR(operands), eval_state);
+
+    op = (enum prim_op)SCM_INT_VALUE(CDR(CAR(operands)));
+    env = eval_state->env;
+    args = CDR(args);
+    left = EVAL(POP(args), env);
+    CHECK_VALID_EVALED_VALUE(left);
+    right = SCM_INVALID;
+    if (prim_table[op].argc == 2) {
+        right = EVAL(CAR(args), env);
+        CHECK_VALID_EVALED_VALUE(right);
+    }
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    switch (op) {
+    case PRIM_CAR:
+        if (CONSP(left))
+            return CAR(left);
+        break;
+    case PRIM_CDR:
+        if (CONSP(left))
+            return CDR(left);
+        break;
+    case PRIM_CONS:
+        return CONS(left, right);
+    case PRIM_EQP:
+        return MAKE_BOOL(EQ(left, right));
+    case PRIM_NULLP:
+        return MAKE_BOOL(NULLP(left));
+    case PRIM_PAIRP:
+        return MAKE_BOOL(CONSP(left));
+    case PRIM_NOT:
+        return MAKE_BOOL(FALSEP(left));
+    default:
+        if (prim_fixnum(op, left, right, &ret))
+            return ret;
+        break;
+    }
+
+    /* other types and errors */
+    return prim_call(proc, left, right);
+}
+
+/* (<folded> <value> <builtins> . <prim node>): constant <prim node> folded
+ * into <value>. <builtins> is an alist of (<symbol> . <builtin>) that the
+ * value depends on. */
+static ScmObj
+node_folded(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj deps, dep;
+
+    deps = CADR(operands);
+    FOR_EACH (dep, deps) {
+        if (!EQ(SCM_SYMBOL_VCELL(CAR(dep)), CDR(dep)))
+            return CDDR(operands);
+    }
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return CAR(operands);
+}
+
+/* Same as the builtins for fixnums. Returns false for the other types and
+ * the errors. */
+static scm_bool
+prim_fixnum(enum prim_op op, ScmObj left, ScmObj right, ScmObj *result)
+{
+    scm_int_t l, r, ret;
+
+    if (!INTP(left) || (prim_table[op].argc == 2 && !INTP(right)))
+        return scm_false;
+
+    l = SCM_INT_VALUE(left);
+    r = (prim_table[op].argc == 2) ? SCM_INT_VALUE(right) : 0;
+    switch (op) {
+    case PRIM_ADD:
+        ret = l + r;
+        if (INT_OUT_OF_RANGEP(ret) || (r > 0 && ret < l) || (r < 0 && ret > l))
+            return scm_false;
+        *result = MAKE_INT(ret);
+        return scm_true;
+    case PRIM_SUBTRACT:
+        ret = l - r;
+        if (INT_OUT_OF_RANGEP(ret) || (r > 0 && ret > l) || (r < 0 && ret < l))
+            return scm_false;
+        *result = MAKE_INT(ret);
+        return scm_true;
+    case PRIM_MULTIPLY:
+        /* no overflow check as well as scm_p_multiply() */
+        *result = MAKE_INT(l * r);
+        return scm_true;
+    case PRIM_EQUAL:
+        *result = MAKE_BOOL(l == r);
+        return scm_true;
+    case PRIM_LESS:
+        *result = MAKE_BOOL(l < r);
+        return scm_true;
+    case PRIM_LESS_EQUAL:
+        *result = MAKE_BOOL(l <= r);
+        return scm_true;
+    case PRIM_GREATER:
+        *result = MAKE_BOOL(l > r);
+        return scm_true;
+    case PRIM_GREATER_EQUAL:
+        *result = MAKE_BOOL(l >= r);
+        return scm_true;
+    case PRIM_ZEROP:
+        *result = MAKE_BOOL(l == 0);
+        return scm_true;
+    default:
+        return scm_false;
+    }
+}
+
+/* Call PROC with the evaluated args as call() does. */
+static ScmObj
+prim_call(ScmObj proc, ScmObj left, ScmObj right)
+{
+    ScmObj (*func)();
+    ScmBinaryOperator binary;
+    enum ScmReductionState state;
+
+    func = SCM_FUNC_CFUNC(proc);
+    if (SCM_FUNC_TYPECODE(proc) == SCM_REDUCTION_OPERATOR) {
+        /* reduce() for 2 args */
+        binary = scm_lookup_binary_operator(func);
+        if (binary)
+            return (*binary)(left, right);
+        state = SCM_REDUCE_LAST;
+        return (*func)(left, right, &state);
+    }
+    if (VALIDP(right))
+        return (*func)(left, right);
+    return (*func)(left);
+}
+#endif /* SCM_USE_SEALED_BUILTINS */
+
+/* (<cond-yield> <test node> <recipient node> . <rest node>) */
+static ScmObj
+node_cond_yield(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj env, test, proc;
+    DECLARE_INTERNAL_FUNCTION("cond");
+
+    env = eval_state->env;
+    test = EVAL(POP(operands), env);
+    CHECK_VALID_EVALED_VALUE(test);
+    if (FALSEP(test))
+        return CDR(operands);
+
+    proc = EVAL(CAR(operands), env);
+    if (!PROCEDUREP(proc))
+        ERR_OBJ("exp after => must be a procedure but got", proc);
+
+    return scm_tailcall(proc, LIST_1(test), eval_state, SCM_VALTYPE_AS_IS);
+}
+
+/* (<case> <key node> <table> <else node> . <body nodes>)
+ *
+ * <table> is either (<min> . <vector>) whose element at <key> - <min> is the
+ * pair of the matched body node in <body nodes>, or a hash table vector whose
+ * entries are (<datum> . <the pair>). An empty entry is #f. */
+static ScmObj
+node_case(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj key, table, entry, *vec;
+    scm_int_t i;
+    scm_uint_t mask, h;
+    DECLARE_INTERNAL_FUNCTION("case");
+
+    key = EVAL(POP(operands), eval_state->env);
+    CHECK_VALID_EVALED_VALUE(key);
+    table = POP(operands);
+
+    if (CONSP(table)) {
+        if (INTP(key)) {
+            i = SCM_INT_VALUE(key) - SCM_INT_VALUE(CAR(table));
+            if (0 <= i && i < SCM_VECTOR_LEN(CDR(table))) {
+                entry = SCM_VECTOR_VEC(CDR(table))[i];
+                if (TRUEP(entry))
+                    return CAR(entry);
+            }
+        }
+    } else if (CASE_DATUMP(key)) {
+        vec = SCM_VECTOR_VEC(table);
+        mask = SCM_VECTOR_LEN(table) - 1;
+        for (h = case_hash(key) & mask;
+             TRUEP(entry = vec[h]);
+             h = (h + 1) & mask)
+        {
+            if (case_eqvp(CAR(entry), key))
+                return CADR(entry);
+        }
+    }
+
+    /* no clause matched */
+    return CAR(operands);
+}
+
+static scm_uint_t
+case_hash(ScmObj datum)
+{
+    scm_uint_t h;
+
+    if (SYMBOLP(datum))
+        h = (scm_uint_t)((scm_uintobj_t)datum >> 4);
+    else if (CHARP(datum))
+        h = (scm_uint_t)SCM_CHAR_VALUE(datum);
+    else
+        h = (scm_uint_t)SCM_INT_VALUE(datum);
+
+    /* spread consecutive values over the table */
+    return h * 2654435761U;
+}
+
+/* eqv? for the data of a hashed 'case' */
+static scm_bool
+case_eqvp(ScmObj datum, ScmObj key)
+{
+    if (EQ(datum, key))
+        return scm_true;
+    if (INTP(datum))
+        return (INTP(key) && SCM_INT_VALUE(datum) == SCM_INT_VALUE(key));
+    if (CHARP(datum))
+        return (CHARP(key) && SCM_CHAR_VALUE(datum) == SCM_CHAR_VALUE(key));
+
+    return scm_false;
+}
+
+/* (<qq-list> <tail> . <elements>): list of a quasiquote template. <tail> is
+ * the element for the rest of the list, which is either the constant rest of
+ * the template or an unquoted expression. */
+static ScmObj
+node_qq_list(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj ret, tail, elm, val;
+    ScmQueue q;
+
+    ret = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, ret);
+    tail = CAR(operands);
+    for (operands = CDR(operands); CONSP(operands); operands = CDR(operands)) {
+        elm = CAR(operands);
+        val = qq_value(elm, eval_state->env);
+        if (QQ_ELM_KIND(elm) == QQ_SPLICE)
+            qq_splice(&q, val);
+        else
+            SCM_QUEUE_ADD(q, val);
+    }
+    SCM_QUEUE_SLOPPY_APPEND(q, qq_value(tail, eval_state->env));
+
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    return ret;
+}
+
+#if SCM_USE_VECTOR
+/* (<qq-vector> <length> . <elements>): vector of a quasiquote template.
+ * <length> is #f if some elements are spliced. */
+static ScmObj
+node_qq_vector(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj ret, len, elm, vals, *vec;
+    ScmQueue q;
+    scm_int_t i;
+
+    len = CAR(operands);
+    operands = CDR(operands);
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    if (INTP(len)) {
+        ret = scm_p_make_vector(len, SCM_NULL);
+        vec = SCM_VECTOR_VEC(ret);
+        for (i = 0; CONSP(operands); operands = CDR(operands)) {
+            /* ret may get old while evaluating the element */
+            elm = qq_value(CAR(operands), eval_state->env);
+            SCM_WRITE_BARRIER(ret);
+            vec[i++] = elm;
+        }
+        return ret;
+    }
+
+    vals = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, vals);
+    for (; CONSP(operands); operands = CDR(operands)) {
+        elm = CAR(operands);
+        if (QQ_ELM_KIND(elm) == QQ_SPLICE)
+            qq_splice(&q, qq_value(elm, eval_state->env));
+        else
+            SCM_QUEUE_ADD(q, qq_value(elm, eval_state->env));
+    }
+    return scm_p_list2vector(vals);
+}
+#endif /* SCM_USE_VECTOR */
+
+static ScmObj
+qq_value(ScmObj elm, ScmObj env)
+{
+    DECLARE_INTERNAL_FUNCTION("quasiquote");
+
+    if (QQ_ELM_KIND(elm) == QQ_CONSTANT)
+        return CDR(QQ_ELM_NODE(elm));
+    return EVAL(QQ_ELM_NODE(elm), env);
+}
+
+/* Append a copy of LST, so that the list is not shared by the result. */
+static void
+qq_splice(ScmQueue *q, ScmObj lst)
+{
+    DECLARE_INTERNAL_FUNCTION("quasiquote");
+
+    for (; CONSP(lst); lst = CDR(lst))
+        SCM_QUEUE_ADD(*q, CAR(lst));
+    if (!NULLP(lst))
+        ERR(",@<x> must evaluate to a proper list");
+}
+
+/* (<body> . <body>): body that is not analyzed */
+static ScmObj
+node_body(ScmObj body, ScmEvalState *eval_state)
+{
+    return scm_s_body(body, eval_state);
+}
+
+/* (<interp> . <form>): form that is not analyzed */
+static ScmObj
+node_interp(ScmObj form, ScmEvalState *eval_state)
+{
+    return form;
+}
+
+/* (<keyword> <symbol> <syntax> <form> . <node>): form of a syntactic
+ * keyword bound at the toplevel. The node is valid while the variable holds
+ * the syntax. */
+static ScmObj
+node_keyword(ScmObj operands, ScmEvalState *eval_state)
+{
+    ScmObj syn;
+
+    syn = CADR(operands);
+    if (EQ(SCM_SYMBOL_VCELL(CAR(operands)), syn))
+        return CDR(CDDR(operands));
+
+    /* The keyword has been redefined after the compilation. Let the
+     * interpreter process the original form, which may capture the env. */
+    scm_invalidate_loop_frames();
+#if SCM_USE_STACK_FRAME
+    scm_drop_stack_frames(0);
+#endif
+    return CAR(CDDR(operands));
+}
+
+/* Extend ENV by a frame in which the proper list FORMALS are bound to the
+ * values of NODES evaluated in EVAL_ENV. */
+static ScmObj
+extend_by_nodes(ScmObj formals, ScmObj nodes, ScmObj eval_env, ScmObj env)
+{
+#if SCM_USE_VECTOR_FRAME
+    ScmObj frame, node, val;
+    scm_int_t i;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    /* evaluate the values directly into the frame */
+    frame = scm_make_vector_frame(formals, scm_finite_length(formals));
+    i = 0;
+    FOR_EACH (node, nodes) {
+        val = EVAL(node, eval_env);
+        CHECK_VALID_EVALED_VALUE(val);
+        VECTOR_FRAME_VALUES(frame)[i++] = val;
+    }
+
+    return scm_extend_environment_by_frame(frame, env);
+#else
+    return scm_extend_environment(formals, eval_nodes(nodes, eval_env), env);
+#endif
+}
+
+/* Extend ENV by a frame in which the proper list FORMALS are bound but
+ * unassigned. */
+static ScmObj
+extend_unassigned(ScmObj formals, ScmObj env)
+{
+#if SCM_USE_VECTOR_FRAME
+    return scm_extend_environment_by_frame(
+        scm_make_vector_frame(formals, scm_finite_length(formals)), env);
+#else
+    ScmQueue q;
+    ScmObj actuals, rest;
+
+    actuals = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, actuals);
+    FOR_EACH_PAIR (rest, formals)
+        SCM_QUEUE_ADD(q, SCM_UNBOUND);
+
+    return scm_extend_environment(formals, actuals, env);
+#endif
+}
+
+/* Extend ENV by a frame in which the proper list FORMALS are bound to the N
+ * values of VALS. */
+static ScmObj
+extend_by_values(ScmObj formals, const ScmObj *vals, scm_int_t n, ScmObj env)
+{
+#if SCM_USE_VECTOR_FRAME
+    ScmObj frame;
+    scm_int_t i;
+
+    frame = scm_make_vector_frame(formals, n);
+    for (i = 0; i < n; i++)
+        VECTOR_FRAME_VALUES(frame)[i] = vals[i];
+
+    return scm_extend_environment_by_frame(frame, env);
+#else
+    ScmObj actuals;
+
+    actuals = SCM_NULL;
+    while (n)
+        actuals = CONS(vals[--n], actuals);
+
+    return scm_extend_environment(formals, actuals, env);
+#endif
+}
+
+/* Replace the N values of the recentmost frame of ENV with VALS in place. */
+static void
+update_frame(ScmObj env, const ScmObj *vals, scm_int_t n)
+{
+    ScmObj frame, actuals;
+    scm_int_t i;
+
+    frame = CAR(env);
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame)) {
+        for (i = 0; i < n; i++)
+            VECTOR_FRAME_VALUES(frame)[i] = vals[i];
+        return;
+    }
+#endif
+    for (i = 0, actuals = CDR(frame); i < n; i++, actuals = CDR(actuals))
+        SET_CAR(actuals, vals[i]);
+}
+
+static ScmObj
+eval_nodes(ScmObj nodes, ScmObj env)
+{
+    ScmQueue q;
+    ScmObj ret, node, val;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    ret = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, ret);
+    FOR_EACH (node, nodes) {
+        val = EVAL(node, env);
+        CHECK_VALID_EVALED_VALUE(val);
+        SCM_QUEUE_ADD(q, val);
+    }
+
+    return ret;
+}
+
+/*===========================================================================
+  Compilation
+===========================================================================*/
+/* Resolve the lexical address of VAR in the frames created by compiled code
+ * in the same manner as scm_lookup_environment(). The frames are never
+ * extended by scm_add_environment(), so the address stays valid for every
+ * activation. */
+static scm_bool
+scope_lookup(ScmObj var, const compile_scope *scope,
+             scm_int_t *depth, scm_int_t *index)
+{
+    ScmObj frames, formals;
+    scm_int_t d, i;
+
+    for (d = 0, frames = scope->frames;
+         CONSP(frames);
+         d++, frames = CDR(frames))
+    {
+        for (i = 0, formals = CAR(frames);
+             CONSP(formals);
+             i++, formals = CDR(formals))
+        {
+            if (EQ(var, CAR(formals))) {
+                *depth = d;
+                *index = i;
+                return scm_true;
+            }
+        }
+        /* the rest parameter */
+        if (EQ(var, formals)) {
+            *depth = d;
+            *index = ~i;
+            return scm_true;
+        }
+    }
+
+    return scm_false;
+}
+
+static scm_bool
+scope_boundp(ScmObj var, const compile_scope *scope)
+{
+    scm_int_t depth, index;
+
+    return scope_lookup(var, scope, &depth, &index);
+}
+
+/* Register NODE that refers the compiled frame at DEPTH to the innermost
+ * lambda if the frame is outside of it. */
+static void
+add_free_ref(ScmObj node, scm_int_t depth, const compile_scope *scope)
+{
+    ScmObj rec, frames;
+    scm_int_t pos;
+
+    rec = scope->lambda;
+    if (!CONSP(rec))
+        return;
+
+    frames = scope->frames;
+    pos = scm_length(frames) - 1 - depth;
+    if (pos < LAMBDA_BASE(rec)) {
+        for (; depth; depth--)
+            frames = CDR(frames);
+        LAMBDA_ADD_REF(rec, node, pos, CAR(frames));
+    }
+}
+
+static void
+mark_assigned(ScmObj formals, const compile_scope *scope)
+{
+    compile_unit *unit;
+
+    unit = scope->unit;
+    if (FALSEP(scm_p_memq(formals, unit->assigned)))
+        unit->assigned = CONS(formals, unit->assigned);
+}
+
+/* Register NODE that refers the compiled frame at DEPTH to the named let
+ * being compiled if the frame is of its name. */
+static void
+add_loop_ref(ScmObj node, scm_int_t depth, const compile_scope *scope)
+{
+    ScmObj frames, rec;
+
+    if (NULLP(scope->unit->loops))
+        return;
+
+    for (frames = scope->frames; depth; depth--)
+        frames = CDR(frames);
+    rec = scm_p_assq(CAR(frames), scope->unit->loops);
+    if (CONSP(rec))
+        SET_CDR(rec, CONS(node, CDR(rec)));
+}
+
+/* Node that makes the interpreter process OBJ. Since the interpreter may
+ * refer and assign any visible variable by name, the enclosing lambdas are
+ * not flattened and the variables are shared with the flat closures. */
+static ScmObj
+opaque_node(ScmObj handler, ScmObj obj, const compile_scope *scope)
+{
+    ScmObj rec, frames;
+
+    for (rec = scope->lambda;
+         CONSP(rec) && TRUEP(LAMBDA_FLATP(rec));
+         rec = LAMBDA_PARENT(rec))
+        LAMBDA_SET_FLATP(rec, SCM_FALSE);
+    for (frames = scope->frames; CONSP(frames); frames = CDR(frames))
+        mark_assigned(CAR(frames), scope);
+
+    return MAKE_NODE(handler, obj);
+}
+
+/* formals of the frame that the call of a closure creates */
+static ScmObj
+frame_formals(ScmObj formals)
+{
+    return (IDENTIFIERP(formals)) ? LIST_1(formals) : formals;
+}
+
+static ScmObj
+compile(ScmObj exp, const compile_scope *scope)
+{
+    if (IDENTIFIERP(exp))
+        return compile_ref(exp, scope);
+    if (CONSP(exp))
+        return compile_form(exp, scope);
+
+    /* Self-evaluating. Invalid forms such as () are also left to
+     * scm_eval(). */
+    return exp;
+}
+
+static ScmObj
+compile_list(ScmObj exps, const compile_scope *scope)
+{
+    ScmQueue q;
+    ScmObj ret, exp;
+
+    ret = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, ret);
+    FOR_EACH (exp, exps)
+        SCM_QUEUE_ADD(q, compile(exp, scope));
+
+    return ret;
+}
+
+static ScmObj
+compile_ref(ScmObj var, const compile_scope *scope)
+{
+    ScmObj node;
+    scm_int_t depth, index;
+
+    /* wrapped identifiers are resolved by scm_lookup_environment() */
+    if (!SYMBOLP(var))
+        return opaque_node(l_node_ref, var, scope);
+
+    if (scope_lookup(var, scope, &depth, &index)) {
+        node = MAKE_NODE(l_node_lref,
+                         CONS(MAKE_INT(depth), CONS(MAKE_INT(index), var)));
+        add_free_ref(node, depth, scope);
+        add_loop_ref(node, depth, scope);
+        return node;
+    }
+    if (scm_toplevel_environmentp(scope->env))
+        return MAKE_NODE(l_node_gref, var);
+
+    /* the opaque environment of the closure or the toplevel */
+    return MAKE_NODE(l_node_ref, var);
+}
+
+static ScmObj
+compile_form(ScmObj form, const compile_scope *scope)
+{
+    ScmObj head, val, nodes, node;
+    ScmRef ref;
+
+    if (!PROPER_LISTP(form))
+        return opaque_node(l_node_interp, form, scope);
+
+    head = CAR(form);
+    if (SYMBOLP(head)) {
+        if (scope_boundp(head, scope))
+            return MAKE_NODE(l_node_call,
+                             CONS(form, compile_list(form, scope)));
+
+        ref = scm_lookup_environment(head, scope->env);
+        val = (ref != SCM_INVALID_REF) ? DEREF(ref) : SCM_SYMBOL_VCELL(head);
+    } else if (IDENTIFIERP(head)) {
+        /* wrapped identifier of a hygienic macro */
+        return opaque_node(l_node_interp, form, scope);
+    } else {
+        ref = SCM_INVALID_REF;
+        val = head;
+    }
+
+    if (SYNTACTIC_OBJECTP(val)) {
+        node = compile_syntax(val, form, scope);
+        /* a toplevel keyword may be redefined as a variable */
+        if (SYMBOLP(head) && ref == SCM_INVALID_REF
+            && !(CONSP(node) && EQ(CAR(node), l_node_interp)))
+            return MAKE_NODE(l_node_keyword,
+                             CONS(head, CONS(val, CONS(form, node))));
+        return node;
+    }
+
+    nodes = compile_list(form, scope);
+    if (CONSP(CAR(nodes)) && EQ(CAR(CAR(nodes)), l_node_gref)) {
+#if SCM_USE_SEALED_BUILTINS
+        node = compile_prim(form, nodes);
+        if (VALIDP(node))
+            return node;
+#endif
+        return MAKE_NODE(l_node_gcall, CONS(SCM_FALSE, CONS(form, nodes)));
+    }
+
+    return MAKE_NODE(l_node_call, CONS(form, nodes));
+}
+
+static ScmObj
+compile_syntax(ScmObj syn, ScmObj form, const compile_scope *scope)
+{
+    if (SYNTAXP(syn)) {
+        if (SYNTAX_CFUNCP(syn, scm_s_quote))
+            return compile_quote(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_if))
+            return compile_if(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_setx))
+            return compile_setx(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_lambda) && CONSP(CDR(form)))
+            return compile_lambda(form, CADR(form), CDDR(form), scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_begin))
+            return compile_seq(form, CDR(form), scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_and))
+            return compile_and_or(l_node_and, form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_or))
+            return compile_and_or(l_node_or, form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_cond))
+            return compile_cond(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_case))
+            return compile_case(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_quasiquote))
+            return compile_quasiquote(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_let))
+            return compile_let(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_letstar))
+            return compile_letstar(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_letrec))
+            return compile_letrec(form, scope);
+        if (SYNTAX_CFUNCP(syn, scm_s_do))
+            return compile_do(form, scope);
+    }
+
+    return opaque_node(l_node_interp, form, scope);
+}
+
+#if SCM_USE_SEALED_BUILTINS
+/* Inline the call of a builtin held by the toplevel variable of the operator
+ * node, and fold it if the operands are constant. Returns SCM_INVALID if the
+ * call is not applicable. */
+static ScmObj
+compile_prim(ScmObj form, ScmObj nodes)
+{
+    ScmObj sym, proc, node, operand, deps, rest, args[2], val;
+    ScmFuncType func;
+    int op, argc, i;
+
+    sym = CDR(CAR(nodes));
+    proc = SCM_SYMBOL_VCELL(sym);
+    if (!FUNCP(proc))
+        return SCM_INVALID;
+    func = SCM_FUNC_CFUNC(proc);
+    argc = scm_length(CDR(nodes));
+    for (op = 0; op < PRIM_NONE; op++) {
+        if (prim_table[op].func == func && prim_table[op].argc == argc)
+            break;
+    }
+    if (op == PRIM_NONE)
+        return SCM_INVALID;
+
+    node = MAKE_NODE(l_node_prim,
+                     CONS(CONS(proc, MAKE_INT(op)), CONS(form, nodes)));
+    if (!prim_table[op].foldablep)
+        return node;
+
+    /* constant folding of fixnums */
+    deps = LIST_1(CONS(sym, proc));
+    args[1] = SCM_INVALID;
+    for (i = 0, nodes = CDR(nodes); i < argc; i++, nodes = CDR(nodes)) {
+        operand = CAR(nodes);
+        if (CONSP(operand) && EQ(CAR(operand), l_node_folded)) {
+            for (rest = CADR(CDR(operand)); CONSP(rest); rest = CDR(rest))
+                deps = CONS(CAR(rest), deps);
+            args[i] = CADR(operand);
+        } else if (INTP(operand)) {
+            args[i] = operand;
+        } else {
+            return node;
+        }
+    }
+    if (!prim_fixnum((enum prim_op)op, args[0], args[1], &val))
+        return node;
+
+    return MAKE_NODE(l_node_folded, CONS(val, CONS(deps, node)));
+}
+#endif /* SCM_USE_SEALED_BUILTINS */
+
+/* (quote <datum>) */
+static ScmObj
+compile_quote(ScmObj form, const compile_scope *scope)
+{
+    ScmObj datum;
+
+    if (!LIST_2_P(form))
+        return opaque_node(l_node_interp, form, scope);
+
+    datum = scm_s_quote(CADR(form), SCM_INTERACTION_ENV);
+    if (IDENTIFIERP(datum) || CONSP(datum) || NULLP(datum)
+#if SCM_USE_VECTOR
+        || VECTORP(datum)
+#endif
+        )
+        return MAKE_NODE(l_node_quote, datum);
+
+    return datum;
+}
+
+/* (if <test> <consequent> [<alternate>]) */
+static ScmObj
+compile_if(ScmObj form, const compile_scope *scope)
+{
+    ScmObj args, test, conseq, alt;
+
+    args = CDR(form);
+    if (!CONSP(args) || !CONSP(CDR(args)))
+        return opaque_node(l_node_interp, form, scope);
+#if SCM_STRICT_ARGCHECK
+    if (CONSP(CDDR(args)) && !NULLP(CDR(CDDR(args))))
+        return opaque_node(l_node_interp, form, scope);
+#endif
+
+    test   = compile(CAR(args), scope);
+    conseq = compile(CADR(args), scope);
+    if (CONSP(CDDR(args)))
+        alt = compile(CAR(CDDR(args)), scope);
+    else
+#if SCM_COMPAT_SIOD_BUGS
+        alt = SCM_FALSE;
+#else
+        alt = SCM_UNDEF;
+#endif
+
+    return MAKE_NODE(l_node_if, CONS(test, CONS(conseq, alt)));
+}
+
+/* (set! <variable> <expression>) */
+static ScmObj
+compile_setx(ScmObj form, const compile_scope *scope)
+{
+    ScmObj var, exp, node, frames;
+    scm_int_t depth, index;
+
+    if (!LIST_3_P(form) || !SYMBOLP(var = CADR(form)))
+        return opaque_node(l_node_interp, form, scope);
+
+    exp = compile(CAR(CDDR(form)), scope);
+    if (scope_lookup(var, scope, &depth, &index)) {
+        node = MAKE_NODE(l_node_lset,
+                         CONS(MAKE_INT(depth),
+                              CONS(MAKE_INT(index), CONS(var, exp))));
+        add_free_ref(node, depth, scope);
+        add_loop_ref(node, depth, scope);
+        for (frames = scope->frames; depth; depth--)
+            frames = CDR(frames);
+        mark_assigned(CAR(frames), scope);
+        return node;
+    }
+    if (scm_toplevel_environmentp(scope->env))
+        return MAKE_NODE(l_node_setg, CONS(var, exp));
+
+    return MAKE_NODE(l_node_set, CONS(var, exp));
+}
+
+/* (lambda <formals> <body>) */
+static ScmObj
+compile_lambda(ScmObj form, ScmObj formals, ScmObj body,
+               const compile_scope *scope)
+{
+    compile_scope inner;
+    ScmObj rec, node;
+
+#if SCM_STRICT_ARGCHECK
+    if (SCM_LISTLEN_ERRORP(scm_validate_formals(formals)))
+        return opaque_node(l_node_interp, form, scope);
+#endif
+    if (!CONSP(body))
+        return opaque_node(l_node_interp, form, scope);
+
+    rec = CONS(SCM_FALSE,
+               CONS(MAKE_INT(scm_length(scope->frames)),
+                    CONS(scope->lambda, CONS(SCM_TRUE, SCM_NULL))));
+    inner = *scope;
+    inner.lambda = rec;
+    node = MAKE_NODE(l_node_lambda, compile_code(formals, body, &inner));
+    LAMBDA_SET_NODE(rec, node);
+    SCM_QUEUE_ADD(scope->unit->lambdaq, rec);
+
+    return node;
+}
+
+static ScmObj
+compile_code(ScmObj formals, ScmObj body, const compile_scope *scope)
+{
+    compile_scope inner;
+    ScmObj body_node, stack_framep;
+
+    inner = *scope;
+    inner.frames = CONS(frame_formals(formals), scope->frames);
+    body_node = compile_body(body, &inner);
+#if SCM_USE_STACK_FRAME
+    stack_framep = MAKE_BOOL(!frame_escapesp(body_node));
+#else
+    stack_framep = SCM_FALSE;
+#endif
+
+    return CONS(scm_compiled_code_tag,
+                CONS(formals,
+                     CONS(body_node,
+                          CONS(stack_framep, CONS(formals, body)))));
+}
+
+/* Whether an activation of the node may capture its env. Operands other
+ * than nodes are walked too, but they never contain the handlers. */
+static scm_bool
+frame_escapesp(ScmObj node)
+{
+    ScmObj elm;
+
+    for (; CONSP(node); node = CDR(node)) {
+        elm = CAR(node);
+        if (EQ(elm, l_node_lambda) || EQ(elm, l_node_flat_lambda)
+            || EQ(elm, l_node_named_let)
+            || EQ(elm, l_node_interp) || EQ(elm, l_node_body))
+            return scm_true;
+        /* the data and the source forms may be circular */
+        if (EQ(elm, l_node_quote))
+            return scm_false;
+        if (EQ(elm, l_node_call))
+            node = CDR(node);
+        else if (EQ(elm, l_node_gcall))
+            node = CDR(CDR(node));
+        else if (EQ(elm, l_node_keyword))
+            node = CDR(CDR(CDR(node)));
+#if SCM_USE_SEALED_BUILTINS
+        else if (EQ(elm, l_node_prim) || EQ(elm, l_node_folded))
+            node = CDR(CDR(node));
+#endif
+        else if (CONSP(elm) && frame_escapesp(elm))
+            return scm_true;
+    }
+
+    return scm_false;
+}
+
+/* (begin <expression>+) */
+static ScmObj
+compile_seq(ScmObj form, ScmObj exps, const compile_scope *scope)
+{
+    if (!CONSP(exps))
+        return opaque_node(l_node_interp, form, scope);
+    if (NULLP(CDR(exps)))
+        return compile(CAR(exps), scope);
+
+    return MAKE_NODE(l_node_seq, compile_list(exps, scope));
+}
+
+/* (and <test>*), (or <test>*) */
+static ScmObj
+compile_and_or(ScmObj node, ScmObj form, const compile_scope *scope)
+{
+    ScmObj args;
+
+    args = CDR(form);
+    if (NULLP(args))
+        return (EQ(node, l_node_and)) ? SCM_TRUE : SCM_FALSE;
+    if (NULLP(CDR(args)))
+        return compile(CAR(args), scope);
+
+    return MAKE_NODE(node, compile_list(args, scope));
+}
+
+/* (cond <cond clause>+) */
+static ScmObj
+compile_cond(ScmObj form, const compile_scope *scope)
+{
+    ScmObj clauses, clause, rest;
+
+    /* validate the clauses in advance to keep the error timing */
+    clauses = CDR(form);
+    if (!CONSP(clauses))
+        return opaque_node(l_node_interp, form, scope);
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        if (!CONSP(clause) || !PROPER_LISTP(clause))
+            return opaque_node(l_node_interp, form, scope);
+        if (EQ(CAR(clause), l_sym_else)
+            && (!NULLP(CDR(rest)) || !CONSP(CDR(clause))))
+            return opaque_node(l_node_interp, form, scope);
+    }
+
+    return compile_cond_clauses(clauses, scope);
+}
+
+static ScmObj
+compile_cond_clauses(ScmObj clauses, const compile_scope *scope)
+{
+    ScmObj clause, test, exps, rest;
+
+    if (NULLP(clauses))
+        return SCM_UNDEF;
+
+    clause = CAR(clauses);
+    test = CAR(clause);
+    exps = CDR(clause);
+    if (EQ(test, l_sym_else))
+        return compile_seq(SCM_FALSE, exps, scope);
+
+    rest = compile_cond_clauses(CDR(clauses), scope);
+    test = compile(test, scope);
+    if (NULLP(exps))
+        return MAKE_NODE(l_node_or, LIST_2(test, rest));
+    if (EQ(CAR(exps), l_sym_yields) && LIST_2_P(exps))
+        return MAKE_NODE(l_node_cond_yield,
+                         CONS(test, CONS(compile(CADR(exps), scope), rest)));
+
+    return MAKE_NODE(l_node_if,
+                     CONS(test, CONS(compile_seq(SCM_FALSE, exps, scope),
+                                     rest)));
+}
+
+/* (case <expression> <case clause>+) */
+static ScmObj
+compile_case(ScmObj form, const compile_scope *scope)
+{
+    ScmQueue q;
+    ScmObj clauses, clause, rest, data, datum, key, bodies, else_node;
+    scm_int_t n;
+
+    /* Only the clauses of literal symbols, characters and fixnums are
+     * dispatched by a table. The others are left to the interpreter as
+     * well as malformed ones to keep the error timing. */
+    if (!CONSP(CDR(form)) || !CONSP(CDDR(form)))
+        return opaque_node(l_node_interp, form, scope);
+    clauses = CDDR(form);
+    n = 0;
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        if (!CONSP(clause) || !CONSP(CDR(clause)) || !PROPER_LISTP(clause))
+            return opaque_node(l_node_interp, form, scope);
+        data = CAR(clause);
+        if (EQ(data, l_sym_else)) {
+            if (!NULLP(CDR(rest)))
+                return opaque_node(l_node_interp, form, scope);
+            continue;
+        }
+        if (!PROPER_LISTP(data))
+            return opaque_node(l_node_interp, form, scope);
+        FOR_EACH (datum, data) {
+            if (!CASE_DATUMP(datum))
+                return opaque_node(l_node_interp, form, scope);
+            n++;
+        }
+    }
+
+    key = compile(CADR(form), scope);
+    bodies = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, bodies);
+    else_node = SCM_UNDEF;
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        if (EQ(CAR(clause), l_sym_else))
+            else_node = compile_seq(SCM_FALSE, CDR(clause), scope);
+        else
+            SCM_QUEUE_ADD(q, compile_seq(SCM_FALSE, CDR(clause), scope));
+    }
+
+    return MAKE_NODE(l_node_case,
+                     CONS(key,
+                          CONS(case_table(clauses, bodies, n),
+                               CONS(else_node, bodies))));
+}
+
+/* Build the table of node_case() that maps the N data of CLAUSES to the
+ * pairs of the corresponding nodes in BODIES. The first clause wins for
+ * duplicated data as memv does. */
+static ScmObj
+case_table(ScmObj clauses, ScmObj bodies, scm_int_t n)
+{
+    ScmObj table, rest, data, datum, entry, *vec;
+    scm_int_t min, max, len;
+    scm_uint_t mask, h;
+    scm_bool fixnump;
+
+    min = SCM_INT_MAX;
+    max = SCM_INT_MIN;
+    fixnump = scm_true;
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        data = CAR(CAR(rest));
+        if (EQ(data, l_sym_else))
+            break;
+        FOR_EACH_PAIR (data, data) {
+            datum = CAR(data);
+            if (!INTP(datum)) {
+                fixnump = scm_false;
+                break;
+            }
+            if (SCM_INT_VALUE(datum) < min)
+                min = SCM_INT_VALUE(datum);
+            if (SCM_INT_VALUE(datum) > max)
+                max = SCM_INT_VALUE(datum);
+        }
+    }
+
+    if (fixnump && n
+        && CASE_DENSE_SPANP((scm_uint_t)max - (scm_uint_t)min, n)) {
+        table = scm_p_make_vector(MAKE_INT(max - min + 1), LIST_1(SCM_FALSE));
+        vec = SCM_VECTOR_VEC(table);
+        for (; CONSP(clauses); clauses = CDR(clauses)) {
+            data = CAR(CAR(clauses));
+            if (EQ(data, l_sym_else))
+                break;
+            FOR_EACH (datum, data) {
+                if (FALSEP(vec[SCM_INT_VALUE(datum) - min]))
+                    vec[SCM_INT_VALUE(datum) - min] = bodies;
+            }
+            bodies = CDR(bodies);
+        }
+
+        return CONS(MAKE_INT(min), table);
+    }
+
+    /* keep the load factor at most 1/2 */
+    for (len = 8; len < 2 * n; len *= 2)
+        continue;
+    table = scm_p_make_vector(MAKE_INT(len), LIST_1(SCM_FALSE));
+    vec = SCM_VECTOR_VEC(table);
+    mask = (scm_uint_t)len - 1;
+    for (; CONSP(clauses); clauses = CDR(clauses)) {
+        data = CAR(CAR(clauses));
+        if (EQ(data, l_sym_else))
+            break;
+        FOR_EACH (datum, data) {
+            for (h = case_hash(datum) & mask;
+                 TRUEP(vec[h]) && !case_eqvp(CAR(vec[h]), datum);
+                 h = (h + 1) & mask)
+                continue;
+            if (FALSEP(vec[h])) {
+                entry = CONS(datum, bodies);
+                SCM_WRITE_BARRIER(table);
+                vec[h] = entry;
+            }
+        }
+        bodies = CDR(bodies);
+    }
+
+    return table;
+}
+
+/* (quasiquote <qq template>) */
+static ScmObj
+compile_quasiquote(ScmObj form, const compile_scope *scope)
+{
+    ScmObj tmpl, elm;
+
+    if (!LIST_2_P(form))
+        return opaque_node(l_node_interp, form, scope);
+
+    /* the interpreter reports a splice at the top on the evaluation */
+    tmpl = CADR(form);
+    if (!qq_compilablep(tmpl, 1)
+        || (CONSP(tmpl) && EQ(CAR(tmpl), SYM_UNQUOTE_SPLICING)))
+        return opaque_node(l_node_interp, form, scope);
+
+    elm = compile_qq(tmpl, 1, scope);
+    SCM_ASSERT(QQ_ELM_KIND(elm) != QQ_SPLICE);
+    return QQ_ELM_NODE(elm);
+}
+
+/* Test whether TMPL is well-formed and free of wrapped identifiers outside
+ * of the unquoted expressions, in the same order as qquote_internal() of
+ * qquote.c walks it. */
+static scm_bool
+qq_compilablep(ScmObj tmpl, scm_int_t nest)
+{
+    ScmObj rest, obj;
+#if SCM_USE_VECTOR
+    scm_int_t i;
+
+    if (VECTORP(tmpl)) {
+        for (i = 0; i < SCM_VECTOR_LEN(tmpl); i++)
+            if (!qq_compilablep(SCM_VECTOR_VEC(tmpl)[i], nest))
+                return scm_false;
+        return scm_true;
+    }
+#endif
+    if (!CONSP(tmpl))
+        return !IDENTIFIERP(tmpl) || SYMBOLP(tmpl);
+
+    for (rest = tmpl; CONSP(rest); rest = CDR(rest)) {
+        obj = CAR(rest);
+        if (EQ(obj, SYM_QUASIQUOTE)) {
+            if (!LIST_1_P(CDR(rest)))
+                return scm_false;
+            ++nest;
+        } else if (EQ(obj, SYM_UNQUOTE)
+                   || EQ(obj, SYM_UNQUOTE_SPLICING)) {
+            if (!LIST_1_P(CDR(rest)))
+                return scm_false;
+            /* (a . ,@b) */
+            if (EQ(obj, SYM_UNQUOTE_SPLICING) && !EQ(rest, tmpl))
+                return scm_false;
+            if (--nest == 0)
+                return scm_true;
+        } else if (!qq_compilablep(obj, nest)) {
+            return scm_false;
+        }
+    }
+    return qq_compilablep(rest, nest);
+}
+
+/* Compile TMPL at the level NEST of nested quasiquotes into an element. */
+static ScmObj
+compile_qq(ScmObj tmpl, scm_int_t nest, const compile_scope *scope)
+{
+    ScmObj elms, elm, rest, obj, shared, tail, last;
+    ScmQueue q;
+    scm_int_t n, kept;
+#if SCM_USE_VECTOR
+    scm_int_t i, len;
+    scm_bool splicep;
+
+    if (VECTORP(tmpl)) {
+        elms = SCM_NULL;
+        SCM_QUEUE_POINT_TO(q, elms);
+        len = SCM_VECTOR_LEN(tmpl);
+        kept = 0;
+        splicep = scm_false;
+        for (i = 0; i < len; i++) {
+            elm = compile_qq(SCM_VECTOR_VEC(tmpl)[i], nest, scope);
+            if (QQ_ELM_KIND(elm) != QQ_CONSTANT)
+                kept = i + 1;
+            if (QQ_ELM_KIND(elm) == QQ_SPLICE)
+                splicep = scm_true;
+            SCM_QUEUE_ADD(q, elm);
+        }
+        if (!kept)
+            return MAKE_QQ_ELM(QQ_CONSTANT, MAKE_NODE(l_node_quote, tmpl));
+        return MAKE_QQ_ELM(QQ_VALUE,
+                           MAKE_NODE(l_node_qq_vector,
+                                     CONS((splicep) ? SCM_FALSE
+                                                    : MAKE_INT(len),
+                                          elms)));
+    }
+#endif
+    if (!CONSP(tmpl))
+        return MAKE_QQ_ELM(QQ_CONSTANT, MAKE_NODE(l_node_quote, tmpl));
+
+    elms = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, elms);
+    /* SHARED is the rest of the template after the last element that is
+     * not constant, and KEPT is the number of the elements up to it */
+    shared = tmpl;
+    tail = SCM_INVALID;
+    n = kept = 0;
+    for (rest = tmpl; CONSP(rest); rest = CDR(rest)) {
+        obj = CAR(rest);
+        if (EQ(obj, SYM_QUASIQUOTE)) {
+            ++nest;
+        } else if (EQ(obj, SYM_UNQUOTE) || EQ(obj, SYM_UNQUOTE_SPLICING)) {
+            if (--nest == 0) {
+                elm = MAKE_QQ_ELM((EQ(obj, SYM_UNQUOTE)) ? QQ_VALUE
+                                                         : QQ_SPLICE,
+                                  compile(CADR(rest), scope));
+                if (EQ(rest, tmpl))
+                    return elm;
+                /* (a . ,b) */
+                tail = elm;
+                break;
+            }
+        } else {
+            elm = compile_qq(obj, nest, scope);
+            if (QQ_ELM_KIND(elm) != QQ_CONSTANT) {
+                SCM_QUEUE_ADD(q, elm);
+                kept = ++n;
+                shared = CDR(rest);
+                continue;
+            }
+        }
+        SCM_QUEUE_ADD(q, MAKE_QQ_ELM(QQ_CONSTANT,
+                                     MAKE_NODE(l_node_quote, obj)));
+        ++n;
+    }
+    if (!VALIDP(tail))
+        tail = compile_qq(rest, nest, scope);
+
+    if (QQ_ELM_KIND(tail) == QQ_CONSTANT) {
+        if (!kept)
+            return MAKE_QQ_ELM(QQ_CONSTANT, MAKE_NODE(l_node_quote, tmpl));
+        /* share the constant elements at the end with the template */
+        tail = MAKE_QQ_ELM(QQ_CONSTANT, MAKE_NODE(l_node_quote, shared));
+        if (kept < n) {
+            last = scm_list_tail(elms, kept - 1);
+            SET_CDR(last, SCM_NULL);
+        }
+    }
+
+    return MAKE_QQ_ELM(QQ_VALUE, MAKE_NODE(l_node_qq_list, CONS(tail, elms)));
+}
+
+/* (let [<variable>] (<binding spec>*) <body>) */
+static ScmObj
+compile_let(ScmObj form, const compile_scope *scope)
+{
+    compile_scope inner;
+    compile_unit *unit;
+    ScmObj name, bindings, body, formals, inits, code, rec, node;
+    DECLARE_INTERNAL_FUNCTION("let");
+
+    if (!CONSP(CDR(form)))
+        return opaque_node(l_node_interp, form, scope);
+    bindings = CADR(form);
+    body = CDDR(form);
+
+    name = SCM_FALSE;
+    if (IDENTIFIERP(bindings)) {
+        name = bindings;
+        if (!SYMBOLP(name) || !CONSP(body))
+            return opaque_node(l_node_interp, form, scope);
+        bindings = POP(body);
+    }
+    if (!parse_bindings(bindings, scm_true, &formals, &inits))
+        return opaque_node(l_node_interp, form, scope);
+
+    inits = compile_list(inits, scope);
+    inner = *scope;
+    if (SYMBOLP(name)) {
+        /* the loop procedure is bound in a frame of its own */
+        inner.frames = CONS(LIST_1(name), scope->frames);
+        mark_assigned(CAR(inner.frames), scope);
+        unit = scope->unit;
+        rec = LIST_1(CAR(inner.frames));
+        unit->loops = CONS(rec, unit->loops);
+        code = compile_code(formals, body, &inner);
+        unit->loops = CDR(unit->loops);
+
+        node = compile_loop(CAR(inner.frames), formals, code, inits, CDR(rec));
+        if (VALIDP(node))
+            return node;
+        return MAKE_NODE(l_node_named_let,
+                         CONS(CAR(inner.frames), CONS(code, inits)));
+    }
+
+    inner.frames = CONS(formals, scope->frames);
+    return MAKE_NODE(l_node_let,
+                     CONS(formals, CONS(inits, compile_body(body, &inner))));
+}
+
+/* Turn the named let of CODE into a loop node if the name is referred only
+ * by REFS that are the operators of tail calls with the right number of
+ * args, and nothing in the body can capture the frame of the loop
+ * variables. Returns SCM_INVALID if not applicable. */
+static ScmObj
+compile_loop(ScmObj name_formals, ScmObj formals, ScmObj code, ScmObj inits,
+             ScmObj refs)
+{
+    ScmQueue q;
+    ScmObj body, calls, call, operands, op;
+    scm_int_t n;
+
+    n = scm_length(formals);
+    body = CODE_BODY(code);
+    if (n > LOOP_VARS_MAX || frame_escapesp(body))
+        return SCM_INVALID;
+
+    calls = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, calls);
+    find_tail_calls(body, refs, &q);
+    if (scm_length(calls) != scm_length(refs))
+        return SCM_INVALID;
+    FOR_EACH_PAIR (call, calls) {
+        /* (<call> <form> <operator node> . <operand nodes>) */
+        if (scm_length(CDDR(CDR(CAR(call)))) != n)
+            return SCM_INVALID;
+    }
+
+    FOR_EACH (call, calls) {
+        operands = CDR(call);
+        op = CADR(operands);
+        SET_CDR(call, CONS(MAKE_INT(SCM_INT_VALUE(CADR(op)) - 1),
+                           CDDR(operands)));
+        SET_CAR(call, l_node_recur);
+    }
+
+    return MAKE_NODE(l_node_loop,
+                     CONS(name_formals, CONS(formals, CONS(body, inits))));
+}
+
+/* Collect the call nodes in the tail positions of NODE whose operator node
+ * is one of REFS. */
+static void
+find_tail_calls(ScmObj node, ScmObj refs, ScmQueue *callq)
+{
+    ScmObj handler, operands, rest;
+
+    while (CONSP(node)) {
+        handler = CAR(node);
+        operands = CDR(node);
+        if (EQ(handler, l_node_call)) {
+            if (TRUEP(scm_p_memq(CADR(operands), refs)))
+                SCM_QUEUE_ADD(*callq, node);
+            return;
+        } else if (EQ(handler, l_node_if)) {
+            find_tail_calls(CADR(operands), refs, callq);
+            node = CDDR(operands);
+        } else if (EQ(handler, l_node_seq) || EQ(handler, l_node_and)
+                   || EQ(handler, l_node_or)) {
+            if (!CONSP(operands))
+                return;
+            for (rest = operands; CONSP(CDR(rest)); rest = CDR(rest))
+                continue;
+            node = CAR(rest);
+        } else if (EQ(handler, l_node_let) || EQ(handler, l_node_letrec)
+                   || EQ(handler, l_node_defines)
+                   || EQ(handler, l_node_cond_yield)) {
+            node = CDDR(operands);
+        } else if (EQ(handler, l_node_keyword)) {
+            node = CDR(CDDR(operands));
+        } else if (EQ(handler, l_node_loop)) {
+            node = CAR(CDDR(operands));
+        } else if (EQ(handler, l_node_do)) {
+            node = CAR(CDR(CDDR(CDR(operands))));
+        } else if (EQ(handler, l_node_case)) {
+            for (rest = CDR(CDDR(operands)); CONSP(rest); rest = CDR(rest))
+                find_tail_calls(CAR(rest), refs, callq);
+            node = CAR(CDDR(operands));
+        } else {
+            return;
+        }
+    }
+}
+
+/* (do ((<variable> <init> <step>)*) (<test> <expression>*) <command>*) */
+static ScmObj
+compile_do(ScmObj form, const compile_scope *scope)
+{
+    compile_scope inner;
+    ScmQueue formalq, initq, stepq;
+    ScmObj bindings, binding, rest, test_exps, commands, formals, inits, steps;
+    ScmObj var, test, exit;
+    scm_bool in_placep;
+
+    /* malformed forms are left to the interpreter */
+    if (!PROPER_LISTP(form) || !CONSP(CDR(form)) || !CONSP(CDDR(form)))
+        return opaque_node(l_node_interp, form, scope);
+    bindings = CADR(form);
+    test_exps = CAR(CDDR(form));
+    commands = CDR(CDDR(form));
+    if (!CONSP(test_exps) || !PROPER_LISTP(test_exps))
+        return opaque_node(l_node_interp, form, scope);
+
+    formals = inits = steps = SCM_NULL;
+    SCM_QUEUE_POINT_TO(formalq, formals);
+    SCM_QUEUE_POINT_TO(initq, inits);
+    SCM_QUEUE_POINT_TO(stepq, steps);
+    for (rest = bindings; CONSP(rest); rest = CDR(rest)) {
+        binding = CAR(rest);
+        if (!CONSP(binding) || !PROPER_LISTP(binding)
+            || !CONSP(CDR(binding)) || scm_length(binding) > 3)
+            return opaque_node(l_node_interp, form, scope);
+        var = CAR(binding);
+        if (!SYMBOLP(var) || TRUEP(scm_p_memq(var, formals)))
+            return opaque_node(l_node_interp, form, scope);
+        SCM_QUEUE_ADD(formalq, var);
+        SCM_QUEUE_ADD(initq, CADR(binding));
+        SCM_QUEUE_ADD(stepq, (CONSP(CDDR(binding))) ? CAR(CDDR(binding)) : var);
+    }
+    if (!NULLP(rest))
+        return opaque_node(l_node_interp, form, scope);
+
+    inits = compile_list(inits, scope);
+    inner = *scope;
+    inner.frames = CONS(formals, scope->frames);
+    test = compile(CAR(test_exps), &inner);
+    exit = (NULLP(CDR(test_exps)))
+        ? SCM_UNDEF : compile_seq(SCM_FALSE, CDR(test_exps), &inner);
+    steps = compile_list(steps, &inner);
+    commands = compile_list(commands, &inner);
+
+    /* the exit exps run once after the last update */
+    in_placep = (scm_length(formals) <= LOOP_VARS_MAX
+                 && !frame_escapesp(LIST_1(test))
+                 && !frame_escapesp(steps)
+                 && !frame_escapesp(commands));
+
+    return MAKE_NODE(l_node_do,
+                     CONS(formals,
+                          CONS(inits,
+                               CONS(MAKE_BOOL(in_placep),
+                                    CONS(test,
+                                         CONS(exit,
+                                              CONS(steps, commands)))))));
+}
+
+/* (let* (<binding spec>*) <body>) */
+static ScmObj
+compile_letstar(ScmObj form, const compile_scope *scope)
+{
+    ScmObj formals, inits;
+
+    if (!CONSP(CDR(form))
+        || !parse_bindings(CADR(form), scm_false, &formals, &inits))
+        return opaque_node(l_node_interp, form, scope);
+
+    return compile_letstar_bindings(formals, inits, CDDR(form), scope);
+}
+
+/* extend the env for each variable */
+static ScmObj
+compile_letstar_bindings(ScmObj formals, ScmObj inits, ScmObj body,
+                         const compile_scope *scope)
+{
+    compile_scope inner;
+    ScmObj var_formals, init;
+
+    if (NULLP(formals))
+        return compile_body(body, scope);
+
+    init = compile(CAR(inits), scope);
+    var_formals = LIST_1(CAR(formals));
+    inner = *scope;
+    inner.frames = CONS(var_formals, scope->frames);
+
+    return MAKE_NODE(l_node_let,
+                     CONS(var_formals,
+                          CONS(LIST_1(init),
+                               compile_letstar_bindings(CDR(formals),
+                                                        CDR(inits), body,
+                                                        &inner))));
+}
+
+/* (letrec (<binding spec>*) <body>) */
+static ScmObj
+compile_letrec(ScmObj form, const compile_scope *scope)
+{
+    compile_scope inner;
+    ScmObj formals, inits;
+
+    if (!CONSP(CDR(form))
+        || !parse_bindings(CADR(form), scm_true, &formals, &inits))
+        return opaque_node(l_node_interp, form, scope);
+
+    inner = *scope;
+    inner.frames = CONS(formals, scope->frames);
+    mark_assigned(formals, scope);
+    return MAKE_NODE(l_node_letrec,
+                     CONS(formals, CONS(compile_list(inits, &inner),
+                                        compile_body(CDDR(form), &inner))));
+}
+
+/* Split (<binding spec>*) into the variables and the init expressions.
+ * Returns false for anything the interpreter would reject. */
+static scm_bool
+parse_bindings(ScmObj bindings, scm_bool uniquep,
+               ScmObj *formals, ScmObj *inits)
+{
+    ScmQueue varq, initq;
+    ScmObj binding, var;
+
+    *formals = *inits = SCM_NULL;
+    SCM_QUEUE_POINT_TO(varq, *formals);
+    SCM_QUEUE_POINT_TO(initq, *inits);
+    FOR_EACH (binding, bindings) {
+#if SCM_COMPAT_SIOD_BUGS
+        if (LIST_1_P(binding))
+            binding = LIST_2(CAR(binding), SCM_FALSE);
+#endif
+        if (!LIST_2_P(binding) || !SYMBOLP(var = CAR(binding)))
+            return scm_false;
+#if SCM_STRICT_ARGCHECK
+        if (uniquep && TRUEP(scm_p_memq(var, *formals)))
+            return scm_false;
+#endif
+        SCM_QUEUE_ADD(varq, var);
+        SCM_QUEUE_ADD(initq, CADR(binding));
+    }
+
+    return NULLP(bindings);
+}
+
+/* <body> part of lambda, let, let* and letrec */
+static ScmObj
+compile_body(ScmObj body, const compile_scope *scope)
+{
+#if SCM_USE_INTERNAL_DEFINITIONS
+    compile_scope inner;
+    ScmQueue varq, expq;
+    ScmObj formals, exps, rest;
+
+    if (!PROPER_LISTP(body))
+        return opaque_node(l_node_body, body, scope);
+
+    formals = exps = SCM_NULL;
+    SCM_QUEUE_POINT_TO(varq, formals);
+    SCM_QUEUE_POINT_TO(expq, exps);
+    rest = scan_definitions(body, &varq, &expq);
+    if (!VALIDP(rest) || !CONSP(rest))
+        return opaque_node(l_node_body, body, scope);
+
+    if (!NULLP(formals)) {
+        inner = *scope;
+        inner.frames = CONS(formals, scope->frames);
+        mark_assigned(formals, scope);
+        return MAKE_NODE(l_node_defines,
+                         CONS(formals,
+                              CONS(compile_list(exps, &inner),
+                                   compile_seq(SCM_FALSE, rest, &inner))));
+    }
+    body = rest;
+#else
+    if (!CONSP(body) || !PROPER_LISTP(body))
+        return opaque_node(l_node_body, body, scope);
+#endif
+
+    return compile_seq(SCM_FALSE, body, scope);
+}
+
+#if SCM_USE_INTERNAL_DEFINITIONS
+/* Same as filter_definitions() of syntax.c except that this returns
+ * SCM_INVALID instead of raising an error. */
+static ScmObj
+scan_definitions(ScmObj body, ScmQueue *varq, ScmQueue *expq)
+{
+    ScmObj exp, var, sym, rest, begin_rest;
+    DECLARE_INTERNAL_FUNCTION("(body)");
+
+    for (; CONSP(body); body = CDR(body)) {
+        exp = CAR(body);
+        if (!CONSP(exp))
+            break;
+        sym = CAR(exp);
+        rest = CDR(exp);
+        if (EQ(sym, l_sym_begin)) {
+            if (!PROPER_LISTP(rest))
+                return SCM_INVALID;
+            begin_rest = scan_definitions(rest, varq, expq);
+            if (!VALIDP(begin_rest))
+                return SCM_INVALID;
+            if (!NULLP(begin_rest)) {
+                /* no definitions found */
+                if (EQ(begin_rest, rest))
+                    return body;
+                /* definitions and expressions intermixed */
+                return SCM_INVALID;
+            }
+        } else if (EQ(sym, l_sym_define)) {
+            if (!CONSP(rest))
+                return SCM_INVALID;
+            var = POP(rest);
+            if (SYMBOLP(var)) {
+                /* (define <variable> <expression>) */
+                if (!LIST_1_P(rest))
+                    return SCM_INVALID;
+                exp = CAR(rest);
+            } else if (CONSP(var) && SYMBOLP(CAR(var))) {
+                /* (define (<variable> . <formals>) <body>) */
+                exp = CONS(l_syn_lambda, CONS(CDR(var), rest));
+                var = CAR(var);
+            } else {
+                return SCM_INVALID;
+            }
+            SCM_QUEUE_ADD(*varq, var);
+            SCM_QUEUE_ADD(*expq, exp);
+        } else {
+            break;
+        }
+    }
+
+    return body;
+}
+#endif /* SCM_USE_INTERNAL_DEFINITIONS */
+
+/*===========================================================================
+  Flat Closures
+===========================================================================*/
+static void
+flatten_lambdas(compile_unit *unit)
+{
+    ScmObj lambdas, rec, parent, refs, ref;
+
+    lambdas = unit->lambdas;
+    FOR_EACH (rec, lambdas) {
+        if (TRUEP(LAMBDA_FLATP(rec))) {
+            flatten_lambda(rec, unit);
+            continue;
+        }
+
+        /* the free refs are left to the enclosing lambda */
+        parent = LAMBDA_PARENT(rec);
+        if (!CONSP(parent))
+            continue;
+        refs = LAMBDA_REFS(rec);
+        FOR_EACH (ref, refs) {
+            if (FREE_REF_POS(ref) < LAMBDA_BASE(parent))
+                LAMBDA_ADD_REF(parent, CAR(ref), FREE_REF_POS(ref),
+                               FREE_REF_FORMALS(ref));
+        }
+    }
+}
+
+/* Rewrite the free refs of the lambda of REC into the accesses to the flat
+ * frame, and the lambda node into a flat-lambda node. The capture nodes are
+ * in turn free refs of the enclosing lambda, as well as the flat-lambda node
+ * itself whose frame count has to be adjusted. */
+static void
+flatten_lambda(ScmObj rec, compile_unit *unit)
+{
+    ScmQueue slotq, formalq, captureq;
+    ScmObj slots, formals, captures, refs, ref, node, operands, slot, capture;
+    ScmObj parent, inner_lambdas;
+    scm_int_t base, pos, depth, i;
+
+    base = LAMBDA_BASE(rec);
+    slots = inner_lambdas = SCM_NULL;
+    SCM_QUEUE_POINT_TO(slotq, slots);
+    refs = LAMBDA_REFS(rec);
+    FOR_EACH (ref, refs) {
+        node = CAR(ref);
+        operands = CDR(node);
+        pos = FREE_REF_POS(ref);
+        if (EQ(CAR(node), l_node_flat_lambda)) {
+            inner_lambdas = CONS(node, inner_lambdas);
+            continue;
+        }
+        /* the flat frame follows the frames of the lambda */
+        depth = SCM_INT_VALUE(CAR(operands)) + pos + 1 - base;
+        SET_CAR(operands, MAKE_INT(depth));
+
+        if (EQ(CAR(node), l_node_fref)) {
+            /* frame captured by an inner flat closure */
+            i = capture_slot(&slotq, &slots, pos, SCM_FALSE,
+                             FREE_REF_FORMALS(ref), l_sym_frame);
+            SET_CAR(node, l_node_lref);
+            SET_CDR(operands, CONS(MAKE_INT(i), l_sym_frame));
+        } else if (TRUEP(scm_p_memq(FREE_REF_FORMALS(ref), unit->assigned))) {
+            /* the variable is shared through its frame */
+            i = capture_slot(&slotq, &slots, pos, SCM_FALSE,
+                             FREE_REF_FORMALS(ref), l_sym_frame);
+            SET_CAR(node,
+                    (EQ(CAR(node), l_node_lref)) ? l_node_cref : l_node_cset);
+            SET_CDR(operands, CONS(MAKE_INT(i), CDR(operands)));
+        } else {
+            /* lref of a variable never assigned */
+            i = capture_slot(&slotq, &slots, pos, CADR(operands),
+                             FREE_REF_FORMALS(ref), CDDR(operands));
+            SET_CAR(CDR(operands), MAKE_INT(i));
+        }
+    }
+
+    /* the compiled frames outside of the lambda are replaced with the flat
+     * frame (if any) in the env of the inner flat closures */
+    FOR_EACH (node, inner_lambdas) {
+        operands = CDR(node);
+        i = SCM_INT_VALUE(CADR(operands)) - base + (CONSP(slots) ? 1 : 0);
+        SET_CAR(CDR(operands), MAKE_INT(i));
+    }
+
+    /* slot: (<frame position> <index or #f> <formals> . <name>) */
+    formals = captures = SCM_NULL;
+    SCM_QUEUE_POINT_TO(formalq, formals);
+    SCM_QUEUE_POINT_TO(captureq, captures);
+    parent = LAMBDA_PARENT(rec);
+    FOR_EACH (slot, slots) {
+        pos = SCM_INT_VALUE(CAR(slot));
+        depth = base - 1 - pos;
+        if (FALSEP(CADR(slot)))
+            capture = MAKE_NODE(l_node_fref,
+                                CONS(MAKE_INT(depth), CAR(CDDR(slot))));
+        else
+            capture = MAKE_NODE(l_node_lref,
+                                CONS(MAKE_INT(depth),
+                                     CONS(CADR(slot), CDR(CDDR(slot)))));
+        SCM_QUEUE_ADD(formalq, CDR(CDDR(slot)));
+        SCM_QUEUE_ADD(captureq, capture);
+        if (CONSP(parent) && pos < LAMBDA_BASE(parent))
+            LAMBDA_ADD_REF(parent, capture, pos, CAR(CDDR(slot)));
+    }
+
+    node = LAMBDA_NODE(rec);
+    SET_CDR(node, CONS(CDR(node),
+                       CONS(MAKE_INT(base), CONS(formals, captures))));
+    SET_CAR(node, l_node_flat_lambda);
+    if (CONSP(parent))
+        LAMBDA_ADD_REF(parent, node, 0, SCM_FALSE);
+}
+
+/* Index of the slot for the variable at INDEX of the frame at POS, or for
+ * the frame itself if INDEX is #f. A new slot is appended if not found. */
+static scm_int_t
+capture_slot(ScmQueue *slotq, ScmObj *slots, scm_int_t pos, ScmObj index,
+             ScmObj formals, ScmObj var)
+{
+    ScmObj rest, slot;
+    scm_int_t i;
+
+    for (i = 0, rest = *slots; CONSP(rest); i++, rest = CDR(rest)) {
+        slot = CAR(rest);
+        if (SCM_INT_VALUE(CAR(slot)) == pos
+            && (FALSEP(index)
+                ? FALSEP(CADR(slot))
+                : (INTP(CADR(slot))
+                   && SCM_INT_VALUE(CADR(slot)) == SCM_INT_VALUE(index))))
+            return i;
+    }
+    SCM_QUEUE_ADD(*slotq,
+                  CONS(MAKE_INT(pos), CONS(index, CONS(formals, var))));
+
+    return i;
+}
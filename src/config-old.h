@@ -56,6 +56,8 @@
 #undef  SCM_DEFAULT_N_HEAPS_MAX
 #define SCM_DEFAULT_N_HEAPS_INIT         1
 #define SCM_DEFAULT_SYMBOL_HASH_SIZE     0x400
+#define SCM_DEFAULT_GC_STEP_BUDGET       0x4000
+#define SCM_DEFAULT_GC_N_MARKERS         0
 
 
 /*===========================================================================
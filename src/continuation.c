@@ -38,6 +38,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 
 #include "sigscheme.h"
@@ -49,30 +50,88 @@
 #if HAVE_SIGSETJMP
 #define JMP_BUF           sigjmp_buf
 #define SETJMP(env)       sigsetjmp((env), 1)
+/* escapes don't restore the signal mask to save a system call */
+#define ESCAPE_SETJMP(env) sigsetjmp((env), 0)
 #define LONGJMP(env, val) siglongjmp((env), (val))
 #else
 #define JMP_BUF           jmp_buf
 #define SETJMP(env)       setjmp(env)
+#define ESCAPE_SETJMP(env) setjmp(env)
 #define LONGJMP(env, val) longjmp((env), (val))
 #endif
 
 #define CONTINUATION_FRAME(cont)                                             \
     ((struct scm_continuation_frame *)SCM_CONTINUATION_OPAQUE(cont))
 #define CONTINUATION_SET_FRAME    SCM_CONTINUATION_SET_OPAQUE
+#define ESCAPE_FRAME(ec)                                                     \
+    ((struct scm_escape_frame *)SCM_CONTINUATION_OPAQUE(ec))
+
+#if SCM_USE_FULL_CONTINUATION
+/* restore_stack() recurses with this size of padding until its frame gets
+ * out of the segment to be restored */
+#define RESTORE_PAD_LEN 64
+#endif
 
 /*=======================================
   File Local Type Definitions
 =======================================*/
+#if SCM_USE_FULL_CONTINUATION
+/*
+ * A full continuation is reentered by writing back the segment of the C stack
+ * between the capture and the base marked by scm_call_with_gc_ready_stack(),
+ * and then by longjmp(). The frame is allocated on the heap to outlive the
+ * activation of call/cc, and the objects are marked by
+ * scm_mark_continuation().
+ */
 struct scm_continuation_frame {
+    volatile ScmObj dyn_ext;
+    volatile ScmObj ret_val;
+#if SCM_USE_BACKTRACE
+    volatile ScmObj trace_stack;
+#endif
+#if SCM_USE_MACHINE
+    scm_int_t machine_sp;
+    ScmObj machine_stack;
+#endif
+#if SCM_USE_VM
+    scm_int_t vm_sp;
+    ScmObj vm_stack;
+#endif
+    ScmObj cont_stack;   /* l_continuation_stack out of call/cc */
+    struct scm_escape_frame *escape_frames;
+    scm_int_t *stack_base;
+    scm_int_t stack_serial;
+    char *stack_start;   /* lowest address of the segment */
+    size_t stack_size;
+    ScmObj *stack;       /* copy of the segment */
+    JMP_BUF c_env;
+};
+#endif /* SCM_USE_FULL_CONTINUATION */
+
+/* The frame of an escape continuation lives in the activation of call/ec and
+ * is linked to the enclosing one. An escape continuation is valid only while
+ * its frame is on the chain l_escape_frames. */
+struct scm_escape_frame {
     /*
      * - To hint appropriate alignment on stack, a ScmObj is listed first
      * - GC marking for these ScmObj are implicitly performed by stack scanning
      */
-    volatile ScmObj dyn_ext;
     volatile ScmObj ret_val;
+    ScmObj ec;
+    ScmObj dyn_ext;
 #if SCM_USE_BACKTRACE
-    volatile ScmObj trace_stack;
+    ScmObj trace_stack;
+#endif
+#if SCM_USE_STACK_FRAME
+    scm_int_t frame_sp;
 #endif
+#if SCM_USE_MACHINE
+    scm_int_t machine_sp;
+#endif
+#if SCM_USE_VM
+    scm_int_t vm_sp;
+#endif
+    struct scm_escape_frame *prev;
     JMP_BUF c_env;
 };
 
@@ -84,6 +143,10 @@ SCM_GLOBAL_VARS_BEGIN(static_continuation);
 static volatile ScmObj l_current_dynamic_extent;
 static volatile ScmObj l_continuation_stack;
 static volatile ScmObj l_trace_stack;
+static struct scm_escape_frame *l_escape_frames;
+#if SCM_USE_FULL_CONTINUATION
+static scm_bool l_stack_grows_down;
+#endif
 #undef static
 SCM_GLOBAL_VARS_END(static_continuation);
 #define l_current_dynamic_extent                                             \
@@ -92,6 +155,10 @@ SCM_GLOBAL_VARS_END(static_continuation);
     SCM_GLOBAL_VAR(static_continuation, l_continuation_stack)
 #define l_trace_stack                                                        \
     SCM_GLOBAL_VAR(static_continuation, l_trace_stack)
+#define l_escape_frames                                                      \
+    SCM_GLOBAL_VAR(static_continuation, l_escape_frames)
+#define l_stack_grows_down                                                   \
+    SCM_GLOBAL_VAR(static_continuation, l_stack_grows_down)
 SCM_DEFINE_STATIC_VARS(static_continuation);
 
 /*=======================================
@@ -102,15 +169,28 @@ static void initialize_dynamic_extent(void);
 static void finalize_dynamic_extent(void);
 static void wind_onto_dynamic_extent(ScmObj before, ScmObj after);
 static void unwind_dynamic_extent(void);
+#if SCM_USE_FULL_CONTINUATION
 static void enter_dynamic_extent(ScmObj dest);
+#endif
 static void exit_dynamic_extent(ScmObj dest);
+static scm_bool dynamic_extent_tailp(ScmObj ext, ScmObj dest);
 
 /* continuation */
 static void initialize_continuation_env(void);
 static void finalize_continuation_env(void);
+static void call_escape_continuation(ScmObj ec, ScmObj ret) SCM_NORETURN;
+#if SCM_USE_FULL_CONTINUATION
 static void continuation_stack_push(ScmObj cont);
 static ScmObj continuation_stack_pop(void);
 static ScmObj continuation_stack_unwind(ScmObj dest_cont);
+static scm_bool stack_grows_downp(volatile ScmObj *caller_local)
+    SCM_NOINLINE;
+static void save_stack(struct scm_continuation_frame *frame) SCM_NOINLINE;
+static void reenter_continuation(struct scm_continuation_frame *frame)
+    SCM_NORETURN;
+static void restore_stack(struct scm_continuation_frame *frame)
+    SCM_NOINLINE SCM_NORETURN;
+#endif
 
 /*=======================================
   Function Definitions
@@ -171,23 +251,29 @@ unwind_dynamic_extent(void)
     l_current_dynamic_extent = CDR(l_current_dynamic_extent);
 }
 
+#if SCM_USE_FULL_CONTINUATION
 /* enter a dynamic extent of another continuation (dest) */
 static void
 enter_dynamic_extent(ScmObj dest)
 {
-    ScmObj frame, unwound, retpath;
+    ScmObj ext, unwound, retpath;
     DECLARE_INTERNAL_FUNCTION("enter_dynamic_extent");
 
     retpath = SCM_NULL;
-    unwound = dest;
-    while (!NULLP(unwound) && !EQ(unwound, l_current_dynamic_extent)) {
-        frame = POP(unwound);
-        retpath = CONS(frame, retpath);
+    for (unwound = dest;
+         !NULLP(unwound) && !EQ(unwound, l_current_dynamic_extent);
+         unwound = CDR(unwound))
+    {
+        retpath = CONS(unwound, retpath);
     }
 
-    FOR_EACH (frame, retpath)
-        scm_call(DYNEXT_FRAME_BEFORE(frame), SCM_NULL);
+    /* each before thunk is called in the outer extent of its frame */
+    FOR_EACH (ext, retpath) {
+        scm_call(DYNEXT_FRAME_BEFORE(CAR(ext)), SCM_NULL);
+        l_current_dynamic_extent = ext;
+    }
 }
+#endif /* SCM_USE_FULL_CONTINUATION */
 
 /* exit to a dynamic extent of another continuation (dest) */
 static void
@@ -196,14 +282,27 @@ exit_dynamic_extent(ScmObj dest)
     ScmObj frame;
     DECLARE_INTERNAL_FUNCTION("exit_dynamic_extent");
 
+    /* the frames shared with dest are not exited from */
     while (!NULLP(l_current_dynamic_extent)
-           && !EQ(l_current_dynamic_extent, dest))
+           && !dynamic_extent_tailp(l_current_dynamic_extent, dest))
     {
         frame = POP(l_current_dynamic_extent);
         scm_call(DYNEXT_FRAME_AFTER(frame), SCM_NULL);
     }
 }
 
+/* whether ext is the outer part of the dynamic extent dest */
+static scm_bool
+dynamic_extent_tailp(ScmObj ext, ScmObj dest)
+{
+    for (; CONSP(dest); dest = CDR(dest)) {
+        if (EQ(dest, ext))
+            return scm_true;
+    }
+
+    return EQ(dest, ext);
+}
+
 SCM_EXPORT ScmObj
 scm_dynamic_wind(ScmObj before, ScmObj thunk, ScmObj after)
 {
@@ -226,6 +325,14 @@ scm_dynamic_wind(ScmObj before, ScmObj thunk, ScmObj after)
 static void
 initialize_continuation_env(void)
 {
+#if SCM_USE_FULL_CONTINUATION
+    volatile ScmObj local;
+    scm_bool (*volatile anti_inline_stack_grows_downp)(volatile ScmObj *);
+
+    anti_inline_stack_grows_downp = stack_grows_downp;
+    l_stack_grows_down = (*anti_inline_stack_grows_downp)(&local);
+#endif
+
     scm_gc_protect_with_init((ScmObj *)&l_continuation_stack, SCM_NULL);
 }
 
@@ -234,6 +341,7 @@ finalize_continuation_env(void)
 {
 }
 
+#if SCM_USE_FULL_CONTINUATION
 static void
 continuation_stack_push(ScmObj cont)
 {
@@ -248,7 +356,7 @@ continuation_stack_pop(void)
     return NULLP(l_continuation_stack) ? SCM_FALSE : POP(l_continuation_stack);
 }
 
-/* expire all descendant continuations and dest_cont */
+/* pop all descendant continuations and dest_cont */
 static ScmObj
 continuation_stack_unwind(ScmObj dest_cont)
 {
@@ -258,96 +366,353 @@ continuation_stack_unwind(ScmObj dest_cont)
         cont = continuation_stack_pop();
         if (FALSEP(cont))
             return SCM_FALSE;
-        CONTINUATION_SET_FRAME(cont, INVALID_CONTINUATION_OPAQUE);
     } while (!EQ(dest_cont, cont));
 
     return dest_cont;
 }
+#endif /* SCM_USE_FULL_CONTINUATION */
 
 SCM_EXPORT void
 scm_destruct_continuation(ScmObj cont)
 {
+#if SCM_USE_FULL_CONTINUATION
+    struct scm_continuation_frame *frame;
+
+    frame = CONTINUATION_FRAME(cont);
+    if (frame != INVALID_CONTINUATION_OPAQUE && !ESCAPE_CONTINUATIONP(cont)) {
+        free(frame->stack);
+        free(frame);
+    }
+#else
     /* no object to be free(3) in this implementation */
+#endif
+}
+
+#if SCM_USE_FULL_CONTINUATION
+SCM_EXPORT void
+scm_mark_continuation(void *opaque)
+{
+    struct scm_continuation_frame *frame;
+
+    frame = (struct scm_continuation_frame *)opaque;
+    if (frame == INVALID_CONTINUATION_OPAQUE)
+        return;
+
+    scm_gc_mark(frame->dyn_ext);
+    scm_gc_mark(frame->ret_val);
+#if SCM_USE_BACKTRACE
+    scm_gc_mark(frame->trace_stack);
+#endif
+    scm_gc_mark(frame->cont_stack);
+#if SCM_USE_MACHINE
+    scm_gc_mark(frame->machine_stack);
+#endif
+#if SCM_USE_VM
+    scm_gc_mark(frame->vm_stack);
+#endif
+    /* the registers saved by setjmp() and the C stack may hold objects */
+    scm_gc_mark_locations((ScmObj *)&frame->c_env,
+                          sizeof(JMP_BUF) / (sizeof(ScmObj)));
+    if (frame->stack)
+        scm_gc_mark_locations(frame->stack,
+                              frame->stack_size / sizeof(ScmObj));
 }
+#endif /* SCM_USE_FULL_CONTINUATION */
 
 SCM_EXPORT ScmObj
 scm_call_with_current_continuation(ScmObj proc, ScmEvalState *eval_state)
 {
+#if SCM_USE_FULL_CONTINUATION
     volatile ScmObj cont, ret;
-    struct scm_continuation_frame cont_frame;
+    struct scm_continuation_frame *volatile frame;
 
-    cont_frame.dyn_ext = l_current_dynamic_extent;
-    cont_frame.ret_val = SCM_UNDEF;
+    frame = scm_malloc(sizeof(struct scm_continuation_frame));
+    frame->stack = NULL;
+    frame->dyn_ext = l_current_dynamic_extent;
+    frame->ret_val = SCM_UNDEF;
 #if SCM_USE_BACKTRACE
-    cont_frame.trace_stack = l_trace_stack;
+    frame->trace_stack = l_trace_stack;
+#endif
+#if SCM_USE_MACHINE
+    frame->machine_sp = scm_machine_sp;
+    frame->machine_stack = SCM_FALSE;
+#endif
+#if SCM_USE_VM
+    frame->vm_sp = scm_vm_sp;
+    frame->vm_stack = SCM_FALSE;
 #endif
+    frame->cont_stack = l_continuation_stack;
+    frame->escape_frames = l_escape_frames;
     cont = MAKE_CONTINUATION();
-    CONTINUATION_SET_FRAME(cont, &cont_frame);
-#if SCM_NESTED_CONTINUATION_ONLY
+    CONTINUATION_SET_FRAME(cont, frame);
     continuation_stack_push(cont);
+#if SCM_USE_MACHINE
+    /* cont protects the copy from here */
+    frame->machine_stack = scm_machine_save_stack();
+    SCM_WRITE_BARRIER(cont);
+#endif
+#if SCM_USE_VM
+    frame->vm_stack = scm_vm_save_stack();
+    SCM_WRITE_BARRIER(cont);
 #endif
 
-    if (SETJMP(cont_frame.c_env)) {
+    if (SETJMP(frame->c_env)) {
         /* returned back to the original continuation */
-        /* Don't refer cont because it may already be invalidated by
-         * continuation_stack_unwind(). */
 #if SCM_USE_BACKTRACE
-        l_trace_stack = cont_frame.trace_stack;
+        l_trace_stack = frame->trace_stack;
+#endif
+#if SCM_USE_MACHINE
+        scm_machine_unwind(frame->machine_sp);
+#endif
+#if SCM_USE_VM
+        scm_vm_unwind(frame->vm_sp);
+#endif
+        l_escape_frames = frame->escape_frames;
+#if SCM_USE_COMPILER
+        /* the frames of the loops may be reentered more than once */
+        scm_invalidate_loop_frames();
 #endif
 
-        enter_dynamic_extent(cont_frame.dyn_ext);
+        enter_dynamic_extent(frame->dyn_ext);
 
         eval_state->ret_type = SCM_VALTYPE_AS_IS;
-        return cont_frame.ret_val;
+        return frame->ret_val;
     } else {
-#if SCM_NESTED_CONTINUATION_ONLY
+        save_stack(frame);
+        /* the copy may hold young objects */
+        SCM_WRITE_BARRIER(cont);
+#if SCM_USE_COMPILER
+        /* the copy refers the frames of the loops in progress */
+        scm_invalidate_loop_frames();
+#endif
         /* Call proc with current continutation as (proc cont): This call must
          * not be scm_values_applier, to preserve current stack until longjmp()
          * is called. And so this implementation is not properly recursive. */
         eval_state->ret_type = SCM_VALTYPE_AS_IS;
         ret = scm_call(proc, LIST_1(cont));
 
-        /* the continuation expires when this function returned */
+        /* the continuation can still be reentered */
         continuation_stack_unwind(cont);
-#else
-        /* ONLY FOR TESTING: This call is properly recursible, but all
-         * continuations are broken and cannot be called, if the continuation
-         * is implemented by longjmp(). */
-        ret = LIST_3(scm_values_applier, proc, cont);
-#endif
 
         return ret;
     }
+#else /* SCM_USE_FULL_CONTINUATION */
+    /* A nested continuation never outlives the activation of call/cc. So it
+     * is an escape continuation. */
+    return scm_call_with_escape_continuation(proc, eval_state);
+#endif /* SCM_USE_FULL_CONTINUATION */
+}
+
+/* Call proc with an escape continuation, which can only be invoked in the
+ * dynamic extent of this call. It needs neither the continuation stack nor
+ * any frame on the heap. */
+SCM_EXPORT ScmObj
+scm_call_with_escape_continuation(ScmObj proc, ScmEvalState *eval_state)
+{
+    struct scm_escape_frame frame;
+    ScmObj ret;
+
+    frame.ret_val = SCM_UNDEF;
+    frame.dyn_ext = l_current_dynamic_extent;
+#if SCM_USE_BACKTRACE
+    frame.trace_stack = l_trace_stack;
+#endif
+#if SCM_USE_STACK_FRAME
+    frame.frame_sp = scm_stack_frame_sp;
+#endif
+#if SCM_USE_MACHINE
+    frame.machine_sp = scm_machine_sp;
+#endif
+#if SCM_USE_VM
+    frame.vm_sp = scm_vm_sp;
+#endif
+    frame.ec = MAKE_CONTINUATION();
+    SCM_CONTINUATION_SET_TAG(frame.ec, ESCAPE_CONTINUATION_TAG);
+    CONTINUATION_SET_FRAME(frame.ec, &frame);
+    frame.prev = l_escape_frames;
+    l_escape_frames = &frame;
+
+    if (ESCAPE_SETJMP(frame.c_env)) {
+        /* escaped from the activations inside */
+        l_escape_frames = frame.prev;
+#if SCM_USE_BACKTRACE
+        l_trace_stack = frame.trace_stack;
+#endif
+#if SCM_USE_STACK_FRAME
+        /* the activations escaped from have not released their frames.
+         * Conservatively leave them to the GC. */
+        scm_drop_stack_frames(frame.frame_sp);
+#endif
+#if SCM_USE_MACHINE
+        scm_machine_unwind(frame.machine_sp);
+#endif
+#if SCM_USE_VM
+        scm_vm_unwind(frame.vm_sp);
+#endif
+
+        eval_state->ret_type = SCM_VALTYPE_AS_IS;
+        return frame.ret_val;
+    }
+
+    /* As well as call/cc, this call must not be scm_values_applier. */
+    eval_state->ret_type = SCM_VALTYPE_AS_IS;
+    ret = scm_call(proc, LIST_1(frame.ec));
+
+    /* the escape continuation expires */
+    l_escape_frames = frame.prev;
+
+    return ret;
 }
 
 SCM_EXPORT void
 scm_call_continuation(ScmObj cont, ScmObj ret)
 {
+#if SCM_USE_FULL_CONTINUATION
     struct scm_continuation_frame *frame;
-#if SCM_NESTED_CONTINUATION_ONLY
-    ScmObj dst;
 #endif
     DECLARE_INTERNAL_FUNCTION("scm_call_continuation");
 
-    frame = CONTINUATION_FRAME(cont);
+    if (ESCAPE_CONTINUATIONP(cont))
+        call_escape_continuation(cont, ret);
 
-    if (frame != INVALID_CONTINUATION_OPAQUE
-#if SCM_NESTED_CONTINUATION_ONLY
-        && (dst = continuation_stack_unwind(cont), CONTINUATIONP(dst))
+#if SCM_USE_FULL_CONTINUATION
+    frame = CONTINUATION_FRAME(cont);
+    if (frame != INVALID_CONTINUATION_OPAQUE) {
+        if (FALSEP(scm_p_memq(cont, l_continuation_stack))) {
+            /* the continuation whose activation of call/cc has already been
+             * exited from is reentered by restoring the stack */
+            SCM_WRITE_BARRIER(cont);
+            frame->ret_val = ret;
+            reenter_continuation(frame);
+        } else {
+            /* escape to the continuation still on the stack: the fast path */
+            continuation_stack_unwind(cont);
+            exit_dynamic_extent(frame->dyn_ext);
+
+            SCM_WRITE_BARRIER(cont);
+            frame->ret_val = ret;
+            LONGJMP(frame->c_env, scm_true);
+        }
+        /* NOTREACHED */
+    }
 #endif
-        )
-    {
-        /* Don't refer cont because it may already be invalidated by
-         * continuation_stack_unwind(). */
-        exit_dynamic_extent(frame->dyn_ext);
+    ERR("expired continuation");
+}
 
-        frame->ret_val = ret;
-        LONGJMP(frame->c_env, scm_true);
-        /* NOTREACHED */
+static void
+call_escape_continuation(ScmObj ec, ScmObj ret)
+{
+    struct scm_escape_frame *frame, *live;
+    DECLARE_INTERNAL_FUNCTION("scm_call_continuation");
+
+    frame = ESCAPE_FRAME(ec);
+
+    /* The frame of an expired one may have been overwritten by another live
+     * frame on the same address. So the owner is also compared. */
+    for (live = l_escape_frames; live; live = live->prev) {
+        if (live == frame && EQ(live->ec, ec)) {
+            exit_dynamic_extent(frame->dyn_ext);
+
+            frame->ret_val = ret;
+            LONGJMP(frame->c_env, scm_true);
+            /* NOTREACHED */
+        }
+    }
+    ERR("expired continuation");
+}
+
+#if SCM_USE_FULL_CONTINUATION
+static scm_bool
+stack_grows_downp(volatile ScmObj *caller_local)
+{
+    volatile ScmObj local;
+
+    return ((char *)&local < (char *)caller_local);
+}
+
+/* Copy the segment of the C stack from the base to the frame of the caller,
+ * which is the activation of call/cc. */
+static void
+save_stack(struct scm_continuation_frame *frame)
+{
+    volatile ScmObj top;  /* approx */
+    scm_int_t *base;
+    char *start, *end;
+
+    base = scm_gc_stack_base();
+    SCM_ASSERT(base);
+
+    if (l_stack_grows_down) {
+        start = (char *)&top;
+        end = (char *)&base[1];
     } else {
-        ERR("expired continuation");
+        start = (char *)base;
+        end = (char *)(&top + 1);
+    }
+    frame->stack_base = base;
+    frame->stack_serial = *base;
+    frame->stack_start = start;
+    frame->stack_size = end - start;
+    frame->stack = scm_malloc(frame->stack_size);
+    memcpy(frame->stack, start, frame->stack_size);
+}
+
+static void
+reenter_continuation(struct scm_continuation_frame *frame)
+{
+    scm_int_t *base;
+    void (*volatile anti_inline_restore_stack)(struct scm_continuation_frame *);
+    DECLARE_INTERNAL_FUNCTION("scm_call_continuation");
+
+    /* the C stack below the base must be the one at the capture */
+    base = scm_gc_stack_base();
+    if (base != frame->stack_base || *base != frame->stack_serial)
+        ERR("continuation of another toplevel evaluation cannot be reentered");
+
+    exit_dynamic_extent(frame->dyn_ext);
+
+    l_continuation_stack = frame->cont_stack;
+#if SCM_USE_MACHINE
+    scm_machine_restore_stack(frame->machine_stack);
+#endif
+#if SCM_USE_VM
+    scm_vm_restore_stack(frame->vm_stack);
+#endif
+    anti_inline_restore_stack = restore_stack;
+    (*anti_inline_restore_stack)(frame);
+    /* NOTREACHED */
+    SCM_NOTREACHED;
+}
+
+/* Write back the saved segment and jump into it. The function recurses
+ * until its own frame gets out of the segment. */
+static void
+restore_stack(struct scm_continuation_frame *frame)
+{
+    volatile ScmObj pad[RESTORE_PAD_LEN];
+    scm_uintref_t here, start;
+    void (*volatile anti_inline_restore_stack)(struct scm_continuation_frame *);
+
+    pad[0] = SCM_FALSE;
+    /* leave a margin for the rest of the frame */
+    here = (scm_uintref_t)pad;
+    start = (scm_uintref_t)frame->stack_start;
+    if ((l_stack_grows_down)
+        ? here + 2 * sizeof(pad) > start
+        : here - sizeof(pad) < start + frame->stack_size)
+    {
+        anti_inline_restore_stack = restore_stack;
+        (*anti_inline_restore_stack)(frame);
+        /* prevent the call from being a tail call which does not grow the
+         * stack */
+        pad[0] = SCM_FALSE;
     }
+
+    memcpy(frame->stack_start, frame->stack, frame->stack_size);
+    LONGJMP(frame->c_env, scm_true);
+    /* NOTREACHED */
 }
+#endif /* SCM_USE_FULL_CONTINUATION */
 
 /*===========================================================================
   Trace Stack
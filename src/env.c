@@ -53,6 +53,16 @@
  *   In this case, rest1 is bound to (var4 var5 ...) and rest2 is bound to
  *   (val1 val2 val3 var4 var5 ...).
  *
+ *   If SCM_USE_VECTOR_FRAME is enabled, the frames created by compiled code
+ *   are vector frames that hold the shared formals and the values in one
+ *   object instead of the formals/actuals pair.
+ *
+ *     frame = #((var1 var2 var3 . rest1) val1 val2 val3 (var4 var5 ...))
+ *
+ *     frame = #(rest2 (val1 val2 val3 var4 var5 ...))
+ *
+ *   Both kinds of the frames can be mixed in an env.
+ *
  *   The environment object should not be manipulated manually, to allow
  *   replacing with another implementation. Use the function interfaces.
  *
@@ -91,6 +101,10 @@
   File Local Function Declarations
 =======================================*/
 static scm_bool valid_framep(ScmObj frame);
+#if SCM_USE_VECTOR_FRAME
+static scm_int_t vector_frame_len(ScmObj formals);
+static ScmObj list2vector_frame(ScmObj formals, ScmObj actuals);
+#endif
 
 /*=======================================
   Function Definitions
@@ -128,6 +142,59 @@ scm_unpack_env(ScmPackedEnv packed, ScmObj context)
     return context;
 }
 
+/*
+ * The expansion of a macro use depends on the environment only through
+ * the variables bound in each frame, so a cached expansion can be
+ * reused in any environment of the same shape.
+ */
+static ScmObj
+frame_formals(ScmObj frame)
+{
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame))
+        return VECTOR_FRAME_FORMALS(frame);
+#endif
+    return CAR(frame);
+}
+
+/* Returns the formals of each frame of ENV. */
+SCM_EXPORT ScmObj
+scm_env_shape(ScmObj env)
+{
+    ScmQueue q;
+    ScmObj shape;
+
+    shape = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, shape);
+    for (; CONSP(env); env = CDR(env))
+        SCM_QUEUE_ADD(q, frame_formals(CAR(env)));
+    return shape;
+}
+
+/* Tests whether ENV binds the same variables as SHAPE frame by frame. */
+SCM_EXPORT scm_bool
+scm_env_shapep(ScmObj env, ScmObj shape)
+{
+    ScmObj formals, expected;
+
+    for (; CONSP(env) && CONSP(shape); env = CDR(env), shape = CDR(shape)) {
+        formals = frame_formals(CAR(env));
+        expected = CAR(shape);
+        /* Interpreted binding forms make their formals on each evaluation. */
+        for (; CONSP(formals) && CONSP(expected);
+             formals = CDR(formals), expected = CDR(expected))
+        {
+            if (EQ(formals, expected))
+                break;
+            if (!EQ(CAR(formals), CAR(expected)))
+                return scm_false;
+        }
+        if (!EQ(formals, expected))
+            return scm_false;
+    }
+    return (NULLP(env) && NULLP(shape));
+}
+
 
 static ScmRef
 lookup_n_frames(ScmObj id, scm_int_t n, ScmObj env)
@@ -239,6 +306,80 @@ scm_extend_environment(ScmObj formals, ScmObj actuals, ScmObj env)
     return CONS(frame, env);
 }
 
+#if SCM_USE_VECTOR_FRAME
+/**
+ * Make a vector frame to be filled by the caller
+ *
+ * @param formals Symbol list as variable names of the frame. Same as
+ *                scm_extend_environment(), a dotted list or a symbol is
+ *                accepted to handle function arguments directly.
+ * @param len Number of the values including the rest list.
+ *
+ * @return A vector frame whose values are unbound.
+ *
+ * @see VECTOR_FRAME_VALUES()
+ */
+SCM_EXPORT ScmObj
+scm_make_vector_frame(ScmObj formals, scm_int_t len)
+{
+    ScmObj *vec;
+    scm_int_t i;
+
+    vec = scm_malloc(sizeof(ScmObj) * (len + 1));
+    vec[0] = formals;
+    for (i = 1; i <= len; i++)
+        vec[i] = SCM_UNBOUND;
+
+    return MAKE_VECTOR(vec, len + 1);
+}
+
+/**
+ * Construct a new env by a filled vector frame
+ *
+ * @see scm_make_vector_frame()
+ */
+SCM_EXPORT ScmObj
+scm_extend_environment_by_frame(ScmObj frame, ScmObj env)
+{
+    DECLARE_INTERNAL_FUNCTION("scm_extend_environment_by_frame");
+
+    SCM_ASSERT(valid_framep(frame));
+    SCM_ASSERT(VALID_ENVP(env));
+
+    return CONS(frame, env);
+}
+
+/* number of the values of a vector frame including the rest list */
+static scm_int_t
+vector_frame_len(ScmObj formals)
+{
+    scm_int_t len;
+
+    for (len = 0; CONSP(formals); formals = CDR(formals))
+        len++;
+    /* the rest parameter */
+    if (!NULLP(formals))
+        len++;
+
+    return len;
+}
+
+static ScmObj
+list2vector_frame(ScmObj formals, ScmObj actuals)
+{
+    ScmObj frame, *vals;
+
+    frame = scm_make_vector_frame(formals, vector_frame_len(formals));
+    vals = VECTOR_FRAME_VALUES(frame);
+    for (; CONSP(formals); formals = CDR(formals), actuals = CDR(actuals))
+        *vals++ = CAR(actuals);
+    if (!NULLP(formals))
+        *vals = actuals;
+
+    return frame;
+}
+#endif /* SCM_USE_VECTOR_FRAME */
+
 /**
  * Replace entire content of recentmost frame of an env
  *
@@ -257,6 +398,12 @@ scm_replace_environment(ScmObj formals, ScmObj actuals, ScmObj env)
     SCM_ASSERT(CONSP(env));
 
     frame = CAR(env);
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame)) {
+        SET_CAR(env, list2vector_frame(formals, actuals));
+        return env;
+    }
+#endif
     SET_CAR(frame, formals);
     SET_CDR(frame, actuals);
 
@@ -280,6 +427,21 @@ scm_update_environment(ScmObj actuals, ScmObj env)
     SCM_ASSERT(CONSP(env));
 
     frame = CAR(env);
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame)) {
+        ScmObj formals, *vals;
+
+        formals = VECTOR_FRAME_FORMALS(frame);
+        SCM_ASSERT(scm_valid_environment_extensionp(formals, actuals));
+        vals = VECTOR_FRAME_VALUES(frame);
+        for (; CONSP(formals); formals = CDR(formals), actuals = CDR(actuals))
+            *vals++ = CAR(actuals);
+        if (!NULLP(formals))
+            *vals = actuals;
+
+        return env;
+    }
+#endif
     SCM_ASSERT(scm_valid_environment_extensionp(CAR(frame), actuals));
     SET_CDR(frame, actuals);
 
@@ -302,6 +464,24 @@ scm_add_environment(ScmObj var, ScmObj val, ScmObj env)
         env = LIST_1(frame);
     } else if (CONSP(env)) {
         frame = CAR(env);
+#if SCM_USE_VECTOR_FRAME
+        if (VECTOR_FRAMEP(frame)) {
+            ScmObj new_frame, *vals, *old_vals;
+            scm_int_t len, i;
+
+            /* reallocate the frame to prepend the binding */
+            len = VECTOR_FRAME_LEN(frame);
+            formals = CONS(var, VECTOR_FRAME_FORMALS(frame));
+            new_frame = scm_make_vector_frame(formals, len + 1);
+            vals = VECTOR_FRAME_VALUES(new_frame);
+            old_vals = VECTOR_FRAME_VALUES(frame);
+            vals[0] = val;
+            for (i = 0; i < len; i++)
+                vals[i + 1] = old_vals[i];
+            SET_CAR(env, new_frame);
+            return env;
+        }
+#endif
         formals = CONS(var, CAR(frame));
         actuals = CONS(val, CDR(frame));
         SET_CAR(frame, formals);
@@ -376,6 +556,23 @@ scm_lookup_frame(ScmObj var, ScmObj frame)
     SCM_ASSERT(IDENTIFIERP(var));
     SCM_ASSERT(valid_framep(frame));
 
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame)) {
+        ScmObj *vals;
+
+        for (formals = VECTOR_FRAME_FORMALS(frame),
+                 vals = VECTOR_FRAME_VALUES(frame);
+             CONSP(formals);
+             formals = CDR(formals), vals++)
+        {
+            if (EQ(var, CAR(formals)))
+                return vals;
+        }
+        /* dotted list */
+        return (EQ(var, formals)) ? vals : SCM_INVALID_REF;
+    }
+#endif
+
     for (formals = CAR(frame), actuals = REF_CDR(frame);
          CONSP(formals);
          formals = CDR(formals), actuals = REF_CDR(DEREF(actuals)))
@@ -390,6 +587,55 @@ scm_lookup_frame(ScmObj var, ScmObj frame)
     return SCM_INVALID_REF;
 }
 
+#if (SCM_USE_COMPILER || SCM_USE_VM)
+/**
+ * Lookup a variable by its lexical address
+ *
+ * The address must have been resolved from the formals of the frames by the
+ * compiler. No identifier comparison is performed.
+ *
+ * @param depth Number of the frames to be skipped.
+ * @param index Position of the variable in the formals of the frame. The rest
+ *              parameter of a dotted formals is encoded as ~position.
+ *
+ * @return Reference to the variable.
+ */
+SCM_EXPORT ScmRef
+scm_lookup_lexical(scm_int_t depth, scm_int_t index, ScmObj env)
+{
+    for (; depth; depth--) {
+        SCM_ASSERT(CONSP(env));
+        env = CDR(env);
+    }
+    SCM_ASSERT(CONSP(env));
+
+    return scm_lookup_frame_lexical(index, CAR(env));
+}
+
+/**
+ * Lookup a variable in a frame by its position
+ *
+ * @see scm_lookup_lexical()
+ */
+SCM_EXPORT ScmRef
+scm_lookup_frame_lexical(scm_int_t index, ScmObj frame)
+{
+    ScmRef actuals;
+    scm_int_t i;
+
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame))
+        return &VECTOR_FRAME_VALUES(frame)[(index < 0) ? ~index : index];
+#endif
+
+    actuals = REF_CDR(frame);
+    for (i = (index < 0) ? ~index : index; i; i--)
+        actuals = REF_CDR(DEREF(actuals));
+
+    return (index < 0) ? actuals : REF_CAR(DEREF(actuals));
+}
+#endif /* (SCM_USE_COMPILER || SCM_USE_VM) */
+
 ScmObj
 scm_symbol_value(ScmObj var, ScmObj env)
 {
@@ -461,6 +707,14 @@ valid_framep(ScmObj frame)
         if (scm_valid_environment_extensionp(formals, actuals))
             return scm_true;
     }
+#if SCM_USE_VECTOR_FRAME
+    if (VECTOR_FRAMEP(frame) && SCM_VECTOR_LEN(frame)) {
+        formals = VECTOR_FRAME_FORMALS(frame);
+        if (!SCM_LISTLEN_ERRORP(scm_validate_formals(formals))
+            && vector_frame_len(formals) == VECTOR_FRAME_LEN(frame))
+            return scm_true;
+    }
+#endif
     return scm_false;
 }
 
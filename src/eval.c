@@ -44,6 +44,7 @@
   File Local Macro Definitions
 =======================================*/
 #define SCM_ERRMSG_NON_R5RS_ENV "the environment is not conformed to R5RS"
+#define ERRMSG_UNMATCHED_ARGS   "unmatched number or improper args"
 
 /*=======================================
   File Local Type Definitions
@@ -65,6 +66,10 @@ static void call_continuation(ScmObj cont, ScmObj args,
 #endif
 static ScmObj call_closure(ScmObj proc, ScmObj args, ScmEvalState *eval_state,
                            enum ScmValueType need_eval);
+#if SCM_USE_VECTOR_FRAME
+static ScmObj eval_vector_frame(ScmObj formals, ScmObj args, ScmObj env,
+                                scm_bool stackp);
+#endif
 static ScmObj call(ScmObj proc, ScmObj args, ScmEvalState *eval_state,
                    enum ScmValueType need_eval);
 static ScmObj map_eval(ScmObj args, scm_int_t *args_len, ScmObj env);
@@ -94,11 +99,24 @@ scm_call(ScmObj proc, ScmObj args)
     return SCM_FINISH_TAILREC_CALL(ret, &state);
 }
 
+#if (SCM_USE_COMPILER || SCM_USE_MACHINE || SCM_USE_VM)
+/* Entry point of call() for compiled code, the machine and the VM. PROC
+ * must have been evaluated already. Since it is not an expression,
+ * evaluating it again for NEED_EVAL yields itself. */
+SCM_EXPORT ScmObj
+scm_tailcall(ScmObj proc, ScmObj args, ScmEvalState *eval_state,
+             enum ScmValueType need_eval)
+{
+    return call(proc, args, eval_state, need_eval);
+}
+#endif /* (SCM_USE_COMPILER || SCM_USE_MACHINE || SCM_USE_VM) */
+
 /* ARGS should NOT have been evaluated yet. */
 static ScmObj
 reduce(ScmObj (*func)(), ScmObj args, ScmObj env, enum ScmValueType need_eval)
 {
     ScmObj left, right;
+    ScmBinaryOperator binary;
     enum ScmReductionState state;
     DECLARE_INTERNAL_FUNCTION("(reduction)");
 
@@ -116,8 +134,24 @@ reduce(ScmObj (*func)(), ScmObj args, ScmObj env, enum ScmValueType need_eval)
         return (*func)(left, left, &state);
     }
 
+    right = POP(args);
+    if (need_eval)
+        right = EVAL(right, env);
+
+    /* the most common case */
+    if (NO_MORE_ARG(args)) {
+        binary = scm_lookup_binary_operator(func);
+        if (binary)
+            return (*binary)(left, right);
+        state = SCM_REDUCE_LAST;
+        return (*func)(left, right, &state);
+    }
+
     /* Reduce upto the penult. */
     state = SCM_REDUCE_PARTWAY;
+    left = (*func)(left, right, &state);
+    if (state == SCM_REDUCE_STOP)
+        return left;
     FOR_EACH_BUTLAST (right, args) {
         if (need_eval)
             right = EVAL(right, env);
@@ -162,7 +196,10 @@ call_closure(ScmObj proc, ScmObj args, ScmEvalState *eval_state,
              enum ScmValueType need_eval)
 {
     ScmObj exp, formals, body, proc_env;
-    scm_int_t formals_len, args_len;
+#if SCM_USE_VECTOR_FRAME
+    ScmObj frame;
+#endif
+    scm_int_t args_len;
     DECLARE_INTERNAL_FUNCTION("call_closure");
 
     /*
@@ -176,17 +213,77 @@ call_closure(ScmObj proc, ScmObj args, ScmEvalState *eval_state,
      *   (2) (<variable1> <variable2> ...)
      *   (3) (<variable1> <variable2> ... <variable n-1> . <variable n>)
      */
-    exp      = SCM_CLOSURE_EXP(proc);
-    formals  = CAR(exp);
-    body     = CDR(exp);
+    /* the engine is fixed at the initialization, so that every closure is
+     * compiled by the enabled one if any */
+    exp = SCM_CLOSURE_EXP(proc);
+#if SCM_USE_VM
+    if (scm_vm_enabled) {
+        /* the code object is returned as the body to be run by the VM */
+        exp = scm_vm_compile_closure(proc);
+        formals = CAR(VM_CODE_SOURCE(exp));
+        body    = exp;
+    } else
+#endif
+#if SCM_USE_COMPILER
+    if (scm_compiler_enabled) {
+        exp = scm_compile_closure(proc);
+        formals = CODE_FORMALS(exp);
+        body    = CODE_BODY(exp);
+    } else
+#endif
+    {
+        formals = CAR(exp);
+        body    = CDR(exp);
+    }
     proc_env = SCM_CLOSURE_ENV(proc);
+#if SCM_USE_VECTOR_FRAME
+    if (need_eval) {
+#if SCM_USE_STACK_FRAME
+        frame = eval_vector_frame(formals, args, eval_state->env,
+                                  COMPILED_CODEP(exp)
+                                  && CODE_STACK_FRAMEP(exp));
+#else
+        frame = eval_vector_frame(formals, args, eval_state->env, scm_false);
+#endif
+        if (VALIDP(frame)) {
+            eval_state->env = scm_extend_environment_by_frame(frame, proc_env);
+            goto eval_body;
+        }
+        /* unmatched number of args is reported by the path below */
+    }
+#endif
     if (need_eval) {
         args = map_eval(args, &args_len, eval_state->env);
     } else {
         args_len = scm_validate_actuals(args);
         if (SCM_LISTLEN_ERRORP(args_len))
-            goto err_improper;
+            ERR_OBJ(ERRMSG_UNMATCHED_ARGS, args);
     }
+    eval_state->env = scm_bind_closure_args(formals, args, args_len, proc_env);
+
+#if SCM_USE_VECTOR_FRAME
+ eval_body:
+#endif
+    eval_state->ret_type = SCM_VALTYPE_NEED_EVAL;
+#if SCM_USE_COMPILER
+    if (COMPILED_CODEP(exp))
+        return body;
+#endif
+#if SCM_USE_VM
+    if (VM_CODEP(exp))
+        return body;
+#endif
+    return scm_s_body(body, eval_state);
+}
+
+/* Extend ENV by the frame of a closure call in which FORMALS are bound to the
+ * evaluated ARGS. ARGS_LEN is the validated length of ARGS. */
+SCM_EXPORT ScmObj
+scm_bind_closure_args(ScmObj formals, ScmObj args, scm_int_t args_len,
+                      ScmObj env)
+{
+    scm_int_t formals_len;
+    DECLARE_INTERNAL_FUNCTION("call_closure");
 
     if (IDENTIFIERP(formals)) {
         /* (1) <variable> */
@@ -216,14 +313,70 @@ call_closure(ScmObj proc, ScmObj args, ScmEvalState *eval_state,
         SCM_NOTREACHED;
     }
 
-    eval_state->env = scm_extend_environment(formals, args, proc_env);
-    eval_state->ret_type = SCM_VALTYPE_NEED_EVAL;
-    return scm_s_body(body, eval_state);
+    return scm_extend_environment(formals, args, env);
 
  err_improper:
-    ERR_OBJ("unmatched number or improper args", args);
+    ERR_OBJ(ERRMSG_UNMATCHED_ARGS, args);
 }
 
+#if SCM_USE_VECTOR_FRAME
+/* Make the frame of a closure call by evaluating ARGS directly into it
+ * without consing an argument list. Returns SCM_INVALID if the number of ARGS
+ * does not match FORMALS. STACKP requests a frame from the stack of frames
+ * (see compiler.c). */
+static ScmObj
+eval_vector_frame(ScmObj formals, ScmObj args, ScmObj env, scm_bool stackp)
+{
+    ScmQueue q;
+    ScmObj frame, rest_formals, rest_args, rest, val;
+    scm_int_t len, i;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    len = 0;
+    for (rest_formals = formals, rest_args = args;
+         CONSP(rest_formals);
+         rest_formals = CDR(rest_formals), rest_args = CDR(rest_args))
+    {
+        if (!CONSP(rest_args))
+            return SCM_INVALID;
+        len++;
+    }
+    if (NULLP(rest_formals)) {
+        if (!NULLP(rest_args))
+            return SCM_INVALID;
+    } else {
+        /* the rest parameter */
+        if (!PROPER_LISTP(rest_args))
+            return SCM_INVALID;
+        len++;
+    }
+
+#if SCM_USE_STACK_FRAME
+    frame = (stackp) ? scm_make_stack_frame(formals, len)
+                     : scm_make_vector_frame(formals, len);
+#else
+    frame = scm_make_vector_frame(formals, len);
+#endif
+    for (i = 0; CONSP(formals); formals = CDR(formals), args = CDR(args)) {
+        val = EVAL(CAR(args), env);
+        CHECK_VALID_EVALED_VALUE(val);
+        VECTOR_FRAME_VALUES(frame)[i++] = val;
+    }
+    if (!NULLP(formals)) {
+        rest = SCM_NULL;
+        SCM_QUEUE_POINT_TO(q, rest);
+        FOR_EACH (val, args) {
+            val = EVAL(val, env);
+            CHECK_VALID_EVALED_VALUE(val);
+            SCM_QUEUE_ADD(q, val);
+        }
+        VECTOR_FRAME_VALUES(frame)[i] = rest;
+    }
+
+    return frame;
+}
+#endif /* SCM_USE_VECTOR_FRAME */
+
 /**
  * @param proc The procedure or syntax to call.
  * @param args The argument list.
@@ -470,6 +623,23 @@ SCM_EXPORT ScmObj
 scm_eval(ScmObj obj, ScmObj env)
 {
     ScmEvalState state;
+#if SCM_USE_STACK_FRAME
+    scm_int_t frame_sp;
+#endif
+
+#if SCM_USE_MACHINE
+    if (scm_machine_enabled)
+        return scm_machine_eval(obj, env);
+#endif
+#if SCM_USE_VM
+    if (scm_vm_enabled)
+        return scm_vm_eval(obj, env);
+#endif
+
+#if SCM_USE_STACK_FRAME
+    /* the stack frames pushed during this evaluation */
+    frame_sp = scm_stack_frame_sp;
+#endif
 
 #if SCM_STRICT_TOPLEVEL_DEFINITIONS
     /* FIXME: temporary hack */
@@ -496,8 +666,24 @@ eval_loop:
     if (IDENTIFIERP(obj)) {
         obj = scm_symbol_value(obj, state.env);
     } else if (CONSP(obj)) {
-        obj = call(CAR(obj), CDR(obj), &state, SCM_VALTYPE_NEED_EVAL);
+#if SCM_USE_COMPILER
+        /* shortcut for the nodes of compiled code. See compiler.c. */
+        if (NODEP(obj)) {
+            state.ret_type = SCM_VALTYPE_NEED_EVAL;
+            obj = (*SCM_FUNC_CFUNC(CAR(obj)))(CDR(obj), &state);
+        } else
+#endif
+        {
+            obj = call(CAR(obj), CDR(obj), &state, SCM_VALTYPE_NEED_EVAL);
+        }
         if (state.ret_type == SCM_VALTYPE_NEED_EVAL) {
+#if SCM_USE_STACK_FRAME
+            /* A tail call into a stack frame leaves no reference to the
+             * frames of the preceding activations. */
+            if (scm_stack_frame_sp > frame_sp + 1 && CONSP(state.env)
+                && scm_top_stack_framep(CAR(state.env)))
+                scm_release_stack_frames_but_top(frame_sp);
+#endif
 #if SCM_STRICT_TOPLEVEL_DEFINITIONS
             if (state.nest == SCM_NEST_RETTYPE_BEGIN)
                 state.nest = SCM_NEST_COMMAND_OR_DEFINITION;
@@ -517,6 +703,10 @@ eval_loop:
         PLAIN_ERR("eval: #() is not a valid R5RS form. use '#() instead");
 #endif
 
+#if SCM_USE_STACK_FRAME
+    if (scm_stack_frame_sp > frame_sp)
+        scm_release_stack_frames(frame_sp);
+#endif
 #if SCM_USE_BACKTRACE
     scm_pop_trace_frame();
 #endif
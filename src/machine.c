@@ -0,0 +1,901 @@
+/*===========================================================================
+ *  Filename : machine.c
+ *  About    : Evaluator driven by an explicit control stack
+ *
+ *  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of authors nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ *  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================*/
+
+/*
+ * The machine evaluates an expression without recursing through C for its
+ * non-tail subexpressions. The computation waiting for the value of a
+ * subexpression is pushed onto the control stack as a frame instead:
+ *
+ *   [<kind> <saved fp> <slot> ...]
+ *
+ * <kind> tells what to do with the value, and <saved fp> is the index of the
+ * frame below. The values of the operands of a call are pushed above the
+ * slots of the frame of the call as they are evaluated, and the whole frame
+ * is popped at once when the call is made. So the native stack does not grow
+ * with the recursion of the program, and a non-tail call costs a few stores
+ * instead of the C calls of the interpreter.
+ *
+ * Procedure calls, closure bodies, if, begin, let, let*, and, or, cond and
+ * map and for-each on a single list, as well as the reductions such as + and
+ * <, are run by the machine. Other syntaxes are called as the interpreter
+ * does. Their tail expressions come back to the machine, while their other
+ * subexpressions, as well as the procedures that C code calls by
+ * scm_call(), are evaluated by nested activations of the machine through
+ * scm_eval(). A nested activation uses the part of the control stack above
+ * the frames of the one that called it, and so the native stack only grows
+ * with the nesting of such syntaxes and C procedures.
+ *
+ * Each activation keeps its stack pointer in a local variable and publishes
+ * it to scm_machine_sp only when calling out. A continuation restores the
+ * published one when it escapes from activations.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "sigscheme.h"
+#include "sigschemeinternal.h"
+
+/*=======================================
+  File Local Macro Definitions
+=======================================*/
+#define ERRMSG_EXPRESSION_REQUIRED "at least 1 expression required"
+
+#define STACK_INITIAL_LEN 4096
+
+#define STACK        (SCM_VECTOR_VEC(l_control_stack))
+#define SLOT(i)      (STACK[fp + (i)])
+#define FRAME_KIND() (SCM_INT_VALUE(SLOT(0)))
+
+/* the values pushed onto the frame of the kind begin at this slot */
+#define ARGS_VALUES  5
+#define LET_VALUES   6
+#define MAP_VALUES   5
+
+#define ENSURE_STACK(n)                                                      \
+    do {                                                                     \
+        if (sp + (n) > SCM_VECTOR_LEN(l_control_stack))                      \
+            grow_stack(sp + (n));                                            \
+        if (sp + (n) > l_stack_hwm)                                          \
+            l_stack_hwm = sp + (n);                                          \
+    } while (/* CONSTCOND */ 0)
+
+/* Push a frame of KIND with N slots. The slots are filled by the caller. */
+#define PUSH_FRAME(kind, n)                                                  \
+    do {                                                                     \
+        ENSURE_STACK((n) + 2);                                               \
+        STACK[sp]     = MAKE_INT(kind);                                      \
+        STACK[sp + 1] = MAKE_INT(fp);                                        \
+        fp = sp;                                                             \
+        sp += (n) + 2;                                                       \
+    } while (/* CONSTCOND */ 0)
+
+#define POP_FRAME()                                                          \
+    do {                                                                     \
+        sp = fp;                                                             \
+        fp = SCM_INT_VALUE(STACK[fp + 1]);                                   \
+    } while (/* CONSTCOND */ 0)
+
+#define PUSH_VALUE(val)                                                      \
+    do {                                                                     \
+        ENSURE_STACK(1);                                                     \
+        STACK[sp++] = (val);                                                 \
+    } while (/* CONSTCOND */ 0)
+
+/* Publish the stack pointer before anything that may evaluate Scheme code,
+ * so that nested activations push their frames above. */
+#define CALL_OUT() (scm_machine_sp = sp)
+
+#if SCM_STRICT_TOPLEVEL_DEFINITIONS
+#define DEFINABLE_TOPLEVELP(env, nest)                                       \
+    (scm_toplevel_environmentp(env)                                          \
+     && ((nest) == SCM_NEST_PROGRAM                                          \
+         || (nest) == SCM_NEST_COMMAND_OR_DEFINITION))
+#else
+#define DEFINABLE_TOPLEVELP(env, nest) (scm_toplevel_environmentp(env))
+#endif
+
+/* the nest of the tail expression returned with SCM_VALTYPE_NEED_EVAL */
+#define TAIL_NEST(nest)                                                      \
+    (((nest) == SCM_NEST_RETTYPE_BEGIN) ? SCM_NEST_COMMAND_OR_DEFINITION    \
+                                        : SCM_NEST_COMMAND)
+
+#define SYNTAX_CFUNCP(obj, func)                                             \
+    (SCM_FUNC_CFUNC(obj) == (ScmFuncType)(func))
+
+#if SCM_USE_INTERNAL_DEFINITIONS
+/* Test whether EXP may be an internal definition. */
+#define DEFINITION_FORMP(exp)                                                \
+    (CONSP(exp) && (EQ(CAR(exp), l_sym_define) || EQ(CAR(exp), l_sym_begin)))
+#endif
+
+/*=======================================
+  File Local Type Definitions
+=======================================*/
+/* The kinds of the frames and their slots. The slots of an index lower than
+ * the one of the values are fixed. */
+enum frame_kind {
+    FRAME_HALT,      /* [halt fp] */
+    FRAME_OPERATOR,  /* [operator fp <env> <args> <nest>] */
+    FRAME_ARGS,      /* [args fp <proc> <env> <rest args> <value> ...] */
+    FRAME_IF,        /* [if fp <env> (<consequent> . <rest>)] */
+    FRAME_SEQ,       /* [seq fp <env> <rest exps> <tail nest>] */
+    FRAME_AND,       /* [and fp <env> <rest exps>] */
+    FRAME_OR,        /* [or fp <env> <rest exps>] */
+    FRAME_COND,      /* [cond fp <env> <rest clauses>] */
+    FRAME_YIELD,     /* [=> fp <env> <test value>] */
+    FRAME_LET,       /* [let fp <env> <formals> <rest bindings> <body>
+                        <value> ...] */
+    FRAME_LETSTAR,   /* [let* fp <env> <rest bindings> <body>] */
+    FRAME_MAP,       /* [map fp <proc> <rest list> <env> <value> ...] */
+    FRAME_FOR_EACH,  /* [for-each fp <proc> <rest list> <env>] */
+    FRAME_REDUCE     /* [reduce fp <proc> <env> <rest args> <left>] */
+};
+
+/*=======================================
+  Variable Definitions
+=======================================*/
+SCM_DEFINE_EXPORTED_VARS(machine);
+
+SCM_GLOBAL_VARS_BEGIN(static_machine);
+#define static
+static ScmObj l_control_stack;
+static scm_int_t l_stack_hwm;  /* upper bound of the slots in use */
+static ScmObj l_sym_else, l_sym_yields;
+#if SCM_USE_INTERNAL_DEFINITIONS
+static ScmObj l_sym_define, l_sym_begin;
+#endif
+#undef static
+SCM_GLOBAL_VARS_END(static_machine);
+#define l_control_stack SCM_GLOBAL_VAR(static_machine, l_control_stack)
+#define l_stack_hwm     SCM_GLOBAL_VAR(static_machine, l_stack_hwm)
+#define l_sym_else      SCM_GLOBAL_VAR(static_machine, l_sym_else)
+#define l_sym_yields    SCM_GLOBAL_VAR(static_machine, l_sym_yields)
+#define l_sym_define    SCM_GLOBAL_VAR(static_machine, l_sym_define)
+#define l_sym_begin     SCM_GLOBAL_VAR(static_machine, l_sym_begin)
+SCM_DEFINE_STATIC_VARS(static_machine);
+
+/*=======================================
+  File Local Function Declarations
+=======================================*/
+static void grow_stack(scm_int_t len);
+static void clear_stack(scm_int_t sp);
+static ScmObj stack_to_list(scm_int_t from, scm_int_t to);
+static scm_bool let_formals(ScmObj bindings, ScmObj *formals);
+static scm_bool letstar_bindingsp(ScmObj bindings);
+
+/*=======================================
+  Function Definitions
+=======================================*/
+SCM_EXPORT void
+scm_init_machine(void)
+{
+    SCM_GLOBAL_VARS_INIT(machine);
+    SCM_GLOBAL_VARS_INIT(static_machine);
+
+    /* the machine runs only when selected by --engine machine */
+    scm_machine_enabled = scm_false;
+
+    scm_machine_sp = l_stack_hwm = 0;
+    scm_gc_protect_with_init(&l_control_stack,
+                             scm_p_make_vector(MAKE_INT(STACK_INITIAL_LEN),
+                                               LIST_1(SCM_FALSE)));
+
+    l_sym_else   = scm_intern("else");
+    l_sym_yields = scm_intern("=>");
+#if SCM_USE_INTERNAL_DEFINITIONS
+    l_sym_define = scm_intern("define");
+    l_sym_begin  = scm_intern("begin");
+#endif
+}
+
+/* Reallocate the control stack to hold at least LEN slots. */
+static void
+grow_stack(scm_int_t len)
+{
+    ScmObj *vec;
+    scm_int_t old_len, new_len, i;
+
+    old_len = SCM_VECTOR_LEN(l_control_stack);
+    new_len = old_len * 2;
+    if (new_len < len)
+        new_len = len;
+
+    vec = scm_malloc(sizeof(ScmObj) * new_len);
+    memcpy(vec, SCM_VECTOR_VEC(l_control_stack), sizeof(ScmObj) * old_len);
+    for (i = old_len; i < new_len; i++)
+        vec[i] = SCM_FALSE;
+    /* the old vector is left to the GC */
+    l_control_stack = MAKE_VECTOR(vec, new_len);
+}
+
+/* Clear the slots above SP to not retain the objects. */
+static void
+clear_stack(scm_int_t sp)
+{
+    scm_int_t i;
+
+    for (i = sp; i < l_stack_hwm; i++)
+        STACK[i] = SCM_FALSE;
+    scm_machine_sp = l_stack_hwm = sp;
+}
+
+/* Forget the frames above SP, which the activations escaped from by a
+ * continuation have left. */
+SCM_EXPORT void
+scm_machine_unwind(scm_int_t sp)
+{
+    if (l_stack_hwm > sp)
+        clear_stack(sp);
+}
+
+#if SCM_USE_FULL_CONTINUATION
+/* Copy the frames of the control stack for a continuation to be
+ * reentered. */
+SCM_EXPORT ScmObj
+scm_machine_save_stack(void)
+{
+    ScmObj saved;
+
+    saved = scm_p_make_vector(MAKE_INT(scm_machine_sp), LIST_1(SCM_FALSE));
+    memcpy(SCM_VECTOR_VEC(saved), STACK, sizeof(ScmObj) * scm_machine_sp);
+
+    return saved;
+}
+
+/* Replace the frames with the ones saved by scm_machine_save_stack(). */
+SCM_EXPORT void
+scm_machine_restore_stack(ScmObj saved)
+{
+    scm_int_t len;
+
+    len = SCM_VECTOR_LEN(saved);
+    if (len > SCM_VECTOR_LEN(l_control_stack))
+        grow_stack(len);
+    memcpy(STACK, SCM_VECTOR_VEC(saved), sizeof(ScmObj) * len);
+    if (l_stack_hwm < len)
+        l_stack_hwm = len;
+    clear_stack(len);
+}
+#endif /* SCM_USE_FULL_CONTINUATION */
+
+/* Make a list of the values in the slots FROM to TO (exclusive). */
+static ScmObj
+stack_to_list(scm_int_t from, scm_int_t to)
+{
+    ScmObj lst;
+
+    for (lst = SCM_NULL; to > from; to--)
+        lst = CONS(STACK[to - 1], lst);
+
+    return lst;
+}
+
+/* Collect the variables of the bindings of a normal let into FORMALS.
+ * Returns false if BINDINGS are malformed, to let scm_s_let() report it. */
+static scm_bool
+let_formals(ScmObj bindings, ScmObj *formals)
+{
+    ScmQueue varq;
+    ScmObj binding, var;
+
+    *formals = SCM_NULL;
+    SCM_QUEUE_POINT_TO(varq, *formals);
+    FOR_EACH (binding, bindings) {
+        if (!LIST_2_P(binding) || !IDENTIFIERP(var = CAR(binding)))
+            return scm_false;
+#if SCM_STRICT_ARGCHECK
+        if (TRUEP(scm_p_memq(var, *formals)))
+            return scm_false;
+#endif
+        SCM_QUEUE_ADD(varq, var);
+    }
+
+    return NULLP(bindings);
+}
+
+static scm_bool
+letstar_bindingsp(ScmObj bindings)
+{
+    ScmObj binding;
+
+    FOR_EACH (binding, bindings) {
+        if (!LIST_2_P(binding) || !IDENTIFIERP(CAR(binding)))
+            return scm_false;
+    }
+
+    return NULLP(bindings);
+}
+
+SCM_EXPORT ScmObj
+scm_machine_eval(ScmObj exp, ScmObj env)
+{
+    ScmEvalState state;
+    scm_reduction_operator reduce;
+    enum ScmReductionState reduce_state;
+    ScmObj val, proc, args, rest, clause, formals;
+    enum ScmNestState nest;
+    scm_int_t base, sp, fp, n;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    /* values need no activation */
+    if (IDENTIFIERP(exp))
+        return scm_symbol_value(exp, env);
+#if (SCM_STRICT_NULL_FORM || SCM_STRICT_VECTOR_FORM)
+    if (!CONSP(exp) && !NULLP(exp) && !VECTORP(exp))
+        return exp;
+#else
+    if (!CONSP(exp))
+        return exp;
+#endif
+
+#if SCM_STRICT_TOPLEVEL_DEFINITIONS
+    /* FIXME: temporary hack. See scm_eval(). */
+    if (EQ(env, SCM_INTERACTION_ENV_INDEFINABLE)) {
+        env = SCM_INTERACTION_ENV;
+        nest = SCM_NEST_COMMAND;
+    } else
+#endif
+    {
+        nest = (EQ(env, SCM_INTERACTION_ENV)) ? SCM_NEST_PROGRAM
+                                              : SCM_NEST_COMMAND;
+    }
+
+#if SCM_USE_BACKTRACE
+    scm_push_trace_frame(exp, env);
+#endif
+
+    base = sp = scm_machine_sp;
+    fp = -1;
+    PUSH_FRAME(FRAME_HALT, 0);
+    goto eval_tail;
+
+    /* Evaluate EXP in ENV as EVAL(exp, env) does. */
+ eval:
+    nest = (EQ(env, SCM_INTERACTION_ENV)) ? SCM_NEST_PROGRAM
+                                          : SCM_NEST_COMMAND;
+    /* Evaluate EXP in ENV at the position of NEST. */
+ eval_tail:
+    if (IDENTIFIERP(exp)) {
+        val = scm_symbol_value(exp, env);
+        goto ret;
+    }
+    if (!CONSP(exp)) {
+#if SCM_STRICT_NULL_FORM
+        if (NULLP(exp))
+            PLAIN_ERR("eval: () is not a valid R5RS form. use '() instead");
+#endif
+#if (SCM_USE_VECTOR && SCM_STRICT_VECTOR_FORM)
+        if (VECTORP(exp))
+            PLAIN_ERR("eval: #() is not a valid R5RS form. use '#() instead");
+#endif
+        val = exp;
+        goto ret;
+    }
+#if SCM_USE_COMPILER
+    /* code compiled by another engine */
+    if (NODEP(exp)) {
+        state.env = env;
+        state.nest = nest;
+        state.ret_type = SCM_VALTYPE_NEED_EVAL;
+        CALL_OUT();
+        val = (*SCM_FUNC_CFUNC(CAR(exp)))(CDR(exp), &state);
+        goto tail_or_ret;
+    }
+#endif
+
+    proc = CAR(exp);
+    args = CDR(exp);
+    if (IDENTIFIERP(proc)) {
+        proc = scm_symbol_value(proc, env);
+    } else if (CONSP(proc)) {
+        PUSH_FRAME(FRAME_OPERATOR, 3);
+        SLOT(2) = env;
+        SLOT(3) = args;
+        SLOT(4) = MAKE_INT(nest);
+        exp = proc;
+        goto eval;
+    }
+
+    /* Call PROC with the unevaluated ARGS. */
+ operate:
+    if (FUNCP(proc)) {
+        if (SCM_FUNC_TYPECODE(proc) & SCM_FUNCTYPE_SYNTAX) {
+            if (SYNTAX_CFUNCP(proc, scm_s_quote) && LIST_1_P(args)) {
+                val = scm_s_quote(CAR(args), env);
+                goto ret;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_lambda) && CONSP(args)) {
+                val = scm_s_lambda(CAR(args), CDR(args), env);
+                goto ret;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_if)
+                && CONSP(args) && CONSP(CDR(args)))
+            {
+                PUSH_FRAME(FRAME_IF, 2);
+                SLOT(2) = env;
+                SLOT(3) = CDR(args);
+                exp = CAR(args);
+                goto eval;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_begin)) {
+                exp = args;
+                goto begin;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_let)
+                && CONSP(args) && let_formals(CAR(args), &formals))
+            {
+                PUSH_FRAME(FRAME_LET, 4);
+                SLOT(2) = env;
+                SLOT(3) = formals;
+                SLOT(4) = CAR(args);
+                SLOT(5) = CDR(args);
+                goto let_next;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_letstar)
+                && CONSP(args) && letstar_bindingsp(CAR(args)))
+            {
+                if (NULLP(CAR(args))) {
+                    exp = CDR(args);
+                    goto body;
+                }
+                PUSH_FRAME(FRAME_LETSTAR, 3);
+                SLOT(2) = env;
+                SLOT(3) = CAR(args);
+                SLOT(4) = CDR(args);
+                exp = CADR(CAR(CAR(args)));
+                goto eval;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_and) && CONSP(args)) {
+                PUSH_FRAME(FRAME_AND, 2);
+                SLOT(2) = env;
+                SLOT(3) = args;
+                goto test_next;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_or) && CONSP(args)) {
+                PUSH_FRAME(FRAME_OR, 2);
+                SLOT(2) = env;
+                SLOT(3) = args;
+                goto test_next;
+            }
+            if (SYNTAX_CFUNCP(proc, scm_s_cond) && CONSP(args)) {
+                PUSH_FRAME(FRAME_COND, 2);
+                SLOT(2) = env;
+                SLOT(3) = args;
+                goto cond_next;
+            }
+            goto syntax;
+        }
+        /* Reductions evaluate each operand only if it is needed. Operands
+         * up to two are all evaluated anyway. */
+        if (SCM_FUNC_TYPECODE(proc) == SCM_REDUCTION_OPERATOR
+            && CONSP(args) && CONSP(CDR(args)) && CONSP(CDDR(args)))
+        {
+            PUSH_FRAME(FRAME_REDUCE, 4);
+            SLOT(2) = proc;
+            SLOT(3) = env;
+            SLOT(4) = CDR(args);
+            SLOT(5) = SCM_INVALID;
+            exp = CAR(args);
+            goto eval;
+        }
+    } else if (CLOSUREP(proc)) {
+#if SCM_USE_LEGACY_MACRO
+        if (SYNTACTIC_CLOSUREP(proc))
+            goto syntax;
+#endif
+    } else if (!CONTINUATIONP(proc) || EQ(proc, scm_values_applier)) {
+        /* macros, the values applier and invalid operators */
+        goto syntax;
+    }
+
+    /* evaluate the operands onto the frame */
+    PUSH_FRAME(FRAME_ARGS, 3);
+    SLOT(2) = proc;
+    SLOT(3) = env;
+    SLOT(4) = args;
+ args_next:
+    rest = SLOT(4);
+    if (CONSP(rest)) {
+        SLOT(4) = CDR(rest);
+        exp = CAR(rest);
+        env = SLOT(3);
+        goto eval;
+    }
+    if (!NULLP(rest))
+        ERR_OBJ(SCM_ERRMSG_IMPROPER_ARGS, rest);
+    n = sp - (fp + ARGS_VALUES);
+    args = stack_to_list(fp + ARGS_VALUES, sp);
+    proc = SLOT(2);
+    env = SLOT(3);
+    POP_FRAME();
+
+    /* Call PROC with the N evaluated ARGS. */
+ apply:
+    if (CLOSUREP(proc)
+#if SCM_USE_LEGACY_MACRO
+        && !SYNTACTIC_CLOSUREP(proc)
+#endif
+        )
+    {
+        exp = SCM_CLOSURE_EXP(proc);
+        env = scm_bind_closure_args(CAR(exp), args, n, SCM_CLOSURE_ENV(proc));
+        exp = CDR(exp);
+        nest = SCM_NEST_COMMAND;
+        goto body;
+    }
+    if (FUNCP(proc) && n == 2
+        && (SYNTAX_CFUNCP(proc, scm_p_map)
+            || SYNTAX_CFUNCP(proc, scm_p_for_each)))
+    {
+        PUSH_FRAME((SYNTAX_CFUNCP(proc, scm_p_map)) ? FRAME_MAP
+                                                      : FRAME_FOR_EACH, 3);
+        SLOT(2) = CAR(args);
+        SLOT(3) = CADR(args);
+        SLOT(4) = env;
+        goto map_next;
+    }
+    state.env = env;
+    state.nest = SCM_NEST_COMMAND;
+    CALL_OUT();
+    val = scm_tailcall(proc, args, &state, SCM_VALTYPE_AS_IS);
+    goto tail_or_ret;
+
+    /* Let call() process the syntax or macro PROC. */
+ syntax:
+    state.env = env;
+    state.nest = nest;
+    CALL_OUT();
+    val = scm_tailcall(proc, args, &state, SCM_VALTYPE_NEED_EVAL);
+ tail_or_ret:
+    if (state.ret_type == SCM_VALTYPE_NEED_EVAL) {
+        exp = val;
+        env = state.env;
+        nest = TAIL_NEST(state.nest);
+        goto eval_tail;
+    }
+    goto ret;
+
+    /* <body> of closures and let forms */
+ body:
+#if SCM_USE_INTERNAL_DEFINITIONS
+    if (!CONSP(exp) || DEFINITION_FORMP(CAR(exp))) {
+        state.env = env;
+        state.nest = nest;
+        state.ret_type = SCM_VALTYPE_NEED_EVAL;
+        CALL_OUT();
+        val = scm_s_body(exp, &state);
+        goto tail_or_ret;
+    }
+#endif
+    /* Fall through. */
+
+    /* (begin <exp> ...) whose operands are EXP */
+ begin:
+    if (DEFINABLE_TOPLEVELP(env, nest)) {
+        if (!CONSP(exp)) {
+            DECLARE_INTERNAL_FUNCTION("begin");
+            ASSERT_NO_MORE_ARG(exp);
+            val = SCM_UNDEF;
+            goto ret;
+        }
+        nest = SCM_NEST_COMMAND_OR_DEFINITION;
+    } else {
+        if (!CONSP(exp)) {
+            DECLARE_INTERNAL_FUNCTION("begin");
+            ERR(ERRMSG_EXPRESSION_REQUIRED);
+        }
+        nest = SCM_NEST_COMMAND;
+    }
+    if (!CONSP(CDR(exp)))
+        goto seq_last;
+    PUSH_FRAME(FRAME_SEQ, 3);
+    SLOT(2) = env;
+    SLOT(3) = exp;
+    SLOT(4) = MAKE_INT(nest);
+ seq_next:
+    rest = SLOT(3);
+    env = SLOT(2);
+    nest = (enum ScmNestState)SCM_INT_VALUE(SLOT(4));
+    if (CONSP(CDR(rest))) {
+        SLOT(3) = CDR(rest);
+        exp = CAR(rest);
+        /* the toplevel env is not forbidden to define in a definable
+         * sequence */
+        nest = (nest == SCM_NEST_COMMAND_OR_DEFINITION) ? SCM_NEST_PROGRAM
+                                                        : SCM_NEST_COMMAND;
+        goto eval_tail;
+    }
+    POP_FRAME();
+    exp = rest;
+ seq_last:
+    {
+        DECLARE_INTERNAL_FUNCTION("begin");
+        ASSERT_NO_MORE_ARG(CDR(exp));
+    }
+    exp = CAR(exp);
+    goto eval_tail;
+
+    /* the rest of the operands of and/or */
+ test_next:
+    rest = SLOT(3);
+    env = SLOT(2);
+    if (CONSP(CDR(rest))) {
+        SLOT(3) = CDR(rest);
+        exp = CAR(rest);
+        nest = SCM_NEST_COMMAND;
+        goto eval_tail;
+    }
+    {
+        DECLARE_INTERNAL_FUNCTION((FRAME_KIND() == FRAME_AND) ? "and" : "or");
+        ASSERT_NO_MORE_ARG(CDR(rest));
+    }
+    POP_FRAME();
+    exp = CAR(rest);
+    nest = SCM_NEST_COMMAND;
+    goto eval_tail;
+
+ cond_next:
+    rest = SLOT(3);
+    if (!CONSP(rest)) {
+        {
+            DECLARE_INTERNAL_FUNCTION("cond");
+            ASSERT_NO_MORE_ARG(rest);
+        }
+        POP_FRAME();
+        val = SCM_UNDEF;
+        goto ret;
+    }
+    clause = CAR(rest);
+    if (!CONSP(clause)) {
+        DECLARE_INTERNAL_FUNCTION("cond");
+        ERR_OBJ("bad clause", clause);
+    }
+    env = SLOT(2);
+    if (EQ(CAR(clause), l_sym_else)) {
+        {
+            DECLARE_INTERNAL_FUNCTION("cond");
+            ASSERT_NO_MORE_ARG(CDR(rest));
+        }
+        POP_FRAME();
+        exp = CDR(clause);
+        nest = SCM_NEST_COMMAND;
+        goto begin;
+    }
+    exp = CAR(clause);
+    goto eval;
+
+ let_next:
+    rest = SLOT(4);
+    if (CONSP(rest)) {
+        SLOT(4) = CDR(rest);
+        exp = CADR(CAR(rest));
+        env = SLOT(2);
+        goto eval;
+    }
+    args = stack_to_list(fp + LET_VALUES, sp);
+    env = scm_extend_environment(SLOT(3), args, SLOT(2));
+    exp = SLOT(5);
+    POP_FRAME();
+    nest = SCM_NEST_COMMAND;
+    goto body;
+
+ map_next:
+    rest = SLOT(3);
+    if (CONSP(rest)) {
+        SLOT(3) = CDR(rest);
+        proc = SLOT(2);
+        env = SLOT(4);
+        args = LIST_1(CAR(rest));
+        n = 1;
+        goto apply;
+    }
+    {
+        DECLARE_INTERNAL_FUNCTION("map");
+        NO_MORE_ARG(rest);
+    }
+    if (FRAME_KIND() == FRAME_MAP)
+        val = stack_to_list(fp + MAP_VALUES, sp);
+    else
+        val = SCM_UNDEF;
+    POP_FRAME();
+    /* Fall through. */
+
+    /* Pass VAL to the frame at the top. */
+ ret:
+    switch (FRAME_KIND()) {
+    case FRAME_HALT:
+        break;
+
+    case FRAME_OPERATOR:
+        proc = val;
+        env = SLOT(2);
+        args = SLOT(3);
+        nest = (enum ScmNestState)SCM_INT_VALUE(SLOT(4));
+        POP_FRAME();
+        goto operate;
+
+    case FRAME_ARGS:
+        CHECK_VALID_EVALED_VALUE(val);
+        PUSH_VALUE(val);
+        goto args_next;
+
+    case FRAME_IF:
+        CHECK_VALID_EVALED_VALUE(val);
+        env = SLOT(2);
+        rest = SLOT(3);
+        POP_FRAME();
+        {
+            DECLARE_INTERNAL_FUNCTION("if");
+
+            exp = POP(rest);
+            if (FALSEP(val)) {
+#if SCM_COMPAT_SIOD_BUGS
+                exp = (CONSP(rest)) ? CAR(rest) : SCM_FALSE;
+#else
+                exp = (CONSP(rest)) ? CAR(rest) : SCM_UNDEF;
+#endif
+            }
+#if SCM_STRICT_ARGCHECK
+            SAFE_POP(rest);
+            ASSERT_NO_MORE_ARG(rest);
+#endif
+        }
+        nest = SCM_NEST_COMMAND;
+        goto eval_tail;
+
+    case FRAME_SEQ:
+        CHECK_VALID_EVALED_VALUE(val);
+        goto seq_next;
+
+    case FRAME_AND:
+    case FRAME_OR:
+        CHECK_VALID_EVALED_VALUE(val);
+        if (FALSEP(val) == (FRAME_KIND() == FRAME_AND)) {
+            {
+                DECLARE_INTERNAL_FUNCTION((FRAME_KIND() == FRAME_AND) ? "and"
+                                                                      : "or");
+                ASSERT_PROPER_ARG_LIST(SLOT(3));
+            }
+            POP_FRAME();
+            goto ret;
+        }
+        goto test_next;
+
+    case FRAME_COND:
+        CHECK_VALID_EVALED_VALUE(val);
+        rest = SLOT(3);
+        if (FALSEP(val)) {
+            SLOT(3) = CDR(rest);
+            goto cond_next;
+        }
+        exp = CDAR(rest);
+        if (NULLP(exp)) {
+            POP_FRAME();
+            goto ret;
+        }
+        if (EQ(l_sym_yields, CAR(exp)) && LIST_2_P(exp)) {
+            SLOT(0) = MAKE_INT(FRAME_YIELD);
+            SLOT(3) = val;
+            exp = CADR(exp);
+            env = SLOT(2);
+            goto eval;
+        }
+        env = SLOT(2);
+        POP_FRAME();
+        nest = SCM_NEST_COMMAND;
+        goto begin;
+
+    case FRAME_YIELD:
+        if (!PROCEDUREP(val)) {
+            DECLARE_INTERNAL_FUNCTION("cond");
+            ERR_OBJ("exp after => must be a procedure but got", val);
+        }
+        proc = val;
+        args = LIST_1(SLOT(3));
+        n = 1;
+        env = SLOT(2);
+        POP_FRAME();
+        goto apply;
+
+    case FRAME_LET:
+        CHECK_VALID_EVALED_VALUE(val);
+        PUSH_VALUE(val);
+        goto let_next;
+
+    case FRAME_LETSTAR:
+        CHECK_VALID_EVALED_VALUE(val);
+        rest = SLOT(3);
+        /* extend env for each variable */
+        env = scm_extend_environment(LIST_1(CAAR(rest)), LIST_1(val),
+                                     SLOT(2));
+        rest = CDR(rest);
+        if (CONSP(rest)) {
+            SLOT(2) = env;
+            SLOT(3) = rest;
+            exp = CADR(CAR(rest));
+            goto eval;
+        }
+        exp = SLOT(4);
+        POP_FRAME();
+        nest = SCM_NEST_COMMAND;
+        goto body;
+
+    case FRAME_MAP:
+        PUSH_VALUE(val);
+        goto map_next;
+
+    case FRAME_FOR_EACH:
+        goto map_next;
+
+    case FRAME_REDUCE:
+        CHECK_VALID_EVALED_VALUE(val);
+        rest = SLOT(4);
+        if (!VALIDP(SLOT(5))) {
+            SLOT(5) = val;
+        } else {
+            /* the same calls as reduce() of eval.c */
+            DECLARE_INTERNAL_FUNCTION("(reduction)");
+
+            reduce = (scm_reduction_operator)SCM_FUNC_CFUNC(SLOT(2));
+            if (CONSP(rest)) {
+                reduce_state = SCM_REDUCE_PARTWAY;
+                val = (*reduce)(SLOT(5), val, &reduce_state);
+            } else {
+                ASSERT_NO_MORE_ARG(rest);
+                reduce_state = SCM_REDUCE_LAST;
+                val = (*reduce)(SLOT(5), val, &reduce_state);
+            }
+            if (!CONSP(rest) || reduce_state == SCM_REDUCE_STOP) {
+                POP_FRAME();
+                goto ret;
+            }
+            SLOT(5) = val;
+        }
+        SLOT(4) = CDR(rest);
+        exp = CAR(rest);
+        env = SLOT(3);
+        goto eval;
+
+    default:
+        SCM_NOTREACHED;
+    }
+
+    clear_stack(base);
+#if SCM_USE_BACKTRACE
+    scm_pop_trace_frame();
+#endif
+    return val;
+}
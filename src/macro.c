@@ -72,6 +72,11 @@
  * Objects found in a compiled pattern or template that mark where
  * pattern variables were.
  *
+ * quoted constant:
+ * A quote form in a template whose datum contains no pattern
+ * variables.  The datum is unwrapped when the template is compiled
+ * and shared by all expansions rather than copied into each.
+ *
  * repeatable subpattern (reppat):
  * A subpattern *or subtemplate* designated as repeatable, i.e.
  * followed by an ellipsis.
@@ -90,6 +95,12 @@
  * A subform which is matched to a pattern variable, or a list of such
  * objects.  It derives, surprisingly perhaps, from `subform', only
  * contracted for disambiguation.  FIXME: Any better name?
+ *
+ * binds:
+ * A vector mapping each pattern variable, by the number given to it
+ * in the order of appearance in the pattern, to its sub.  A pattern
+ * variable at level N is bound to N nested vectors, so that a
+ * template can refer to any repetition in constant time.
  */
 
 #if SCM_DEBUG_MACRO
@@ -110,16 +121,36 @@ SCM_GLOBAL_VARS_BEGIN(static_macro);
 #if SCM_DEBUG_MACRO
 static enum dbg_flag l_debug_mode;
 #endif
-static int l_dummy;
+static ScmObj l_expansion_cache;
+static ScmObj l_constant_mark;
 #undef static
 SCM_GLOBAL_VARS_END(static_macro);
 #define l_debug_mode SCM_GLOBAL_VAR(static_macro, l_debug_mode)
+#define l_expansion_cache SCM_GLOBAL_VAR(static_macro, l_expansion_cache)
+#define l_constant_mark   SCM_GLOBAL_VAR(static_macro, l_constant_mark)
 SCM_DEFINE_STATIC_VARS(static_macro);
 
 #define SYM_SYNTAX_RULES scm_intern("syntax-rules")
 
+/* Direct-mapped cache of expansions.  Each entry is #f or
+ * (args macro env-shape . expansion), so a redefined macro, being a
+ * new object, never hits the entries of its predecessor. */
+#define EXPANSION_CACHE_SIZE 256
+#define EXPANSION_CACHE_INDEX(macro, args)                                   \
+    ((scm_int_t)((((scm_uintobj_t)(macro) ^ (scm_uintobj_t)(args)) >> 4)     \
+                 & (EXPANSION_CACHE_SIZE - 1)))
+
 #define ELLIPSISP(o) EQ((o), SYM_ELLIPSIS)
 
+#define QUOTE_SYNTAXP(o)                                                     \
+    (SYNTAXP(o) && SCM_FUNC_CFUNC(o) == (ScmFuncType)scm_s_quote)
+
+/* A quoted constant is compiled into (<constant mark> quote . datum). */
+#define MAKE_CONSTANT(quote, datum) CONS(l_constant_mark, CONS((quote), (datum)))
+#define CONSTANTP(tmpl)             (EQ(CAR(tmpl), l_constant_mark))
+#define CONSTANT_QUOTE(tmpl)        (CADR(tmpl))
+#define CONSTANT_DATUM(tmpl)        (CDDR(tmpl))
+
 #define MAKE_PVAR SCM_SUBPAT_MAKE_PVAR
 #define PVAR_INDEX SCM_SUBPAT_PVAR_INDEX
 #define PVARP SCM_SUBPAT_PVARP
@@ -129,6 +160,31 @@ SCM_DEFINE_STATIC_VARS(static_macro);
 #define REPPAT_PVCOUNT SCM_SUBPAT_REPPAT_PVCOUNT
 #define REPPATP SCM_SUBPAT_REPPATP
 
+/* The pvars of a reppat in a pattern are numbered consecutively, so
+ * the reppat records the number of the first one alongside its
+ * subpattern. */
+#define MAKE_PATTERN_REPPAT(subpat, first, pvcount)                          \
+    MAKE_REPPAT(CONS(MAKE_INT(first), (subpat)), (pvcount))
+#define PATTERN_REPPAT_PAT(reppat)   CDR(REPPAT_PAT(reppat))
+#define PATTERN_REPPAT_FIRST(reppat) SCM_INT_VALUE(CAR(REPPAT_PAT(reppat)))
+
+/* A compiled rule is (pattern template npvars . arity).  ARITY is the
+ * length of the argument lists the pattern can match, or ~N if it can
+ * match any with N or more pairs.  The length of a macro use is
+ * computed once and tested against the arity of each rule, so that
+ * only the rules that may match are tried. */
+#define MAKE_RULE(pat, tmpl, npvars, arity)                                  \
+    CONS((pat), CONS((tmpl), CONS(MAKE_INT(npvars), MAKE_INT(arity))))
+#define RULE_PATTERN(rule)  (CAR(rule))
+#define RULE_TEMPLATE(rule) (CADR(rule))
+#define RULE_NPVARS(rule)   (SCM_INT_VALUE(CAR(CDDR(rule))))
+#define RULE_ARITY(rule)    (SCM_INT_VALUE(CDR(CDDR(rule))))
+#define ARITY_MATCHP(arity, len)                                             \
+    ((0 <= (arity)) ? ((len) == (arity))                                     \
+     : (SCM_LISTLEN_PROPERP(len) ? (~(arity) <= (len))                       \
+        : (SCM_LISTLEN_CIRCULARP(len)                                        \
+           || ~(arity) <= SCM_LISTLEN_DOTTED(len))))
+
 
 #if SCM_DEBUG_MACRO
 #define DBG_PRINT(args) (dbg_print args)
@@ -191,20 +247,30 @@ typedef struct {
 } var_map;
 
 typedef struct {
-    ScmObj pvmark;              /** Pvar marker in patterns. */
     var_map pvars;              /** Pvar -> level/marker. */
     scm_int_t pvlen;            /** Length of pvars.syms */
+    scm_int_t npvars;           /** Number of pvars in the pattern. */
     ScmObj literals;
+    ScmObj env;                 /** Environment of the definition. */
+    scm_bool share_constants;   /** Compile quoted constants. */
     struct {
         scm_bool pattern;       /* False if compiling template. */
     } mode;
 } compilation_context;
 
 static ScmObj compile(compilation_context *ctx, ScmObj form);
-static ScmObj match(ScmObj pattern, ScmObj form, ScmPackedEnv def_penv, ScmPackedEnv use_penv, ScmObj env);
-static ScmObj transcribe(ScmObj template, ScmObj sub, ScmPackedEnv def_penv, ScmObj use_env);
+static scm_bool constant_quotep(compilation_context *ctx, ScmObj form);
+static scm_bool constant_datump(compilation_context *ctx, ScmObj datum);
+static scm_bool mentionsp(ScmObj form, ScmObj sym);
+static scm_int_t pattern_arity(ScmObj pattern);
+static ScmObj match(ScmObj pattern, scm_int_t npvars, ScmObj form,
+                    ScmPackedEnv def_penv, ScmPackedEnv use_penv, ScmObj env);
+static ScmObj binds_to_list(ScmObj binds, ScmObj levels);
+static ScmObj transcribe(ScmObj template, ScmObj binds, ScmPackedEnv def_penv,
+                         ScmObj use_env);
 
 static ScmObj expand_hygienic_macro(ScmObj macro, ScmObj args, ScmObj env);
+static ScmObj expand_cached(ScmObj macro, ScmObj args, ScmObj env);
 
 static scm_int_t list_find_index(ScmObj x, ScmObj ls);
 
@@ -216,6 +282,11 @@ scm_init_macro(void)
 
     scm_register_funcs(scm_functable_r5rs_macro);
 
+    scm_gc_protect_with_init(&l_expansion_cache,
+                             scm_p_make_vector(MAKE_INT(EXPANSION_CACHE_SIZE),
+                                               LIST_1(SCM_FALSE)));
+    scm_gc_protect_with_init(&l_constant_mark, CONS(SCM_FALSE, SCM_FALSE));
+
     INIT_DBG();
 }
 
@@ -231,24 +302,49 @@ scm_macro_bad_scope(ScmObj id)
 static ScmObj
 expand_hygienic_macro(ScmObj macro, ScmObj args, ScmObj env)
 {
-    ScmObj sub, rule, rules;
+    ScmObj binds, rule, rules;
     ScmPackedEnv use_penv, def_penv;
+    scm_int_t len;
     DECLARE_INTERNAL_FUNCTION("(expand_hygienic_macro)");
 
     rules = SCM_HMACRO_RULES(macro);
     def_penv = SCM_HMACRO_ENV(macro);
     use_penv = scm_pack_env(env);
+    len = scm_length(args);
 
     FOR_EACH (rule, rules) {
-        sub = match(CAR(rule), args, def_penv, use_penv, env);
-        if (VALIDP(sub))
-            return transcribe(CDR(rule), sub, SCM_HMACRO_ENV(macro),
-                              env);
+        if (!ARITY_MATCHP(RULE_ARITY(rule), len))
+            continue;
+        binds = match(RULE_PATTERN(rule), RULE_NPVARS(rule), args,
+                      def_penv, use_penv, env);
+        if (VALIDP(binds))
+            return transcribe(RULE_TEMPLATE(rule), binds, def_penv, env);
     }
     ERR_OBJ("no matching pattern for", args);
     /* Not reached. */
 }
 
+/* Reuses the expansion of ARGS if it was made by MACRO in an
+ * environment of the same shape as ENV.  Use sites are identified by
+ * the argument list of the form, which the evaluator never copies. */
+static ScmObj
+expand_cached(ScmObj macro, ScmObj args, ScmObj env)
+{
+    ScmObj entry, ret;
+    scm_int_t i;
+
+    i = EXPANSION_CACHE_INDEX(macro, args);
+    entry = SCM_VECTOR_VEC(l_expansion_cache)[i];
+    if (CONSP(entry) && EQ(CAR(entry), args) && EQ(CADR(entry), macro)
+        && scm_env_shapep(env, CAR(CDDR(entry))))
+        return CDR(CDDR(entry));
+
+    ret = expand_hygienic_macro(macro, args, env);
+    entry = CONS(args, CONS(macro, CONS(scm_env_shape(env), ret)));
+    SCM_VECTOR_VEC(l_expansion_cache)[i] = entry;
+    return ret;
+}
+
 SCM_EXPORT ScmObj
 scm_expand_macro(ScmObj macro, ScmObj args, ScmEvalState *eval_state)
 {
@@ -260,7 +356,7 @@ scm_expand_macro(ScmObj macro, ScmObj args, ScmEvalState *eval_state)
     if (!SCM_LISTLEN_PROPERP(scm_length(args)))
         ERR_OBJ("bad argument list", args);
 #endif
-    ret = expand_hygienic_macro(macro, args, eval_state->env);
+    ret = expand_cached(macro, args, eval_state->env);
     DBG_PRINT((DBG_EXPANDER, "expanded to ~s\n", ret));
     return ret;
 }
@@ -288,6 +384,7 @@ scm_s_syntax_rules(ScmObj args, ScmObj env)
         ERR_OBJ("missing rules", args);
 
     ctx.literals = CAR(args);
+    ctx.env      = env;
     args = CDR(args);
 #if SCM_STRICT_ARGCHECK
     /* Check literals. */
@@ -300,7 +397,6 @@ scm_s_syntax_rules(ScmObj args, ScmObj env)
     }
 #endif
 
-    ctx.pvmark = MAKE_PVAR(SCM_NULL, 0);
     SCM_QUEUE_POINT_TO(q, compiled_rules);
 
     FOR_EACH (rule, args) {
@@ -317,11 +413,16 @@ scm_s_syntax_rules(ScmObj args, ScmObj env)
         ctx.pvlen        = 0;
         ctx.mode.pattern = scm_true;
         pat  = compile(&ctx, CDAR(rule));
+        ctx.npvars       = ctx.pvlen;
         ctx.mode.pattern = scm_false;
+        /* Quoted data in the template of a nested syntax-rules may be
+         * patterns, where their identifiers must stay wrapped. */
+        ctx.share_constants = !mentionsp(CADR(rule), SYM_SYNTAX_RULES);
         /* ctx.pvlen = 0; Not necessary because we just need its
          * change, not the absolute value. */
         tmpl = compile(&ctx, CADR(rule));
-        SCM_QUEUE_ADD(q, CONS(pat, tmpl));
+        SCM_QUEUE_ADD(q, MAKE_RULE(pat, tmpl, ctx.npvars,
+                                   pattern_arity(pat)));
     }
 
     return MAKE_HMACRO(compiled_rules, env);
@@ -335,15 +436,16 @@ scm_s_match(ScmObj form, ScmObj clauses, ScmEvalState *state)
     DECLARE_FUNCTION("match", syntax_variadic_tailrec_1);
 
     form             = EVAL(form, state->env);
-    ctx.pvmark       = MAKE_PVAR(SCM_NULL, 0);
     ctx.literals     = SCM_NULL;
+    ctx.env          = state->env;
+    ctx.share_constants = scm_false;
     ctx.mode.pattern = scm_true;
     /* (match <datum>
      *  (<pattern>)
      *  (<pattern>))
      */
     FOR_EACH (clause, clauses) {
-        ScmObj pat, sub;
+        ScmObj pat, binds;
         if (!CONSP(clause))
             ERR_OBJ("malformed match clause", clause);
         ctx.pvars.syms = SCM_NULL;
@@ -355,11 +457,13 @@ scm_s_match(ScmObj form, ScmObj clauses, ScmEvalState *state)
         /* match should never invoke scm_identifierequalp() since at
          * the moment no construct to literalize an identifier is
          * provided. */
-        sub = match(pat, form,
-                    0, 0, SCM_INVALID);
-        if (VALIDP(sub)) {
+        binds = match(pat, ctx.pvlen, form,
+                      0, 0, SCM_INVALID);
+        if (VALIDP(binds)) {
             /* FIXME: directly manipulates environment. */
-            state->env = CONS(CONS(ctx.pvars.syms, sub), state->env);
+            state->env = CONS(CONS(ctx.pvars.syms,
+                                   binds_to_list(binds, ctx.pvars.vals)),
+                              state->env);
 
             /* FIXME: enforce proper tail recursion (but don't let
              * code that does no matching pay for it!). */
@@ -432,6 +536,9 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
         ScmObj out, obj, rest;
         ScmQueue q;
 
+        if (!ctx->mode.pattern && constant_quotep(ctx, form))
+            return MAKE_CONSTANT(CAR(form), SCM_UNWRAP_SYNTAX(CADR(form)));
+
         rest = out = form;
         SCM_QUEUE_POINT_TO(q, out);
 
@@ -446,14 +553,17 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
                 pvlen_before = ctx->pvlen;
                 rest = CDR(rest);
                 subpat = compile_rec(ctx, obj, level + 1);
-                subpat = MAKE_REPPAT(subpat, ctx->pvlen - pvlen_before);
-                SCM_QUEUE_ADD(q, subpat);
 
                 if (ctx->mode.pattern) {
                     if (!NULLP(rest))
                         ERR_OBJ("misplaced ellipsis", form);
+                    SCM_QUEUE_ADD(q, MAKE_PATTERN_REPPAT(subpat, pvlen_before,
+                                                         ctx->pvlen
+                                                         - pvlen_before));
                     return out;
                 }
+                SCM_QUEUE_ADD(q, MAKE_REPPAT(subpat,
+                                             ctx->pvlen - pvlen_before));
                 if (ctx->pvlen == pvlen_before)
                     ERR_OBJ("constant repeatable subtemplate", form);
                 if (CONSP(rest))
@@ -475,7 +585,7 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
         scm_int_t i, j, ellipses, len;
         scm_bool ellipsis_ok, constantp;
         ScmObj *invec, *outvec;
-        ScmObj out;
+        ScmObj out, elm;
 
         len = SCM_VECTOR_LEN(form);
         if (!len) return form;
@@ -520,17 +630,28 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
 
                 pvlen_before = ctx->pvlen;
                 subpat = compile_rec(ctx, invec[i - 1], level + 1);
-                if (!ctx->mode.pattern && ctx->pvlen == pvlen_before)
+                if (ctx->mode.pattern)
+                    elm = MAKE_PATTERN_REPPAT(subpat, pvlen_before,
+                                              ctx->pvlen - pvlen_before);
+                else if (ctx->pvlen == pvlen_before)
                     ERR_OBJ("constant repeatable subtemplate", form);
-                outvec[j] = MAKE_REPPAT(subpat, ctx->pvlen - pvlen_before);
+                else
+                    elm = MAKE_REPPAT(subpat, ctx->pvlen - pvlen_before);
+                /* out may get old while compiling the elements */
+                SCM_WRITE_BARRIER(out);
+                outvec[j] = elm;
                 if (++i == len)
                     return out;
             } else {
-                outvec[j] = compile_rec(ctx, invec[i - 1], level);
+                elm = compile_rec(ctx, invec[i - 1], level);
+                SCM_WRITE_BARRIER(out);
+                outvec[j] = elm;
             }
         }
         SCM_ASSERT(i == len);
-        outvec[j] = compile_rec(ctx, invec[i - 1], level);
+        elm = compile_rec(ctx, invec[i - 1], level);
+        SCM_WRITE_BARRIER(out);
+        outvec[j] = elm;
         return out;
     } else if (IDENTIFIERP(form)) {
         /* ctx->pvars.vals initially contains a list of levels.  Then
@@ -550,12 +671,7 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
                     ERR_OBJ("duplicate pattern variable", form);
                 ctx->pvars.syms = CONS(form, ctx->pvars.syms);
                 ctx->pvars.vals = CONS(MAKE_INT(level), ctx->pvars.vals);
-                ++ctx->pvlen;
-#if SCM_DEBUG_MACRO
-                return MAKE_PVAR(form, 0);
-#else
-                return ctx->pvmark;
-#endif
+                return MAKE_PVAR(form, ctx->pvlen++);
             }
             return form;
         } else {
@@ -579,7 +695,8 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
                 } else {
                     SCM_ASSERT(INTP(CAR(tail)));
                     pvlevel = SCM_INT_VALUE(CAR(tail));
-                    ret = MAKE_PVAR(form, index);
+                    /* pvars.syms is in the reverse order. */
+                    ret = MAKE_PVAR(form, ctx->npvars - 1 - index);
                     SET_CAR(tail, CONS(ret, CAR(tail)));
                 }
                 if (level != pvlevel) {
@@ -592,6 +709,73 @@ compile_rec(compilation_context *ctx, ScmObj form, scm_int_t level)
     return form;
 }
 
+/* Tests whether FORM is a quote form that evaluates to the same datum
+ * in any expansion. */
+static scm_bool
+constant_quotep(compilation_context *ctx, ScmObj form)
+{
+    SCM_ASSERT(CONSP(form));
+
+    if (!ctx->share_constants
+        || !EQ(CAR(form), SYM_QUOTE) || !LIST_2_P(form))
+        return scm_false;
+    if (0 <= list_find_index(SYM_QUOTE, ctx->pvars.syms)
+        || scm_lookup_environment(SYM_QUOTE, ctx->env) != SCM_INVALID_REF
+        || !QUOTE_SYNTAXP(SCM_SYMBOL_VCELL(SYM_QUOTE)))
+        return scm_false;
+    return constant_datump(ctx, CADR(form));
+}
+
+static scm_bool
+constant_datump(compilation_context *ctx, ScmObj datum)
+{
+    scm_int_t i;
+
+    for (; CONSP(datum); datum = CDR(datum))
+        if (!constant_datump(ctx, CAR(datum)))
+            return scm_false;
+    if (VECTORP(datum)) {
+        for (i = 0; i < SCM_VECTOR_LEN(datum); i++)
+            if (!constant_datump(ctx, SCM_VECTOR_VEC(datum)[i]))
+                return scm_false;
+    } else if (IDENTIFIERP(datum)) {
+        /* Ellipses are left to compile_rec() to report. */
+        return (!ELLIPSISP(datum)
+                && list_find_index(datum, ctx->pvars.syms) < 0);
+    }
+    return scm_true;
+}
+
+static scm_bool
+mentionsp(ScmObj form, ScmObj sym)
+{
+    scm_int_t i;
+
+    for (; CONSP(form); form = CDR(form))
+        if (mentionsp(CAR(form), sym))
+            return scm_true;
+    if (VECTORP(form)) {
+        for (i = 0; i < SCM_VECTOR_LEN(form); i++)
+            if (mentionsp(SCM_VECTOR_VEC(form)[i], sym))
+                return scm_true;
+        return scm_false;
+    }
+    return (IDENTIFIERP(form) && EQ(SCM_UNWRAP_KEYWORD(form), sym));
+}
+
+static scm_int_t
+pattern_arity(ScmObj pattern)
+{
+    scm_int_t n;
+
+    for (n = 0; CONSP(pattern); pattern = CDR(pattern)) {
+        if (SUBPATP(CAR(pattern)) && REPPATP(CAR(pattern)))
+            return ~n;
+        ++n;
+    }
+    return (NULLP(pattern)) ? n : ~n;
+}
+
 
 /* ==============================
  * Pattern Matcher
@@ -601,21 +785,21 @@ typedef struct {
     ScmPackedEnv def_penv;
     ScmPackedEnv use_penv;
     ScmObj use_env;
-    ScmObj sub;                 /** Objects that matched a pvar.
-                                 * Populated only if it's VALIDP(). */
+    ScmObj binds;               /** Objects that matched each pvar. */
 } match_context;
 
-static void merge_subs(ScmObj to, ScmObj from, ScmObj end);
 static scm_bool match_rec(match_context *ctx, ScmObj pat, ScmObj form);
 static scm_bool match_reppat(match_context *ctx, ScmObj arg, ScmObj form);
+static ScmObj vectors_to_lists(ScmObj obj, scm_int_t level);
 
 /**
- * Matches FORM against RULES.
+ * Matches FORM against PATTERN, which has NPVARS pattern variables.
+ * Returns the binds, or SCM_INVALID if FORM doesn't match.
  *
  * @param env Environment of the macro use.
  */
 static ScmObj
-match(ScmObj pattern, ScmObj form, ScmPackedEnv def_penv,
+match(ScmObj pattern, scm_int_t npvars, ScmObj form, ScmPackedEnv def_penv,
       ScmPackedEnv use_penv, ScmObj use_env)
 {
     match_context ctx;
@@ -627,16 +811,13 @@ match(ScmObj pattern, ScmObj form, ScmPackedEnv def_penv,
     ctx.def_penv = def_penv;
     ctx.use_penv = use_penv;
     ctx.use_env  = use_env;
-    ctx.sub = SCM_INVALID;     /* Not investing storage yet. */
+    ctx.binds    = scm_p_make_vector(MAKE_INT(npvars), SCM_NULL);
 
-    if (match_rec(&ctx, pattern, form)) {
-        /* Matched. */
-        ctx.sub = SCM_NULL;
-        match_rec(&ctx, pattern, form);
-    }
+    if (!match_rec(&ctx, pattern, form))
+        ctx.binds = SCM_INVALID;
     DBG_PRINT((DBG_MATCHER | DBG_RETURN, "match done, returning ~s\n",
-               VALIDP(ctx.sub) ? ctx.sub : SCM_UNDEF));
-    return ctx.sub;
+               VALIDP(ctx.binds) ? ctx.binds : SCM_UNDEF));
+    return ctx.binds;
 }
 
 #define MATCH_REC(c, p, f)                      \
@@ -677,8 +858,8 @@ match_rec(match_context *ctx, ScmObj pat, ScmObj form)
 
     if (SUBPATP(pat)) {
         SCM_ASSERT(PVARP(pat));
-        if (VALIDP(ctx->sub))
-            ctx->sub = CONS(form, ctx->sub);
+        SCM_WRITE_BARRIER(ctx->binds);
+        SCM_VECTOR_VEC(ctx->binds)[PVAR_INDEX(pat)] = form;
         return scm_true;
     }
 
@@ -723,105 +904,115 @@ match_rec(match_context *ctx, ScmObj pat, ScmObj form)
     /* Not reached. */
 }
 
-
 /* FIXME: give arg a better name. */
 static scm_bool
 match_reppat(match_context *ctx, ScmObj arg, ScmObj form)
 {
-    ScmObj pat, sub_save, accum, reppat;
-    scm_int_t i = 0;  /* the value is needed only to suppress warning */
+    ScmObj pat, reppat, subform, cols, col, *binds;
+    scm_int_t first, pvcount, len, i, j, k;
 
     DBG_PRINT((DBG_MATCHER | DBG_FUNCALL, "match_reppat: ~s =~~ ~s\n",
                form, arg));
 
     if (CONSP(arg)) {
         reppat = CAR(arg);
-        pat = REPPAT_PAT(reppat);
-
-        if (SUBPATP(pat)) {
-            /* (pvar ...) */
-            SCM_ASSERT(PVARP(pat));
-            if (!SCM_LISTLEN_PROPERP(scm_length(form)))
-                MISMATCH("repeatable subpattern matched against "
-                         "improper list, vector, or atom",
-                         pat, form);
-            if (VALIDP(ctx->sub))
-                ctx->sub = CONS(form, ctx->sub);
-            return scm_true;
-        }
+        i = 0;
+        len = scm_length(form);
+        if (!SCM_LISTLEN_PROPERP(len))
+            MISMATCH("repeatable subpattern matched against "
+                     "improper list, vector, or atom",
+                     reppat, form);
     } else {
         SCM_ASSERT(VECTORP(arg));
+        SCM_ASSERT(VECTORP(form));
         i = SCM_VECTOR_LEN(arg) - 1;
         SCM_ASSERT(i >= 0);
         SCM_ASSERT(i <= SCM_VECTOR_LEN(form));
         reppat = SCM_VECTOR_VEC(arg)[i];
-        pat = REPPAT_PAT(reppat);
+        len = SCM_VECTOR_LEN(form) - i;
     }
     SCM_ASSERT(SUBPATP(reppat) && REPPATP(reppat));
-
-    accum = sub_save = ctx->sub;
-    /* Populate with empty subs. */
-    if (VALIDP(ctx->sub)) {
-        scm_int_t pvcount;
-        for (pvcount = REPPAT_PVCOUNT(reppat); pvcount--;)
-            accum = CONS(SCM_NULL, accum);
+    pat     = PATTERN_REPPAT_PAT(reppat);
+    first   = PATTERN_REPPAT_FIRST(reppat);
+    pvcount = REPPAT_PVCOUNT(reppat);
+
+    if (SUBPATP(pat) && CONSP(arg)) {
+        /* (pvar ...) */
+        SCM_ASSERT(PVARP(pat) && PVAR_INDEX(pat) == first);
+        col = scm_p_list2vector(form);
+        SCM_WRITE_BARRIER(ctx->binds);
+        SCM_VECTOR_VEC(ctx->binds)[first] = col;
+        return scm_true;
     }
 
-    if (CONSP(arg)) {
-        ScmObj subform;
-        FOR_EACH (subform, form) {
-            ctx->sub = sub_save;
-            MATCH_REC(ctx, pat, subform);
-            merge_subs(accum, ctx->sub, sub_save);
+    /* Match the elements in a single pass, moving what each of them
+     * bound to the pvars into a column per pvar. */
+    cols = scm_p_make_vector(MAKE_INT(pvcount), SCM_NULL);
+    for (j = 0; j < pvcount; j++) {
+        col = scm_p_make_vector(MAKE_INT(len), SCM_NULL);
+        SCM_WRITE_BARRIER(cols);
+        SCM_VECTOR_VEC(cols)[j] = col;
+    }
+    for (k = 0; k < len; k++) {
+        if (CONSP(arg)) {
+            subform = CAR(form);
+            form = CDR(form);
+        } else {
+            subform = SCM_VECTOR_VEC(form)[i + k];
         }
-        if (!NULLP(form))
-            MISMATCH("repeatable subpattern matched against "
-                     "improper list, vector, or atom",
-                     pat, form);
-    } else {                    /* VECTORP(arg) */
-        scm_int_t len;
-        ScmObj *vec;
-
-        SCM_ASSERT(VECTORP(form));
-        len = SCM_VECTOR_LEN(form);
-        vec = SCM_VECTOR_VEC(form);
-        /* i = SCM_VECTOR_LEN(pat) - 1; */
-        for (; i < len; i++) {
-            ctx->sub = sub_save;
-            MATCH_REC(ctx, pat, vec[i]);
-            merge_subs(accum, ctx->sub, sub_save);
+        MATCH_REC(ctx, pat, subform);
+        binds = SCM_VECTOR_VEC(ctx->binds);
+        for (j = 0; j < pvcount; j++) {
+            /* the columns may get old while matching */
+            col = SCM_VECTOR_VEC(cols)[j];
+            SCM_WRITE_BARRIER(col);
+            SCM_VECTOR_VEC(col)[k] = binds[first + j];
         }
     }
-
-    for (ctx->sub = accum; !EQ(accum, sub_save); accum = CDR(accum))
-        SET_CAR(accum, scm_p_reversex(CAR(accum)));
+    SCM_WRITE_BARRIER(ctx->binds);
+    binds = SCM_VECTOR_VEC(ctx->binds);
+    for (j = 0; j < pvcount; j++)
+        binds[first + j] = SCM_VECTOR_VEC(cols)[j];
 
     return scm_true;
 }
 
-/* ;; Push new bindings at the front.
- * (map!
- *  (cut cons <> <>)
- *  ctx->sub
- *  (take-until (cut eq? <> end) from))
- *
- * If you're hacking on this code, beware that the arguments can be
- * all SCM_INVALID.
- */
-static void
-merge_subs(ScmObj to, ScmObj from, ScmObj end)
+/* Makes a list of the subs in BINDS in the order of pvars.syms, whose
+ * levels are LEVELS, for binding them to the pvars in an environment
+ * frame. */
+static ScmObj
+binds_to_list(ScmObj binds, ScmObj levels)
 {
-    DBG_PRINT((DBG_MATCHER | DBG_FUNCALL, "merging ~s ++ ~s\n",
-               VALIDP(to) ? to : SCM_UNDEF,
-               VALIDP(from) ? from : SCM_UNDEF));
-    while (!EQ(from, end)) {
-        ScmObj next;
-        next = CDR(from);
-        SET_CDR(from, CAR(to));
-        SET_CAR(to, from);
-        to = CDR(to);
-        from = next;
+    ScmObj level, ret;
+    ScmQueue q;
+    scm_int_t i;
+
+    ret = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, ret);
+    i = SCM_VECTOR_LEN(binds);
+    FOR_EACH (level, levels) {
+        SCM_ASSERT(i > 0 && INTP(level));
+        --i;
+        SCM_QUEUE_ADD(q, vectors_to_lists(SCM_VECTOR_VEC(binds)[i],
+                                          SCM_INT_VALUE(level)));
     }
+    return ret;
+}
+
+static ScmObj
+vectors_to_lists(ScmObj obj, scm_int_t level)
+{
+    ScmObj ret;
+    ScmQueue q;
+    scm_int_t i;
+
+    if (!level)
+        return obj;
+    ret = SCM_NULL;
+    SCM_QUEUE_POINT_TO(q, ret);
+    for (i = 0; i < SCM_VECTOR_LEN(obj); i++)
+        SCM_QUEUE_ADD(q, vectors_to_lists(SCM_VECTOR_VEC(obj)[i], level - 1));
+    return ret;
 }
 
 
@@ -833,6 +1024,7 @@ merge_subs(ScmObj to, ScmObj from, ScmObj end)
 
 typedef struct {
     ScmObj fvars;              /* Alist; free variables -> wrapped ident. */
+    ScmObj binds;
     scm_int_t index_buf[DEFAULT_INDEX_BUF_SIZE];
     scm_int_t *indices;
     scm_int_t index_buf_size;
@@ -854,26 +1046,26 @@ typedef struct {
 } transcribe_ret;
 
 static transcribe_ret transcribe_rec(transcription_context *ctx,
-                                     ScmObj template, ScmObj sub,
-                                     scm_int_t level);
+                                     ScmObj template, scm_int_t level);
 static transcribe_ret transcribe_reppat(transcription_context *ctx,
-                                        ScmObj template, ScmObj sub,
-                                        scm_int_t level);
+                                        ScmObj template, scm_int_t level);
 
 static ScmObj
-transcribe(ScmObj template, ScmObj sub, ScmPackedEnv def_penv, ScmObj use_env)
+transcribe(ScmObj template, ScmObj binds, ScmPackedEnv def_penv,
+           ScmObj use_env)
 {
     transcribe_ret ret;
     transcription_context ctx;
 
     DBG_PRINT((DBG_TRANSCRIPTOR | DBG_FUNCALL, "transcribe\n"));
     ctx.fvars = SCM_NULL;
+    ctx.binds = binds;
     ctx.indices = ctx.index_buf;
     ctx.index_buf_size = DEFAULT_INDEX_BUF_SIZE;
     ctx.def_penv = def_penv;
     ctx.def_env = scm_unpack_env(def_penv, use_env);
     ctx.use_env = use_env;
-    ret = transcribe_rec(&ctx, template, sub, 0);
+    ret = transcribe_rec(&ctx, template, 0);
     SCM_ASSERT(ret.msg == MSG_REPLACE);
     if (ctx.indices != ctx.index_buf) {
         free(ctx.indices);
@@ -885,19 +1077,18 @@ transcribe(ScmObj template, ScmObj sub, ScmPackedEnv def_penv, ScmObj use_env)
 }
 
 static transcribe_ret
-transcribe_rec(transcription_context *ctx, ScmObj template, ScmObj sub,
-               scm_int_t level)
+transcribe_rec(transcription_context *ctx, ScmObj template, scm_int_t level)
 {
     transcribe_ret ret;
 
     DBG_PRINT((DBG_TRANSCRIPTOR | DBG_FUNCALL,
                "transcribe_rec [lv ~MD] ~s | ~s\n",
-               level, template, sub));
+               level, template, ctx->binds));
 
 #define RECURSE(_q, _obj)                                       \
         do {                                                    \
             transcribe_ret r;                                   \
-            r = transcribe_rec(ctx, (_obj), sub, level);        \
+            r = transcribe_rec(ctx, (_obj), level);             \
             switch (r.msg) {                                    \
             case MSG_PVAR_EXHAUSTED:                            \
                 return r;                                       \
@@ -913,7 +1104,7 @@ transcribe_rec(transcription_context *ctx, ScmObj template, ScmObj sub,
 #define RECURSE_ALWAYS_APPEND(_q, _obj)                         \
         do {                                                    \
             transcribe_ret r;                                   \
-            r = transcribe_rec(ctx, (_obj), sub, level);        \
+            r = transcribe_rec(ctx, (_obj), level);             \
             if (r.msg == MSG_PVAR_EXHAUSTED)                    \
                 return r;                                       \
             SCM_ASSERT(r.msg == MSG_REPLACE);                   \
@@ -923,6 +1114,18 @@ transcribe_rec(transcription_context *ctx, ScmObj template, ScmObj sub,
     if (CONSP(template)) {
         ScmObj tmp;
         ScmQueue q;
+
+        if (CONSTANTP(template)) {
+            /* Where the use doesn't rebind quote, the plain symbol
+             * denotes the same syntax, and the compiler can fold the
+             * form. */
+            tmp = CONSTANT_QUOTE(template);
+            if (scm_lookup_environment(tmp, ctx->use_env) != SCM_INVALID_REF)
+                tmp = transcribe_rec(ctx, tmp, level).u.obj;
+            ret.msg = MSG_REPLACE;
+            ret.u.obj = LIST_2(tmp, CONSTANT_DATUM(template));
+            return ret;
+        }
         ret.msg = MSG_REPLACE;
         ret.u.obj = SCM_NULL;
         SCM_QUEUE_POINT_TO(q, ret.u.obj);
@@ -948,28 +1151,27 @@ transcribe_rec(transcription_context *ctx, ScmObj template, ScmObj sub,
         return ret;
     } else if (SUBPATP(template)) {
         if (PVARP(template)) {
+            ScmObj sub;
             scm_int_t i;
-            sub = scm_list_tail(sub, PVAR_INDEX(template));
-            SCM_ASSERT(CONSP(sub));
-            sub = CAR(sub);
+            SCM_ASSERT(PVAR_INDEX(template) < SCM_VECTOR_LEN(ctx->binds));
+            sub = SCM_VECTOR_VEC(ctx->binds)[PVAR_INDEX(template)];
             for (i = 0; i < level; i++) {
                 DBG_PRINT((DBG_TRANSCRIPTOR, "ref (~MD) ; ~s\n",
                            ctx->indices[i], sub));
-                sub = scm_list_tail(sub, ctx->indices[i]);
-                SCM_ASSERT(VALIDP(sub));
-                if (NULLP(sub)) {
+                SCM_ASSERT(VECTORP(sub));
+                if (SCM_VECTOR_LEN(sub) <= ctx->indices[i]) {
                     ret.msg = MSG_PVAR_EXHAUSTED;
                     ret.u.exhausted_level = i;
                     return ret;
                 }
-                sub = CAR(sub);
+                sub = SCM_VECTOR_VEC(sub)[ctx->indices[i]];
             }
             ret.msg = MSG_REPLACE;
             ret.u.obj = sub;
             return ret;
         }
         /* REPPATP(template) */
-        return transcribe_reppat(ctx, template, sub, level);
+        return transcribe_reppat(ctx, template, level);
     } else if (IDENTIFIERP(template)) {
         ScmObj wrapped;
 
@@ -994,8 +1196,7 @@ transcribe_rec(transcription_context *ctx, ScmObj template, ScmObj sub,
 }
 
 static transcribe_ret
-transcribe_reppat(transcription_context *ctx, ScmObj template, ScmObj sub,
-                  scm_int_t level)
+transcribe_reppat(transcription_context *ctx, ScmObj template, scm_int_t level)
 {
     ScmObj form;
     transcribe_ret ret;
@@ -1029,7 +1230,7 @@ transcribe_reppat(transcription_context *ctx, ScmObj template, ScmObj sub,
 
     for (;;) {
         transcribe_ret subret;
-        subret = transcribe_rec(ctx, form, sub, level + 1);
+        subret = transcribe_rec(ctx, form, level + 1);
         if (subret.msg == MSG_PVAR_EXHAUSTED) {
             if (subret.u.exhausted_level == level)
                 break;
@@ -1093,6 +1294,7 @@ unwrap_vectorx(ScmObj obj)
     ScmObj *vec;
     scm_int_t i;
 
+    SCM_WRITE_BARRIER(obj);
     i = SCM_VECTOR_LEN(obj);
     vec = SCM_VECTOR_VEC(obj);
     while (i--) {
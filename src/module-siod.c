@@ -200,7 +200,7 @@ scm_p_closure_code(ScmObj closure)
 
     ENSURE_CLOSURE(closure);
 
-    exp = SCM_CLOSURE_EXP(closure);
+    exp = CLOSURE_SOURCE(closure);
     /* make SIOD-compatible 'begin' -prefixed body */
     body = CONS(scm_intern("begin"), CDR(exp));
 
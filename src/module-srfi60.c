@@ -64,6 +64,13 @@
         return MAKE_INT(result);                                             \
     } while (/* CONSTCOND */ 0)
 
+#define BITWISE_BINARY_BODY(op, left, right)                                 \
+    do {                                                                     \
+        ENSURE_INT(left);                                                    \
+        ENSURE_INT(right);                                                   \
+        return MAKE_INT(SCM_INT_VALUE(left) op SCM_INT_VALUE(right));        \
+    } while (/* CONSTCOND */ 0)
+
 /*=======================================
   File Local Type Definitions
 =======================================*/
@@ -76,6 +83,9 @@
 /*=======================================
   File Local Function Declarations
 =======================================*/
+static ScmObj logand_binary(ScmObj left, ScmObj right);
+static ScmObj logior_binary(ScmObj left, ScmObj right);
+static ScmObj logxor_binary(ScmObj left, ScmObj right);
 
 /*=======================================
   Function Definitions
@@ -84,6 +94,12 @@ SCM_EXPORT void
 scm_initialize_srfi60(void)
 {
     scm_register_funcs(scm_functable_srfi60);
+    scm_register_binary_operator((ScmFuncType)scm_p_srfi60_logand,
+                                 logand_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_srfi60_logior,
+                                 logior_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_srfi60_logxor,
+                                 logxor_binary);
 
     /* SRFI-33 aliases */
     scm_define_alias("bitwise-and",   "logand");
@@ -119,6 +135,30 @@ scm_p_srfi60_logxor(ScmObj left, ScmObj right, enum ScmReductionState *state)
     BITWISE_OPERATION_BODY(^, left, right, 0);
 }
 
+static ScmObj
+logand_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("logand");
+
+    BITWISE_BINARY_BODY(&, left, right);
+}
+
+static ScmObj
+logior_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("logior");
+
+    BITWISE_BINARY_BODY(|, left, right);
+}
+
+static ScmObj
+logxor_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("logxor");
+
+    BITWISE_BINARY_BODY(^, left, right);
+}
+
 SCM_EXPORT ScmObj
 scm_p_srfi60_lognot(ScmObj n)
 {
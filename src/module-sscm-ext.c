@@ -51,6 +51,10 @@
 #define ERRMSG_INVALID_BINDINGS    "invalid bindings form"
 #define ERRMSG_INVALID_BINDING     "invalid binding form"
 
+#if !SCM_USE_CONTINUATION
+#define scm_p_call_with_escape_continuation NULL
+#endif
+
 /*=======================================
   File Local Type Definitions
 =======================================*/
@@ -73,8 +77,13 @@ SCM_EXPORT void
 scm_initialize_sscm_extensions(void)
 {
     scm_register_funcs(scm_functable_sscm_ext);
+#if !SCM_USE_CONTINUATION
+    SCM_SYMBOL_SET_VCELL(scm_intern("call-with-escape-continuation"),
+                         SCM_UNBOUND);
+#endif
 
     scm_define_alias("call/cc", "call-with-current-continuation");
+    scm_define_alias("call/ec", "call-with-escape-continuation");
 }
 
 /*
@@ -126,6 +135,17 @@ scm_p_current_environment(ScmEvalState *eval_state)
     return eval_state->env;
 }
 
+#if SCM_USE_CONTINUATION
+SCM_EXPORT ScmObj
+scm_p_call_with_escape_continuation(ScmObj proc, ScmEvalState *eval_state)
+{
+    DECLARE_FUNCTION("call-with-escape-continuation",
+                     procedure_fixed_tailrec_1);
+
+    return scm_call_with_escape_continuation(proc, eval_state);
+}
+#endif /* SCM_USE_CONTINUATION */
+
 SCM_EXPORT ScmObj
 scm_p_current_char_codec(void)
 {
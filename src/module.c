@@ -46,6 +46,10 @@
 /*=======================================
   File Local Macro Definitions
 =======================================*/
+/* must be a power of 2 */
+#define BINARY_OPERATORS_SIZE 64
+#define BINARY_OPERATOR_HASH(reducer)                                        \
+    ((size_t)((scm_uintref_t)(reducer) >> 4) & (BINARY_OPERATORS_SIZE - 1))
 
 /*=======================================
   File Local Type Definitions
@@ -57,6 +61,12 @@ struct scm_module_info {
     void (*finalizer)(void);
 };
 
+/* specialized entry point of a reduction operator for 2 args */
+struct binary_operator_info {
+    ScmFuncType reducer;
+    ScmBinaryOperator binary;
+};
+
 /*=======================================
   Variable Definitions
 =======================================*/
@@ -64,10 +74,15 @@ SCM_GLOBAL_VARS_BEGIN(static_module);
 #define static
 static ScmObj l_features;
 static ScmObj l_provided_modules;
+static struct binary_operator_info l_binary_operators[BINARY_OPERATORS_SIZE];
+static size_t l_n_binary_operators;
 #undef static
 SCM_GLOBAL_VARS_END(static_module);
 #define l_features         SCM_GLOBAL_VAR(static_module, l_features)
 #define l_provided_modules SCM_GLOBAL_VAR(static_module, l_provided_modules)
+#define l_binary_operators SCM_GLOBAL_VAR(static_module, l_binary_operators)
+#define l_n_binary_operators                                                 \
+    SCM_GLOBAL_VAR(static_module, l_n_binary_operators)
 SCM_DEFINE_STATIC_VARS(static_module);
 
 static const struct scm_module_info module_info_table[] = {
@@ -268,6 +283,48 @@ scm_define_alias(const char *newsym, const char *sym)
                          SCM_SYMBOL_VCELL(scm_intern(sym)));
 }
 
+/* Register BINARY as the entry point of the reduction operator REDUCER for
+ * exactly 2 args. BINARY must behave as REDUCER called with
+ * SCM_REDUCE_LAST. */
+SCM_EXPORT void
+scm_register_binary_operator(ScmFuncType reducer, ScmBinaryOperator binary)
+{
+    size_t i;
+
+    for (i = BINARY_OPERATOR_HASH(reducer);
+         l_binary_operators[i].reducer;
+         i = (i + 1) & (BINARY_OPERATORS_SIZE - 1))
+    {
+        if (l_binary_operators[i].reducer == reducer) {
+            l_binary_operators[i].binary = binary;
+            return;
+        }
+    }
+
+    /* keep an empty entry to terminate the lookup */
+    SCM_ASSERT(l_n_binary_operators < BINARY_OPERATORS_SIZE - 1);
+    l_binary_operators[i].reducer = reducer;
+    l_binary_operators[i].binary = binary;
+    l_n_binary_operators++;
+}
+
+/* Returns NULL if REDUCER has no binary entry point. */
+SCM_EXPORT ScmBinaryOperator
+scm_lookup_binary_operator(ScmFuncType reducer)
+{
+    size_t i;
+
+    for (i = BINARY_OPERATOR_HASH(reducer);
+         l_binary_operators[i].reducer;
+         i = (i + 1) & (BINARY_OPERATORS_SIZE - 1))
+    {
+        if (l_binary_operators[i].reducer == reducer)
+            return l_binary_operators[i].binary;
+    }
+
+    return NULL;
+}
+
 SCM_EXPORT void
 scm_register_funcs(const struct scm_func_registration_info *table)
 {
@@ -57,10 +57,41 @@
 /*=======================================
   File Local Function Declarations
 =======================================*/
+static ScmObj add_binary(ScmObj left, ScmObj right);
+static ScmObj multiply_binary(ScmObj left, ScmObj right);
+static ScmObj subtract_binary(ScmObj left, ScmObj right);
+static ScmObj divide_binary(ScmObj left, ScmObj right);
+static ScmObj equal_binary(ScmObj left, ScmObj right);
+static ScmObj less_binary(ScmObj left, ScmObj right);
+static ScmObj less_equal_binary(ScmObj left, ScmObj right);
+static ScmObj greater_binary(ScmObj left, ScmObj right);
+static ScmObj greater_equal_binary(ScmObj left, ScmObj right);
+static ScmObj max_binary(ScmObj left, ScmObj right);
+static ScmObj min_binary(ScmObj left, ScmObj right);
 
 /*=======================================
   Function Definitions
 =======================================*/
+SCM_EXPORT void
+scm_init_number(void)
+{
+    scm_register_binary_operator((ScmFuncType)scm_p_add, add_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_multiply,
+                                 multiply_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_subtract,
+                                 subtract_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_divide, divide_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_equal, equal_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_less, less_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_less_equal,
+                                 less_equal_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_greater, greater_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_greater_equal,
+                                 greater_equal_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_max, max_binary);
+    scm_register_binary_operator((ScmFuncType)scm_p_min, min_binary);
+}
+
 /*===========================================================================
   R5RS : 6.2 Numbers : 6.2.5 Numerical Operations
 ===========================================================================*/
@@ -337,6 +368,143 @@ scm_p_min(ScmObj left, ScmObj right, enum ScmReductionState *state)
     return (SCM_INT_VALUE(left) < SCM_INT_VALUE(right)) ? left : right;
 }
 
+/*
+ * Entry points of the reduction operators for exactly 2 args. Each of them
+ * is equivalent to the call of the operator with SCM_REDUCE_LAST.
+ */
+static ScmObj
+add_binary(ScmObj left, ScmObj right)
+{
+    scm_int_t result, l, r;
+    DECLARE_INTERNAL_FUNCTION("+");
+
+    ENSURE_INT(left);
+    ENSURE_INT(right);
+    l = SCM_INT_VALUE(left);
+    r = SCM_INT_VALUE(right);
+    result = l + r;
+    if (INT_OUT_OF_RANGEP(result)
+        || (r > 0 && result < l)
+        || (r < 0 && result > l))
+        ERR(ERRMSG_FIXNUM_OVERFLOW);
+
+    return MAKE_INT(result);
+}
+
+static ScmObj
+multiply_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("*");
+
+    ENSURE_INT(left);
+    ENSURE_INT(right);
+
+    return MAKE_INT(SCM_INT_VALUE(left) * SCM_INT_VALUE(right));
+}
+
+static ScmObj
+subtract_binary(ScmObj left, ScmObj right)
+{
+    scm_int_t result, l, r;
+    DECLARE_INTERNAL_FUNCTION("-");
+
+    ENSURE_INT(left);
+    ENSURE_INT(right);
+    l = SCM_INT_VALUE(left);
+    r = SCM_INT_VALUE(right);
+    result = l - r;
+    if (INT_OUT_OF_RANGEP(result)
+        || (r > 0 && result > l)
+        || (r < 0 && result < l))
+        ERR(ERRMSG_FIXNUM_OVERFLOW);
+
+    return MAKE_INT(result);
+}
+
+static ScmObj
+divide_binary(ScmObj left, ScmObj right)
+{
+    scm_int_t val;
+    DECLARE_INTERNAL_FUNCTION("/");
+
+    ENSURE_INT(left);
+    ENSURE_INT(right);
+    val = SCM_INT_VALUE(right);
+    if (val == 0)
+        ERR(ERRMSG_DIV_BY_ZERO);
+
+    return MAKE_INT(SCM_INT_VALUE(left) / val);
+}
+
+#define COMPARATOR_BINARY_BODY(op)                                           \
+    ENSURE_INT(left);                                                        \
+    ENSURE_INT(right);                                                       \
+    return MAKE_BOOL(SCM_INT_VALUE(left) op SCM_INT_VALUE(right))
+
+static ScmObj
+equal_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("=");
+
+    COMPARATOR_BINARY_BODY(==);
+}
+
+static ScmObj
+less_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("<");
+
+    COMPARATOR_BINARY_BODY(<);
+}
+
+static ScmObj
+less_equal_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("<=");
+
+    COMPARATOR_BINARY_BODY(<=);
+}
+
+static ScmObj
+greater_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION(">");
+
+    COMPARATOR_BINARY_BODY(>);
+}
+
+static ScmObj
+greater_equal_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION(">=");
+
+    COMPARATOR_BINARY_BODY(>=);
+}
+
+#undef COMPARATOR_BINARY_BODY
+
+static ScmObj
+max_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("max");
+
+    ENSURE_INT(left);
+    ENSURE_INT(right);
+
+    return (SCM_INT_VALUE(left) > SCM_INT_VALUE(right)) ? left : right;
+}
+
+static ScmObj
+min_binary(ScmObj left, ScmObj right)
+{
+    DECLARE_INTERNAL_FUNCTION("min");
+
+    ENSURE_INT(left);
+    ENSURE_INT(right);
+
+    return (SCM_INT_VALUE(left) < SCM_INT_VALUE(right)) ? left : right;
+}
+
 
 SCM_EXPORT ScmObj
 scm_p_abs(ScmObj _n)
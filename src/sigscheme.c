@@ -142,6 +142,9 @@ static const char *const builtin_features[] = {
 #if SCM_USE_DEEP_CADRS
     "deep-cadrs",
 #endif
+#if SCM_USE_COMPILER
+    "compiler",
+#endif
 #if SCM_COMPAT_SIOD
     "compat-siod",
 #endif
@@ -186,6 +189,7 @@ static char **scm_initialize_internal(const char *const *argv);
 static void *scm_eval_c_string_internal(const char *exp);
 #endif
 static void argv_err(char **argv, const char *err_msg);
+static const char *current_engine(void);
 
 /*=======================================
   Function Definitions
@@ -277,6 +281,15 @@ scm_initialize_internal(const char *const *argv)
 
     /* R5RS Syntaxes */
     scm_init_syntax();
+#if SCM_USE_COMPILER
+    scm_init_compiler();
+#endif
+#if SCM_USE_MACHINE
+    scm_init_machine();
+#endif
+#if SCM_USE_VM
+    scm_init_vm();
+#endif
 #if SCM_USE_QUASIQUOTE
     scm_register_funcs(scm_functable_r5rs_qquote);
 #endif
@@ -295,6 +308,7 @@ scm_initialize_internal(const char *const *argv)
 #endif
 #if SCM_USE_NUMBER
     scm_register_funcs(scm_functable_r5rs_number);
+    scm_init_number();
 #endif
 #if (SCM_USE_NUMBER_IO && SCM_USE_STRING)
     scm_register_funcs(scm_functable_r5rs_number_io);
@@ -471,20 +485,39 @@ argv_err(char **argv, const char *err_msg)
     }
 }
 
+/* name of the engine selected by --engine */
+static const char *
+current_engine(void)
+{
+#if SCM_USE_VM
+    if (scm_vm_enabled)
+        return "vm";
+#endif
+#if SCM_USE_MACHINE
+    if (scm_machine_enabled)
+        return "machine";
+#endif
+#if SCM_USE_COMPILER
+    if (scm_compiler_enabled)
+        return "compiler";
+#endif
+    return "interpreter";
+}
+
 /* TODO: parse properly */
 /* don't access ScmObj if (!l_scm_initialized) */
 SCM_EXPORT char **
 scm_interpret_argv(char **argv)
 {
     char **argp, **rest;
-    const char *encoding, *sys_load_path;
+    const char *encoding, *sys_load_path, *engine;
 #if SCM_USE_MULTIBYTE_CHAR
     ScmCharCodec *specified_codec;
     ScmObj err_obj;
 #endif
     DECLARE_INTERNAL_FUNCTION("scm_interpret_argv");
 
-    encoding = sys_load_path = NULL;
+    encoding = sys_load_path = engine = NULL;
     argp = &argv[0];
     if (strcmp(argv[0], "/usr/bin/env") == 0)
         argp++;
@@ -506,6 +539,13 @@ scm_interpret_argv(char **argv)
             sys_load_path = *++argp;
             if (!sys_load_path)
                 argv_err(argv, "no system load path specified");
+        } else if (strcmp(*argp, "--engine") == 0) {
+            /* evaluator of closure bodies */
+            engine = *++argp;
+            if (!engine)
+                argv_err(argv, "no engine name specified");
+        } else if (strncmp(*argp, "--engine=", strlen("--engine=")) == 0) {
+            engine = &(*argp)[strlen("--engine=")];
         } else {
             argv_err(argv, "invalid option");
         }
@@ -538,6 +578,49 @@ scm_interpret_argv(char **argv)
         scm_set_system_load_path(sys_load_path);
     }
 
+    if (engine && l_scm_initialized) {
+        /* the closures made so far belong to the current engine */
+        if (strcmp(engine, current_engine()) != 0)
+            argv_err(argv, "engine cannot be switched after initialization");
+    } else if (engine) {
+#if SCM_USE_COMPILER
+        scm_compiler_enabled = scm_false;
+#endif
+#if SCM_USE_MACHINE
+        scm_machine_enabled = scm_false;
+#endif
+#if SCM_USE_VM
+        scm_vm_enabled = scm_false;
+#endif
+        if (strcmp(engine, "interpreter") == 0) {
+            /* nothing to enable */
+        } else if (strcmp(engine, "compiler") == 0) {
+#if SCM_USE_COMPILER
+            scm_compiler_enabled = scm_true;
+#else
+            argv_err(argv, "compiler engine is not enabled");
+#endif
+        } else if (strcmp(engine, "machine") == 0) {
+#if SCM_USE_MACHINE
+            scm_machine_enabled = scm_true;
+            /* the native stack no longer limits the depth of recursion */
+            scm_provide(CONST_STRING("machine"));
+#else
+            argv_err(argv, "machine engine is not enabled");
+#endif
+        } else if (strcmp(engine, "vm") == 0) {
+#if SCM_USE_VM
+            scm_vm_enabled = scm_true;
+            /* the native stack no longer limits the depth of recursion */
+            scm_provide(CONST_STRING("vm"));
+#else
+            argv_err(argv, "vm engine is not enabled");
+#endif
+        } else {
+            argv_err(argv, "unknown engine name");
+        }
+    }
+
     return rest;
 }
 
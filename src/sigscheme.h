@@ -510,6 +510,13 @@ struct ScmStorageConf_ {
 
     /* symbol table */
     size_t symbol_hash_size;      /* hash size of symbol table */
+
+    /* incremental GC */
+    size_t gc_step_budget;        /* max number of cells marked at a time */
+
+    /* parallel marking */
+    size_t gc_n_markers;          /* number of threads marking, including
+                                     the mutator. 0 for the processors */
 };
 
 #define SCM_FULLY_ADDRESSABLEP                                               \
@@ -990,6 +997,11 @@ struct ScmStorageConf_ {
 /* RFC: Is there a better name? */
 #define SCM_SET(ref, obj)     SCM_SAL_SET((ref), (obj))
 
+/* Must precede a store into OBJ that bypasses the accessors above, such as
+ * one into the element array of a vector. It is a no-op unless the
+ * generational or incremental GC is enabled. */
+#define SCM_WRITE_BARRIER(obj) SCM_SAL_WRITE_BARRIER(obj)
+
 /*===========================================================================
   Special Constants and Predicates
 ===========================================================================*/
@@ -1307,6 +1319,10 @@ SCM_EXPORT void scm_gc_unprotect(ScmObj *var);
 SCM_EXPORT scm_bool scm_gc_protectedp(ScmObj obj);
 SCM_EXPORT void *scm_call_with_gc_ready_stack(ScmGCGateFunc func, void *arg);
 SCM_EXPORT scm_bool scm_gc_protected_contextp(void);
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+SCM_EXPORT void scm_gc_remember(ScmObj obj);
+SCM_EXPORT void scm_gc_remember_ref(ScmRef ref);
+#endif
 /* for semantic assertions */
 #define scm_gc_any_contextp()                                                \
     (!scm_gc_protected_contextp() || scm_gc_protected_contextp())
@@ -1689,6 +1705,10 @@ SCM_EXPORT void scm_require(const char *filename);
 SCM_EXPORT ScmObj scm_p_symbol_boundp(ScmObj sym, ScmObj rest);
 SCM_EXPORT ScmObj scm_p_sscm_version(void);
 SCM_EXPORT ScmObj scm_p_current_environment(ScmEvalState *eval_state);
+#if SCM_USE_CONTINUATION
+SCM_EXPORT ScmObj scm_p_call_with_escape_continuation(ScmObj proc,
+                                                      ScmEvalState *eval_state);
+#endif
 SCM_EXPORT ScmObj scm_p_current_char_codec(void);
 SCM_EXPORT ScmObj scm_p_set_current_char_codecx(ScmObj encoding);
 SCM_EXPORT ScmObj scm_p_prealloc_heaps(ScmObj n);
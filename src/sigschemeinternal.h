@@ -207,11 +207,21 @@ extern "C" {
 #endif
 
 /* specifies whether the storage abstraction layer can only handle nested
- * (stacked) continuation or R5RS-conformant full implementation. But current
- * implementation only supports '1'. */
+ * (stacked) continuation or R5RS-conformant full implementation. The full
+ * implementation copies the C stack and is enabled by
+ * SCM_USE_FULL_CONTINUATION. */
+#if SCM_USE_FULL_CONTINUATION
+#define SCM_NESTED_CONTINUATION_ONLY 0
+#else
 #define SCM_NESTED_CONTINUATION_ONLY 1
+#endif
 #define INVALID_CONTINUATION_OPAQUE  NULL
 
+/* escape continuations made by call/ec are tagged */
+#define ESCAPE_CONTINUATION_TAG      1
+#define ESCAPE_CONTINUATIONP(cont)                                           \
+    (SCM_CONTINUATION_TAG(cont) == ESCAPE_CONTINUATION_TAG)
+
 /* trace stack for debugging */
 #define MAKE_TRACE_FRAME(obj, env) CONS((obj), (env))
 #define TRACE_FRAME_OBJ CAR
@@ -443,6 +453,68 @@ SCM_EXPORT void scm_error_with_implicit_func(const char *msg, ...) SCM_NORETURN;
 #define CHECK_VALID_EVALED_VALUE(x) SCM_EMPTY_EXPR
 #endif
 
+/*=======================================
+  Environment
+=======================================*/
+#if SCM_USE_VECTOR_FRAME
+/* #(<formals> <value> ...). See env.c. */
+#define VECTOR_FRAMEP(frame)        (VECTORP(frame))
+#define VECTOR_FRAME_FORMALS(frame) (SCM_VECTOR_VEC(frame)[0])
+#define VECTOR_FRAME_VALUES(frame)  (&SCM_VECTOR_VEC(frame)[1])
+#define VECTOR_FRAME_LEN(frame)     (SCM_VECTOR_LEN(frame) - 1)
+#endif /* SCM_USE_VECTOR_FRAME */
+
+/*=======================================
+  Compiled Code
+=======================================*/
+#if SCM_USE_COMPILER
+/* (<handler> . <operands>) */
+#define NODEP(obj)                                                           \
+    (FUNCP(CAR(obj))                                                         \
+     && SCM_FUNC_TYPECODE(CAR(obj)) == SCM_SYNTAX_VARIADIC_TAILREC_0)
+
+/* (<code tag> <formals> <body node> <stack frame?> . (<formals> . <body>)) */
+#define COMPILED_CODEP(exp)     (EQ(CAR(exp), scm_compiled_code_tag))
+#define CODE_FORMALS(code)      (CAR(CDR(code)))
+#define CODE_BODY(code)         (CAR(CDR(CDR(code))))
+#define CODE_STACK_FRAMEP(code) (TRUEP(CAR(CDR(CDR(CDR(code))))))
+#define CODE_SOURCE(code)       (CDR(CDR(CDR(CDR(code)))))
+#endif /* SCM_USE_COMPILER */
+
+#if SCM_USE_VM
+/* (<vm code tag>
+ *  . #(<insns> <nargs> <frame formals> <stack framep> (<formals> . <body>)))
+ * The fields are kept in a vector to not nest the accessors deeply. */
+#define VM_CODEP(exp)              (EQ(CAR(exp), scm_vm_code_tag))
+#define VM_CODE_FIELDS(code)       (SCM_VECTOR_VEC(CDR(code)))
+#define VM_CODE_INSNS(code)        (VM_CODE_FIELDS(code)[0])
+#define VM_CODE_NARGS(code)        (SCM_INT_VALUE(VM_CODE_FIELDS(code)[1]))
+#define VM_CODE_FRAME_FORMALS(code) (VM_CODE_FIELDS(code)[2])
+#define VM_CODE_STACK_FRAMEP(code) (TRUEP(VM_CODE_FIELDS(code)[3]))
+#define VM_CODE_SOURCE(code)       (VM_CODE_FIELDS(code)[4])
+#define VM_CODE_FIELDS_LEN         5
+#endif /* SCM_USE_VM */
+
+/* (<formals> . <body>) of a closure regardless of whether compiled, and of
+ * which engine compiled it when both are enabled */
+#if (SCM_USE_COMPILER && SCM_USE_VM)
+#define CLOSURE_SOURCE(closure)                                              \
+    ((COMPILED_CODEP(SCM_CLOSURE_EXP(closure)))                              \
+     ? CODE_SOURCE(SCM_CLOSURE_EXP(closure))                                 \
+     : (VM_CODEP(SCM_CLOSURE_EXP(closure)))                                  \
+     ? VM_CODE_SOURCE(SCM_CLOSURE_EXP(closure)) : SCM_CLOSURE_EXP(closure))
+#elif SCM_USE_COMPILER
+#define CLOSURE_SOURCE(closure)                                              \
+    ((COMPILED_CODEP(SCM_CLOSURE_EXP(closure)))                              \
+     ? CODE_SOURCE(SCM_CLOSURE_EXP(closure)) : SCM_CLOSURE_EXP(closure))
+#elif SCM_USE_VM
+#define CLOSURE_SOURCE(closure)                                              \
+    ((VM_CODEP(SCM_CLOSURE_EXP(closure)))                                    \
+     ? VM_CODE_SOURCE(SCM_CLOSURE_EXP(closure)) : SCM_CLOSURE_EXP(closure))
+#else
+#define CLOSURE_SOURCE(closure) (SCM_CLOSURE_EXP(closure))
+#endif
+
 /*=======================================
   Numbers
 =======================================*/
@@ -569,6 +641,8 @@ SCM_EXPORT size_t scm_lbuf_f_exponential(struct ScmLBuf_void_ *lbuf);
 /*=======================================
   Type Definitions
 =======================================*/
+typedef ScmObj (*ScmBinaryOperator)(ScmObj left, ScmObj right);
+
 typedef struct ScmSpecialCharInfo_ ScmSpecialCharInfo;
 struct ScmSpecialCharInfo_ {
     scm_ichar_t code;     /* character code as ASCII/Unicode */
@@ -616,6 +690,45 @@ SCM_GLOBAL_VARS_END(storage);
 SCM_DECLARE_EXPORTED_VARS(storage);
 #endif
 
+/* compiler.c */
+#if SCM_USE_COMPILER
+SCM_GLOBAL_VARS_BEGIN(compiler);
+ScmObj scm_compiled_code_tag;
+scm_bool scm_compiler_enabled;
+#if SCM_USE_STACK_FRAME
+scm_int_t scm_stack_frame_sp;
+#endif
+SCM_GLOBAL_VARS_END(compiler);
+#define scm_compiled_code_tag SCM_GLOBAL_VAR(compiler, scm_compiled_code_tag)
+#define scm_compiler_enabled  SCM_GLOBAL_VAR(compiler, scm_compiler_enabled)
+#define scm_stack_frame_sp    SCM_GLOBAL_VAR(compiler, scm_stack_frame_sp)
+SCM_DECLARE_EXPORTED_VARS(compiler);
+#endif /* SCM_USE_COMPILER */
+
+/* machine.c */
+#if SCM_USE_MACHINE
+SCM_GLOBAL_VARS_BEGIN(machine);
+scm_bool scm_machine_enabled;
+scm_int_t scm_machine_sp;
+SCM_GLOBAL_VARS_END(machine);
+#define scm_machine_enabled SCM_GLOBAL_VAR(machine, scm_machine_enabled)
+#define scm_machine_sp      SCM_GLOBAL_VAR(machine, scm_machine_sp)
+SCM_DECLARE_EXPORTED_VARS(machine);
+#endif /* SCM_USE_MACHINE */
+
+/* vm.c */
+#if SCM_USE_VM
+SCM_GLOBAL_VARS_BEGIN(vm);
+ScmObj scm_vm_code_tag;
+scm_bool scm_vm_enabled;
+scm_int_t scm_vm_sp;
+SCM_GLOBAL_VARS_END(vm);
+#define scm_vm_code_tag SCM_GLOBAL_VAR(vm, scm_vm_code_tag)
+#define scm_vm_enabled  SCM_GLOBAL_VAR(vm, scm_vm_enabled)
+#define scm_vm_sp       SCM_GLOBAL_VAR(vm, scm_vm_sp)
+SCM_DECLARE_EXPORTED_VARS(vm);
+#endif /* SCM_USE_VM */
+
 /* symbol.c */
 /* Only permitted to storage-gc.c */
 SCM_GLOBAL_VARS_BEGIN(symbol);
@@ -644,14 +757,24 @@ SCM_EXPORT void scm_init_gc(const ScmStorageConf *conf);
 SCM_EXPORT void scm_fin_gc(void);
 SCM_EXPORT ScmObj scm_alloc_cell(void);
 SCM_EXPORT void scm_prealloc_heaps(size_t n);
+#if SCM_USE_FULL_CONTINUATION
+SCM_EXPORT scm_int_t *scm_gc_stack_base(void);
+SCM_EXPORT void scm_gc_mark(ScmObj obj);
+SCM_EXPORT void scm_gc_mark_locations(ScmObj *start, size_t n);
+#endif
 
 /* continuation.c */
 #if SCM_USE_CONTINUATION
 SCM_EXPORT void scm_init_continuation(void);
 SCM_EXPORT void scm_fin_continuation(void);
 SCM_EXPORT void scm_destruct_continuation(ScmObj cont);
+#if SCM_USE_FULL_CONTINUATION
+SCM_EXPORT void scm_mark_continuation(void *opaque);
+#endif
 SCM_EXPORT ScmObj scm_call_with_current_continuation(ScmObj proc,
                                                      ScmEvalState *eval_state);
+SCM_EXPORT ScmObj scm_call_with_escape_continuation(ScmObj proc,
+                                                    ScmEvalState *eval_state);
 SCM_EXPORT void scm_call_continuation(ScmObj cont, ScmObj ret) SCM_NORETURN;
 SCM_EXPORT ScmObj scm_dynamic_wind(ScmObj before, ScmObj thunk, ScmObj after);
 #if SCM_USE_BACKTRACE
@@ -671,15 +794,26 @@ SCM_EXPORT void scm_fin_symbol(void);
 SCM_EXPORT scm_bool scm_toplevel_environmentp(ScmObj env);
 SCM_EXPORT ScmObj scm_extend_environment(ScmObj formals, ScmObj actuals,
                                          ScmObj env);
+#if SCM_USE_VECTOR_FRAME
+SCM_EXPORT ScmObj scm_make_vector_frame(ScmObj formals, scm_int_t len);
+SCM_EXPORT ScmObj scm_extend_environment_by_frame(ScmObj frame, ScmObj env);
+#endif
 SCM_EXPORT ScmObj scm_replace_environment(ScmObj formals, ScmObj actuals,
                                           ScmObj env);
 SCM_EXPORT ScmObj scm_update_environment(ScmObj actuals, ScmObj env);
 SCM_EXPORT ScmObj scm_add_environment(ScmObj var, ScmObj val, ScmObj env);
 SCM_EXPORT ScmRef scm_lookup_environment(ScmObj var, ScmObj env);
 SCM_EXPORT ScmRef scm_lookup_frame(ScmObj var, ScmObj frame);
+#if (SCM_USE_COMPILER || SCM_USE_VM)
+SCM_EXPORT ScmRef scm_lookup_lexical(scm_int_t depth, scm_int_t index,
+                                     ScmObj env);
+SCM_EXPORT ScmRef scm_lookup_frame_lexical(scm_int_t index, ScmObj frame);
+#endif
 #if SCM_USE_HYGIENIC_MACRO
 SCM_EXPORT ScmPackedEnv scm_pack_env(ScmObj env);
 SCM_EXPORT ScmObj scm_unpack_env(ScmPackedEnv penv, ScmObj context);
+SCM_EXPORT ScmObj scm_env_shape(ScmObj env);
+SCM_EXPORT scm_bool scm_env_shapep(ScmObj env, ScmObj shape);
 SCM_EXPORT scm_bool scm_subenvp(ScmObj env, ScmPackedEnv sub);
 SCM_EXPORT scm_bool scm_identifierequalp(ScmObj x, ScmPackedEnv xpenv,
                                          ScmObj y,
@@ -695,6 +829,52 @@ SCM_EXPORT scm_bool scm_valid_environment_extension_lengthp(scm_int_t formals_le
 SCM_EXPORT scm_int_t scm_validate_formals(ScmObj formals);
 SCM_EXPORT scm_int_t scm_validate_actuals(ScmObj actuals);
 
+/* eval.c */
+#if (SCM_USE_COMPILER || SCM_USE_MACHINE || SCM_USE_VM)
+SCM_EXPORT ScmObj scm_tailcall(ScmObj proc, ScmObj args,
+                               ScmEvalState *eval_state,
+                               enum ScmValueType need_eval);
+#endif
+SCM_EXPORT ScmObj scm_bind_closure_args(ScmObj formals, ScmObj args,
+                                        scm_int_t args_len, ScmObj env);
+
+/* compiler.c */
+#if SCM_USE_COMPILER
+SCM_EXPORT void scm_init_compiler(void);
+SCM_EXPORT ScmObj scm_compile_closure(ScmObj closure);
+SCM_EXPORT void scm_invalidate_loop_frames(void);
+#if SCM_USE_STACK_FRAME
+SCM_EXPORT ScmObj scm_make_stack_frame(ScmObj formals, scm_int_t len);
+SCM_EXPORT void scm_release_stack_frames(scm_int_t sp);
+SCM_EXPORT void scm_release_stack_frames_but_top(scm_int_t sp);
+SCM_EXPORT scm_bool scm_top_stack_framep(ScmObj frame);
+SCM_EXPORT void scm_drop_stack_frames(scm_int_t sp);
+#endif
+#endif
+
+/* machine.c */
+#if SCM_USE_MACHINE
+SCM_EXPORT void scm_init_machine(void);
+SCM_EXPORT ScmObj scm_machine_eval(ScmObj exp, ScmObj env);
+SCM_EXPORT void scm_machine_unwind(scm_int_t sp);
+#if SCM_USE_FULL_CONTINUATION
+SCM_EXPORT ScmObj scm_machine_save_stack(void);
+SCM_EXPORT void scm_machine_restore_stack(ScmObj saved);
+#endif
+#endif
+
+/* vm.c */
+#if SCM_USE_VM
+SCM_EXPORT void scm_init_vm(void);
+SCM_EXPORT ScmObj scm_vm_eval(ScmObj exp, ScmObj env);
+SCM_EXPORT ScmObj scm_vm_compile_closure(ScmObj closure);
+SCM_EXPORT void scm_vm_unwind(scm_int_t sp);
+#if SCM_USE_FULL_CONTINUATION
+SCM_EXPORT ScmObj scm_vm_save_stack(void);
+SCM_EXPORT void scm_vm_restore_stack(ScmObj saved);
+#endif
+#endif
+
 /* syntax.c */
 SCM_EXPORT void scm_init_syntax(void);
 #if SCM_USE_INTERNAL_DEFINITIONS
@@ -764,6 +944,14 @@ SCM_EXPORT void scm_load_system_file(const char *file);
 /* module.c */
 SCM_EXPORT void scm_init_module(void);
 SCM_EXPORT void scm_fin_module(void);
+SCM_EXPORT void scm_register_binary_operator(ScmFuncType reducer,
+                                             ScmBinaryOperator binary);
+SCM_EXPORT ScmBinaryOperator scm_lookup_binary_operator(ScmFuncType reducer);
+
+/* number.c */
+#if SCM_USE_NUMBER
+SCM_EXPORT void scm_init_number(void);
+#endif
 
 /* sigscheme.c */
 SCM_EXPORT char **scm_interpret_argv(char **argv);
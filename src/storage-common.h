@@ -51,6 +51,9 @@
   Internal SAL
 =======================================*/
 /* for mark phase */
+#if !SCM_USE_MARK_BITMAP
+/* With SCM_USE_MARK_BITMAP, storage-gc.c defines the mark operations on its
+ * bitmaps instead. */
 #define SCM_MARKEDP(o)                                                  \
     SCM_TYPESAFE_MACRO(SCM_ISAL_MARKEDP,                                \
                        int,                                             \
@@ -60,8 +63,10 @@
     SCM_TYPESAFE_MACRO_VOID(SCM_ISAL_MARK,                              \
                             (ScmObj),                                   \
                             (o))
+#endif /* !SCM_USE_MARK_BITMAP */
 
 /* for sweep phase */
+#if !SCM_USE_MARK_BITMAP
 #define SCM_CELL_MARKEDP(c)                                             \
     SCM_TYPESAFE_MACRO(SCM_ISAL_CELL_MARKEDP,                           \
                        int,                                             \
@@ -71,12 +76,30 @@
     SCM_TYPESAFE_MACRO_VOID(SCM_ISAL_CELL_UNMARK,                       \
                             (ScmCell *),                                \
                             (c))
+#endif /* !SCM_USE_MARK_BITMAP */
 #define SCM_CELL_FREECELLP(c)                                           \
     SCM_TYPESAFE_MACRO(SCM_ISAL_CELL_FREECELLP,                         \
                        int,                                             \
                        (ScmCell *),                                     \
                        (c))
 
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+/* for the remembered set */
+#define SCM_CELL_REMEMBEREDP(c)                                         \
+    SCM_TYPESAFE_MACRO(SCM_ISAL_CELL_REMEMBEREDP,                       \
+                       int,                                             \
+                       (ScmCell *),                                     \
+                       (c))
+#define SCM_CELL_SET_REMEMBERED(c)                                      \
+    SCM_TYPESAFE_MACRO_VOID(SCM_ISAL_CELL_SET_REMEMBERED,               \
+                            (ScmCell *),                                \
+                            (c))
+#define SCM_CELL_CLEAR_REMEMBERED(c)                                    \
+    SCM_TYPESAFE_MACRO_VOID(SCM_ISAL_CELL_CLEAR_REMEMBERED,             \
+                            (ScmCell *),                                \
+                            (c))
+#endif /* (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC) */
+
 /* For optimized operation: Cleanup a destructed ScmCell *c to a freecell,
  * chain it into freelist and returns ScmObj for c. */
 #define SCM_CELL_RECLAIM_CELL(c, next)                                  \
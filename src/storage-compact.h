@@ -280,6 +280,21 @@ typedef ScmObj (*ScmFuncType)();
 #define SCM_ISAL_CELL_UNMARK(c)                                         \
     SCM_SET_X((c), SCM_DROP_GCBIT(SCM_X(c)) | SCM_GCBIT_UNMARKED)
 
+/* The mark bit shares the word with car and the like, so the marks cannot be
+ * kept over collections to represent the old generation, nor be seen by the
+ * mutator between incremental marking steps or until lazily swept. */
+#if SCM_USE_GENERATIONAL_GC
+#error "generational GC is not supported by the compact storage"
+#endif
+#if SCM_USE_INCREMENTAL_GC
+#error "incremental GC is not supported by the compact storage"
+#endif
+#if SCM_USE_LAZY_SWEEP
+#error "lazy sweep is not supported by the compact storage"
+#endif
+#define SCM_SAL_WRITE_BARRIER(o)       SCM_EMPTY_EXPR
+#define SCM_SAL_WRITE_BARRIER_REF(ref) SCM_EMPTY_EXPR
+
 /* See if O's tag and the content of the cell C it references are
  * consistent.  O must be a tagged ScmObj and SCM_DROP_TAG(O) == &C. */
 #define SCM_TAG_CONSISTENTP(o, c) (!!SCM_SYMMETRICP(o)          \
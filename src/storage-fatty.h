@@ -84,7 +84,7 @@ struct ScmCell_ {
     union {
         struct {
             enum ScmObjType type;
-            char gcmark, immutable, pad2, pad3;
+            char gcmark, immutable, gcremembered, pad3;
         } v;
 
         /* to align against 64-bit primitives */
@@ -257,8 +257,10 @@ struct ScmCell_ {
 /* don't use as lvalue */
 #define SCM_SAL_CONS_CAR(o)            (SCM_AS_CONS(o)->obj.cons.car + 0)
 #define SCM_SAL_CONS_CDR(o)            (SCM_AS_CONS(o)->obj.cons.cdr + 0)
-#define SCM_SAL_CONS_SET_CAR(o, kar)   (SCM_AS_CONS(o)->obj.cons.car = (kar))
-#define SCM_SAL_CONS_SET_CDR(o, kdr)   (SCM_AS_CONS(o)->obj.cons.cdr = (kdr))
+#define SCM_SAL_CONS_SET_CAR(o, kar)                                         \
+    (SCM_AS_CONS(o)->obj.cons.car = (kar), SCM_SAL_WRITE_BARRIER(o))
+#define SCM_SAL_CONS_SET_CDR(o, kdr)                                         \
+    (SCM_AS_CONS(o)->obj.cons.cdr = (kdr), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_SAL_CONS_MUTABLEP(o)       (SCM_MUTABLEP(o))
 #define SCM_SAL_CONS_SET_MUTABLE(o)    (SCM_SET_MUTABLE(o))
 #define SCM_SAL_CONS_SET_IMMUTABLE(o)  (SCM_SET_IMMUTABLE(o))
@@ -277,7 +279,8 @@ struct ScmCell_ {
 #define SCM_SAL_SYMBOL_NAME(o)         (SCM_AS_SYMBOL(o)->obj.symbol.name)
 #define SCM_SAL_SYMBOL_SET_NAME(o, name) (SCM_SYMBOL_NAME(o) = (name))
 #define SCM_SAL_SYMBOL_VCELL(o)        (SCM_AS_SYMBOL(o)->obj.symbol.value)
-#define SCM_SAL_SYMBOL_SET_VCELL(o, val) (SCM_SYMBOL_VCELL(o) = (val))
+#define SCM_SAL_SYMBOL_SET_VCELL(o, val)                                     \
+    (SCM_SYMBOL_VCELL(o) = (val), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_ISAL_SYMBOL_INIT(o, n, v)  (SCM_ENTYPE((o), ScmSymbol),     \
                                         SCM_SYMBOL_SET_NAME((o), (n)),  \
                                         SCM_SYMBOL_SET_VCELL((o), (v)))
@@ -319,9 +322,11 @@ struct ScmCell_ {
 
 #define SCM_SAL_CLOSUREP(o)               (SCM_TYPE(o) == ScmClosure)
 #define SCM_SAL_CLOSURE_EXP(o)            (SCM_AS_CLOSURE(o)->obj.closure.exp)
-#define SCM_SAL_CLOSURE_SET_EXP(o, exp)   (SCM_CLOSURE_EXP(o) = (exp))
+#define SCM_SAL_CLOSURE_SET_EXP(o, exp)                                      \
+    (SCM_CLOSURE_EXP(o) = (exp), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_SAL_CLOSURE_ENV(o)            (SCM_AS_CLOSURE(o)->obj.closure.env)
-#define SCM_SAL_CLOSURE_SET_ENV(o, env)   (SCM_CLOSURE_ENV(o) = (env))
+#define SCM_SAL_CLOSURE_SET_ENV(o, env)                                      \
+    (SCM_CLOSURE_ENV(o) = (env), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_ISAL_CLOSURE_INIT(o, x, e)    (SCM_ENTYPE((o), ScmClosure),       \
                                            SCM_CLOSURE_SET_EXP((o), (x)), \
                                            SCM_CLOSURE_SET_ENV((o), (e)))
@@ -381,7 +386,8 @@ struct ScmCell_ {
 #define SCM_SAL_VALUEPACKETP(o)        (SCM_TYPE(o) == ScmValuePacket)
 #define SCM_SAL_VALUEPACKET_VALUES(o)                                        \
     (SCM_AS_VALUEPACKET(o)->obj.value_packet.lst)
-#define SCM_SAL_VALUEPACKET_SET_VALUES(o, v) (SCM_VALUEPACKET_VALUES(o) = (v))
+#define SCM_SAL_VALUEPACKET_SET_VALUES(o, v)                                 \
+    (SCM_VALUEPACKET_VALUES(o) = (v), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_ISAL_VALUEPACKET_INIT(o, v) (SCM_ENTYPE((o), ScmValuePacket),     \
                                          SCM_VALUEPACKET_SET_VALUES((o), (v)))
 #endif /* SCM_USE_VALUECONS */
@@ -394,7 +400,8 @@ struct ScmCell_ {
 #define SCM_SAL_HMACROP(o)             (SCM_SAL_MACROP(o))
 #endif /* not SCM_USE_UNHYGIENIC_MACRO */
 #define SCM_SAL_HMACRO_RULES(o)        (SCM_AS_HMACRO(o)->obj.hmacro.rules)
-#define SCM_SAL_HMACRO_SET_RULES(o, r) (SCM_SAL_HMACRO_RULES(o) = (r))
+#define SCM_SAL_HMACRO_SET_RULES(o, r)                                       \
+    (SCM_SAL_HMACRO_RULES(o) = (r), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_SAL_HMACRO_ENV(o)          (SCM_AS_HMACRO(o)->obj.hmacro.env)
 #define SCM_SAL_HMACRO_SET_ENV(o, e)   (SCM_SAL_HMACRO_ENV(o) = (e))
 #define SCM_ISAL_HMACRO_INIT(o, r, e)  (SCM_ENTYPE((o), ScmMacro),      \
@@ -403,7 +410,8 @@ struct ScmCell_ {
 
 #define SCM_SAL_FARSYMBOLP(o)           (SCM_TYPE(o) == ScmFarsymbol)
 #define SCM_SAL_FARSYMBOL_SYM(o)        (SCM_AS_FARSYMBOL(o)->obj.farsym.sym)
-#define SCM_SAL_FARSYMBOL_SET_SYM(o, s) (SCM_SAL_FARSYMBOL_SYM(o) = (s))
+#define SCM_SAL_FARSYMBOL_SET_SYM(o, s)                                      \
+    (SCM_SAL_FARSYMBOL_SYM(o) = (s), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_SAL_FARSYMBOL_ENV(o)        (SCM_AS_FARSYMBOL(o)->obj.farsym.env)
 #define SCM_SAL_FARSYMBOL_SET_ENV(o, e) (SCM_SAL_FARSYMBOL_ENV(o) = (e))
 #define SCM_ISAL_FARSYMBOL_INIT(o, s, e) (SCM_ENTYPE((o), ScmFarsymbol),   \
@@ -413,7 +421,8 @@ struct ScmCell_ {
 #define SCM_SAL_SUBPATP(o)              (SCM_TYPE(o) == ScmSubpat)
 #define SCM_SAL_SUBPAT_OBJ(o)           (SCM_AS_SUBPAT(o)->obj.subpat.obj)
 #define SCM_SAL_SUBPAT_META(o)          (SCM_AS_SUBPAT(o)->obj.subpat.meta)
-#define SCM_SAL_SUBPAT_SET_OBJ(o, x)    (SCM_SAL_SUBPAT_OBJ(o) = (x))
+#define SCM_SAL_SUBPAT_SET_OBJ(o, x)                                         \
+    (SCM_SAL_SUBPAT_OBJ(o) = (x), SCM_SAL_WRITE_BARRIER(o))
 #define SCM_SAL_SUBPAT_SET_META(o, m)   (SCM_SAL_SUBPAT_META(o) = (m))
 #define SCM_ISAL_SUBPAT_INIT(o, x, m)   (SCM_ENTYPE((o), ScmSubpat),    \
                                          SCM_SUBPAT_SET_OBJ((o), (x)),  \
@@ -472,6 +481,33 @@ struct ScmCell_ {
 #define SCM_ISAL_CELL_MARKEDP(c) ((c)->attr.v.gcmark)
 #define SCM_ISAL_CELL_UNMARK(c)  ((c)->attr.v.gcmark = scm_false)
 
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+/* A marked object is recorded into the remembered set once it is modified,
+ * to be traced again. The marks represent the old generation for the
+ * generational GC, and the objects already traced in the current cycle for
+ * the incremental one. The barrier follows the store since evaluating the
+ * stored value may trigger a GC. */
+#define SCM_ISAL_CELL_REMEMBEREDP(c)     ((c)->attr.v.gcremembered)
+#define SCM_ISAL_CELL_SET_REMEMBERED(c)  ((c)->attr.v.gcremembered = scm_true)
+#define SCM_ISAL_CELL_CLEAR_REMEMBERED(c)                                    \
+    ((c)->attr.v.gcremembered = scm_false)
+
+#define SCM_SAL_WRITE_BARRIER(o)                                             \
+    ((SCM_ISAL_MARKEDP(o) && !SCM_ISAL_CELL_REMEMBEREDP(o))                  \
+     ? scm_gc_remember(o) : SCM_EMPTY_EXPR)
+/* REF may be off-heap. The cell-sized block containing it is always readable
+ * though, and scm_gc_remember_ref() ignores it if it is not a cell. */
+#define SCM_ISAL_REF_CELL(ref)                                               \
+    ((ScmCell *)((uintptr_t)(ref) & ~(uintptr_t)(sizeof(ScmCell) - 1)))
+#define SCM_SAL_WRITE_BARRIER_REF(ref)                                       \
+    ((SCM_ISAL_CELL_MARKEDP(SCM_ISAL_REF_CELL(ref))                          \
+      && !SCM_ISAL_CELL_REMEMBEREDP(SCM_ISAL_REF_CELL(ref)))                 \
+     ? scm_gc_remember_ref(ref) : SCM_EMPTY_EXPR)
+#else /* (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC) */
+#define SCM_SAL_WRITE_BARRIER(o)       SCM_EMPTY_EXPR
+#define SCM_SAL_WRITE_BARRIER_REF(ref) SCM_EMPTY_EXPR
+#endif /* (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC) */
+
 /*===========================================================================
   Abstract ScmObj Reference For Storage-Representation Independent Efficient
   List Operations
@@ -486,7 +522,7 @@ struct ScmCell_ {
 #define SCM_SAL_DEREF(ref)    (*(ref) + 0)
 
 /* RFC: Is there a better name? */
-#define SCM_SAL_SET(ref, obj) (*(ref) = (obj))
+#define SCM_SAL_SET(ref, obj) (*(ref) = (obj), SCM_SAL_WRITE_BARRIER_REF(ref))
 
 /*===========================================================================
   Special Constants and Predicates
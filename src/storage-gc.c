@@ -54,12 +54,64 @@
  *
  * [2] Sweep phase : gc_sweep()
  *   - collects unmarked objects on heaps into the freelist.
+ *
+ * With SCM_USE_GENERATIONAL_GC, the sweep leaves the marks of the survivors
+ * as is and the marked objects are regarded as the old generation. A minor
+ * collection marks only the young objects reachable from the roots and from
+ * the remembered set, which records the old objects modified by the write
+ * barrier. The heaps fully occupied by old objects are not swept. A full
+ * collection clears all the marks beforehand, and is performed only when a
+ * minor one cannot collect enough cells.
+ *
+ * With SCM_USE_INCREMENTAL_GC, the mark phase is divided into steps performed
+ * on allocation once the free cells run short. A marked object is grey until
+ * traced, and the grey objects are held in the remembered set. Each step
+ * traces at most gc_step_budget cells. The cells allocated during the marking
+ * are grey, and the write barrier makes a modified black object grey again.
+ * Once no grey object is left, the step marks the roots again. The marking
+ * ends if the objects made grey by them are traced within the budget of the
+ * step, and otherwise goes on in the next steps. The sweep is left to the
+ * lazy sweep, which SCM_USE_INCREMENTAL_GC requires. Only the collection
+ * forced by running out of the free cells marks all at once.
+ *
+ * With SCM_USE_LAZY_SWEEP, the sweep phase only counts the collected cells
+ * and leaves the heaps marked. scm_alloc_cell() sweeps them from a cursor
+ * when the freelist runs out, so that a dead cell is finalized by free_cell()
+ * just before it is reused. The rest of the heaps is swept before the next
+ * marking.
+ *
+ * With SCM_USE_MARK_BITMAP, the marks are kept in a bitmap placed after the
+ * cells of each heap instead of in the cells, so that the pages of the live
+ * cells are not written by a collection and stay shared with forked
+ * processes. A heap is aligned to the power of 2 covering its cells to find
+ * the bitmap from a cell address. The sweep skips the bitmap words marking
+ * all of their cells at once.
+ *
+ * With SCM_USE_PARALLEL_MARK, the marking is shared by gc_n_markers threads
+ * including the mutator one, which is the only thread running Scheme code.
+ * The region of the stack is split into slices scanned by each marker. A
+ * marked object is grey until traced, and is pushed onto the private stack
+ * of the marker having set its mark bit atomically. While some marker is
+ * idle, the others move a half of their stacks to their work-stealing deques,
+ * from which a marker having run out of its own grey objects steals. The
+ * marking ends once all the markers are idle. A marker runs for each online
+ * processor unless gc_n_markers is given. A lone marker marks recursively
+ * as without SCM_USE_PARALLEL_MARK. The helper threads are started on
+ * the first marking, and started again in a forked process.
  */
 
 #include <config.h>
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#if SCM_USE_PARALLEL_MARK
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#endif
 
 #include "sigscheme.h"
 #include "sigschemeinternal.h"
@@ -68,7 +120,59 @@
   File Local Macro Definitions
 =======================================*/
 #define SCMOBJ_ALIGNEDP(ptr) (!((uintptr_t)(ptr) % sizeof(ScmObj)))
-#if SCM_DEBUG
+#define REMEMBERED_SET_INIT_SIZE 256
+/* number of cells traced per allocated cell during an incremental marking */
+#define INCREMENTAL_MARK_RATE    8
+/* number of cells swept at a time on allocation */
+#define LAZY_SWEEP_UNIT          64
+#if (SCM_USE_INCREMENTAL_GC && !SCM_USE_LAZY_SWEEP)
+#error "incremental GC requires the lazy sweep"
+#endif
+#if SCM_USE_MARK_BITMAP
+#if !HAVE_POSIX_MEMALIGN
+#error "mark bitmaps require posix_memalign(3)"
+#endif
+#define MARK_WORD_BITS           (sizeof(ScmMarkWord) * 8)
+#if SCM_USE_STORAGE_COMPACT
+#define OBJ_CELL(o)              ((ScmCell *)SCM_DROP_TAG(o))
+#else
+#define OBJ_CELL(o)              (o)
+#endif
+#define CELL_HEAP(c)             ((ScmCell *)((uintptr_t)(c) & ~l_heap_mask))
+#define CELL_INDEX(c)                                                        \
+    (((uintptr_t)(c) & l_heap_mask) / sizeof(ScmCell))
+#define HEAP_BITMAP(heap)        ((ScmMarkWord *)&(heap)[l_heap_size])
+#define CELL_MARK_WORD(c)                                                    \
+    (HEAP_BITMAP(CELL_HEAP(c))[CELL_INDEX(c) / MARK_WORD_BITS])
+#define CELL_MARK_BIT(c)                                                     \
+    ((ScmMarkWord)1 << CELL_INDEX(c) % MARK_WORD_BITS)
+#define MARK_BITMAP_SIZE                                                     \
+    ((l_heap_size + MARK_WORD_BITS - 1) / MARK_WORD_BITS * sizeof(ScmMarkWord))
+
+#define SCM_CELL_MARKEDP(c)      ((CELL_MARK_WORD(c) & CELL_MARK_BIT(c)) != 0)
+#define SCM_CELL_UNMARK(c)       (CELL_MARK_WORD(c) &= ~CELL_MARK_BIT(c))
+#define SCM_MARKEDP(o)           (SCM_CELL_MARKEDP(OBJ_CELL(o)))
+#define SCM_MARK(o)              (CELL_MARK_WORD(OBJ_CELL(o))                \
+                                  |= CELL_MARK_BIT(OBJ_CELL(o)))
+#endif /* SCM_USE_MARK_BITMAP */
+#if SCM_USE_PARALLEL_MARK
+/* capacity of the work-stealing deque of a marker. must be a power of 2 */
+#define MARK_DEQUE_SIZE          4096
+/* true if the object is newly marked by the calling thread */
+#define MARK_ATOMICALLY(o)                                                   \
+    (!(__atomic_fetch_or(&CELL_MARK_WORD(OBJ_CELL(o)),                       \
+                         CELL_MARK_BIT(OBJ_CELL(o)), __ATOMIC_RELAXED)       \
+       & CELL_MARK_BIT(OBJ_CELL(o))))
+#endif
+#if (SCM_DEBUG && SCM_USE_PARALLEL_MARK)
+/* entered by the marker threads too */
+#define SCM_BEGIN_GC_SUBCONTEXT() (scm_ensure_proper_freelist(l_freelist), \
+                                   __atomic_add_fetch(&l_gcing, 1,         \
+                                                      __ATOMIC_SEQ_CST))
+#define SCM_END_GC_SUBCONTEXT()   (scm_ensure_proper_freelist(l_freelist), \
+                                   __atomic_sub_fetch(&l_gcing, 1,         \
+                                                      __ATOMIC_SEQ_CST))
+#elif SCM_DEBUG
 #define SCM_BEGIN_GC_SUBCONTEXT() (scm_ensure_proper_freelist(l_freelist), \
                                    ++l_gcing)
 #define SCM_END_GC_SUBCONTEXT()   (scm_ensure_proper_freelist(l_freelist), \
@@ -82,6 +186,26 @@
   File Local Type Definitions
 =======================================*/
 typedef ScmCell *ScmObjHeap;
+#if SCM_USE_MARK_BITMAP
+typedef uintptr_t ScmMarkWord;
+#endif
+#if SCM_USE_PARALLEL_MARK
+typedef struct ScmMarker_ ScmMarker;
+struct ScmMarker_ {
+    pthread_t thread;
+    size_t epoch;                    /* the last marking run */
+    ScmObj *stack;                   /* the private grey objects */
+    size_t stack_size, n_stack;
+    /* Chase-Lev deque of the grey objects shared with the idle markers. The
+     * owner pushes and pops at the bottom, and the others steal from the
+     * top. */
+    ScmObj *deque;
+    scm_int_t top, bottom;
+#if SCM_USE_LAZY_SWEEP
+    size_t n_marked;
+#endif
+};
+#endif
 
 /*=======================================
   Variable Definitions
@@ -92,6 +216,9 @@ static size_t l_heap_size, l_heap_alloc_threshold;
 static size_t l_n_heaps, l_n_heaps_max;
 static ScmObjHeap *l_heaps;
 static ScmCell *l_heaps_lowest, *l_heaps_highest;
+#if SCM_USE_MARK_BITMAP
+static uintptr_t l_heap_mask;  /* the alignment of the heaps minus 1 */
+#endif
 /* Do not declare the type of l_freelist as ScmCell *, because the freelist
  * head should be capable of non-pointer cell reference such as heap number &
  * cell index pair. Although it costs NULLP() on every cell allocation, source
@@ -102,12 +229,51 @@ static ScmObj l_freelist;
 static ScmObj **l_protected_vars;
 static size_t l_protected_vars_size, l_n_empty_protected_vars;
 static GCROOTS_context *l_gcroots_ctx;
+#if SCM_USE_FULL_CONTINUATION
+static scm_int_t *l_stack_base, l_stack_serial;
+#endif
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+static ScmObj *l_remembered;
+static size_t l_remembered_size, l_n_remembered;
+#endif
+#if SCM_USE_GENERATIONAL_GC
+static scm_bool *l_tenured_heaps;  /* the heaps having no young cells */
+#endif
+#if SCM_USE_INCREMENTAL_GC
+static scm_bool l_marking;
+static size_t l_step_budget, l_n_allocs_to_step;
+static size_t l_marking_trigger;
+#endif
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_LAZY_SWEEP)
+static size_t l_n_free;  /* including the dead cells not swept yet */
+#endif
+#if SCM_USE_LAZY_SWEEP
+static size_t l_n_marked, l_sweep_heap;
+static ScmCell *l_sweep_cell;  /* null if all heaps are swept */
+#endif
+#if SCM_USE_PARALLEL_MARK
+static ScmMarker *l_markers;  /* l_markers[0] is the mutator thread */
+static size_t l_n_markers;
+static pid_t l_markers_pid;   /* the process the helpers run in */
+static pthread_mutex_t l_marker_mutex;
+static pthread_cond_t l_marker_cond, l_marker_done_cond;
+static size_t l_mark_epoch, l_n_markers_done;
+static scm_bool l_markers_quit;
+static size_t l_n_idle_markers;
+static ScmObj *l_mark_roots;  /* the region split among the markers */
+static size_t l_n_mark_roots;
+static scm_bool l_mark_roots_certain;
+#endif
 #if SCM_DEBUG
 static size_t l_gcing;
 static scm_bool l_allocating;
 #endif /* SCM_DEBUG */
 #undef static
 SCM_GLOBAL_VARS_END(static_gc);
+#if SCM_USE_PARALLEL_MARK
+/* per thread, so that it is not one of the global variables above */
+static __thread ScmMarker *l_current_marker;
+#endif
 #define l_heap_size            SCM_GLOBAL_VAR(static_gc, l_heap_size)
 #define l_heap_alloc_threshold SCM_GLOBAL_VAR(static_gc, l_heap_alloc_threshold)
 #define l_n_heaps              SCM_GLOBAL_VAR(static_gc, l_n_heaps)
@@ -115,12 +281,56 @@ SCM_GLOBAL_VARS_END(static_gc);
 #define l_heaps                SCM_GLOBAL_VAR(static_gc, l_heaps)
 #define l_heaps_lowest         SCM_GLOBAL_VAR(static_gc, l_heaps_lowest)
 #define l_heaps_highest        SCM_GLOBAL_VAR(static_gc, l_heaps_highest)
+#if SCM_USE_MARK_BITMAP
+#define l_heap_mask            SCM_GLOBAL_VAR(static_gc, l_heap_mask)
+#endif
 #define l_freelist             SCM_GLOBAL_VAR(static_gc, l_freelist)
 #define l_protected_vars       SCM_GLOBAL_VAR(static_gc, l_protected_vars)
 #define l_protected_vars_size  SCM_GLOBAL_VAR(static_gc, l_protected_vars_size)
 #define l_n_empty_protected_vars                                             \
     SCM_GLOBAL_VAR(static_gc, l_n_empty_protected_vars)
 #define l_gcroots_ctx          SCM_GLOBAL_VAR(static_gc, l_gcroots_ctx)
+#if SCM_USE_FULL_CONTINUATION
+#define l_stack_base           SCM_GLOBAL_VAR(static_gc, l_stack_base)
+#define l_stack_serial         SCM_GLOBAL_VAR(static_gc, l_stack_serial)
+#endif
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+#define l_remembered           SCM_GLOBAL_VAR(static_gc, l_remembered)
+#define l_remembered_size      SCM_GLOBAL_VAR(static_gc, l_remembered_size)
+#define l_n_remembered         SCM_GLOBAL_VAR(static_gc, l_n_remembered)
+#endif
+#if SCM_USE_GENERATIONAL_GC
+#define l_tenured_heaps        SCM_GLOBAL_VAR(static_gc, l_tenured_heaps)
+#endif
+#if SCM_USE_INCREMENTAL_GC
+#define l_marking              SCM_GLOBAL_VAR(static_gc, l_marking)
+#define l_step_budget          SCM_GLOBAL_VAR(static_gc, l_step_budget)
+#define l_n_allocs_to_step     SCM_GLOBAL_VAR(static_gc, l_n_allocs_to_step)
+#define l_marking_trigger      SCM_GLOBAL_VAR(static_gc, l_marking_trigger)
+#endif
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_LAZY_SWEEP)
+#define l_n_free               SCM_GLOBAL_VAR(static_gc, l_n_free)
+#endif
+#if SCM_USE_LAZY_SWEEP
+#define l_n_marked             SCM_GLOBAL_VAR(static_gc, l_n_marked)
+#define l_sweep_heap           SCM_GLOBAL_VAR(static_gc, l_sweep_heap)
+#define l_sweep_cell           SCM_GLOBAL_VAR(static_gc, l_sweep_cell)
+#endif
+#if SCM_USE_PARALLEL_MARK
+#define l_markers              SCM_GLOBAL_VAR(static_gc, l_markers)
+#define l_n_markers            SCM_GLOBAL_VAR(static_gc, l_n_markers)
+#define l_markers_pid          SCM_GLOBAL_VAR(static_gc, l_markers_pid)
+#define l_marker_mutex         SCM_GLOBAL_VAR(static_gc, l_marker_mutex)
+#define l_marker_cond          SCM_GLOBAL_VAR(static_gc, l_marker_cond)
+#define l_marker_done_cond     SCM_GLOBAL_VAR(static_gc, l_marker_done_cond)
+#define l_mark_epoch           SCM_GLOBAL_VAR(static_gc, l_mark_epoch)
+#define l_n_markers_done       SCM_GLOBAL_VAR(static_gc, l_n_markers_done)
+#define l_markers_quit         SCM_GLOBAL_VAR(static_gc, l_markers_quit)
+#define l_n_idle_markers       SCM_GLOBAL_VAR(static_gc, l_n_idle_markers)
+#define l_mark_roots           SCM_GLOBAL_VAR(static_gc, l_mark_roots)
+#define l_n_mark_roots         SCM_GLOBAL_VAR(static_gc, l_n_mark_roots)
+#define l_mark_roots_certain   SCM_GLOBAL_VAR(static_gc, l_mark_roots_certain)
+#endif
 #if SCM_DEBUG
 #define l_gcing                SCM_GLOBAL_VAR(static_gc, l_gcing)
 #define l_allocating           SCM_GLOBAL_VAR(static_gc, l_allocating)
@@ -137,10 +347,48 @@ static void add_heap(void);
 static void finalize_heap(void);
 
 static void gc_mark_and_sweep(void);
+#if SCM_USE_INCREMENTAL_GC
+static void gc_start_marking(void);
+static void gc_mark_step(void);
+#endif
+#if SCM_USE_LAZY_SWEEP
+static size_t gc_start_sweep(void);
+#endif
+static void gc_adjust_heaps(size_t n_collected);
 
 /* GC Mark Related Functions */
 static void mark_obj(ScmObj obj);
+#if SCM_USE_PARALLEL_MARK
+static void mark_obj_recursively(ScmObj obj);
+#endif
 static scm_bool within_heapp(ScmObj obj);
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+static void remember(ScmObj obj);
+static void mark_old_obj(ScmObj obj);
+#endif
+#if SCM_USE_GENERATIONAL_GC
+static void gc_mark_remembered(void);
+static void gc_clear_marks(void);
+#endif
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_PARALLEL_MARK)
+static size_t trace_obj(ScmObj obj);
+#endif
+#if SCM_USE_INCREMENTAL_GC
+static size_t gc_trace_grey(size_t budget);
+#endif
+#if SCM_USE_PARALLEL_MARK
+static void initialize_markers(const ScmStorageConf *conf);
+static void start_markers(void);
+static void finalize_markers(void);
+static void *marker_main(void *arg);
+static void run_marker(ScmMarker *marker);
+static void push_grey(ScmMarker *marker, ScmObj obj);
+static ScmObj pop_grey(ScmMarker *marker);
+static void share_grey(ScmMarker *marker);
+static ScmObj steal_grey(ScmMarker *thief);
+static scm_bool grey_leftp(void);
+static void gc_mark_in_parallel(ScmObj *start, size_t n, scm_bool is_certain);
+#endif
 
 static void gc_mark_protected_var();
 static void gc_mark_locations_n(ScmObj *start, size_t n);
@@ -153,6 +401,9 @@ static void gc_mark_global_vars(void);
 /* GC Sweep Related Functions */
 static void free_cell(ScmCell *cell);
 static size_t gc_sweep(void);
+#if SCM_USE_LAZY_SWEEP
+static void gc_sweep_lazily(size_t n);
+#endif
 
 static void finalize_protected_var(void);
 
@@ -192,12 +443,18 @@ scm_init_gc(const ScmStorageConf *conf)
                                  (GCROOTS_mark_proc)gc_mark_locations,
                                  scm_false);
 
+#if SCM_USE_PARALLEL_MARK
+    initialize_markers(conf);
+#endif
     initialize_heap(conf);
 }
 
 SCM_EXPORT void
 scm_fin_gc(void)
 {
+#if SCM_USE_PARALLEL_MARK
+    finalize_markers();
+#endif
     finalize_heap();
     finalize_protected_var();
 
@@ -218,12 +475,40 @@ scm_alloc_cell(void)
     l_allocating = scm_true;
 #endif
 
+#if SCM_USE_LAZY_SWEEP
+    while (NULLP(l_freelist) && l_sweep_cell)
+        gc_sweep_lazily(LAZY_SWEEP_UNIT);
+#endif
     if (NULLP(l_freelist))
         gc_mark_and_sweep();
+#if SCM_USE_INCREMENTAL_GC
+    else if (l_marking && !--l_n_allocs_to_step)
+        gc_mark_step();
+#if SCM_USE_LAZY_SWEEP
+    /* the marks of the last cycle are swept in steps before the next one */
+    else if (!l_marking && l_n_free <= l_marking_trigger && l_sweep_cell)
+        gc_sweep_lazily(l_step_budget);
+#endif
+    else if (!l_marking && l_n_free <= l_marking_trigger)
+        gc_start_marking();
+#endif
     SCM_ASSERT(SCM_FREECELLP(l_freelist));
 
     ret = l_freelist;
     l_freelist = SCM_FREECELL_NEXT(l_freelist);
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_LAZY_SWEEP)
+    l_n_free--;
+#endif
+#if SCM_USE_INCREMENTAL_GC
+    /* grey to be traced after initialized */
+    if (l_marking) {
+        SCM_MARK(ret);
+        remember(ret);
+#if SCM_USE_LAZY_SWEEP
+        l_n_marked++;
+#endif
+    }
+#endif
 
 #if SCM_DEBUG
     l_allocating = scm_false;
@@ -354,12 +639,27 @@ scm_gc_protectedp(ScmObj obj)
     }
 
     /* referred from on-heap objects */
+#if SCM_USE_GENERATIONAL_GC
+    /* the old objects must be traced too */
+    gc_clear_marks();
+#elif SCM_USE_INCREMENTAL_GC
+    /* start from the unmarked heaps */
+    if (l_marking)
+        gc_mark_and_sweep();
+#endif
+#if SCM_USE_LAZY_SWEEP
+    /* the marks left would hide dead objects */
+    gc_sweep_lazily((size_t)-1);
+#endif
     if (scm_gc_protected_contextp()) {
         /* mark registers, stack and global vars */
         gc_mark();
     } else {
         /* doesn't mark registers and stack */
         gc_mark_global_vars();
+#if SCM_USE_INCREMENTAL_GC
+        gc_trace_grey((size_t)-1);
+#endif
     }
     gc_sweep();
 
@@ -373,8 +673,37 @@ scm_gc_protectedp(ScmObj obj)
 SCM_EXPORT void *
 scm_call_with_gc_ready_stack(ScmGCGateFunc func, void *arg)
 {
+#if SCM_USE_FULL_CONTINUATION
+    void *ret;
+    volatile scm_int_t stack_base;
+
+    if (l_stack_base)
+        return GCROOTS_call_with_gc_ready_stack(l_gcroots_ctx, func, arg);
+
+    /* The outermost call marks the bottom of the stack that continuations
+     * copy. Each call is numbered to distinguish it from another one which
+     * happens to have the same stack address. */
+    stack_base = ++l_stack_serial;
+    l_stack_base = (scm_int_t *)&stack_base;
+    ret = GCROOTS_call_with_gc_ready_stack(l_gcroots_ctx, func, arg);
+    l_stack_base = NULL;
+
+    return ret;
+#else
     return GCROOTS_call_with_gc_ready_stack(l_gcroots_ctx, func, arg);
+#endif
+}
+
+#if SCM_USE_FULL_CONTINUATION
+/* Returns the bottom of the stack of the current outermost
+ * scm_call_with_gc_ready_stack(), or NULL. The pointed value is the serial
+ * number of the call. */
+SCM_EXPORT scm_int_t *
+scm_gc_stack_base(void)
+{
+    return l_stack_base;
 }
+#endif
 
 SCM_EXPORT scm_bool
 scm_gc_protected_contextp(void)
@@ -382,6 +711,49 @@ scm_gc_protected_contextp(void)
   return GCROOTS_is_protected_context(l_gcroots_ctx);
 }
 
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+/*===========================================================================
+  Remembered Set
+===========================================================================*/
+/* Called by the write barrier for an old object that is not remembered
+ * yet. */
+SCM_EXPORT void
+scm_gc_remember(ScmObj obj)
+{
+#if (SCM_USE_INCREMENTAL_GC && SCM_USE_LAZY_SWEEP)
+    /* the marks out of a marking cycle are left for the lazy sweep */
+    if (!l_marking)
+        return;
+#endif
+    remember(obj);
+}
+
+static void
+remember(ScmObj obj)
+{
+    SCM_ASSERT(SCM_MARKEDP(obj) && !SCM_CELL_REMEMBEREDP(obj));
+
+    if (l_n_remembered == l_remembered_size) {
+        l_remembered_size = (l_remembered_size) ? l_remembered_size * 2
+                                                : REMEMBERED_SET_INIT_SIZE;
+        l_remembered = scm_realloc(l_remembered,
+                                   sizeof(ScmObj) * l_remembered_size);
+    }
+    SCM_CELL_SET_REMEMBERED(obj);
+    l_remembered[l_n_remembered++] = obj;
+}
+
+SCM_EXPORT void
+scm_gc_remember_ref(ScmRef ref)
+{
+    ScmObj obj;
+
+    obj = (ScmObj)SCM_ISAL_REF_CELL(ref);
+    if (within_heapp(obj))
+        scm_gc_remember(obj);
+}
+#endif /* (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC) */
+
 /*===========================================================================
   Heap Allocator & Garbage Collector
 ===========================================================================*/
@@ -395,7 +767,36 @@ initialize_heap(const ScmStorageConf *conf)
     l_heaps = NULL;
     l_heaps_lowest = (void *)UINTPTR_MAX;
     l_heaps_highest = NULL;
+#if SCM_USE_MARK_BITMAP
+    l_heap_mask = sizeof(ScmCell);
+    while (l_heap_mask < sizeof(ScmCell) * l_heap_size)
+        l_heap_mask *= 2;
+    l_heap_mask--;
+#endif
     l_freelist = SCM_NULL;
+#if SCM_USE_GENERATIONAL_GC
+    l_tenured_heaps = NULL;
+#endif
+#if SCM_USE_INCREMENTAL_GC
+    l_marking = scm_false;
+    l_step_budget = conf->gc_step_budget;
+    l_marking_trigger = 0;
+#endif
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_LAZY_SWEEP)
+    l_n_free = 0;
+#endif
+#if SCM_USE_LAZY_SWEEP
+    l_n_marked = l_sweep_heap = 0;
+    l_sweep_cell = NULL;
+#endif
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+    l_remembered = NULL;
+    l_remembered_size = l_n_remembered = 0;
+
+    /* SCM_ISAL_REF_CELL() relies on it */
+    if (sizeof(ScmCell) & (sizeof(ScmCell) - 1))
+        scm_fatal_error("the size of a cell must be a power of 2");
+#endif
 
     /* Since maximum length of list can be represented by a Scheme integer,
      * SCM_INT_MAX limits the number of cons cells. */
@@ -419,7 +820,19 @@ add_heap(void)
         scm_fatal_error("heap exhausted");
 
     l_heaps = scm_realloc(l_heaps, sizeof(ScmObjHeap) * (l_n_heaps + 1));
+#if SCM_USE_GENERATIONAL_GC
+    l_tenured_heaps = scm_realloc(l_tenured_heaps,
+                                  sizeof(scm_bool) * (l_n_heaps + 1));
+    l_tenured_heaps[l_n_heaps] = scm_false;
+#endif
+#if SCM_USE_MARK_BITMAP
+    if (posix_memalign((void **)&heap, l_heap_mask + 1,
+                       sizeof(ScmCell) * l_heap_size + MARK_BITMAP_SIZE))
+        scm_fatal_error("memory exhausted");
+    memset(HEAP_BITMAP(heap), 0, MARK_BITMAP_SIZE);
+#else
     heap = scm_malloc_aligned(sizeof(ScmCell) * l_heap_size);
+#endif
     l_heaps[l_n_heaps++] = heap;
 
     /* update the enclosure */
@@ -433,6 +846,9 @@ add_heap(void)
     for (cell = &heap[l_heap_size - 1]; cell >= &heap[0]; cell--)
         next = SCM_CELL_RECLAIM_CELL(cell, next);
     l_freelist = next;
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_LAZY_SWEEP)
+    l_n_free += l_heap_size;
+#endif
 
     SCM_END_GC_SUBCONTEXT();
 }
@@ -451,6 +867,12 @@ finalize_heap(void)
         free(heap);
     }
     free(l_heaps);
+#if SCM_USE_GENERATIONAL_GC
+    free(l_tenured_heaps);
+#endif
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+    free(l_remembered);
+#endif
 }
 
 static void
@@ -462,19 +884,649 @@ gc_mark_and_sweep(void)
 
     CDBG((SCM_DBG_GC, "[ gc start ]"));
 
+#if SCM_USE_GENERATIONAL_GC
+    gc_mark_remembered();
+    gc_mark();
+    n_collected = gc_sweep();
+
+    if (n_collected < l_heap_alloc_threshold) {
+        CDBG((SCM_DBG_GC, "minor collection is not enough. collecting all generations."));
+        gc_clear_marks();
+        gc_mark();
+        n_collected += gc_sweep();
+    }
+#elif SCM_USE_LAZY_SWEEP
+#if SCM_USE_INCREMENTAL_GC
+    if (!l_marking)
+#endif
+        l_n_marked = 0;
+    gc_mark();
+    n_collected = gc_start_sweep();
+#else
     gc_mark();
     n_collected = gc_sweep();
+#endif
+    gc_adjust_heaps(n_collected);
+
+    SCM_END_GC_SUBCONTEXT();
+}
+
+#if SCM_USE_LAZY_SWEEP
+/* Leave all the unmarked cells to scm_alloc_cell() and return the number of
+ * the collected ones. */
+static size_t
+gc_start_sweep(void)
+{
+    size_t n_collected;
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    SCM_ASSERT(!l_sweep_cell);
+
+    /* The free cells are linked again since they may be ahead of the
+     * cursor. */
+    n_collected = l_n_heaps * l_heap_size - l_n_marked - l_n_free;
+    l_n_free += n_collected;
+    l_freelist = SCM_NULL;
+    /* from the last heap to leave the ones added afterwards */
+    l_sweep_heap = l_n_heaps - 1;
+    l_sweep_cell = &l_heaps[l_sweep_heap][0];
+    while (NULLP(l_freelist) && l_sweep_cell)
+        gc_sweep_lazily(LAZY_SWEEP_UNIT);
+
+    SCM_END_GC_SUBCONTEXT();
+
+    return n_collected;
+}
+#endif /* SCM_USE_LAZY_SWEEP */
+
+static void
+gc_adjust_heaps(size_t n_collected)
+{
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+#if SCM_USE_INCREMENTAL_GC
+    l_marking = scm_false;
+#endif
 
     if (n_collected < l_heap_alloc_threshold) {
         CDBG((SCM_DBG_GC, "enough number of free cells cannot be collected. allocating new heap."));
         add_heap();
     }
 
+#if SCM_USE_INCREMENTAL_GC
+    /* Start the next marking early enough to finish it before the free cells
+     * run out. */
+    l_marking_trigger = (l_n_heaps * l_heap_size - l_n_free)
+                        / (INCREMENTAL_MARK_RATE / 2);
+    if (l_n_free <= l_marking_trigger && l_n_heaps < l_n_heaps_max) {
+        CDBG((SCM_DBG_GC, "too few free cells to mark incrementally. allocating new heap."));
+        add_heap();
+    }
+#endif
+
+    SCM_END_GC_SUBCONTEXT();
+}
+
+#if SCM_USE_INCREMENTAL_GC
+static void
+gc_start_marking(void)
+{
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+#if SCM_USE_LAZY_SWEEP
+    l_n_marked = 0;
+#endif
+
+    CDBG((SCM_DBG_GC, "[ incremental marking start ]"));
+
+    l_marking = scm_true;
+    l_n_allocs_to_step = l_step_budget / INCREMENTAL_MARK_RATE + 1;
+
+    /* Only make the roots grey. The stack and the global vars are marked
+     * again at last. */
+    GCROOTS_mark(l_gcroots_ctx);
+    gc_mark_global_vars();
+
+    SCM_END_GC_SUBCONTEXT();
+}
+
+static void
+gc_mark_step(void)
+{
+    size_t n_traced;
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    l_n_allocs_to_step = l_step_budget / INCREMENTAL_MARK_RATE + 1;
+    n_traced = gc_trace_grey(l_step_budget);
+    if (!l_n_remembered) {
+        /* The roots may refer to unmarked objects now. The marking ends only
+         * if no grey object is left within the budget of this step. */
+        GCROOTS_mark(l_gcroots_ctx);
+        gc_mark_global_vars();
+        if (n_traced < l_step_budget)
+            gc_trace_grey(l_step_budget - n_traced);
+        if (!l_n_remembered) {
+            CDBG((SCM_DBG_GC, "[ incremental marking end ]"));
+            gc_adjust_heaps(gc_start_sweep());
+        }
+    }
+
+    SCM_END_GC_SUBCONTEXT();
+}
+#endif /* SCM_USE_INCREMENTAL_GC */
+
+#if SCM_USE_PARALLEL_MARK
+/*===========================================================================
+  Parallel Marking
+===========================================================================*/
+static void
+initialize_markers(const ScmStorageConf *conf)
+{
+    size_t i;
+    long n_cpus;
+
+    l_n_markers = conf->gc_n_markers;
+    if (!l_n_markers) {
+        n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        l_n_markers = (0 < n_cpus) ? (size_t)n_cpus : 1;
+    }
+    l_markers = scm_calloc(l_n_markers, sizeof(ScmMarker));
+    for (i = 0; i < l_n_markers; i++)
+        l_markers[i].deque = scm_malloc(sizeof(ScmObj) * MARK_DEQUE_SIZE);
+    l_markers_pid = 0;
+    l_mark_epoch = 0;
+}
+
+/* Also called in a forked process, in which the helper threads and their
+ * synchronization objects are lost. */
+static void
+start_markers(void)
+{
+    sigset_t set, orig_set;
+    size_t i;
+
+    pthread_mutex_init(&l_marker_mutex, NULL);
+    pthread_cond_init(&l_marker_cond, NULL);
+    pthread_cond_init(&l_marker_done_cond, NULL);
+    l_markers_quit = scm_false;
+    l_markers_pid = getpid();
+
+    /* leave the signals to the mutator thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, &orig_set);
+    for (i = 1; i < l_n_markers; i++) {
+        l_markers[i].epoch = l_mark_epoch;
+        if (pthread_create(&l_markers[i].thread, NULL,
+                           marker_main, &l_markers[i]))
+        {
+            CDBG((SCM_DBG_GC, "cannot start marker thread ~ZU.", i));
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+
+    /* run with the markers started */
+    while (i < l_n_markers) {
+        l_n_markers--;
+        free(l_markers[l_n_markers].deque);
+        free(l_markers[l_n_markers].stack);
+    }
+}
+
+static void
+finalize_markers(void)
+{
+    size_t i;
+
+    if (l_markers_pid == getpid()) {
+        pthread_mutex_lock(&l_marker_mutex);
+        l_markers_quit = scm_true;
+        pthread_cond_broadcast(&l_marker_cond);
+        pthread_mutex_unlock(&l_marker_mutex);
+
+        for (i = 1; i < l_n_markers; i++)
+            pthread_join(l_markers[i].thread, NULL);
+        pthread_cond_destroy(&l_marker_done_cond);
+        pthread_cond_destroy(&l_marker_cond);
+        pthread_mutex_destroy(&l_marker_mutex);
+    }
+
+    for (i = 0; i < l_n_markers; i++) {
+        free(l_markers[i].deque);
+        free(l_markers[i].stack);
+    }
+    free(l_markers);
+}
+
+static void *
+marker_main(void *arg)
+{
+    ScmMarker *marker;
+
+    marker = (ScmMarker *)arg;
+    l_current_marker = marker;
+
+    pthread_mutex_lock(&l_marker_mutex);
+    for (;;) {
+        while (marker->epoch == l_mark_epoch && !l_markers_quit)
+            pthread_cond_wait(&l_marker_cond, &l_marker_mutex);
+        if (l_markers_quit)
+            break;
+        marker->epoch = l_mark_epoch;
+        pthread_mutex_unlock(&l_marker_mutex);
+
+        run_marker(marker);
+
+        pthread_mutex_lock(&l_marker_mutex);
+        if (++l_n_markers_done == l_n_markers - 1)
+            pthread_cond_signal(&l_marker_done_cond);
+    }
+    pthread_mutex_unlock(&l_marker_mutex);
+
+    return NULL;
+}
+
+/* Scan the slice of the root region, and then trace the grey objects until
+ * all the markers are idle. */
+static void
+run_marker(ScmMarker *marker)
+{
+    size_t slice, begin, end;
+    ScmObj obj;
+
+    slice = (l_n_mark_roots + l_n_markers - 1) / l_n_markers;
+    begin = slice * (size_t)(marker - l_markers);
+    end = (begin + slice < l_n_mark_roots) ? begin + slice : l_n_mark_roots;
+    if (begin < end) {
+        if (l_mark_roots_certain)
+            gc_mark_definite_locations_n(&l_mark_roots[begin], end - begin);
+        else
+            gc_mark_locations_n(&l_mark_roots[begin], end - begin);
+    }
+
+    for (;;) {
+        while (VALIDP(obj = pop_grey(marker))) {
+            trace_obj(obj);
+            if (__atomic_load_n(&l_n_idle_markers, __ATOMIC_RELAXED))
+                share_grey(marker);
+        }
+        obj = steal_grey(marker);
+        if (VALIDP(obj)) {
+            trace_obj(obj);
+            continue;
+        }
+
+        /* An idle marker has no grey object, so that no grey object is left
+         * once all the markers are idle. */
+        __atomic_add_fetch(&l_n_idle_markers, 1, __ATOMIC_SEQ_CST);
+        while (!grey_leftp()) {
+            if (__atomic_load_n(&l_n_idle_markers, __ATOMIC_SEQ_CST)
+                == l_n_markers)
+                return;
+            sched_yield();
+        }
+        __atomic_sub_fetch(&l_n_idle_markers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void
+push_grey(ScmMarker *marker, ScmObj obj)
+{
+    if (marker->n_stack == marker->stack_size) {
+        marker->stack_size = (marker->stack_size) ? marker->stack_size * 2
+                                                  : MARK_DEQUE_SIZE;
+        marker->stack = scm_realloc(marker->stack,
+                                    sizeof(ScmObj) * marker->stack_size);
+    }
+    marker->stack[marker->n_stack++] = obj;
+}
+
+/* Only called by the owner of the deque. */
+static ScmObj
+pop_grey(ScmMarker *marker)
+{
+    scm_int_t b, t;
+    ScmObj obj;
+
+    if (marker->n_stack)
+        return marker->stack[--marker->n_stack];
+
+    /* take back the ones not stolen */
+    b = marker->bottom - 1;
+    __atomic_store_n(&marker->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&marker->top, __ATOMIC_RELAXED);
+    if (t < b)
+        return marker->deque[b & (MARK_DEQUE_SIZE - 1)];
+    if (t == b) {
+        /* compete with the thieves for the last one */
+        obj = marker->deque[b & (MARK_DEQUE_SIZE - 1)];
+        if (!__atomic_compare_exchange_n(&marker->top, &t, t + 1,
+                                         scm_false, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED))
+            obj = SCM_INVALID;
+        __atomic_store_n(&marker->bottom, b + 1, __ATOMIC_RELAXED);
+        return obj;
+    }
+    __atomic_store_n(&marker->bottom, t, __ATOMIC_RELAXED);
+
+    return SCM_INVALID;
+}
+
+/* Move a half of the private grey objects to the deque to be stolen, unless
+ * the deque still has some. */
+static void
+share_grey(ScmMarker *marker)
+{
+    scm_int_t b;
+    size_t n;
+
+    b = marker->bottom;
+    if (b != __atomic_load_n(&marker->top, __ATOMIC_ACQUIRE))
+        return;
+
+    n = (marker->n_stack / 2 < MARK_DEQUE_SIZE) ? marker->n_stack / 2
+                                                : MARK_DEQUE_SIZE;
+    for (; n; n--)
+        marker->deque[b++ & (MARK_DEQUE_SIZE - 1)]
+            = marker->stack[--marker->n_stack];
+    __atomic_store_n(&marker->bottom, b, __ATOMIC_RELEASE);
+}
+
+static ScmObj
+steal_grey(ScmMarker *thief)
+{
+    ScmMarker *victim;
+    scm_int_t t, b;
+    size_t i;
+    ScmObj obj;
+
+    for (i = 1; i < l_n_markers; i++) {
+        victim = &l_markers[(size_t)(thief - l_markers + i) % l_n_markers];
+        t = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        b = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+        if (t < b) {
+            obj = victim->deque[t & (MARK_DEQUE_SIZE - 1)];
+            if (__atomic_compare_exchange_n(&victim->top, &t, t + 1,
+                                            scm_false, __ATOMIC_SEQ_CST,
+                                            __ATOMIC_RELAXED))
+                return obj;
+        }
+    }
+
+    return SCM_INVALID;
+}
+
+static scm_bool
+grey_leftp(void)
+{
+    size_t i;
+
+    for (i = 0; i < l_n_markers; i++) {
+        if (__atomic_load_n(&l_markers[i].top, __ATOMIC_ACQUIRE)
+            < __atomic_load_n(&l_markers[i].bottom, __ATOMIC_ACQUIRE))
+            return scm_true;
+    }
+
+    return scm_false;
+}
+
+/* Mark the objects reachable from the root region and from the grey objects
+ * by all the markers. */
+static void
+gc_mark_in_parallel(ScmObj *start, size_t n, scm_bool is_certain)
+{
+#if SCM_USE_LAZY_SWEEP
+    size_t i;
+#endif
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    if (l_markers_pid != getpid())
+        start_markers();
+
+    pthread_mutex_lock(&l_marker_mutex);
+    l_mark_roots = start;
+    l_n_mark_roots = n;
+    l_mark_roots_certain = is_certain;
+    l_n_idle_markers = 0;
+    l_n_markers_done = 0;
+    l_mark_epoch++;
+    pthread_cond_broadcast(&l_marker_cond);
+    pthread_mutex_unlock(&l_marker_mutex);
+
+    run_marker(&l_markers[0]);
+
+    pthread_mutex_lock(&l_marker_mutex);
+    while (l_n_markers_done < l_n_markers - 1)
+        pthread_cond_wait(&l_marker_done_cond, &l_marker_mutex);
+    pthread_mutex_unlock(&l_marker_mutex);
+
+#if SCM_USE_LAZY_SWEEP
+    for (i = 0; i < l_n_markers; i++) {
+        l_n_marked += l_markers[i].n_marked;
+        l_markers[i].n_marked = 0;
+    }
+#endif
+
     SCM_END_GC_SUBCONTEXT();
 }
+#endif /* SCM_USE_PARALLEL_MARK */
+
 
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_PARALLEL_MARK)
+#if SCM_USE_INCREMENTAL_GC
+/* Make an object grey. It is traced later by gc_trace_grey(). */
+static void
+mark_obj(ScmObj obj)
+{
+    if (SCM_CONSTANTP(obj) || SCM_MARKEDP(obj))
+        return;
+
+    SCM_MARK(obj);
+    remember(obj);
+#if SCM_USE_LAZY_SWEEP
+    l_n_marked++;
+#endif
+}
+#else /* SCM_USE_INCREMENTAL_GC */
+/* Make an object grey on the stack of the calling marker. It is traced later
+ * by run_marker(). */
+static void
+mark_obj(ScmObj obj)
+{
+    ScmMarker *marker;
+
+    if (l_n_markers == 1) {
+        mark_obj_recursively(obj);
+        return;
+    }
 
 #if SCM_USE_STORAGE_COMPACT
+    if (SCM_IMMP(obj) || SCM_MARKEDP(obj) || !MARK_ATOMICALLY(obj))
+        return;
+#else
+    if (SCM_CONSTANTP(obj) || SCM_MARKEDP(obj) || !MARK_ATOMICALLY(obj))
+        return;
+#endif
+
+    /* only the helper threads have it set */
+    marker = l_current_marker;
+    if (!marker)
+        marker = &l_markers[0];
+    push_grey(marker, obj);
+#if SCM_USE_LAZY_SWEEP
+    marker->n_marked++;
+#endif
+}
+#endif /* SCM_USE_INCREMENTAL_GC */
+
+/* Mark the children of a grey object and return the number of traced
+ * cells. */
+#if SCM_USE_STORAGE_COMPACT
+static size_t
+trace_obj(ScmObj obj)
+{
+#if SCM_USE_VECTOR
+    scm_int_t i, len;
+    ScmObj *vec;
+#endif
+
+    switch (SCM_PTAG(obj)) {
+    case SCM_PTAG_CONS:
+        /* CONS accessors bypass tag manipulation by default so we
+         * have to do it specially here. */
+        obj = SCM_DROP_GCBIT(obj);
+        mark_obj(SCM_CONS_CDR(obj));
+        mark_obj(SCM_CONS_CAR(obj));
+        break;
+
+    case SCM_PTAG_CLOSURE:
+        mark_obj(SCM_CLOSURE_EXP(obj));
+        mark_obj(SCM_CLOSURE_ENV(obj));
+        break;
+
+    case SCM_PTAG_MISC:
+        if (SYMBOLP(obj)) {
+            mark_obj(SCM_SYMBOL_VCELL(obj));
+#if SCM_USE_HYGIENIC_MACRO
+        } else if (SCM_WRAPPERP(obj)) { /* Macro-related wrapper. */
+            mark_obj(SCM_WRAPPER_OBJ(obj));
+#endif /* SCM_USE_HYGIENIC_MACRO */
+#if SCM_USE_VECTOR
+        } else if (VECTORP(obj)) {
+            len = SCM_VECTOR_LEN(obj);
+            vec = SCM_VECTOR_VEC(obj);
+            vec = (ScmObj *)SCM_DROP_GCBIT((scm_intobj_t)vec);
+            for (i = 0; i < len; i++) {
+                mark_obj(vec[i]);
+            }
+            return 1 + len;
+#endif /* SCM_USE_VECTOR */
+        } else if (VALUEPACKETP(obj)) {
+            mark_obj(SCM_VALUEPACKET_VALUES(obj));
+#if SCM_USE_FULL_CONTINUATION
+        } else if (CONTINUATIONP(obj) && !ESCAPE_CONTINUATIONP(obj)) {
+            /* the opaque frame is stored with the GC bit */
+            scm_mark_continuation((void *)SCM_DROP_GCBIT(
+                (scm_intobj_t)SCM_CONTINUATION_OPAQUE(obj)));
+#endif
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return 1;
+}
+#else /* SCM_USE_STORAGE_COMPACT */
+static size_t
+trace_obj(ScmObj obj)
+{
+#if SCM_USE_VECTOR
+    scm_int_t i;
+#endif
+
+    switch (SCM_TYPE(obj)) {
+    case ScmCons:
+        /* the car is traced first as the recursive marking does */
+        mark_obj(CDR(obj));
+        mark_obj(CAR(obj));
+        break;
+
+    case ScmSymbol:
+        mark_obj(SCM_SYMBOL_VCELL(obj));
+        break;
+
+    case ScmClosure:
+        mark_obj(SCM_CLOSURE_EXP(obj));
+        mark_obj(SCM_CLOSURE_ENV(obj));
+        break;
+
+#if SCM_USE_HYGIENIC_MACRO
+    case ScmMacro:
+        /* Assumes that ScmPackedEnv is an integer. */
+        mark_obj(SCM_HMACRO_RULES(obj));
+        break;
+
+    case ScmFarsymbol:
+        /* Assumes that ScmPackedEnv is an integer. */
+        mark_obj(SCM_FARSYMBOL_SYM(obj));
+        break;
+
+    case ScmSubpat:
+        mark_obj(SCM_SUBPAT_OBJ(obj));
+        break;
+#endif /* SCM_USE_HYGIENIC_MACRO */
+
+    case ScmValuePacket:
+#if SCM_USE_VALUECONS
+        mark_obj(SCM_VALUECONS_CAR(obj));
+        mark_obj(SCM_VALUECONS_CDR(obj));
+#else
+        mark_obj(SCM_VALUEPACKET_VALUES(obj));
+#endif
+        break;
+
+#if SCM_USE_VECTOR
+    case ScmVector:
+        for (i = 0; i < SCM_VECTOR_LEN(obj); i++) {
+            mark_obj(SCM_VECTOR_VEC(obj)[i]);
+        }
+        return 1 + SCM_VECTOR_LEN(obj);
+#endif
+
+#if SCM_USE_FULL_CONTINUATION
+    case ScmContinuation:
+        if (!ESCAPE_CONTINUATIONP(obj))
+            scm_mark_continuation(SCM_CONTINUATION_OPAQUE(obj));
+        break;
+#endif
+
+    default:
+        break;
+    }
+
+    return 1;
+}
+#endif /* SCM_USE_STORAGE_COMPACT */
+
+#if SCM_USE_INCREMENTAL_GC
+/* Trace the grey objects until the budget runs out. Returns the number of the
+ * traced cells. */
+static size_t
+gc_trace_grey(size_t budget)
+{
+    size_t n_traced;
+    ScmObj obj;
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    for (n_traced = 0; l_n_remembered && n_traced < budget;) {
+        obj = l_remembered[--l_n_remembered];
+        SCM_CELL_CLEAR_REMEMBERED(obj);
+        n_traced += trace_obj(obj);
+    }
+    CDBG((SCM_DBG_GC, "traced = ~ZU, grey = ~ZU", n_traced, l_n_remembered));
+
+    SCM_END_GC_SUBCONTEXT();
+
+    return n_traced;
+}
+#endif /* SCM_USE_INCREMENTAL_GC */
+#endif /* (SCM_USE_INCREMENTAL_GC || SCM_USE_PARALLEL_MARK) */
+
+#if SCM_USE_INCREMENTAL_GC
+/* the objects are made grey by mark_obj() above */
+#elif SCM_USE_STORAGE_COMPACT
+#if SCM_USE_PARALLEL_MARK
+/* A lone marker needs neither the grey stacks nor the atomic marking. */
+#define mark_obj mark_obj_recursively
+#endif
 static void
 mark_obj(ScmObj obj)
 {
@@ -494,6 +1546,9 @@ mark_loop:
 
     /* mark this object */
     SCM_MARK(obj);
+#if SCM_USE_LAZY_SWEEP
+    l_n_marked++;
+#endif
 
     /* mark recursively */
     switch (SCM_PTAG(obj)) {
@@ -534,6 +1589,12 @@ mark_loop:
         } else if (VALUEPACKETP(obj)) {
             obj = SCM_VALUEPACKET_VALUES(obj);
             goto mark_loop;
+#if SCM_USE_FULL_CONTINUATION
+        } else if (CONTINUATIONP(obj) && !ESCAPE_CONTINUATIONP(obj)) {
+            /* the opaque frame is stored with the GC bit */
+            scm_mark_continuation((void *)SCM_DROP_GCBIT(
+                (scm_intobj_t)SCM_CONTINUATION_OPAQUE(obj)));
+#endif
         }
         break;
 
@@ -541,7 +1602,14 @@ mark_loop:
         break;
     }
 }
+#if SCM_USE_PARALLEL_MARK
+#undef mark_obj
+#endif
 #elif SCM_USE_STORAGE_FATTY
+#if SCM_USE_PARALLEL_MARK
+/* A lone marker needs neither the grey stacks nor the atomic marking. */
+#define mark_obj mark_obj_recursively
+#endif
 static void
 mark_obj(ScmObj obj)
 {
@@ -560,6 +1628,9 @@ mark_loop:
 
     /* mark this object */
     SCM_MARK(obj);
+#if SCM_USE_LAZY_SWEEP
+    l_n_marked++;
+#endif
 
     /* mark recursively */
     switch (SCM_TYPE(obj)) {
@@ -610,10 +1681,20 @@ mark_loop:
         break;
 #endif
 
+#if SCM_USE_FULL_CONTINUATION
+    case ScmContinuation:
+        if (!ESCAPE_CONTINUATIONP(obj))
+            scm_mark_continuation(SCM_CONTINUATION_OPAQUE(obj));
+        break;
+#endif
+
     default:
         break;
     }
 }
+#if SCM_USE_PARALLEL_MARK
+#undef mark_obj
+#endif
 #else
 #error "mark_obj() is not implemented for this storage"
 #endif
@@ -678,7 +1759,11 @@ gc_mark_protected_var(void)
              slot++)
         {
             if (*slot)
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+                mark_old_obj(**slot);
+#else
                 mark_obj(**slot);
+#endif
         }
     }
 
@@ -696,13 +1781,34 @@ gc_mark_locations_n(ScmObj *start, size_t n)
     SCM_ASSERT(SCMOBJ_ALIGNEDP(start));
 
     for (objp = start; objp < &start[n]; objp++) {
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC                \
+     || SCM_USE_LAZY_SWEEP)
+        /* A marked freecell would be allocated as a marked object. */
+        if (within_heapp(*objp) && !SCM_FREECELLP(*objp))
+#else
         if (within_heapp(*objp))
+#endif
             mark_obj(*objp);
     }
 
     SCM_END_GC_SUBCONTEXT();
 }
 
+#if SCM_USE_FULL_CONTINUATION
+/* For the objects held by continuations. Only valid while marking. */
+SCM_EXPORT void
+scm_gc_mark(ScmObj obj)
+{
+    mark_obj(obj);
+}
+
+SCM_EXPORT void
+scm_gc_mark_locations(ScmObj *start, size_t n)
+{
+    gc_mark_locations_n(start, n);
+}
+#endif
+
 static void
 gc_mark_definite_locations_n(ScmObj *start, size_t n)
 {
@@ -750,6 +1856,11 @@ gc_mark_locations(ScmObj *start, ScmObj *end, int is_certain, int is_aligned)
         CDBG((SCM_DBG_GC, "gc_mark_locations: start = ~P, end = ~P, len = ~TD, offset = ~U",
               adjusted_start, end, len, offset));
 
+#if SCM_USE_PARALLEL_MARK
+        if (l_n_markers != 1)
+            gc_mark_in_parallel(adjusted_start, len, is_certain);
+        else
+#endif
         if (is_certain)
             gc_mark_definite_locations_n(adjusted_start, len);
         else
@@ -772,10 +1883,79 @@ gc_mark(void)
     GCROOTS_mark(l_gcroots_ctx);
 
     gc_mark_global_vars();
+#if SCM_USE_INCREMENTAL_GC
+    gc_trace_grey((size_t)-1);
+#endif
+
+    SCM_END_GC_SUBCONTEXT();
+}
+
+#if (SCM_USE_GENERATIONAL_GC || SCM_USE_INCREMENTAL_GC)
+/* Trace the children of a marked object again. */
+static void
+mark_old_obj(ScmObj obj)
+{
+#if SCM_USE_INCREMENTAL_GC
+    /* A black one is scanned at once like the roots, so that a step is not
+     * spent on the objects marked already. */
+    if (!SCM_CONSTANTP(obj) && SCM_MARKEDP(obj)
+        && !SCM_CELL_REMEMBEREDP(obj))
+    {
+        trace_obj(obj);
+        return;
+    }
+#else
+    if (!SCM_CONSTANTP(obj) && SCM_MARKEDP(obj))
+        SCM_CELL_UNMARK(obj);
+#endif
+    mark_obj(obj);
+}
+#endif
+
+#if SCM_USE_GENERATIONAL_GC
+
+static void
+gc_mark_remembered(void)
+{
+    size_t i;
+    ScmObj obj;
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    for (i = 0; i < l_n_remembered; i++) {
+        obj = l_remembered[i];
+        SCM_CELL_CLEAR_REMEMBERED(obj);
+        mark_old_obj(obj);
+    }
+    l_n_remembered = 0;
 
     SCM_END_GC_SUBCONTEXT();
 }
 
+/* Make all objects young to collect the old generation too. */
+static void
+gc_clear_marks(void)
+{
+    size_t i;
+    ScmObjHeap heap;
+    ScmCell *cell;
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    for (i = 0; i < l_n_heaps; i++) {
+        heap = l_heaps[i];
+        for (cell = &heap[0]; cell < &heap[l_heap_size]; cell++) {
+            SCM_CELL_UNMARK(cell);
+            SCM_CELL_CLEAR_REMEMBERED(cell);
+        }
+        l_tenured_heaps[i] = scm_false;
+    }
+    l_n_remembered = 0;
+
+    SCM_END_GC_SUBCONTEXT();
+}
+#endif /* SCM_USE_GENERATIONAL_GC */
+
 static void
 gc_mark_global_vars(void)
 {
@@ -784,6 +1964,11 @@ gc_mark_global_vars(void)
     gc_mark_protected_var();
     if (scm_symbol_hash)
         gc_mark_definite_locations_n(scm_symbol_hash, scm_symbol_hash_size);
+#if SCM_USE_PARALLEL_MARK
+    /* trace the grey objects left on the deque of the mutator thread */
+    if (l_n_markers != 1)
+        gc_mark_in_parallel(NULL, 0, scm_true);
+#endif
 
     SCM_END_GC_SUBCONTEXT();
 }
@@ -888,6 +2073,9 @@ static size_t
 gc_sweep(void)
 {
     size_t i, sum_collected, n_collected;
+#if SCM_USE_GENERATIONAL_GC
+    size_t n_live;
+#endif
     ScmObjHeap heap;
     ScmCell *cell;
     ScmObj new_freelist;
@@ -902,10 +2090,29 @@ gc_sweep(void)
     for (i = 0; i < l_n_heaps; i++) {
         n_collected = 0;
         heap = l_heaps[i];
+#if SCM_USE_GENERATIONAL_GC
+        if (l_tenured_heaps[i])
+            continue;
+        n_live = 0;
+#endif
 
         for (cell = &heap[0]; cell < &heap[l_heap_size]; cell++) {
+#if SCM_USE_MARK_BITMAP
+            if (!(CELL_INDEX(cell) % MARK_WORD_BITS)
+                && !~CELL_MARK_WORD(cell))
+            {
+                /* all of the cells covered by the word are live */
+                CELL_MARK_WORD(cell) = 0;
+                cell += MARK_WORD_BITS - 1;
+                continue;
+            }
+#endif
             if (SCM_CELL_MARKEDP(cell)) {
+#if SCM_USE_GENERATIONAL_GC
+                n_live++;
+#else
                 SCM_CELL_UNMARK(cell);
+#endif
             } else if (!SCM_CELL_FREECELLP(cell)) {
                 /* scm_gc_protectedp() causes GC sweep on heaps that contain
                  * freecells. So !SCM_CELL_FREECELLP(cell) is required. */
@@ -915,12 +2122,57 @@ gc_sweep(void)
             }
         }
 
+#if SCM_USE_GENERATIONAL_GC
+        l_tenured_heaps[i] = (n_live == l_heap_size);
+#endif
         sum_collected += n_collected;
         CDBG((SCM_DBG_GC, "heap[~ZU] swept = ~ZU", i, n_collected));
     }
     l_freelist = new_freelist;
+#if (SCM_USE_INCREMENTAL_GC || SCM_USE_LAZY_SWEEP)
+    l_n_free += sum_collected;
+#endif
 
     SCM_END_GC_SUBCONTEXT();
 
     return sum_collected;
 }
+
+#if SCM_USE_LAZY_SWEEP
+/* Sweep at most n cells from the sweep cursor. */
+static void
+gc_sweep_lazily(size_t n)
+{
+    ScmCell *cell;
+
+    SCM_BEGIN_GC_SUBCONTEXT();
+
+    while (n && l_sweep_cell) {
+        cell = l_sweep_cell;
+#if SCM_USE_MARK_BITMAP
+        if (!(CELL_INDEX(cell) % MARK_WORD_BITS) && !~CELL_MARK_WORD(cell)
+            && MARK_WORD_BITS <= n)
+        {
+            /* all of the cells covered by the word are live */
+            CELL_MARK_WORD(cell) = 0;
+            l_sweep_cell += MARK_WORD_BITS;
+            n -= MARK_WORD_BITS;
+        } else
+#endif
+        {
+            l_sweep_cell++;
+            n--;
+            if (SCM_CELL_MARKEDP(cell)) {
+                SCM_CELL_UNMARK(cell);
+            } else {
+                free_cell(cell);
+                l_freelist = SCM_CELL_RECLAIM_CELL(cell, l_freelist);
+            }
+        }
+        if (l_sweep_cell == &l_heaps[l_sweep_heap][l_heap_size])
+            l_sweep_cell = (l_sweep_heap) ? &l_heaps[--l_sweep_heap][0] : NULL;
+    }
+
+    SCM_END_GC_SUBCONTEXT();
+}
+#endif /* SCM_USE_LAZY_SWEEP */
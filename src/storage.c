@@ -224,7 +224,9 @@ static const ScmStorageConf default_storage_conf = {
     SCM_DEFAULT_HEAP_ALLOC_THRESHOLD,
     SCM_DEFAULT_N_HEAPS_MAX,
     SCM_DEFAULT_N_HEAPS_INIT,
-    SCM_DEFAULT_SYMBOL_HASH_SIZE
+    SCM_DEFAULT_SYMBOL_HASH_SIZE,
+    SCM_DEFAULT_GC_STEP_BUDGET,
+    SCM_DEFAULT_GC_N_MARKERS
 };
 
 /*=======================================
@@ -66,6 +66,27 @@
 #define FORBID_TOPLEVEL_DEFINITIONS(env) (env)
 #endif
 
+#if SCM_USE_INTERNAL_DEFINITIONS
+/* The internal definitions of a body are scanned once and cached as
+ * (<body> <rest of the body> <number of definitions> <formals> . <exps>),
+ * where <formals> is in the reversed order. The entry holds <body> and so
+ * the address is not reused by another body while it is cached. */
+#define BODY_CACHE_SIZE 256
+#define BODY_CACHE_INDEX(body)                                               \
+    ((scm_int_t)(((scm_uintobj_t)(body) >> 4) & (BODY_CACHE_SIZE - 1)))
+
+#define BODY_ENTRY_BODY(entry)    (CAR(entry))
+#define BODY_ENTRY_REST(entry)    (CADR(entry))
+#define BODY_ENTRY_NDEFS(entry)   (SCM_INT_VALUE(CAR(CDDR(entry))))
+#define BODY_ENTRY_FORMALS(entry) (CADR(CDDR(entry)))
+#define BODY_ENTRY_EXPS(entry)    (CDDR(CDDR(entry)))
+
+/* Test whether the first expression of a body may be a definition. */
+#define DEFINITION_LEADP(body)                                               \
+    (CONSP(body) && CONSP(CAR(body))                                         \
+     && (EQ(CAAR(body), l_sym_define) || EQ(CAAR(body), l_sym_begin)))
+#endif /* SCM_USE_INTERNAL_DEFINITIONS */
+
 #if SCM_USE_HYGIENIC_MACRO
 #define CHECK_VALID_BINDEE(permitted_type, bindee)                           \
     do {                                                                     \
@@ -102,6 +123,7 @@ SCM_GLOBAL_VARS_BEGIN(static_syntax);
 static ScmObj l_sym_else, l_sym_yields, l_sym_define;
 #if SCM_USE_INTERNAL_DEFINITIONS
 static ScmObj l_sym_begin, l_syn_lambda;
+static ScmObj l_body_cache;
 #endif /* SCM_USE_INTERNAL_DEFINITIONS */
 #undef static
 SCM_GLOBAL_VARS_END(static_syntax);
@@ -110,6 +132,7 @@ SCM_GLOBAL_VARS_END(static_syntax);
 #define l_sym_define SCM_GLOBAL_VAR(static_syntax, l_sym_define)
 #define l_sym_begin  SCM_GLOBAL_VAR(static_syntax, l_sym_begin)
 #define l_syn_lambda SCM_GLOBAL_VAR(static_syntax, l_syn_lambda)
+#define l_body_cache SCM_GLOBAL_VAR(static_syntax, l_body_cache)
 SCM_DEFINE_STATIC_VARS(static_syntax);
 
 /*=======================================
@@ -118,6 +141,7 @@ SCM_DEFINE_STATIC_VARS(static_syntax);
 #if SCM_USE_INTERNAL_DEFINITIONS
 static ScmObj filter_definitions(ScmObj body, ScmObj *formals, ScmObj *actuals,
                                  ScmQueue *def_expq);
+static ScmObj scan_body(ScmObj body);
 #endif
 
 /*=======================================
@@ -145,6 +169,9 @@ scm_init_syntax(void)
     scm_gc_protect_with_init(&l_syn_lambda,
                              scm_symbol_value(scm_intern("lambda"),
                                               SCM_INTERACTION_ENV));
+    scm_gc_protect_with_init(&l_body_cache,
+                             scm_p_make_vector(MAKE_INT(BODY_CACHE_SIZE),
+                                               LIST_1(SCM_FALSE)));
 #endif
 }
 
@@ -501,8 +528,15 @@ scm_s_let_internal(enum ScmObjType permitted, ScmObj bindings, ScmObj body,
                    ScmEvalState *eval_state)
 {
     ScmObj env, named_let_sym, proc, binding;
-    ScmObj formals, var, actuals, val, exp;
+    ScmObj formals, var, val;
+#if SCM_USE_VECTOR_FRAME
+    ScmObj frame, rest;
+    scm_int_t len, i;
+    ScmQueue varq;
+#else
+    ScmObj actuals, exp;
     ScmQueue varq, valq;
+#endif
     DECLARE_INTERNAL_FUNCTION("let" /* , syntax_variadic_tailrec_1 */);
 
     env = eval_state->env;
@@ -535,6 +569,48 @@ scm_s_let_internal(enum ScmObjType permitted, ScmObj bindings, ScmObj body,
         bindings = POP(body);
     }
 
+#if SCM_USE_VECTOR_FRAME
+    /* The values are evaluated directly into a vector frame without making
+     * the list of actuals. Since the frame must be sized before that, the
+     * bindings are validated in advance. */
+    rest = bindings;
+    formals = SCM_NULL;
+    SCM_QUEUE_POINT_TO(varq, formals);
+    len = 0;
+    FOR_EACH (binding, rest) {
+#if SCM_COMPAT_SIOD_BUGS
+        if (LIST_1_P(binding) && IDENTIFIERP(var = CAR(binding))) {
+            /* bound to #f */
+        } else
+#endif
+        if (!LIST_2_P(binding) || !IDENTIFIERP(var = CAR(binding)))
+            ERR_OBJ(ERRMSG_INVALID_BINDING, binding);
+#if SCM_STRICT_ARGCHECK
+        if (TRUEP(scm_p_memq(var, formals)))
+            ERR_OBJ(ERRMSG_DUPLICATE_VARNAME, var);
+#endif
+        SCM_QUEUE_ADD(varq, var);
+        len++;
+    }
+    if (!NULLP(rest))
+        ERR_OBJ(ERRMSG_INVALID_BINDINGS, rest);
+
+    frame = scm_make_vector_frame(formals, len);
+    for (i = 0; i < len; i++) {
+        binding = POP(bindings);
+#if SCM_COMPAT_SIOD_BUGS
+        if (NULLP(CDR(binding))) {
+            VECTOR_FRAME_VALUES(frame)[i] = SCM_FALSE;
+            continue;
+        }
+#endif
+        val = EVAL(CADR(binding), env);
+        CHECK_VALID_BINDEE(permitted, val);
+        VECTOR_FRAME_VALUES(frame)[i] = val;
+    }
+
+    env = scm_extend_environment_by_frame(frame, env);
+#else /* SCM_USE_VECTOR_FRAME */
     formals = actuals = SCM_NULL;
     SCM_QUEUE_POINT_TO(varq, formals);
     SCM_QUEUE_POINT_TO(valq, actuals);
@@ -565,6 +641,7 @@ scm_s_let_internal(enum ScmObjType permitted, ScmObj bindings, ScmObj body,
         ERR_OBJ(ERRMSG_INVALID_BINDINGS, bindings);
 
     env = scm_extend_environment(formals, actuals, env);
+#endif /* SCM_USE_VECTOR_FRAME */
 
     /* named let */
     if (IDENTIFIERP(named_let_sym)) {
@@ -762,6 +839,31 @@ filter_definitions(ScmObj body, ScmObj *formals, ScmObj *actuals,
     return body;
 }
 
+/* Return the cache entry of the internal definitions of BODY. Since the scan
+ * depends only on the form of BODY, it is performed once per body rather
+ * than on every evaluation of the body. */
+static ScmObj
+scan_body(ScmObj body)
+{
+    ScmQueue def_expq;
+    ScmObj entry, formals, actuals, def_exps, rest;
+    scm_int_t i;
+
+    i = BODY_CACHE_INDEX(body);
+    entry = SCM_VECTOR_VEC(l_body_cache)[i];
+    if (CONSP(entry) && EQ(BODY_ENTRY_BODY(entry), body))
+        return entry;
+
+    def_exps = formals = actuals = SCM_NULL;
+    SCM_QUEUE_POINT_TO(def_expq, def_exps);
+    rest = filter_definitions(body, &formals, &actuals, &def_expq);
+
+    entry = CONS(body, CONS(rest, CONS(MAKE_INT(scm_finite_length(formals)),
+                                       CONS(formals, def_exps))));
+    SCM_VECTOR_VEC(l_body_cache)[i] = entry;
+    return entry;
+}
+
 /* <body> part of let, let*, letrec and lambda. This function performs strict
  * form validation for internal definitions as specified in R5RS ("5.2.2
  * Internal definitions" and "7.1.6 Programs and definitions"). */
@@ -770,19 +872,31 @@ filter_definitions(ScmObj body, ScmObj *formals, ScmObj *actuals,
 SCM_EXPORT ScmObj
 scm_s_body(ScmObj body, ScmEvalState *eval_state)
 {
-    ScmQueue def_expq;
-    ScmObj env, formals, actuals, def_exps, exp, val;
+    ScmObj entry, env, formals, actuals, def_exps, exp, val;
+#if !SCM_USE_VECTOR_FRAME
+    scm_int_t i;
+#endif
     DECLARE_INTERNAL_FUNCTION("(body)" /* , syntax_variadic_tailrec_0 */);
 
-    if (CONSP(body)) {
+    if (DEFINITION_LEADP(body)) {
         /* collect internal definitions */
-        def_exps = formals = actuals = SCM_NULL;
-        SCM_QUEUE_POINT_TO(def_expq, def_exps);
-        body = filter_definitions(body, &formals, &actuals, &def_expq);
+        entry = scan_body(body);
+        body = BODY_ENTRY_REST(entry);
+        def_exps = BODY_ENTRY_EXPS(entry);
 
         if (!NULLP(def_exps)) {
             /* extend env with the unbound variables */
+            formals = BODY_ENTRY_FORMALS(entry);
+#if SCM_USE_VECTOR_FRAME
+            env = scm_extend_environment_by_frame(
+                scm_make_vector_frame(formals, BODY_ENTRY_NDEFS(entry)),
+                eval_state->env);
+#else
+            actuals = SCM_NULL;
+            for (i = BODY_ENTRY_NDEFS(entry); i; i--)
+                actuals = CONS(SCM_UNBOUND, actuals);
             env = scm_extend_environment(formals, actuals, eval_state->env);
+#endif
 
             /* eval the definitions and fill the variables with the results as
              * if letrec */
@@ -73,7 +73,7 @@ scm_p_vectorp(ScmObj obj)
 SCM_EXPORT ScmObj
 scm_p_make_vector(ScmObj scm_len, ScmObj args)
 {
-    ScmObj *vec, filler;
+    ScmObj *vec, filler, ret;
     scm_int_t len, i;
     DECLARE_FUNCTION("make-vector", procedure_variadic_1);
 
@@ -83,17 +83,20 @@ scm_p_make_vector(ScmObj scm_len, ScmObj args)
     if (len < 0)
         ERR_OBJ("length must be a non-negative integer", scm_len);
 
-    vec = scm_malloc(sizeof(ScmObj) * len);
     if (NULLP(args)) {
         filler = SCM_UNDEF;
     } else {
         filler = POP(args);
         ASSERT_NO_MORE_ARG(args);
     }
+    /* fill after the allocation of the vector, which may trigger GC. vec is
+     * not scanned until then. */
+    vec = scm_malloc(sizeof(ScmObj) * len);
+    ret = MAKE_VECTOR(vec, len);
     for (i = 0; i < len; i++)
         vec[i] = filler;
 
-    return MAKE_VECTOR(vec, len);
+    return ret;
 }
 
 SCM_EXPORT ScmObj
@@ -148,6 +151,7 @@ scm_p_vector_setx(ScmObj vec, ScmObj _k, ScmObj obj)
     if (!SCM_VECTOR_VALID_INDEXP(vec, k))
         ERR_OBJ("index out of range", _k);
 
+    SCM_WRITE_BARRIER(vec);
     SCM_VECTOR_VEC(vec)[k] = obj;
 
     return SCM_UNDEF;
@@ -177,7 +181,7 @@ scm_p_vector2list(ScmObj vec)
 SCM_EXPORT ScmObj
 scm_p_list2vector(ScmObj lst)
 {
-    ScmObj *vec;
+    ScmObj *vec, ret;
     scm_int_t len, i;
     DECLARE_FUNCTION("list->vector", procedure_fixed_1);
 
@@ -185,11 +189,14 @@ scm_p_list2vector(ScmObj lst)
     if (!SCM_LISTLEN_PROPERP(len))
         ERR_OBJ("proper list required but got", lst);
 
+    /* the elements must be kept reachable from lst until the vector is
+     * allocated */
     vec = scm_malloc(sizeof(ScmObj) * len);
+    ret = MAKE_VECTOR(vec, len);
     for (i = 0; i < len; i++)
         vec[i] = POP(lst);
 
-    return MAKE_VECTOR(vec, len);
+    return ret;
 }
 
 SCM_EXPORT ScmObj
@@ -204,6 +211,7 @@ scm_p_vector_fillx(ScmObj vec, ScmObj fill)
     ENSURE_MUTABLE_VECTOR(vec);
 #endif
 
+    SCM_WRITE_BARRIER(vec);
     v   = SCM_VECTOR_VEC(vec);
     len = SCM_VECTOR_LEN(vec);
     for (i = 0; i < len; i++)
@@ -0,0 +1,2546 @@
+/*===========================================================================
+ *  Filename : vm.c
+ *  About    : Bytecode compiler and virtual machine
+ *
+ *  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of authors nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ *  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================*/
+
+/*
+ * The VM runs a flat sequence of instructions instead of walking the forms.
+ * Each toplevel expression, as well as the body of each closure on its
+ * first call, is compiled into a vector of words: an opcode fixnum followed
+ * by its operands, which are fixnums, jump targets and arbitrary objects
+ * such as constants and symbols. A closure made by compiled code holds a
+ * code object as its SCM_CLOSURE_EXP() in place of the original
+ * (<formals> . <body>), which is kept for the writer:
+ *
+ *   (<vm code tag>
+ *    . #(<insns> <nargs> <frame formals> <stack framep> (<formals> . <body>)))
+ *
+ * <nargs> is the number of the parameters, or ~n if the formals take the
+ * rest of the arguments after n ones.
+ *
+ * The VM has an accumulator (val), the env and a control stack shared with
+ * nested activations in the same manner as machine.c. The operands of a
+ * call are pushed onto the stack over the operator. A non-tail call of a
+ * closure pushes a frame of the return address:
+ *
+ *   [<insns> <pc> <env> <saved fp> <saved ap>]
+ *
+ * and a tail call reuses the frame of the caller, so that proper tail calls
+ * take no space. The native stack grows only with the nesting of the
+ * syntaxes and C procedures that evaluate Scheme code by scm_eval() or
+ * scm_call(), including call/cc and dynamic-wind. The stack pointer is
+ * published to scm_vm_sp before calling out, and continuations unwind or
+ * restore the stack through it.
+ *
+ * Variables bound by the frames that compiled code creates are referred by
+ * their lexical addresses. The others are looked up by name, or taken from
+ * the symbol directly if the code is compiled in the toplevel env.
+ *
+ * The frame of a call is a heap frame of the env unless the code is a stack
+ * framed one, which makes no closure or frame over its parameters and never
+ * assigns them. The arguments of such a call stay in the control stack above
+ * the frame of the return address, at ap:
+ *
+ *   [<code> <env of the frame or #f> <arg> ... <rest list>]
+ *
+ * and the env register keeps the env of the closure. Only do loops, the forms
+ * left to the interpreter and the procedures taking the eval state need the
+ * frame in the env, which is made on demand and shared with the rest of the
+ * call. The arguments are copied back from it whenever the call is resumed,
+ * since the code evaluated in the env may assign them.
+ *
+ * quote, if, set!, lambda, begin, and, or, cond, case, let, let*, letrec,
+ * do, quasiquote and the internal definitions of bodies are compiled into
+ * instructions. Other syntaxes, macro uses, malformed forms and operators
+ * that turned into syntaxes after the compilation are handed to call() of
+ * eval.c as the unevaluated form at run time, so that macros are expanded
+ * before the expansion is compiled and evaluated in turn. The expansions are
+ * not cached. As in compiler.c, a form whose keyword is bound at the
+ * toplevel is guarded by the identity of the syntax, and reductions such as
+ * + and < evaluate their operands only as far as needed. A call of 2
+ * operands of a toplevel reduction that has the binary entry point is
+ * guarded in the same way, and calls the entry point directly.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "sigscheme.h"
+#include "sigschemeinternal.h"
+
+/*=======================================
+  File Local Macro Definitions
+=======================================*/
+#define ERRMSG_UNMATCHED_ARGS  "unmatched number or improper args"
+#define ERRMSG_BAD_SPLICE_LIST "bad splice list"
+
+#define STACK_INITIAL_LEN 4096
+
+#define STACK (SCM_VECTOR_VEC(l_control_stack))
+
+/* [<insns> <pc> <env> <saved fp> <saved ap>] */
+#define CONT_SLOTS 5
+
+#define ENSURE_STACK(n)                                                      \
+    do {                                                                     \
+        if (sp + (n) > SCM_VECTOR_LEN(l_control_stack))                      \
+            grow_stack(sp + (n));                                            \
+        if (sp + (n) > l_stack_hwm)                                          \
+            l_stack_hwm = sp + (n);                                          \
+    } while (/* CONSTCOND */ 0)
+
+#define PUSH(obj)                                                            \
+    do {                                                                     \
+        ENSURE_STACK(1);                                                     \
+        STACK[sp++] = (obj);                                                 \
+    } while (/* CONSTCOND */ 0)
+
+/* Push a frame to return to RET_PC of the current code. */
+#define PUSH_CONT(ret_pc)                                                    \
+    do {                                                                     \
+        ENSURE_STACK(CONT_SLOTS);                                            \
+        STACK[sp]     = code;                                                \
+        STACK[sp + 1] = MAKE_INT(ret_pc);                                    \
+        STACK[sp + 2] = env;                                                 \
+        STACK[sp + 3] = MAKE_INT(fp);                                        \
+        STACK[sp + 4] = MAKE_INT(ap);                                        \
+        fp = sp;                                                             \
+        sp += CONT_SLOTS;                                                    \
+    } while (/* CONSTCOND */ 0)
+
+/* the env of the current activation including the stack frame if any */
+#define CURRENT_ENV() ((ap >= 0) ? frame_env(ap, env) : env)
+
+/* Copy the arguments back from the frame made by CURRENT_ENV(). */
+#define SYNC_FRAME()                                                         \
+    do {                                                                     \
+        if (ap >= 0 && !FALSEP(STACK[ap + 1]))                               \
+            sync_frame(ap);                                                  \
+    } while (/* CONSTCOND */ 0)
+
+/* Publish the stack pointer before anything that may evaluate Scheme code,
+ * so that nested activations push their frames above. */
+#define CALL_OUT() (scm_vm_sp = sp)
+
+/* an error may run a handler above the stack pointer */
+#if SCM_STRICT_ARGCHECK
+#define CHECK_VALID(obj)                                                     \
+    do {                                                                     \
+        CALL_OUT();                                                          \
+        CHECK_VALID_EVALED_VALUE(obj);                                       \
+    } while (/* CONSTCOND */ 0)
+#else
+#define CHECK_VALID(obj) SCM_EMPTY_EXPR
+#endif
+
+#define OPERAND(i) (insns[pc + (i)])
+#define INT_OPERAND(i) (SCM_INT_VALUE(insns[pc + (i)]))
+
+/* the position of a subexpression: its nest and whether it is a tail */
+#define CTX(nest, tailp) (((int)(nest) << 1) | ((tailp) ? 1 : 0))
+#define CTX_NEST(ctx)    ((enum ScmNestState)((ctx) >> 1))
+#define CTX_TAILP(ctx)   ((ctx) & 1)
+/* The operands and the other subexpressions that are not tails. EVAL in
+ * the interaction env allows them to be toplevel definitions. */
+#define SUB_CTX(scope)                                                       \
+    CTX((NULLP((scope)->frames) && EQ((scope)->env, SCM_INTERACTION_ENV))    \
+        ? SCM_NEST_PROGRAM : SCM_NEST_COMMAND, scm_false)
+/* the subexpressions evaluated in the env forbidding toplevel definitions */
+#define FORBIDDEN_CTX    CTX(SCM_NEST_COMMAND, scm_false)
+/* the tail expressions of a syntax */
+#define INNER_CTX(ctx)   CTX(SCM_NEST_COMMAND, CTX_TAILP(ctx))
+
+#if SCM_STRICT_TOPLEVEL_DEFINITIONS
+#define DEFINABLE_TOPLEVELP(env, nest)                                       \
+    (scm_toplevel_environmentp(env)                                          \
+     && ((nest) == SCM_NEST_PROGRAM                                          \
+         || (nest) == SCM_NEST_COMMAND_OR_DEFINITION))
+#else
+#define DEFINABLE_TOPLEVELP(env, nest) (scm_toplevel_environmentp(env))
+#endif
+
+/* the nest of the tail expression returned with SCM_VALTYPE_NEED_EVAL */
+#define TAIL_NEST(nest)                                                      \
+    (((nest) == SCM_NEST_RETTYPE_BEGIN) ? SCM_NEST_COMMAND_OR_DEFINITION    \
+                                        : SCM_NEST_COMMAND)
+
+#define SYNTAX_CFUNCP(obj, func)                                             \
+    (SCM_FUNC_CFUNC(obj) == (ScmFuncType)(func))
+
+#if SCM_USE_LEGACY_MACRO
+#define PLAIN_CLOSUREP(obj) (CLOSUREP(obj) && !SYNTACTIC_CLOSUREP(obj))
+#else
+#define PLAIN_CLOSUREP(obj) (CLOSUREP(obj))
+#endif
+
+#define REDUCTIONP(obj)                                                      \
+    (FUNCP(obj) && SCM_FUNC_TYPECODE(obj) == SCM_REDUCTION_OPERATOR)
+
+/* the kinds of the elements of a quasiquote template */
+#define QQ_CONSTANT 0
+#define QQ_VALUE    1
+#define QQ_SPLICE   2
+
+#define EMIT_OP(scope, op) (emit((scope), MAKE_INT(op)))
+#define EMIT_INT(scope, i) (emit((scope), MAKE_INT(i)))
+
+/*=======================================
+  File Local Type Definitions
+=======================================*/
+/* The instructions and their operands. A <pc> operand is a jump target
+ * within the code. */
+enum vm_opcode {
+    OP_CONST,        /* <obj>: val = obj */
+    OP_PUSH_CONST,   /* <obj>: push obj */
+    OP_LREF,         /* <depth> <index> <symbol> */
+    OP_AREF,         /* <slot> <index> <symbol>: argument in a stack frame */
+    OP_GREF,         /* <symbol>: toplevel variable */
+    OP_NREF,         /* <identifier>: looked up by name */
+    OP_LSET,         /* <depth> <index> <symbol> */
+    OP_GSET,         /* <symbol> */
+    OP_NSET,         /* <symbol> */
+    OP_PUSH,         /* push val */
+    OP_POP,
+    OP_CHECK,        /* val must be a first-class value */
+    OP_JUMP,         /* <pc> */
+    OP_JUMPF,        /* <pc>: jump if val is #f */
+    OP_JUMPT,        /* <pc>: jump unless val is #f */
+    OP_EXIT,         /* <pc>: OP_JUMPT without checking val as do test */
+    OP_CLOSURE,      /* <code> */
+    OP_OPERATOR,     /* <argc> <form> <pc after> <ctx> <reduction pc>:
+                        val is the operator */
+    OP_CALL,         /* <argc>: [proc arg ...] */
+    OP_TAILCALL,     /* <argc>: [proc arg ...] */
+    OP_REDUCE,       /* <pc after>: [proc left], val is the right */
+    OP_REDUCE_LAST,  /* [proc left], val is the right */
+    OP_RET,
+    OP_FRAME,        /* <n> <formals>: bind the n values pushed */
+    OP_LOOP,         /* <n> <formals>: call the code again by the n values
+                        pushed */
+    OP_LETREC,       /* <n> <formals>: frame of unassigned variables */
+    OP_FILL,         /* <n>: assign the n values pushed to the frame */
+    OP_UNFRAME,      /* <n>: drop n frames */
+    OP_NAMED_LET,    /* <code> <name formals> <argc>: [#f arg ...] */
+    OP_DO,           /* <code> <argc> <ctx>: [#f arg ...], call the loop in
+                        the current env */
+    OP_YIELD,        /* [test], val is the receiver of cond => */
+    OP_CASE,         /* <data> <pc>: [key] */
+    OP_QQ_LIST,      /* <n> <kinds>: [elm ...], val is the tail */
+    OP_QQ_VECTOR,    /* <n> <kinds>: [elm ...] */
+    OP_BODY,         /* <body> <pc after> <ctx> */
+    OP_EVAL,         /* <exp> <pc after> <ctx> */
+    OP_BINARY,       /* <C function pointer>: [left], val is the right */
+    OP_GUARD         /* <symbol> <value> <form> <pc after> <ctx>: evaluate
+                        the form unless the symbol is bound to the value */
+};
+
+/* the number of the operands of each instruction */
+static const int insn_operands[] = {
+    1, 1, 3, 3, 1, 1, 3, 1, 1,  /* OP_CONST ... OP_NSET */
+    0, 0, 0,                    /* OP_PUSH, OP_POP, OP_CHECK */
+    1, 1, 1, 1, 1,              /* OP_JUMP ... OP_CLOSURE */
+    5, 1, 1, 1, 0, 0,           /* OP_OPERATOR ... OP_RET */
+    2, 2, 2, 1, 1, 3, 3,        /* OP_FRAME ... OP_DO */
+    0, 2, 2, 2,                 /* OP_YIELD ... OP_QQ_VECTOR */
+    3, 3, 1, 5                  /* OP_BODY ... OP_GUARD */
+};
+
+typedef struct {
+    ScmObj words;
+    ScmQueue q;
+    scm_int_t pc;
+} vm_emitter;
+
+/* the compiled frames enclosing the code being compiled */
+typedef struct {
+    ScmObj frames;
+    ScmObj env;        /* env of the outermost compiled frame */
+    vm_emitter *em;
+} vm_scope;
+
+typedef struct {
+    ScmQueue q;
+    scm_int_t pc;
+} vm_mark;
+
+/*=======================================
+  Variable Definitions
+=======================================*/
+SCM_DEFINE_EXPORTED_VARS(vm);
+
+SCM_GLOBAL_VARS_BEGIN(static_vm);
+#define static
+static ScmObj l_control_stack;
+static scm_int_t l_stack_hwm;  /* upper bound of the slots in use */
+static ScmObj l_label_tag;
+static ScmObj l_sym_else, l_sym_yields, l_sym_define, l_sym_begin;
+static ScmObj l_syn_lambda;
+#undef static
+SCM_GLOBAL_VARS_END(static_vm);
+#define l_control_stack SCM_GLOBAL_VAR(static_vm, l_control_stack)
+#define l_stack_hwm     SCM_GLOBAL_VAR(static_vm, l_stack_hwm)
+#define l_label_tag     SCM_GLOBAL_VAR(static_vm, l_label_tag)
+#define l_sym_else      SCM_GLOBAL_VAR(static_vm, l_sym_else)
+#define l_sym_yields    SCM_GLOBAL_VAR(static_vm, l_sym_yields)
+#define l_sym_define    SCM_GLOBAL_VAR(static_vm, l_sym_define)
+#define l_sym_begin     SCM_GLOBAL_VAR(static_vm, l_sym_begin)
+#define l_syn_lambda    SCM_GLOBAL_VAR(static_vm, l_syn_lambda)
+SCM_DEFINE_STATIC_VARS(static_vm);
+
+/*=======================================
+  File Local Function Declarations
+=======================================*/
+static void grow_stack(scm_int_t len);
+static void clear_stack(scm_int_t sp);
+static ScmObj stack_to_list(scm_int_t from, scm_int_t to);
+static ScmObj frame_env(scm_int_t ap, ScmObj env);
+static void sync_frame(scm_int_t ap);
+static scm_int_t enter_stack_frame(ScmObj code, ScmObj env, scm_int_t sp);
+static ScmObj call_cfunc(ScmFuncType func, const ScmObj *argv, int argc);
+static ScmObj qq_build(scm_int_t sp, scm_int_t n, ScmObj kinds, ScmObj tail,
+                       scm_bool vectorp);
+
+static void init_emitter(vm_emitter *em);
+static void emit(const vm_scope *scope, ScmObj word);
+static ScmObj new_label(void);
+static void place_label(const vm_scope *scope, ScmObj label);
+static void emit_ret(const vm_scope *scope, int ctx);
+static void emit_deferred(enum vm_opcode op, ScmObj exp,
+                          const vm_scope *scope, int ctx);
+static vm_mark mark_code(const vm_scope *scope);
+static void rollback_code(const vm_scope *scope, vm_mark mark);
+static ScmObj assemble(vm_emitter *em);
+
+static scm_bool scope_lookup(ScmObj var, const vm_scope *scope,
+                             scm_int_t *depth, scm_int_t *index);
+static ScmObj compile_exp(ScmObj exp, ScmObj env, enum ScmNestState nest);
+static ScmObj compile_code(ScmObj formals, ScmObj body,
+                           const vm_scope *scope);
+static ScmObj make_code(vm_emitter *em, scm_int_t nargs, ScmObj frame_formals,
+                        ScmObj formals, ScmObj body);
+static scm_bool use_stack_frame(ScmObj insns);
+static void compile(ScmObj exp, const vm_scope *scope, int ctx);
+static void compile_ref(ScmObj var, const vm_scope *scope);
+static void compile_form(ScmObj form, const vm_scope *scope, int ctx);
+static void compile_call(ScmObj form, scm_int_t argc, scm_bool reducep,
+                         const vm_scope *scope, int ctx);
+static scm_bool compile_syntax(ScmObj syn, ScmObj form,
+                               const vm_scope *scope, int ctx);
+static scm_bool compile_quote(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_if(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_setx(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_lambda(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_begin(ScmObj form, const vm_scope *scope, int ctx);
+static void compile_seq(ScmObj exps, const vm_scope *scope,
+                        int sub_ctx, int ctx);
+static scm_bool compile_and_or(ScmObj form, scm_bool andp,
+                               const vm_scope *scope, int ctx);
+static scm_bool compile_cond(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_case(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_quasiquote(ScmObj form, const vm_scope *scope,
+                                   int ctx);
+static scm_bool qq_compilablep(ScmObj tmpl, scm_int_t nest);
+static scm_bool qq_constantp(ScmObj tmpl, scm_int_t nest);
+static int compile_qq(ScmObj tmpl, scm_int_t nest, const vm_scope *scope);
+static scm_int_t push_constants(ScmObj consts, ScmObj *kinds,
+                                const vm_scope *scope);
+static scm_bool compile_let(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_letstar(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_letrec(ScmObj form, const vm_scope *scope, int ctx);
+static scm_bool compile_do(ScmObj form, const vm_scope *scope, int ctx);
+static scm_int_t compile_pushes(ScmObj exps, const vm_scope *scope,
+                                int ctx);
+static scm_bool parse_bindings(ScmObj bindings, scm_bool uniquep,
+                               ScmObj *formals, ScmObj *inits);
+static void compile_body(ScmObj body, const vm_scope *scope, int ctx);
+#if SCM_USE_INTERNAL_DEFINITIONS
+static ScmObj scan_definitions(ScmObj body, ScmQueue *varq, ScmQueue *expq);
+#endif
+
+/*=======================================
+  Function Definitions
+=======================================*/
+SCM_EXPORT void
+scm_init_vm(void)
+{
+    SCM_GLOBAL_VARS_INIT(vm);
+    SCM_GLOBAL_VARS_INIT(static_vm);
+
+    /* the VM runs only when selected by --engine vm */
+    scm_vm_enabled = scm_false;
+
+    scm_vm_sp = l_stack_hwm = 0;
+    scm_gc_protect_with_init(&l_control_stack,
+                             scm_p_make_vector(MAKE_INT(STACK_INITIAL_LEN),
+                                               LIST_1(SCM_FALSE)));
+
+    /* unique markers of code objects and unresolved jump targets */
+    scm_gc_protect_with_init(&scm_vm_code_tag, CONS(SCM_FALSE, SCM_FALSE));
+    scm_gc_protect_with_init(&l_label_tag, CONS(SCM_FALSE, SCM_FALSE));
+
+    l_sym_else   = scm_intern("else");
+    l_sym_yields = scm_intern("=>");
+    l_sym_define = scm_intern("define");
+    l_sym_begin  = scm_intern("begin");
+    scm_gc_protect_with_init(&l_syn_lambda,
+                             scm_symbol_value(scm_intern("lambda"),
+                                              SCM_INTERACTION_ENV));
+}
+
+/* Reallocate the control stack to hold at least LEN slots. */
+static void
+grow_stack(scm_int_t len)
+{
+    ScmObj *vec;
+    scm_int_t old_len, new_len, i;
+
+    old_len = SCM_VECTOR_LEN(l_control_stack);
+    new_len = old_len * 2;
+    if (new_len < len)
+        new_len = len;
+
+    vec = scm_malloc(sizeof(ScmObj) * new_len);
+    memcpy(vec, SCM_VECTOR_VEC(l_control_stack), sizeof(ScmObj) * old_len);
+    for (i = old_len; i < new_len; i++)
+        vec[i] = SCM_FALSE;
+    /* the old vector is left to the GC */
+    l_control_stack = MAKE_VECTOR(vec, new_len);
+}
+
+/* Clear the slots above SP to not retain the objects. */
+static void
+clear_stack(scm_int_t sp)
+{
+    scm_int_t i;
+
+    for (i = sp; i < l_stack_hwm; i++)
+        STACK[i] = SCM_FALSE;
+    scm_vm_sp = l_stack_hwm = sp;
+}
+
+/* Forget the frames above SP, which the activations escaped from by a
+ * continuation have left. */
+SCM_EXPORT void
+scm_vm_unwind(scm_int_t sp)
+{
+    if (l_stack_hwm > sp)
+        clear_stack(sp);
+}
+
+#if SCM_USE_FULL_CONTINUATION
+/* Copy the frames of the control stack for a continuation to be
+ * reentered. */
+SCM_EXPORT ScmObj
+scm_vm_save_stack(void)
+{
+    ScmObj saved;
+
+    saved = scm_p_make_vector(MAKE_INT(scm_vm_sp), LIST_1(SCM_FALSE));
+    memcpy(SCM_VECTOR_VEC(saved), STACK, sizeof(ScmObj) * scm_vm_sp);
+
+    return saved;
+}
+
+/* Replace the frames with the ones saved by scm_vm_save_stack(). */
+SCM_EXPORT void
+scm_vm_restore_stack(ScmObj saved)
+{
+    scm_int_t len;
+
+    len = SCM_VECTOR_LEN(saved);
+    if (len > SCM_VECTOR_LEN(l_control_stack))
+        grow_stack(len);
+    memcpy(STACK, SCM_VECTOR_VEC(saved), sizeof(ScmObj) * len);
+    if (l_stack_hwm < len)
+        l_stack_hwm = len;
+    clear_stack(len);
+}
+#endif /* SCM_USE_FULL_CONTINUATION */
+
+/* Make a list of the values in the slots FROM to TO (exclusive). */
+static ScmObj
+stack_to_list(scm_int_t from, scm_int_t to)
+{
+    ScmObj lst;
+
+    for (lst = SCM_NULL; to > from; to--)
+        lst = CONS(STACK[to - 1], lst);
+
+    return lst;
+}
+
+/* The env of the stack frame at AP over ENV, the env of the closure. The
+ * frame is made on the first call and kept in the stack frame. */
+static ScmObj
+frame_env(scm_int_t ap, ScmObj env)
+{
+    ScmQueue q;
+    ScmObj formals, args;
+    scm_int_t i;
+
+    if (FALSEP(STACK[ap + 1])) {
+        args = SCM_NULL;
+        SCM_QUEUE_POINT_TO(q, args);
+        for (i = 0, formals = VM_CODE_FRAME_FORMALS(STACK[ap]);
+             CONSP(formals);
+             i++, formals = CDR(formals))
+            SCM_QUEUE_ADD(q, STACK[ap + 2 + i]);
+        /* the rest list */
+        if (!NULLP(formals))
+            SCM_QUEUE_SLOPPY_APPEND(q, STACK[ap + 2 + i]);
+        formals = VM_CODE_FRAME_FORMALS(STACK[ap]);
+        STACK[ap + 1] = scm_extend_environment(formals, args, env);
+    }
+
+    return STACK[ap + 1];
+}
+
+/* Copy the values of the frame made by frame_env() to the stack frame at
+ * AP. */
+static void
+sync_frame(scm_int_t ap)
+{
+    ScmObj formals, frame;
+    scm_int_t i;
+
+    frame = CAR(STACK[ap + 1]);
+    for (i = 0, formals = VM_CODE_FRAME_FORMALS(STACK[ap]);
+         CONSP(formals);
+         i++, formals = CDR(formals))
+        STACK[ap + 2 + i] = DEREF(scm_lookup_frame_lexical(i, frame));
+    if (!NULLP(formals))
+        STACK[ap + 2 + i] = DEREF(scm_lookup_frame_lexical(~i, frame));
+}
+
+/* Make the stack frame of CODE at SP from ENV extended by the interpreter
+ * for the call. Returns the new stack pointer. */
+static scm_int_t
+enter_stack_frame(ScmObj code, ScmObj env, scm_int_t sp)
+{
+    scm_int_t nargs;
+
+    nargs = VM_CODE_NARGS(code);
+    ENSURE_STACK(2 + ((nargs >= 0) ? nargs : ~nargs + 1));
+    STACK[sp] = code;
+    STACK[sp + 1] = env;
+    sync_frame(sp);
+
+    return sp + 2 + ((nargs >= 0) ? nargs : ~nargs + 1);
+}
+
+/* Call a C procedure of a fixed number of arguments. The rest list of a
+ * variadic one is passed as the last one. */
+static ScmObj
+call_cfunc(ScmFuncType func, const ScmObj *argv, int argc)
+{
+    switch (argc) {
+    case 0:
+        return (*func)();
+    case 1:
+        return (*func)(argv[0]);
+    case 2:
+        return (*func)(argv[0], argv[1]);
+    case 3:
+        return (*func)(argv[0], argv[1], argv[2]);
+    case 4:
+        return (*func)(argv[0], argv[1], argv[2], argv[3]);
+    case 5:
+        return (*func)(argv[0], argv[1], argv[2], argv[3], argv[4]);
+    case 6:
+        return (*func)(argv[0], argv[1], argv[2], argv[3], argv[4], argv[5]);
+    default:
+        SCM_NOTREACHED;
+    }
+}
+
+/* Build the list of the N values pushed below SP onto TAIL. KINDS tells
+ * whether each value is to be spliced, from the last one. The spliced lists
+ * are copied. */
+static ScmObj
+qq_build(scm_int_t sp, scm_int_t n, ScmObj kinds, ScmObj tail,
+         scm_bool vectorp)
+{
+    ScmQueue q;
+    ScmObj lst, elm, copy, rest;
+    scm_int_t i;
+    DECLARE_INTERNAL_FUNCTION("quasiquote");
+
+    lst = tail;
+    for (i = sp - 1; i >= sp - n; i--, kinds = CDR(kinds)) {
+        elm = STACK[i];
+        if (FALSEP(CAR(kinds))) {
+            lst = CONS(elm, lst);
+            continue;
+        }
+        copy = SCM_NULL;
+        SCM_QUEUE_POINT_TO(q, copy);
+        for (rest = elm; CONSP(rest); rest = CDR(rest))
+            SCM_QUEUE_ADD(q, CAR(rest));
+#if !SCM_STRICT_ARGCHECK
+        if (vectorp)
+#endif
+        {
+            if (!NULLP(rest))
+                ERR_OBJ(ERRMSG_BAD_SPLICE_LIST, elm);
+        }
+        SCM_QUEUE_SLOPPY_APPEND(q, lst);
+        lst = copy;
+    }
+
+    return lst;
+}
+
+SCM_EXPORT ScmObj
+scm_vm_eval(ScmObj exp, ScmObj env)
+{
+    ScmEvalState state;
+    scm_reduction_operator reduce;
+    enum ScmReductionState reduce_state;
+    ScmBinaryOperator binary;
+    ScmObj code, val, proc, args, env2;
+    ScmObj argbuf[SCM_FUNCTYPE_MAND_MAX + 1];
+    const ScmObj *insns;
+    ScmRef ref;
+    enum ScmNestState nest;
+    scm_int_t base, sp, fp, ap, pc, skip, n, p, nargs, i;
+    int ctx, type, mand;
+    scm_bool tailp;
+    DECLARE_INTERNAL_FUNCTION("(function call)");
+
+    /* values need no activation */
+    if (IDENTIFIERP(exp))
+        return scm_symbol_value(exp, env);
+    if (!CONSP(exp)) {
+#if SCM_STRICT_NULL_FORM
+        if (NULLP(exp))
+            PLAIN_ERR("eval: () is not a valid R5RS form. use '() instead");
+#endif
+#if (SCM_USE_VECTOR && SCM_STRICT_VECTOR_FORM)
+        if (VECTORP(exp))
+            PLAIN_ERR("eval: #() is not a valid R5RS form. use '#() instead");
+#endif
+        return exp;
+    }
+
+#if SCM_STRICT_TOPLEVEL_DEFINITIONS
+    /* FIXME: temporary hack. See scm_eval(). */
+    if (EQ(env, SCM_INTERACTION_ENV_INDEFINABLE)) {
+        env = SCM_INTERACTION_ENV;
+        nest = SCM_NEST_COMMAND;
+    } else
+#endif
+    {
+        nest = (EQ(env, SCM_INTERACTION_ENV)) ? SCM_NEST_PROGRAM
+                                              : SCM_NEST_COMMAND;
+    }
+
+#if SCM_USE_BACKTRACE
+    scm_push_trace_frame(exp, env);
+#endif
+
+    /* the code of a closure returned by call() or the expression */
+    code = (VM_CODEP(exp)) ? VM_CODE_INSNS(exp) : compile_exp(exp, env, nest);
+
+    base = sp = scm_vm_sp;
+    fp = ap = -1;
+    val = SCM_UNDEF;
+    /* the frame to halt */
+    ENSURE_STACK(CONT_SLOTS);
+    STACK[sp]     = SCM_FALSE;
+    STACK[sp + 1] = MAKE_INT(0);
+    STACK[sp + 2] = env;
+    STACK[sp + 3] = MAKE_INT(fp);
+    STACK[sp + 4] = MAKE_INT(ap);
+    fp = sp;
+    sp += CONT_SLOTS;
+    if (VM_CODEP(exp) && VM_CODE_STACK_FRAMEP(exp)) {
+        ap = sp;
+        sp = enter_stack_frame(exp, env, sp);
+        env = CDR(env);
+    }
+    insns = SCM_VECTOR_VEC(code);
+    pc = 0;
+
+ dispatch:
+    switch (SCM_INT_VALUE(insns[pc++])) {
+    case OP_CONST:
+        val = OPERAND(0);
+        pc++;
+        goto dispatch;
+
+    case OP_PUSH_CONST:
+        PUSH(OPERAND(0));
+        pc++;
+        goto dispatch;
+
+    case OP_LREF:
+        val = DEREF(scm_lookup_lexical(INT_OPERAND(0), INT_OPERAND(1), env));
+        /* unassigned variable of letrec or internal definitions */
+        if (EQ(val, SCM_UNBOUND)) {
+            DECLARE_INTERNAL_FUNCTION("scm_symbol_value");
+            CALL_OUT();
+            ERR_OBJ("unbound variable", OPERAND(2));
+        }
+        pc += 3;
+        goto dispatch;
+
+    case OP_AREF:
+        val = STACK[ap + 2 + INT_OPERAND(0)];
+        pc += 3;
+        goto dispatch;
+
+    case OP_GREF:
+        val = SCM_SYMBOL_VCELL(OPERAND(0));
+        if (EQ(val, SCM_UNBOUND)) {
+            DECLARE_INTERNAL_FUNCTION("scm_symbol_value");
+            CALL_OUT();
+            ERR_OBJ("unbound variable", OPERAND(0));
+        }
+        pc++;
+        goto dispatch;
+
+    case OP_NREF:
+        CALL_OUT();
+        val = scm_symbol_value(OPERAND(0), env);
+        pc++;
+        goto dispatch;
+
+    case OP_LSET:
+        CHECK_VALID(val);
+        ref = scm_lookup_lexical(INT_OPERAND(0), INT_OPERAND(1), env);
+        /* the variables of letrec are not visible from the inits */
+        if (EQ(DEREF(ref), SCM_UNBOUND)) {
+            DECLARE_INTERNAL_FUNCTION("set!");
+            CALL_OUT();
+            ERR_OBJ("unbound variable", OPERAND(2));
+        }
+        SET(ref, val);
+        pc += 3;
+        goto set_done;
+
+    case OP_NSET:
+        CHECK_VALID(val);
+        ref = scm_lookup_environment(OPERAND(0), env);
+        if (ref != SCM_INVALID_REF) {
+            SET(ref, val);
+            pc++;
+            goto set_done;
+        }
+        /* Fall through. */
+    case OP_GSET:
+        CHECK_VALID(val);
+        if (!SCM_SYMBOL_BOUNDP(OPERAND(0))) {
+            DECLARE_INTERNAL_FUNCTION("set!");
+            CALL_OUT();
+            ERR_OBJ("unbound variable", OPERAND(0));
+        }
+        SCM_SYMBOL_SET_VCELL(OPERAND(0), val);
+        pc++;
+    set_done:
+#if SCM_STRICT_R5RS
+        val = SCM_UNDEF;
+#endif
+        goto dispatch;
+
+    case OP_PUSH:
+        CHECK_VALID(val);
+        PUSH(val);
+        goto dispatch;
+
+    case OP_POP:
+        sp--;
+        goto dispatch;
+
+    case OP_CHECK:
+        CHECK_VALID(val);
+        goto dispatch;
+
+    case OP_JUMP:
+        pc = INT_OPERAND(0);
+        goto dispatch;
+
+    case OP_JUMPF:
+        CHECK_VALID(val);
+        pc = (FALSEP(val)) ? INT_OPERAND(0) : pc + 1;
+        goto dispatch;
+
+    case OP_JUMPT:
+        CHECK_VALID(val);
+        /* Fall through. */
+    case OP_EXIT:
+        pc = (FALSEP(val)) ? pc + 1 : INT_OPERAND(0);
+        goto dispatch;
+
+    case OP_CLOSURE:
+        val = MAKE_CLOSURE(OPERAND(0), env);
+        pc++;
+        goto dispatch;
+
+    case OP_OPERATOR:
+        n = INT_OPERAND(0);
+        if (n >= 0) {
+            if (PLAIN_CLOSUREP(val)
+                || (CONTINUATIONP(val) && !EQ(val, scm_values_applier))) {
+                PUSH(val);
+                pc += 5;
+                goto dispatch;
+            }
+            if (FUNCP(val)
+                && !(SCM_FUNC_TYPECODE(val) & SCM_FUNCTYPE_SYNTAX)) {
+                if (!REDUCTIONP(val) || n < 3) {
+                    PUSH(val);
+                    pc += 5;
+                    goto dispatch;
+                }
+                /* reductions evaluate each operand only if it is needed */
+                if (TRUEP(OPERAND(4))) {
+                    PUSH(val);
+                    pc = INT_OPERAND(4);
+                    goto dispatch;
+                }
+            }
+        }
+        if (!PROCEDUREP(val) && !SYNTACTIC_OBJECTP(val)) {
+            CALL_OUT();
+            ERR_OBJ("procedure or syntax required but got", val);
+        }
+        /* Let call() process the unevaluated operands of the syntaxes,
+         * macros and the others. */
+        ctx = INT_OPERAND(3);
+        skip = INT_OPERAND(2);
+        tailp = CTX_TAILP(ctx);
+        CALL_OUT();
+        state.env = CURRENT_ENV();
+        state.nest = CTX_NEST(ctx);
+        state.ret_type = SCM_VALTYPE_AS_IS;
+        val = scm_tailcall(val, CDR(OPERAND(1)), &state,
+                           SCM_VALTYPE_NEED_EVAL);
+        goto result;
+
+    case OP_CALL:
+    case OP_TAILCALL:
+        tailp = (SCM_INT_VALUE(insns[pc - 1]) == OP_TAILCALL);
+        n = INT_OPERAND(0);
+        skip = ++pc;
+        p = sp - n - 1;
+        proc = STACK[p];
+        goto apply;
+
+    case OP_REDUCE:
+        CHECK_VALID(val);
+        reduce = (scm_reduction_operator)SCM_FUNC_CFUNC(STACK[sp - 2]);
+        reduce_state = SCM_REDUCE_PARTWAY;
+        CALL_OUT();
+        val = (*reduce)(STACK[sp - 1], val, &reduce_state);
+        if (reduce_state == SCM_REDUCE_STOP) {
+            sp -= 2;
+            pc = INT_OPERAND(0);
+            goto dispatch;
+        }
+        STACK[sp - 1] = val;
+        pc++;
+        goto dispatch;
+
+    case OP_REDUCE_LAST:
+        CHECK_VALID(val);
+        reduce = (scm_reduction_operator)SCM_FUNC_CFUNC(STACK[sp - 2]);
+        reduce_state = SCM_REDUCE_LAST;
+        CALL_OUT();
+        val = (*reduce)(STACK[sp - 1], val, &reduce_state);
+        sp -= 2;
+        goto dispatch;
+
+    case OP_RET:
+        goto ret;
+
+    case OP_FRAME:
+        n = INT_OPERAND(0);
+        args = stack_to_list(sp - n, sp);
+        sp -= n;
+        env = scm_extend_environment(OPERAND(1), args, env);
+        pc += 2;
+        goto dispatch;
+
+    case OP_LOOP:
+        n = INT_OPERAND(0);
+        if (ap >= 0) {
+            memmove(&STACK[ap + 2], &STACK[sp - n], sizeof(ScmObj) * n);
+            STACK[ap + 1] = SCM_FALSE;
+            sp = ap + 2 + n;
+        } else {
+            /* a new frame for each iteration */
+            args = stack_to_list(sp - n, sp);
+            sp -= n;
+            env = scm_extend_environment(OPERAND(1), args, CDR(env));
+        }
+        pc = 0;
+        goto dispatch;
+
+    case OP_LETREC:
+        for (args = SCM_NULL, n = INT_OPERAND(0); n; n--)
+            args = CONS(SCM_UNBOUND, args);
+        env = scm_extend_environment(OPERAND(1), args, env);
+        pc += 2;
+        goto dispatch;
+
+    case OP_FILL:
+        n = INT_OPERAND(0);
+        args = stack_to_list(sp - n, sp);
+        sp -= n;
+        env = scm_update_environment(args, env);
+        pc++;
+        goto dispatch;
+
+    case OP_UNFRAME:
+        for (n = INT_OPERAND(0); n; n--)
+            env = CDR(env);
+        pc++;
+        goto dispatch;
+
+    case OP_NAMED_LET:
+        /* the frame of the name is not visible from the inits */
+        env2 = scm_extend_environment(OPERAND(1), LIST_1(SCM_UNBOUND), env);
+        proc = MAKE_CLOSURE(OPERAND(0), env2);
+        env2 = scm_update_environment(LIST_1(proc), env2);
+        SCM_CLOSURE_SET_ENV(proc, env2);
+        STACK[sp - INT_OPERAND(2) - 1] = proc;
+        pc += 3;
+        goto dispatch;
+
+    case OP_DO:
+        exp = OPERAND(0);
+        n = INT_OPERAND(1);
+        tailp = CTX_TAILP(INT_OPERAND(2));
+        skip = pc + 3;
+        p = sp - n - 1;
+        env2 = CURRENT_ENV();
+        goto enter;
+
+    case OP_YIELD:
+        if (!PROCEDUREP(val)) {
+            DECLARE_INTERNAL_FUNCTION("cond");
+            CALL_OUT();
+            ERR_OBJ("exp after => must be a procedure but got", val);
+        }
+        ENSURE_STACK(1);
+        STACK[sp] = STACK[sp - 1];
+        STACK[sp - 1] = val;
+        sp++;
+        goto dispatch;
+
+    case OP_CASE:
+        if (TRUEP(scm_p_memv(STACK[sp - 1], OPERAND(0)))) {
+            sp--;
+            pc += 2;
+        } else {
+            pc = INT_OPERAND(1);
+        }
+        goto dispatch;
+
+    case OP_QQ_LIST:
+    case OP_QQ_VECTOR:
+        n = INT_OPERAND(0);
+        CALL_OUT();
+#if SCM_USE_VECTOR
+        if (SCM_INT_VALUE(insns[pc - 1]) == OP_QQ_VECTOR)
+            val = scm_p_list2vector(qq_build(sp, n, OPERAND(1), SCM_NULL,
+                                             scm_true));
+        else
+#endif
+            val = qq_build(sp, n, OPERAND(1), val, scm_false);
+        sp -= n;
+        pc += 2;
+        goto dispatch;
+
+    case OP_BODY:
+        ctx = INT_OPERAND(2);
+        skip = INT_OPERAND(1);
+        tailp = CTX_TAILP(ctx);
+        CALL_OUT();
+        state.env = CURRENT_ENV();
+        state.nest = CTX_NEST(ctx);
+        state.ret_type = SCM_VALTYPE_NEED_EVAL;
+        val = scm_s_body(OPERAND(0), &state);
+        goto result;
+
+    case OP_BINARY:
+        CHECK_VALID(val);
+        binary = (ScmBinaryOperator)SCM_C_FUNCPOINTER_VALUE(OPERAND(0));
+        sp--;
+        CALL_OUT();
+        val = (*binary)(STACK[sp], val);
+        pc++;
+        goto dispatch;
+
+    case OP_GUARD:
+        if (EQ(SCM_SYMBOL_VCELL(OPERAND(0)), OPERAND(1))) {
+            pc += 5;
+            goto dispatch;
+        }
+        /* the keyword or the procedure has been redefined */
+        pc += 2;
+        /* Fall through. */
+    case OP_EVAL:
+        exp = OPERAND(0);
+        skip = INT_OPERAND(1);
+        ctx = INT_OPERAND(2);
+        tailp = CTX_TAILP(ctx);
+        nest = CTX_NEST(ctx);
+        CALL_OUT();
+        env2 = CURRENT_ENV();
+        goto run;
+
+    default:
+        SCM_NOTREACHED;
+    }
+
+    /* Call PROC with the N values above the slot P. */
+ apply:
+    if (PLAIN_CLOSUREP(proc)) {
+        exp = SCM_CLOSURE_EXP(proc);
+        if (!VM_CODEP(exp)) {
+            CALL_OUT();
+            exp = scm_vm_compile_closure(proc);
+        }
+        env2 = SCM_CLOSURE_ENV(proc);
+        goto enter;
+    }
+    if (FUNCP(proc)) {
+        type = SCM_FUNC_TYPECODE(proc);
+        mand = type & SCM_FUNCTYPE_MAND_MASK;
+        if (!(type & (SCM_FUNCTYPE_SYNTAX | SCM_FUNCTYPE_TAILREC
+                      | SCM_FUNCTYPE_ODDBALL))
+            && ((type & SCM_FUNCTYPE_VARIADIC) ? n >= mand : n == mand))
+        {
+            for (i = 0; i < mand; i++)
+                argbuf[i] = STACK[p + 1 + i];
+            if (type & SCM_FUNCTYPE_VARIADIC)
+                argbuf[mand++] = stack_to_list(p + 1 + i, sp);
+            sp = (tailp) ? fp + CONT_SLOTS : p;
+            CALL_OUT();
+            val = call_cfunc(SCM_FUNC_CFUNC(proc), argbuf, mand);
+            goto value;
+        }
+        if (type == SCM_REDUCTION_OPERATOR && n == 2) {
+            argbuf[0] = STACK[p + 1];
+            argbuf[1] = STACK[p + 2];
+            sp = (tailp) ? fp + CONT_SLOTS : p;
+            CALL_OUT();
+            /* the same calls as reduce() of eval.c */
+            binary = scm_lookup_binary_operator(SCM_FUNC_CFUNC(proc));
+            if (binary) {
+                val = (*binary)(argbuf[0], argbuf[1]);
+            } else {
+                reduce = (scm_reduction_operator)SCM_FUNC_CFUNC(proc);
+                reduce_state = SCM_REDUCE_LAST;
+                val = (*reduce)(argbuf[0], argbuf[1], &reduce_state);
+            }
+            goto value;
+        }
+    }
+    /* continuations and the procedures of the other types */
+    args = stack_to_list(p + 1, sp);
+    state.env = CURRENT_ENV();
+    state.nest = SCM_NEST_COMMAND;
+    state.ret_type = SCM_VALTYPE_AS_IS;
+    sp = (tailp) ? fp + CONT_SLOTS : p;
+    CALL_OUT();
+    val = scm_tailcall(proc, args, &state, SCM_VALTYPE_AS_IS);
+    /* Fall through. */
+
+    /* The result of call(). */
+ result:
+    if (state.ret_type == SCM_VALTYPE_NEED_EVAL) {
+        exp = val;
+        env2 = state.env;
+        nest = TAIL_NEST(state.nest);
+        goto run;
+    }
+    /* Fall through. */
+
+    /* VAL is the value of the expression being evaluated. */
+ value:
+    if (tailp)
+        goto ret;
+    SYNC_FRAME();
+    pc = skip;
+    goto dispatch;
+
+    /* Evaluate EXP in ENV2 at NEST as a tail or to return to SKIP. */
+ run:
+    CALL_OUT();
+    if (IDENTIFIERP(exp)) {
+        val = scm_symbol_value(exp, env2);
+        goto value;
+    }
+    if (!CONSP(exp)) {
+#if SCM_STRICT_NULL_FORM
+        if (NULLP(exp))
+            PLAIN_ERR("eval: () is not a valid R5RS form. use '() instead");
+#endif
+#if (SCM_USE_VECTOR && SCM_STRICT_VECTOR_FORM)
+        if (VECTORP(exp))
+            PLAIN_ERR("eval: #() is not a valid R5RS form. use '#() instead");
+#endif
+        val = exp;
+        goto value;
+    }
+    if (tailp)
+        sp = fp + CONT_SLOTS;
+    else
+        PUSH_CONT(skip);
+    if (VM_CODEP(exp)) {
+        ap = -1;
+        if (VM_CODE_STACK_FRAMEP(exp)) {
+            ap = sp;
+            sp = enter_stack_frame(exp, env2, sp);
+            env2 = CDR(env2);
+        }
+        exp = VM_CODE_INSNS(exp);
+    } else {
+        ap = -1;
+        exp = compile_exp(exp, env2, nest);
+    }
+    env = env2;
+    code = exp;
+    insns = SCM_VECTOR_VEC(code);
+    pc = 0;
+    goto dispatch;
+
+    /* Call the code object EXP in ENV2 with the N values above the slot P. */
+ enter:
+    nargs = VM_CODE_NARGS(exp);
+    if ((nargs >= 0) ? n != nargs : n < ~nargs) {
+        DECLARE_INTERNAL_FUNCTION("call_closure");
+        CALL_OUT();
+        ERR_OBJ(ERRMSG_UNMATCHED_ARGS, stack_to_list(p + 1, sp));
+    }
+    if (VM_CODE_STACK_FRAMEP(exp)) {
+        if (nargs < 0) {
+            /* the rest list takes the place of the first one */
+            i = p + 1 + ~nargs;
+            args = stack_to_list(i, sp);
+            STACK[i] = args;
+            n = ~nargs + 1;
+            sp = i + 1;
+        }
+        /* [<code> #f <arg> ...] above the frame to return */
+        ENSURE_STACK(CONT_SLOTS + 1);
+        i = ((tailp) ? fp : p) + CONT_SLOTS;
+        memmove(&STACK[i + 2], &STACK[p + 1], sizeof(ScmObj) * n);
+        if (!tailp) {
+            sp = p;
+            PUSH_CONT(skip);
+        }
+        ap = i;
+        STACK[ap] = exp;
+        STACK[ap + 1] = SCM_FALSE;
+        sp = ap + 2 + n;
+        env = env2;
+    } else {
+        args = stack_to_list(p + 1, sp);
+        if (nargs == ~0)
+            args = LIST_1(args);
+        if (tailp) {
+            sp = fp + CONT_SLOTS;
+        } else {
+            sp = p;
+            PUSH_CONT(skip);
+        }
+        ap = -1;
+        env = scm_extend_environment(VM_CODE_FRAME_FORMALS(exp), args, env2);
+    }
+    code = VM_CODE_INSNS(exp);
+    insns = SCM_VECTOR_VEC(code);
+    pc = 0;
+    goto dispatch;
+
+    /* Return VAL to the frame at FP. */
+ ret:
+    sp = fp;
+    code = STACK[fp];
+    if (FALSEP(code)) {
+        clear_stack(base);
+#if SCM_USE_BACKTRACE
+        scm_pop_trace_frame();
+#endif
+        return val;
+    }
+    pc = SCM_INT_VALUE(STACK[fp + 1]);
+    env = STACK[fp + 2];
+    ap = SCM_INT_VALUE(STACK[fp + 4]);
+    fp = SCM_INT_VALUE(STACK[fp + 3]);
+    insns = SCM_VECTOR_VEC(code);
+    SYNC_FRAME();
+    goto dispatch;
+}
+
+/* Replace the (<formals> . <body>) of CLOSURE with a code object if not yet
+ * compiled, and return the code. */
+SCM_EXPORT ScmObj
+scm_vm_compile_closure(ScmObj closure)
+{
+    vm_scope scope;
+    ScmObj exp;
+
+    SCM_ASSERT(CLOSUREP(closure));
+
+    exp = SCM_CLOSURE_EXP(closure);
+    if (!VM_CODEP(exp)) {
+        scope.frames = SCM_NULL;
+        scope.env = SCM_CLOSURE_ENV(closure);
+        scope.em = NULL;
+        exp = compile_code(CAR(exp), CDR(exp), &scope);
+        SCM_CLOSURE_SET_EXP(closure, exp);
+    }
+
+    return exp;
+}
+
+/*===========================================================================
+  Code Emission
+===========================================================================*/
+static void
+init_emitter(vm_emitter *em)
+{
+    em->words = SCM_NULL;
+    SCM_QUEUE_POINT_TO(em->q, em->words);
+    em->pc = 0;
+}
+
+static void
+emit(const vm_scope *scope, ScmObj word)
+{
+    SCM_QUEUE_ADD(scope->em->q, word);
+    scope->em->pc++;
+}
+
+/* A jump target to be placed later. It is emitted as an operand and
+ * resolved into the fixnum pc by assemble(). */
+static ScmObj
+new_label(void)
+{
+    return CONS(l_label_tag, SCM_FALSE);
+}
+
+static void
+place_label(const vm_scope *scope, ScmObj label)
+{
+    SET_CDR(label, MAKE_INT(scope->em->pc));
+}
+
+static void
+emit_ret(const vm_scope *scope, int ctx)
+{
+    if (CTX_TAILP(ctx))
+        EMIT_OP(scope, OP_RET);
+}
+
+/* Emit an instruction that hands EXP to the interpreter at run time. */
+static void
+emit_deferred(enum vm_opcode op, ScmObj exp, const vm_scope *scope, int ctx)
+{
+    ScmObj skip;
+
+    skip = new_label();
+    EMIT_OP(scope, op);
+    emit(scope, exp);
+    emit(scope, skip);
+    EMIT_INT(scope, ctx);
+    place_label(scope, skip);
+}
+
+static vm_mark
+mark_code(const vm_scope *scope)
+{
+    vm_mark mark;
+
+    mark.q = scope->em->q;
+    mark.pc = scope->em->pc;
+
+    return mark;
+}
+
+/* Discard the words emitted after MARK. */
+static void
+rollback_code(const vm_scope *scope, vm_mark mark)
+{
+    scope->em->q = mark.q;
+    scope->em->pc = mark.pc;
+    SCM_SET(scope->em->q, SCM_NULL);
+}
+
+static ScmObj
+assemble(vm_emitter *em)
+{
+    ScmObj *vec, rest, word;
+    scm_int_t i;
+
+    vec = scm_malloc(sizeof(ScmObj) * em->pc);
+    for (i = 0, rest = em->words; CONSP(rest); i++, rest = CDR(rest)) {
+        word = CAR(rest);
+        if (CONSP(word) && EQ(CAR(word), l_label_tag)) {
+            SCM_ASSERT(INTP(CDR(word)));
+            word = CDR(word);
+        }
+        vec[i] = word;
+    }
+    SCM_ASSERT(i == em->pc);
+
+    return MAKE_VECTOR(vec, em->pc);
+}
+
+/*===========================================================================
+  Compiler
+===========================================================================*/
+/* Resolve the lexical address of VAR in the compiled frames of SCOPE in the
+ * same manner as scm_lookup_environment(). The frames are never extended by
+ * scm_add_environment(), so the address stays valid for every activation. */
+static scm_bool
+scope_lookup(ScmObj var, const vm_scope *scope,
+             scm_int_t *depth, scm_int_t *index)
+{
+    ScmObj frames, formals;
+    scm_int_t d, i;
+
+    for (d = 0, frames = scope->frames;
+         CONSP(frames);
+         d++, frames = CDR(frames))
+    {
+        for (i = 0, formals = CAR(frames);
+             CONSP(formals);
+             i++, formals = CDR(formals))
+        {
+            if (EQ(var, CAR(formals))) {
+                *depth = d;
+                *index = i;
+                return scm_true;
+            }
+        }
+        /* the rest parameter */
+        if (EQ(var, formals)) {
+            *depth = d;
+            *index = ~i;
+            return scm_true;
+        }
+    }
+
+    return scm_false;
+}
+
+/* Compile EXP to be evaluated once in ENV at NEST. */
+static ScmObj
+compile_exp(ScmObj exp, ScmObj env, enum ScmNestState nest)
+{
+    vm_emitter em;
+    vm_scope scope;
+
+    init_emitter(&em);
+    scope.frames = SCM_NULL;
+    scope.env = env;
+    scope.em = &em;
+    compile(exp, &scope, CTX(nest, scm_true));
+
+    return assemble(&em);
+}
+
+static ScmObj
+compile_code(ScmObj formals, ScmObj body, const vm_scope *scope)
+{
+    vm_emitter em;
+    vm_scope inner;
+    ScmObj frame_formals, rest;
+    scm_int_t nargs;
+
+    if (IDENTIFIERP(formals)) {
+        frame_formals = LIST_1(formals);
+        nargs = ~0;
+    } else {
+        frame_formals = formals;
+        for (nargs = 0, rest = formals; CONSP(rest); rest = CDR(rest))
+            nargs++;
+        if (!NULLP(rest))
+            nargs = ~nargs;
+    }
+
+    init_emitter(&em);
+    inner.frames = CONS(frame_formals, scope->frames);
+    inner.env = scope->env;
+    inner.em = &em;
+    compile_body(body, &inner, CTX(SCM_NEST_COMMAND, scm_true));
+
+    return make_code(&em, nargs, frame_formals, formals, body);
+}
+
+static ScmObj
+make_code(vm_emitter *em, scm_int_t nargs, ScmObj frame_formals,
+          ScmObj formals, ScmObj body)
+{
+    ScmObj insns, source, *fields;
+
+    insns = assemble(em);
+    source = CONS(formals, body);
+    fields = scm_malloc(sizeof(ScmObj) * VM_CODE_FIELDS_LEN);
+    fields[0] = insns;
+    fields[1] = MAKE_INT(nargs);
+    fields[2] = frame_formals;
+    fields[3] = MAKE_BOOL(use_stack_frame(insns));
+    fields[4] = source;
+
+    return CONS(scm_vm_code_tag, MAKE_VECTOR(fields, VM_CODE_FIELDS_LEN));
+}
+
+/* Turn the references to the parameters in INSNS into OP_AREF if the frame
+ * of the parameters can be kept in the control stack. Returns whether
+ * turned. */
+static scm_bool
+use_stack_frame(ScmObj insns)
+{
+    ScmObj *vec;
+    scm_int_t len, pc, index;
+    int op;
+
+    vec = SCM_VECTOR_VEC(insns);
+    len = SCM_VECTOR_LEN(insns);
+    for (pc = 0; pc < len; pc += 1 + insn_operands[op]) {
+        op = SCM_INT_VALUE(vec[pc]);
+        switch (op) {
+        case OP_LSET:
+            if (SCM_INT_VALUE(vec[pc + 1]))
+                break;
+            /* Fall through. */
+        case OP_NREF:
+        case OP_NSET:
+        case OP_CLOSURE:
+        case OP_FRAME:
+        case OP_LETREC:
+        case OP_FILL:
+        case OP_UNFRAME:
+        case OP_NAMED_LET:
+            return scm_false;
+        default:
+            break;
+        }
+    }
+
+    /* the frame of the parameters is no longer in the env */
+    for (pc = 0; pc < len; pc += 1 + insn_operands[op]) {
+        op = SCM_INT_VALUE(vec[pc]);
+        if (op == OP_LREF && !SCM_INT_VALUE(vec[pc + 1])) {
+            index = SCM_INT_VALUE(vec[pc + 2]);
+            vec[pc] = MAKE_INT(OP_AREF);
+            vec[pc + 1] = MAKE_INT((index >= 0) ? index : ~index);
+        } else if (op == OP_LREF || op == OP_LSET) {
+            vec[pc + 1] = MAKE_INT(SCM_INT_VALUE(vec[pc + 1]) - 1);
+        }
+    }
+
+    return scm_true;
+}
+
+/* Emit the code that leaves the value of EXP in val, and returns it if CTX
+ * is a tail. */
+static void
+compile(ScmObj exp, const vm_scope *scope, int ctx)
+{
+    if (IDENTIFIERP(exp)) {
+        compile_ref(exp, scope);
+    } else if (CONSP(exp)) {
+        compile_form(exp, scope, ctx);
+        return;
+#if SCM_STRICT_NULL_FORM
+    } else if (NULLP(exp)) {
+        /* reported at run time */
+        emit_deferred(OP_EVAL, exp, scope, ctx);
+        return;
+#endif
+#if (SCM_USE_VECTOR && SCM_STRICT_VECTOR_FORM)
+    } else if (VECTORP(exp)) {
+        emit_deferred(OP_EVAL, exp, scope, ctx);
+        return;
+#endif
+    } else {
+        /* self-evaluating */
+        EMIT_OP(scope, OP_CONST);
+        emit(scope, exp);
+    }
+    emit_ret(scope, ctx);
+}
+
+static void
+compile_ref(ScmObj var, const vm_scope *scope)
+{
+    scm_int_t depth, index;
+
+    /* wrapped identifiers are resolved by scm_lookup_environment() */
+    if (SYMBOLP(var)) {
+        if (scope_lookup(var, scope, &depth, &index)) {
+            EMIT_OP(scope, OP_LREF);
+            EMIT_INT(scope, depth);
+            EMIT_INT(scope, index);
+            emit(scope, var);
+            return;
+        }
+        if (scm_toplevel_environmentp(scope->env)) {
+            EMIT_OP(scope, OP_GREF);
+            emit(scope, var);
+            return;
+        }
+    }
+
+    /* the opaque environment of the closure or the toplevel */
+    EMIT_OP(scope, OP_NREF);
+    emit(scope, var);
+}
+
+
+static void
+compile_form(ScmObj form, const vm_scope *scope, int ctx)
+{
+    vm_mark mark;
+    ScmBinaryOperator binary;
+    ScmObj head, val, skip;
+    ScmRef ref;
+    scm_int_t depth, index, argc;
+    scm_bool guardp;
+
+    head = CAR(form);
+    /* the operands are left to call() as is */
+    if (!PROPER_LISTP(form) || EQ(head, scm_values_applier)) {
+        compile_call(form, -1, scm_false, scope, ctx);
+        return;
+    }
+
+    argc = scm_length(CDR(form));
+    if (SYMBOLP(head)) {
+        if (scope_lookup(head, scope, &depth, &index)) {
+            compile_call(form, argc, scm_false, scope, ctx);
+            return;
+        }
+        ref = scm_lookup_environment(head, scope->env);
+        val = (ref != SCM_INVALID_REF) ? DEREF(ref) : SCM_SYMBOL_VCELL(head);
+    } else if (IDENTIFIERP(head)) {
+        /* wrapped identifier of a hygienic macro */
+        compile_call(form, argc, scm_false, scope, ctx);
+        return;
+    } else {
+        ref = SCM_INVALID_REF;
+        val = head;
+    }
+
+    if (SYNTAXP(val)) {
+        mark = mark_code(scope);
+        /* a toplevel keyword may be redefined as a variable */
+        guardp = (SYMBOLP(head) && ref == SCM_INVALID_REF);
+        skip = new_label();
+        if (guardp) {
+            EMIT_OP(scope, OP_GUARD);
+            emit(scope, head);
+            emit(scope, val);
+            emit(scope, form);
+            emit(scope, skip);
+            EMIT_INT(scope, ctx);
+        }
+        if (compile_syntax(val, form, scope, ctx)) {
+            place_label(scope, skip);
+            return;
+        }
+        rollback_code(scope, mark);
+    }
+
+    if (SYMBOLP(head) && ref == SCM_INVALID_REF && REDUCTIONP(val)) {
+        if (argc == 2
+            && (binary = scm_lookup_binary_operator(SCM_FUNC_CFUNC(val))))
+        {
+            skip = new_label();
+            EMIT_OP(scope, OP_GUARD);
+            emit(scope, head);
+            emit(scope, val);
+            emit(scope, form);
+            emit(scope, skip);
+            EMIT_INT(scope, ctx);
+            compile(CADR(form), scope, SUB_CTX(scope));
+            EMIT_OP(scope, OP_PUSH);
+            compile(CAR(CDDR(form)), scope, SUB_CTX(scope));
+            EMIT_OP(scope, OP_BINARY);
+            emit(scope, SCM_MAKE_C_FUNCPOINTER((ScmCFunc)binary));
+            emit_ret(scope, ctx);
+            place_label(scope, skip);
+            return;
+        }
+        compile_call(form, argc, argc >= 3, scope, ctx);
+        return;
+    }
+    compile_call(form, argc, scm_false, scope, ctx);
+}
+
+/* A call of the operator that is not known at the compilation. ARGC is
+ * negative if the operands must be left to call(). If REDUCEP, the code to
+ * evaluate the operands of a reduction one by one follows. */
+static void
+compile_call(ScmObj form, scm_int_t argc, scm_bool reducep,
+             const vm_scope *scope, int ctx)
+{
+    ScmObj skip, red, args;
+
+    skip = new_label();
+    red = (reducep) ? new_label() : SCM_FALSE;
+    compile(CAR(form), scope, SUB_CTX(scope));
+    EMIT_OP(scope, OP_OPERATOR);
+    EMIT_INT(scope, argc);
+    emit(scope, form);
+    emit(scope, skip);
+    EMIT_INT(scope, ctx);
+    emit(scope, red);
+    if (argc >= 0) {
+        compile_pushes(CDR(form), scope, SUB_CTX(scope));
+        EMIT_OP(scope, (CTX_TAILP(ctx)) ? OP_TAILCALL : OP_CALL);
+        EMIT_INT(scope, argc);
+    }
+    if (reducep) {
+        if (!CTX_TAILP(ctx)) {
+            EMIT_OP(scope, OP_JUMP);
+            emit(scope, skip);
+        }
+        place_label(scope, red);
+        args = CDR(form);
+        compile(CAR(args), scope, SUB_CTX(scope));
+        EMIT_OP(scope, OP_PUSH);
+        for (args = CDR(args); CONSP(CDR(args)); args = CDR(args)) {
+            compile(CAR(args), scope, SUB_CTX(scope));
+            EMIT_OP(scope, OP_REDUCE);
+            emit(scope, skip);
+        }
+        compile(CAR(args), scope, SUB_CTX(scope));
+        EMIT_OP(scope, OP_REDUCE_LAST);
+    }
+    place_label(scope, skip);
+    if (reducep)
+        emit_ret(scope, ctx);
+}
+
+/* Compile the syntax SYN into instructions. Returns false if FORM is left
+ * to the interpreter. */
+static scm_bool
+compile_syntax(ScmObj syn, ScmObj form, const vm_scope *scope, int ctx)
+{
+    if (SYNTAX_CFUNCP(syn, scm_s_quote))
+        return compile_quote(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_if))
+        return compile_if(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_setx))
+        return compile_setx(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_lambda))
+        return compile_lambda(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_begin))
+        return compile_begin(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_and))
+        return compile_and_or(form, scm_true, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_or))
+        return compile_and_or(form, scm_false, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_cond))
+        return compile_cond(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_case))
+        return compile_case(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_quasiquote))
+        return compile_quasiquote(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_let))
+        return compile_let(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_letstar))
+        return compile_letstar(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_letrec))
+        return compile_letrec(form, scope, ctx);
+    if (SYNTAX_CFUNCP(syn, scm_s_do))
+        return compile_do(form, scope, ctx);
+
+    return scm_false;
+}
+
+/* (quote <datum>) */
+static scm_bool
+compile_quote(ScmObj form, const vm_scope *scope, int ctx)
+{
+    if (!LIST_2_P(form))
+        return scm_false;
+
+    EMIT_OP(scope, OP_CONST);
+    emit(scope, scm_s_quote(CADR(form), SCM_INTERACTION_ENV));
+    emit_ret(scope, ctx);
+
+    return scm_true;
+}
+
+/* (if <test> <consequent> [<alternate>]) */
+static scm_bool
+compile_if(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj args, alt, end;
+
+    args = CDR(form);
+    if (!CONSP(args) || !CONSP(CDR(args)))
+        return scm_false;
+#if SCM_STRICT_ARGCHECK
+    if (CONSP(CDDR(args)) && !NULLP(CDR(CDDR(args))))
+        return scm_false;
+#endif
+
+    alt = new_label();
+    end = new_label();
+    compile(CAR(args), scope, SUB_CTX(scope));
+    EMIT_OP(scope, OP_JUMPF);
+    emit(scope, alt);
+    compile(CADR(args), scope, INNER_CTX(ctx));
+    if (!CTX_TAILP(ctx)) {
+        EMIT_OP(scope, OP_JUMP);
+        emit(scope, end);
+    }
+    place_label(scope, alt);
+    if (CONSP(CDDR(args))) {
+        compile(CAR(CDDR(args)), scope, INNER_CTX(ctx));
+    } else {
+        EMIT_OP(scope, OP_CONST);
+#if SCM_COMPAT_SIOD_BUGS
+        emit(scope, SCM_FALSE);
+#else
+        emit(scope, SCM_UNDEF);
+#endif
+        emit_ret(scope, ctx);
+    }
+    place_label(scope, end);
+
+    return scm_true;
+}
+
+/* (set! <variable> <expression>) */
+static scm_bool
+compile_setx(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj var;
+    scm_int_t depth, index;
+
+    if (!LIST_3_P(form) || !SYMBOLP(var = CADR(form)))
+        return scm_false;
+
+    compile(CAR(CDDR(form)), scope, SUB_CTX(scope));
+    if (scope_lookup(var, scope, &depth, &index)) {
+        EMIT_OP(scope, OP_LSET);
+        EMIT_INT(scope, depth);
+        EMIT_INT(scope, index);
+        emit(scope, var);
+    } else {
+        EMIT_OP(scope, (scm_toplevel_environmentp(scope->env)) ? OP_GSET
+                                                                 : OP_NSET);
+        emit(scope, var);
+    }
+    emit_ret(scope, ctx);
+
+    return scm_true;
+}
+
+/* (lambda <formals> <body>) */
+static scm_bool
+compile_lambda(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj formals, body;
+
+    if (!CONSP(CDR(form)))
+        return scm_false;
+    formals = CADR(form);
+    body = CDDR(form);
+    /* the frame of a call is made by the formals as is */
+    if (SCM_LISTLEN_ERRORP(scm_validate_formals(formals)) || !CONSP(body))
+        return scm_false;
+
+    EMIT_OP(scope, OP_CLOSURE);
+    emit(scope, compile_code(formals, body, scope));
+    emit_ret(scope, ctx);
+
+    return scm_true;
+}
+
+/* (begin <expression>*) */
+static scm_bool
+compile_begin(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj exps;
+
+    exps = CDR(form);
+    if (NULLP(scope->frames)
+        && DEFINABLE_TOPLEVELP(scope->env, CTX_NEST(ctx)))
+    {
+        /* '(begin)' is valid only at the toplevel */
+        if (NULLP(exps)) {
+            EMIT_OP(scope, OP_CONST);
+            emit(scope, SCM_UNDEF);
+            emit_ret(scope, ctx);
+            return scm_true;
+        }
+        if (!PROPER_LISTP(exps))
+            return scm_false;
+        /* the same nests as scm_s_begin() gives */
+        compile_seq(exps, scope, CTX(SCM_NEST_PROGRAM, scm_false),
+                    CTX(SCM_NEST_COMMAND_OR_DEFINITION, CTX_TAILP(ctx)));
+        return scm_true;
+    }
+
+    if (!CONSP(exps) || !PROPER_LISTP(exps))
+        return scm_false;
+    compile_seq(exps, scope, FORBIDDEN_CTX, INNER_CTX(ctx));
+
+    return scm_true;
+}
+
+/* Compile the non-empty proper list EXPS to be evaluated in order. */
+static void
+compile_seq(ScmObj exps, const vm_scope *scope, int sub_ctx, int ctx)
+{
+    for (; CONSP(CDR(exps)); exps = CDR(exps)) {
+        compile(CAR(exps), scope, sub_ctx);
+#if SCM_STRICT_ARGCHECK
+        EMIT_OP(scope, OP_CHECK);
+#endif
+    }
+    compile(CAR(exps), scope, ctx);
+}
+
+/* (and <test>*), (or <test>*) */
+static scm_bool
+compile_and_or(ScmObj form, scm_bool andp, const vm_scope *scope, int ctx)
+{
+    ScmObj args, end;
+
+    args = CDR(form);
+    if (NULLP(args)) {
+        EMIT_OP(scope, OP_CONST);
+        emit(scope, MAKE_BOOL(andp));
+        emit_ret(scope, ctx);
+        return scm_true;
+    }
+
+    end = new_label();
+    for (; CONSP(CDR(args)); args = CDR(args)) {
+        compile(CAR(args), scope, FORBIDDEN_CTX);
+        EMIT_OP(scope, (andp) ? OP_JUMPF : OP_JUMPT);
+        emit(scope, end);
+    }
+    compile(CAR(args), scope, INNER_CTX(ctx));
+    place_label(scope, end);
+    emit_ret(scope, ctx);
+
+    return scm_true;
+}
+
+/* (cond <cond clause>+) */
+static scm_bool
+compile_cond(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj clauses, clause, rest, test, exps, next, end;
+
+    /* validate the clauses in advance to keep the error timing */
+    clauses = CDR(form);
+    if (!CONSP(clauses))
+        return scm_false;
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        if (!CONSP(clause) || !PROPER_LISTP(clause))
+            return scm_false;
+        if (EQ(CAR(clause), l_sym_else)
+            && (!NULLP(CDR(rest)) || !CONSP(CDR(clause))))
+            return scm_false;
+    }
+
+    end = new_label();
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        test = CAR(clause);
+        exps = CDR(clause);
+        if (EQ(test, l_sym_else)) {
+            compile_seq(exps, scope, FORBIDDEN_CTX, INNER_CTX(ctx));
+            break;
+        }
+
+        compile(test, scope, SUB_CTX(scope));
+        if (NULLP(exps)) {
+            /* the value of the test is the result */
+            EMIT_OP(scope, OP_JUMPT);
+            emit(scope, end);
+            continue;
+        }
+        next = new_label();
+        EMIT_OP(scope, OP_JUMPF);
+        emit(scope, next);
+        if (EQ(CAR(exps), l_sym_yields) && LIST_2_P(exps)) {
+            /* the call of the receiver is in the tail context */
+            EMIT_OP(scope, OP_PUSH);
+            compile(CADR(exps), scope, SUB_CTX(scope));
+            EMIT_OP(scope, OP_YIELD);
+            EMIT_OP(scope, (CTX_TAILP(ctx)) ? OP_TAILCALL : OP_CALL);
+            EMIT_INT(scope, 1);
+        } else {
+            compile_seq(exps, scope, FORBIDDEN_CTX, INNER_CTX(ctx));
+        }
+        if (!CTX_TAILP(ctx)) {
+            EMIT_OP(scope, OP_JUMP);
+            emit(scope, end);
+        }
+        place_label(scope, next);
+    }
+    if (NULLP(rest)) {
+        /* no clause is selected */
+        EMIT_OP(scope, OP_CONST);
+        emit(scope, SCM_UNDEF);
+    }
+    place_label(scope, end);
+    emit_ret(scope, ctx);
+
+    return scm_true;
+}
+
+/* (case <expression> <case clause>+) */
+static scm_bool
+compile_case(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj clauses, clause, rest, data, next, end;
+
+    /* malformed forms are left to the interpreter to keep the error
+     * timing */
+    if (!CONSP(CDR(form)) || !CONSP(CDDR(form)))
+        return scm_false;
+    clauses = CDDR(form);
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        if (!CONSP(clause) || !CONSP(CDR(clause)) || !PROPER_LISTP(clause))
+            return scm_false;
+        data = CAR(clause);
+        if (EQ(data, l_sym_else)) {
+            if (!NULLP(CDR(rest)))
+                return scm_false;
+        } else if (!PROPER_LISTP(data)) {
+            return scm_false;
+        }
+    }
+
+    /* the key is kept on the stack until a clause is selected */
+    compile(CADR(form), scope, SUB_CTX(scope));
+    EMIT_OP(scope, OP_PUSH);
+    end = new_label();
+    for (rest = clauses; CONSP(rest); rest = CDR(rest)) {
+        clause = CAR(rest);
+        if (EQ(CAR(clause), l_sym_else)) {
+            EMIT_OP(scope, OP_POP);
+            compile_seq(CDR(clause), scope, FORBIDDEN_CTX, INNER_CTX(ctx));
+            break;
+        }
+        next = new_label();
+        EMIT_OP(scope, OP_CASE);
+        emit(scope, CAR(clause));
+        emit(scope, next);
+        compile_seq(CDR(clause), scope, FORBIDDEN_CTX, INNER_CTX(ctx));
+        if (!CTX_TAILP(ctx)) {
+            EMIT_OP(scope, OP_JUMP);
+            emit(scope, end);
+        }
+        place_label(scope, next);
+    }
+    if (NULLP(rest)) {
+        EMIT_OP(scope, OP_POP);
+        EMIT_OP(scope, OP_CONST);
+        emit(scope, SCM_UNDEF);
+        emit_ret(scope, ctx);
+    }
+    place_label(scope, end);
+
+    return scm_true;
+}
+
+/* (quasiquote <qq template>) */
+static scm_bool
+compile_quasiquote(ScmObj form, const vm_scope *scope, int ctx)
+{
+    ScmObj tmpl;
+
+    if (!LIST_2_P(form))
+        return scm_false;
+
+    /* the interpreter reports a splice at the top on the evaluation */
+    tmpl = CADR(form);
+    if (!qq_compilablep(tmpl, 1)
+        || (CONSP(tmpl) && EQ(CAR(tmpl), SYM_UNQUOTE_SPLICING)))
+        return scm_false;
+
+    if (compile_qq(tmpl, 1, scope) == QQ_CONSTANT) {
+        EMIT_OP(scope, OP_CONST);
+        emit(scope, tmpl);
+    }
+    emit_ret(scope, ctx);
+
+    return scm_true;
+}
+
+/* Test whether TMPL is well-formed and free of wrapped identifiers outside
+ * of the unquoted expressions, in the same order as qquote_internal() of
+ * qquote.c walks it. */
+static scm_bool
+qq_compilablep(ScmObj tmpl, scm_int_t nest)
+{
+    ScmObj rest, obj;
+#if SCM_USE_VECTOR
+    scm_int_t i;
+
+    if (VECTORP(tmpl)) {
+        for (i = 0; i < SCM_VECTOR_LEN(tmpl); i++)
+            if (!qq_compilablep(SCM_VECTOR_VEC(tmpl)[i], nest))
+                return scm_false;
+        return scm_true;
+    }
+#endif
+    if (!CONSP(tmpl))
+        return !IDENTIFIERP(tmpl) || SYMBOLP(tmpl);
+
+    for (rest = tmpl; CONSP(rest); rest = CDR(rest)) {
+        obj = CAR(rest);
+        if (EQ(obj, SYM_QUASIQUOTE)) {
+            if (!LIST_1_P(CDR(rest)))
+                return scm_false;
+            ++nest;
+        } else if (EQ(obj, SYM_UNQUOTE)
+                   || EQ(obj, SYM_UNQUOTE_SPLICING)) {
+            if (!LIST_1_P(CDR(rest)))
+                return scm_false;
+            /* (a . ,@b) */
+            if (EQ(obj, SYM_UNQUOTE_SPLICING) && !EQ(rest, tmpl))
+                return scm_false;
+            if (--nest == 0)
+                return scm_true;
+        } else if (!qq_compilablep(obj, nest)) {
+            return scm_false;
+        }
+    }
+    return qq_compilablep(rest, nest);
+}
+
+/* Whether TMPL at the level NEST has no unquoted expression. */
+static scm_bool
+qq_constantp(ScmObj tmpl, scm_int_t nest)
+{
+    ScmObj rest, obj;
+#if SCM_USE_VECTOR
+    scm_int_t i;
+
+    if (VECTORP(tmpl)) {
+        for (i = 0; i < SCM_VECTOR_LEN(tmpl); i++)
+            if (!qq_constantp(SCM_VECTOR_VEC(tmpl)[i], nest))
+                return scm_false;
+        return scm_true;
+    }
+#endif
+    for (rest = tmpl; CONSP(rest); rest = CDR(rest)) {
+        obj = CAR(rest);
+        if (EQ(obj, SYM_QUASIQUOTE)) {
+            ++nest;
+        } else if (EQ(obj, SYM_UNQUOTE)
+                   || EQ(obj, SYM_UNQUOTE_SPLICING)) {
+            if (--nest == 0)
+                return scm_false;
+        } else if (!qq_constantp(obj, nest)) {
+            return scm_false;
+        }
+    }
+    /* (a . #(,b)) */
+    return (EQ(rest, tmpl)) ? scm_true : qq_constantp(rest, nest);
+}
+
+/* Compile the template TMPL at the level NEST of nested quasiquotes. The
+ * code leaves the value, or the list to be spliced, in val. A constant
+ * template emits nothing and is the value as is. */
+static int
+compile_qq(ScmObj tmpl, scm_int_t nest, const vm_scope *scope)
+{
+    ScmObj kinds, consts, rest, obj, shared;
+    scm_int_t n;
+    int kind;
+#if SCM_USE_VECTOR
+    scm_int_t i;
+#endif
+
+    if (qq_constantp(tmpl, nest))
+        return QQ_CONSTANT;
+
+    /* Each element is pushed in order. The constant ones are pushed just
+     * before the next element that is not constant. */
+    kinds = consts = SCM_NULL;
+    n = 0;
+#if SCM_USE_VECTOR
+    if (VECTORP(tmpl)) {
+        for (i = 0; i < SCM_VECTOR_LEN(tmpl); i++) {
+            obj = SCM_VECTOR_VEC(tmpl)[i];
+            if (qq_constantp(obj, nest)) {
+                consts = CONS(obj, consts);
+                continue;
+            }
+            n += push_constants(consts, &kinds, scope);
+            consts = SCM_NULL;
+            kind = compile_qq(obj, nest, scope);
+            EMIT_OP(scope, OP_PUSH);
+            kinds = CONS(MAKE_BOOL(kind == QQ_SPLICE), kinds);
+            n++;
+        }
+        n += push_constants(consts, &kinds, scope);
+        EMIT_OP(scope, OP_QQ_VECTOR);
+        EMIT_INT(scope, n);
+        emit(scope, kinds);
+        return QQ_VALUE;
+    }
+#endif
+
+    /* SHARED is the rest of the template after the last element that is not
+     * constant */
+    shared = tmpl;
+    for (rest = tmpl; CONSP(rest); rest = CDR(rest)) {
+        obj = CAR(rest);
+        if (EQ(obj, SYM_QUASIQUOTE)) {
+            ++nest;
+        } else if (EQ(obj, SYM_UNQUOTE) || EQ(obj, SYM_UNQUOTE_SPLICING)) {
+            if (--nest == 0) {
+                if (EQ(rest, tmpl)) {
+                    compile(CADR(rest), scope, SUB_CTX(scope));
+                    return (EQ(obj, SYM_UNQUOTE)) ? QQ_VALUE : QQ_SPLICE;
+                }
+                /* (a . ,b) */
+                n += push_constants(consts, &kinds, scope);
+                compile(CADR(rest), scope, SUB_CTX(scope));
+                goto list;
+            }
+        } else if (!qq_constantp(obj, nest)) {
+            n += push_constants(consts, &kinds, scope);
+            consts = SCM_NULL;
+            kind = compile_qq(obj, nest, scope);
+            EMIT_OP(scope, OP_PUSH);
+            kinds = CONS(MAKE_BOOL(kind == QQ_SPLICE), kinds);
+            n++;
+            shared = CDR(rest);
+            continue;
+        }
+        consts = CONS(obj, consts);
+    }
+    if (qq_constantp(rest, nest)) {
+        /* share the constant elements at the end with the template */
+        EMIT_OP(scope, OP_CONST);
+        emit(scope, shared);
+    } else {
+        /* (a . #(,b)) */
+        n += push_constants(consts, &kinds, scope);
+        compile_qq(rest, nest, scope);
+    }
+
+ list:
+    EMIT_OP(scope, OP_QQ_LIST);
+    EMIT_INT(scope, n);
+    emit(scope, kinds);
+
+    return QQ_VALUE;
+}
+
+/* Push the constant elements CONSTS in the reverse order. Returns the
+ * number of them. */
+static scm_int_t
+push_constants(ScmObj consts, ScmObj *kinds, const vm_scope *scope)
+{
+    ScmObj lst;
+    scm_int_t n;
+
+    for (lst = SCM_NULL; CONSP(consts); consts = CDR(consts))
+        lst = CONS(CAR(consts), lst);
+    for (n = 0; CONSP(lst); lst = CDR(lst), n++) {
+        EMIT_OP(scope, OP_PUSH_CONST);
+        emit(scope, CAR(lst));
+        *kinds = CONS(SCM_FALSE, *kinds);
+    }
+
+    return n;
+}
+
+/* (let [<variable>] (<binding spec>*) <body>) */
+static scm_bool
+compile_let(ScmObj form, const vm_scope *scope, int ctx)
+{
+    vm_scope inner;
+    ScmObj name, bindings, body, formals, inits, name_formals, code;
+    scm_int_t n;
+    DECLARE_INTERNAL_FUNCTION("let");
+
+    if (!CONSP(CDR(form)))
+        return scm_false;
+    bindings = CADR(form);
+    body = CDDR(form);
+
+    name = SCM_FALSE;
+    if (IDENTIFIERP(bindings)) {
+        name = bindings;
+        if (!SYMBOLP(name) || !CONSP(body))
+            return scm_false;
+        bindings = POP(body);
+    }
+    if (!parse_bindings(bindings, scm_true, &formals, &inits))
+        return scm_false;
+
+    if (FALSEP(name)) {
+        n = compile_pushes(inits, scope, SUB_CTX(scope));
+        EMIT_OP(scope, OP_FRAME);
+        EMIT_INT(scope, n);
+        emit(scope, formals);
+        inner = *scope;
+        inner.frames = CONS(formals, scope->frames);
+        compile_body(body, &inner, ctx);
+        if (!CTX_TAILP(ctx)) {
+            EMIT_OP(scope, OP_UNFRAME);
+            EMIT_INT(scope, 1);
+        }
+        return scm_true;
+    }
+
+    /* the procedure is bound in a frame of its own, and called by the
+     * values of the inits in place of the placeholder */
+    name_formals = LIST_1(name);
+    inner = *scope;
+    inner.frames = CONS(name_formals, scope->frames);
+    code = compile_code(formals, body, &inner);
+    EMIT_OP(scope, OP_PUSH_CONST);
+    emit(scope, SCM_FALSE);
+    n = compile_pushes(inits, scope, SUB_CTX(scope));
+    EMIT_OP(scope, OP_NAMED_LET);
+    emit(scope, code);
+    emit(scope, name_formals);
+    EMIT_INT(scope, n);
+    EMIT_OP(scope, (CTX_TAILP(ctx)) ? OP_TAILCALL : OP_CALL);
+    EMIT_INT(scope, n);
+
+    return scm_true;
+}
+
+/* (let* (<binding spec>*) <body>) */
+static scm_bool
+compile_letstar(ScmObj form, const vm_scope *scope, int ctx)
+{
+    vm_scope inner;
+    ScmObj formals, inits, var_formals;
+    scm_int_t n;
+
+    if (!CONSP(CDR(form))
+        || !parse_bindings(CADR(form), scm_false, &formals, &inits))
+        return scm_false;
+
+    /* extend the env for each variable */
+    inner = *scope;
+    for (n = 0;
+         CONSP(formals);
+         formals = CDR(formals), inits = CDR(inits), n++)
+    {
+        compile(CAR(inits), &inner, SUB_CTX(&inner));
+        EMIT_OP(scope, OP_PUSH);
+        var_formals = LIST_1(CAR(formals));
+        EMIT_OP(scope, OP_FRAME);
+        EMIT_INT(scope, 1);
+        emit(scope, var_formals);
+        inner.frames = CONS(var_formals, inner.frames);
+    }
+    compile_body(CDDR(form), &inner, ctx);
+    if (n && !CTX_TAILP(ctx)) {
+        EMIT_OP(scope, OP_UNFRAME);
+        EMIT_INT(scope, n);
+    }
+
+    return scm_true;
+}
+
+/* (letrec (<binding spec>*) <body>) */
+static scm_bool
+compile_letrec(ScmObj form, const vm_scope *scope, int ctx)
+{
+    vm_scope inner;
+    ScmObj formals, inits;
+    scm_int_t n;
+
+    if (!CONSP(CDR(form))
+        || !parse_bindings(CADR(form), scm_true, &formals, &inits))
+        return scm_false;
+
+    n = scm_length(formals);
+    EMIT_OP(scope, OP_LETREC);
+    EMIT_INT(scope, n);
+    emit(scope, formals);
+    inner = *scope;
+    inner.frames = CONS(formals, scope->frames);
+    compile_pushes(inits, &inner, SUB_CTX(&inner));
+    EMIT_OP(scope, OP_FILL);
+    EMIT_INT(scope, n);
+    compile_body(CDDR(form), &inner, ctx);
+    if (!CTX_TAILP(ctx)) {
+        EMIT_OP(scope, OP_UNFRAME);
+        EMIT_INT(scope, 1);
+    }
+
+    return scm_true;
+}
+
+/* (do ((<variable> <init> <step>)*) (<test> <expression>*) <command>*) */
+static scm_bool
+compile_do(ScmObj form, const vm_scope *scope, int ctx)
+{
+    vm_emitter em;
+    vm_scope inner;
+    ScmQueue formalq, initq, stepq;
+    ScmObj bindings, binding, rest, test_exps, commands, formals, inits, steps;
+    ScmObj var, exit;
+    scm_int_t n;
+
+    /* malformed forms are left to the interpreter */
+    if (!PROPER_LISTP(form) || !CONSP(CDR(form)) || !CONSP(CDDR(form)))
+        return scm_false;
+    bindings = CADR(form);
+    test_exps = CAR(CDDR(form));
+    commands = CDR(CDDR(form));
+    if (!CONSP(test_exps) || !PROPER_LISTP(test_exps))
+        return scm_false;
+
+    formals = inits = steps = SCM_NULL;
+    SCM_QUEUE_POINT_TO(formalq, formals);
+    SCM_QUEUE_POINT_TO(initq, inits);
+    SCM_QUEUE_POINT_TO(stepq, steps);
+    for (rest = bindings; CONSP(rest); rest = CDR(rest)) {
+        binding = CAR(rest);
+        if (!CONSP(binding) || !PROPER_LISTP(binding)
+            || !CONSP(CDR(binding)) || scm_length(binding) > 3)
+            return scm_false;
+        var = CAR(binding);
+        if (!SYMBOLP(var) || TRUEP(scm_p_memq(var, formals)))
+            return scm_false;
+        SCM_QUEUE_ADD(formalq, var);
+        SCM_QUEUE_ADD(initq, CADR(binding));
+        SCM_QUEUE_ADD(stepq,
+                      (CONSP(CDDR(binding))) ? CAR(CDDR(binding)) : var);
+    }
+    if (!NULLP(rest))
+        return scm_false;
+
+    /* The loop is a code of the variables called in the current env as a
+     * closure, and each iteration calls it again. The variables stay in the
+     * stack unless a frame of each iteration is made for a closure. */
+    init_emitter(&em);
+    inner = *scope;
+    inner.frames = CONS(formals, scope->frames);
+    inner.em = &em;
+    exit = new_label();
+    compile(CAR(test_exps), &inner, SUB_CTX(&inner));
+    EMIT_OP(&inner, OP_EXIT);
+    emit(&inner, exit);
+    for (rest = commands; CONSP(rest); rest = CDR(rest))
+        compile(CAR(rest), &inner, SUB_CTX(&inner));
+    n = compile_pushes(steps, &inner, SUB_CTX(&inner));
+    EMIT_OP(&inner, OP_LOOP);
+    EMIT_INT(&inner, n);
+    emit(&inner, formals);
+
+    place_label(&inner, exit);
+    if (NULLP(CDR(test_exps))) {
+        EMIT_OP(&inner, OP_CONST);
+        emit(&inner, SCM_UNDEF);
+        EMIT_OP(&inner, OP_RET);
+    } else {
+        compile_seq(CDR(test_exps), &inner, FORBIDDEN_CTX,
+                    CTX(SCM_NEST_COMMAND, scm_true));
+    }
+
+    EMIT_OP(scope, OP_PUSH_CONST);
+    emit(scope, SCM_FALSE);
+    compile_pushes(inits, scope, FORBIDDEN_CTX);
+    EMIT_OP(scope, OP_DO);
+    emit(scope, make_code(&em, n, formals, formals, commands));
+    EMIT_INT(scope, n);
+    EMIT_INT(scope, ctx);
+
+    return scm_true;
+}
+
+/* Emit the code pushing the values of the proper list EXPS compiled in
+ * CTX. Returns the number of them. */
+static scm_int_t
+compile_pushes(ScmObj exps, const vm_scope *scope, int ctx)
+{
+    scm_int_t n;
+
+    for (n = 0; CONSP(exps); exps = CDR(exps), n++) {
+        compile(CAR(exps), scope, ctx);
+        EMIT_OP(scope, OP_PUSH);
+    }
+
+    return n;
+}
+
+/* Split (<binding spec>*) into the variables and the init expressions.
+ * Returns false for anything the interpreter would reject. */
+static scm_bool
+parse_bindings(ScmObj bindings, scm_bool uniquep,
+               ScmObj *formals, ScmObj *inits)
+{
+    ScmQueue varq, initq;
+    ScmObj binding, var;
+
+    *formals = *inits = SCM_NULL;
+    SCM_QUEUE_POINT_TO(varq, *formals);
+    SCM_QUEUE_POINT_TO(initq, *inits);
+    FOR_EACH (binding, bindings) {
+#if SCM_COMPAT_SIOD_BUGS
+        if (LIST_1_P(binding))
+            binding = LIST_2(CAR(binding), SCM_FALSE);
+#endif
+        if (!LIST_2_P(binding) || !SYMBOLP(var = CAR(binding)))
+            return scm_false;
+#if SCM_STRICT_ARGCHECK
+        if (uniquep && TRUEP(scm_p_memq(var, *formals)))
+            return scm_false;
+#endif
+        SCM_QUEUE_ADD(varq, var);
+        SCM_QUEUE_ADD(initq, CADR(binding));
+    }
+
+    return NULLP(bindings);
+}
+
+/* <body> part of lambda, let, let* and letrec */
+static void
+compile_body(ScmObj body, const vm_scope *scope, int ctx)
+{
+#if SCM_USE_INTERNAL_DEFINITIONS
+    vm_scope inner;
+    ScmQueue varq, expq;
+    ScmObj formals, exps, rest;
+    scm_int_t n;
+
+    if (!PROPER_LISTP(body)) {
+        emit_deferred(OP_BODY, body, scope, ctx);
+        return;
+    }
+
+    formals = exps = SCM_NULL;
+    SCM_QUEUE_POINT_TO(varq, formals);
+    SCM_QUEUE_POINT_TO(expq, exps);
+    rest = scan_definitions(body, &varq, &expq);
+    if (!VALIDP(rest) || !CONSP(rest)) {
+        emit_deferred(OP_BODY, body, scope, ctx);
+        return;
+    }
+
+    if (!NULLP(formals)) {
+        /* same as letrec */
+        n = scm_length(formals);
+        EMIT_OP(scope, OP_LETREC);
+        EMIT_INT(scope, n);
+        emit(scope, formals);
+        inner = *scope;
+        inner.frames = CONS(formals, scope->frames);
+        compile_pushes(exps, &inner, SUB_CTX(&inner));
+        EMIT_OP(scope, OP_FILL);
+        EMIT_INT(scope, n);
+        compile_seq(rest, &inner, SUB_CTX(&inner), INNER_CTX(ctx));
+        if (!CTX_TAILP(ctx)) {
+            EMIT_OP(scope, OP_UNFRAME);
+            EMIT_INT(scope, 1);
+        }
+        return;
+    }
+    body = rest;
+#else
+    if (!CONSP(body) || !PROPER_LISTP(body)) {
+        emit_deferred(OP_BODY, body, scope, ctx);
+        return;
+    }
+#endif
+
+    compile_seq(body, scope, SUB_CTX(scope), INNER_CTX(ctx));
+}
+
+#if SCM_USE_INTERNAL_DEFINITIONS
+/* Same as filter_definitions() of syntax.c except that this returns
+ * SCM_INVALID instead of raising an error. */
+static ScmObj
+scan_definitions(ScmObj body, ScmQueue *varq, ScmQueue *expq)
+{
+    ScmObj exp, var, sym, rest, begin_rest;
+    DECLARE_INTERNAL_FUNCTION("(body)");
+
+    for (; CONSP(body); body = CDR(body)) {
+        exp = CAR(body);
+        if (!CONSP(exp))
+            break;
+        sym = CAR(exp);
+        rest = CDR(exp);
+        if (EQ(sym, l_sym_begin)) {
+            if (!PROPER_LISTP(rest))
+                return SCM_INVALID;
+            begin_rest = scan_definitions(rest, varq, expq);
+            if (!VALIDP(begin_rest))
+                return SCM_INVALID;
+            if (!NULLP(begin_rest)) {
+                /* no definitions found */
+                if (EQ(begin_rest, rest))
+                    return body;
+                /* definitions and expressions intermixed */
+                return SCM_INVALID;
+            }
+        } else if (EQ(sym, l_sym_define)) {
+            if (!CONSP(rest))
+                return SCM_INVALID;
+            var = POP(rest);
+            if (SYMBOLP(var)) {
+                /* (define <variable> <expression>) */
+                if (!LIST_1_P(rest))
+                    return SCM_INVALID;
+                exp = CAR(rest);
+            } else if (CONSP(var) && SYMBOLP(CAR(var))) {
+                /* (define (<variable> . <formals>) <body>) */
+                exp = CONS(l_syn_lambda, CONS(CDR(var), rest));
+                var = CAR(var);
+            } else {
+                return SCM_INVALID;
+            }
+            SCM_QUEUE_ADD(*varq, var);
+            SCM_QUEUE_ADD(*expq, exp);
+        } else {
+            break;
+        }
+    }
+
+    return body;
+}
+#endif /* SCM_USE_INTERNAL_DEFINITIONS */
@@ -292,7 +292,7 @@ write_obj(ScmObj port, ScmObj obj, enum ScmOutputType otype)
         else
 #endif
             scm_port_puts(port, "#<closure ");
-        write_obj(port, SCM_CLOSURE_EXP(obj), otype);
+        write_obj(port, CLOSURE_SOURCE(obj), otype);
         scm_port_put_char(port, '>');
         break;
 #if SCM_USE_VECTOR
@@ -738,7 +738,7 @@ write_ss_scan(ScmObj obj, scm_write_ss_context *ctx)
         switch (SCM_TYPE(obj)) {
         case ScmClosure:
             /* We don't need to track env because it's not printed anyway. */
-            write_ss_scan(SCM_CLOSURE_EXP(obj), ctx);
+            write_ss_scan(CLOSURE_SOURCE(obj), ctx);
             break;
 
         case ScmValuePacket:
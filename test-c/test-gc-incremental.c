@@ -0,0 +1,179 @@
+/*===========================================================================
+ *  Filename : test-gc-incremental.c
+ *  About    : incremental garbage collector test
+ *
+ *  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of authors nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ *  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================*/
+#include <sigscheme/config.h>
+#if !SCM_USE_INCREMENTAL_GC
+#define TST_EXCLUDE_THIS
+#endif
+
+#define TST_HAVE_MAIN 1
+#include "sscm-test.h"
+
+#ifndef TST_EXCLUDE_THIS
+
+#include "sigscheme.h"
+#include "sigschemeinternal.h"
+
+/* A small heap and a small budget make a marking span many steps. */
+#define HEAP_SIZE    1024
+#define STEP_BUDGET  256
+#define N_CELLS      (HEAP_SIZE * 16)
+#define N_MOVED      (HEAP_SIZE * 8)
+
+static const ScmStorageConf storage_conf = {
+    HEAP_SIZE,
+    HEAP_SIZE / 2,
+    SCM_DEFAULT_N_HEAPS_MAX,
+    1,
+    SCM_DEFAULT_SYMBOL_HASH_SIZE,
+    STEP_BUDGET,
+    SCM_DEFAULT_GC_N_MARKERS
+};
+
+int
+main(int argc, char **argv)
+{
+    tst_suite_info suite = TST_DEFAULT_SUITE_SETUP;
+    const char *my_argv[] = {
+        "dummy",
+        "--system-load-path", TST_SCM_SYSTEM_LOAD_PATH,
+        NULL
+    };
+
+    scm_initialize(&storage_conf, my_argv);
+
+    tst_main(&suite);
+
+    scm_finalize();
+
+    TST_DEFAULT_SUITE_CLEANUP(suite);
+    return !!suite.stats.fail;
+}
+
+static void
+churn(size_t n)
+{
+    while (n--)
+        CONS(SCM_NULL, SCM_NULL);
+}
+
+static scm_bool
+countdownp(ScmObj lst, scm_int_t n)
+{
+    for (; CONSP(lst); lst = CDR(lst), n--) {
+        if (!INTP(CAR(lst)) || SCM_INT_VALUE(CAR(lst)) != n)
+            return scm_false;
+    }
+    return NULLP(lst) && !n;
+}
+
+TST_CASE("list grown on the stack across the steps")
+{
+    ScmObj lst;
+    scm_int_t i;
+
+    lst = SCM_NULL;
+    for (i = 1; i <= N_CELLS; i++) {
+        lst = CONS(MAKE_INT(i), lst);
+        churn(3);
+    }
+    churn(N_CELLS);
+    TST_TN_TRUE(countdownp(lst, N_CELLS));
+}
+
+TST_CASE("list grown in an old pair across the steps")
+{
+    ScmObj pair;
+    scm_int_t i;
+
+    pair = CONS(SCM_FALSE, SCM_NULL);
+    churn(N_CELLS);
+    for (i = 1; i <= N_CELLS; i++) {
+        SET_CDR(pair, CONS(MAKE_INT(i), CDR(pair)));
+        churn(3);
+    }
+    churn(N_CELLS);
+    TST_TN_TRUE(countdownp(CDR(pair), N_CELLS));
+}
+
+/* The cells only referred from the stack once detached must be found by
+ * scanning the roots again. */
+TST_CASE("list moved from an old pair to the stack across the steps")
+{
+    ScmObj pair, prev, cell, lst;
+    scm_int_t i;
+
+    pair = CONS(SCM_FALSE, SCM_NULL);
+    for (i = 1; i <= N_MOVED; i++)
+        SET_CDR(pair, CONS(MAKE_INT(i), CDR(pair)));
+    churn(N_CELLS);
+    lst = SCM_NULL;
+    while (CONSP(CDR(pair))) {
+        for (prev = pair; CONSP(CDDR(prev)); prev = CDR(prev))
+            ;
+        cell = CDR(prev);
+        SET_CDR(prev, SCM_NULL);
+        SET_CDR(cell, lst);
+        lst = cell;
+        churn(16);
+    }
+    churn(N_CELLS);
+    TST_TN_TRUE(countdownp(lst, N_MOVED));
+}
+
+#if SCM_USE_VECTOR
+TST_CASE("vector filled across the steps")
+{
+    ScmObj vec, lst;
+    scm_int_t i, len;
+
+    len = HEAP_SIZE;
+    vec = scm_p_make_vector(MAKE_INT(len), SCM_NULL);
+    churn(N_CELLS);
+    for (i = 0; i < len; i++) {
+        lst = LIST_2(MAKE_INT(i), MAKE_INT(1));
+        scm_p_vector_setx(vec, MAKE_INT(i), lst);
+        churn(16);
+    }
+    churn(N_CELLS);
+    for (i = 0; i < len; i++) {
+        lst = SCM_VECTOR_VEC(vec)[i];
+        if (!CONSP(lst) || !INTP(CAR(lst)) || SCM_INT_VALUE(CAR(lst)) != i
+            || !countdownp(CDR(lst), 1))
+            break;
+    }
+    TST_TN_EQ_INT(len, i);
+}
+#endif /* SCM_USE_VECTOR */
+
+#endif /* !TST_EXCLUDE_THIS */
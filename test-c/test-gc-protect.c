@@ -153,6 +153,7 @@ TST_CASE("GC static variable protection")
 
     /* protected */
     for (i = 0; i < N_OBJS; i++) {
+        static_objs[i] = SCM_FALSE;  /* may be marked on make_obj() */
         scm_gc_protect(&static_objs[i]);
         static_objs[i] = make_obj();
     }
@@ -185,16 +186,17 @@ TST_CASE("GC auto variable protection with scm_gc_protect()")
 
     /* protected */
     for (i = 0; i < N_OBJS; i++) {
+        auto_objs[i] = SCM_FALSE;  /* may be marked on make_obj() */
         scm_gc_protect(&auto_objs[i]);
         auto_objs[i] = make_obj();
     }
     for (i = 0; i < N_OBJS; i++)
         TST_TN_TRUE(scm_gc_protectedp(auto_objs[i]));
 
-#if TRY_TESTS_THAT_PASS_IN_MOST_CASES
-    /* unprotect again */
+    /* unprotect again. It must be done before the variables go away. */
     for (i = 0; i < N_OBJS; i++)
         scm_gc_unprotect(&auto_objs[i]);
+#if TRY_TESTS_THAT_PASS_IN_MOST_CASES
     for (i = 0; i < N_OBJS; i++)
         TST_TN_FALSE(scm_gc_protectedp(auto_objs[i]));
 #endif
@@ -0,0 +1,515 @@
+;;  Filename : test-compiler.scm
+;;  About    : unit test for the pre-analysis of closure bodies
+;;
+;;  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+
+(define *test-track-progress* #f)
+(define tn test-name)
+
+;; These tests pass regardless of --enable-compiler. Each procedure is called
+;; at least once before the interesting assertion so that its body has been
+;; pre-analyzed when the compiler is enabled.
+
+(define write-to-string
+  (lambda (obj)
+    (let ((port (open-output-string)))
+      (write obj port)
+      (get-output-string port))))
+
+(tn "compiled closure source")
+(define (source-kept x) (+ x 1))
+(assert-equal? (tn) 2 (source-kept 1))
+(assert-equal? (tn) "#<closure ((x) (+ x 1))>" (write-to-string source-kept))
+
+(tn "operator rebound after compilation")
+(define (use-later-op) (later-op 1 2))
+(define later-op list)
+(assert-equal? (tn) '(1 2) (use-later-op))
+(define later-op (lambda (a b) (list b a)))
+(assert-equal? (tn) '(2 1) (use-later-op))
+(if (symbol-bound? 'define-macro)
+    (begin
+      (eval '(define-macro (later-op a b) (list 'quote (cons b a)))
+            (interaction-environment))
+      (assert-equal? (tn) '(2 . 1) (use-later-op))))
+(define later-op 3)
+(assert-error (tn) (lambda () (use-later-op)))
+
+(tn "inline cache of global procedures")
+(define cached-op car)
+(define (call-cached-op x) (cached-op x))
+(assert-equal? (tn) 1 (call-cached-op '(1 2)))
+(assert-equal? (tn) 1 (call-cached-op '(1 2)))
+(set! cached-op cdr)
+(assert-equal? (tn) '(2) (call-cached-op '(1 2)))
+(define cached-op cons)
+(assert-error  (tn) (lambda () (call-cached-op '(1 2))))
+(define cached-op (lambda (x) (list x)))
+(assert-equal? (tn) '((1 2)) (call-cached-op '(1 2)))
+(define cached-op length)
+(assert-equal? (tn) 2 (call-cached-op '(1 2)))
+(assert-error  (tn) (lambda () (call-cached-op 'not-a-list)))
+(define cached-op 'not-a-procedure)
+(assert-error  (tn) (lambda () (call-cached-op '(1 2))))
+
+(tn "inlined builtins")
+(define (prim-ops a b)
+  (list (+ a b) (- a b) (* a b) (< a b) (= a b) (>= a b) (zero? a)))
+(assert-equal? (tn) '(7 -1 12 #t #f #f #f) (prim-ops 3 4))
+(assert-equal? (tn) '(7 -1 12 #t #f #f #f) (prim-ops 3 4))
+(assert-error  (tn) (lambda () (prim-ops 'a 4)))
+(assert-error  (tn) (lambda () (prim-ops 3 "4")))
+(define (prim-pairs x y)
+  (list (car x) (cdr x) (cons x y) (eq? x y) (null? y) (pair? y) (not y)))
+(assert-equal? (tn) '(1 (2) ((1 2) . ()) #f #t #f #f) (prim-pairs '(1 2) '()))
+(assert-error  (tn) (lambda () (prim-pairs 1 '())))
+(define (prim-folded) (+ 1 (* 2 3)))
+(define (prim-add a b) (+ a b))
+(assert-equal? (tn) 7 (prim-folded))
+(assert-equal? (tn) 3 (prim-add 1 2))
+;; replacing a builtin deoptimizes the calls
+(define saved-+ +)
+(assert-equal? (tn)
+               '(replaced replaced)
+               (let ((ret (begin
+                            (set! + (lambda (a b) 'replaced))
+                            (list (prim-folded) (prim-add 1 2)))))
+                 (set! + saved-+)
+                 ret))
+(assert-equal? (tn) 7 (prim-folded))
+(assert-equal? (tn) 3 (prim-add 1 2))
+
+(tn "global and local set!")
+(define compiled-counter 0)
+(define (bump! n)
+  (set! compiled-counter (+ compiled-counter n))
+  (set! n (* n 2))
+  (list compiled-counter n))
+(assert-equal? (tn) '(1 2) (bump! 1))
+(assert-equal? (tn) '(3 4) (bump! 2))
+(define (set-unbound!) (set! compiled-never-defined 1))
+(assert-error (tn) set-unbound!)
+
+(tn "unbound global reference")
+(define (ref-later) compiled-defined-later)
+(assert-error (tn) ref-later)
+(define compiled-defined-later 'now)
+(assert-equal? (tn) 'now (ref-later))
+
+(tn "conditionals")
+(define (classify x)
+  (cond ((assv x '((1 . one) (2 . two))) => cdr)
+        ((and (number? x) (< 10 x)) 'big)
+        ((or (eq? x 'a) (eq? x 'b)))
+        ((null? x))
+        (else 'other)))
+(assert-equal? (tn) 'one   (classify 1))
+(assert-equal? (tn) 'two   (classify 2))
+(assert-equal? (tn) 'big   (classify 11))
+(assert-equal? (tn) #t     (classify 'b))
+(assert-equal? (tn) #t     (classify '()))
+(assert-equal? (tn) 'other (classify 5))
+(define (cond-bad-recv x) (cond (x => 'not-a-procedure)))
+(assert-error (tn) (lambda () (cond-bad-recv #t)))
+
+(tn "case dispatch")
+(define (case-dense x)
+  (case x
+    ((1 2 3) 'low)
+    ((4 5 2) 'mid)
+    ((7) (set! x 'seven) x)
+    (else 'other)))
+(assert-equal? (tn) 'low   (case-dense 2))
+(assert-equal? (tn) 'mid   (case-dense 5))
+(assert-equal? (tn) 'seven (case-dense 7))
+(assert-equal? (tn) 'other (case-dense 6))
+(assert-equal? (tn) 'other (case-dense 100))
+(assert-equal? (tn) 'other (case-dense 'a))
+(define (case-hashed x)
+  (case x
+    ((a b) 1)
+    ((#\a -1000000) 2)
+    ((1000000 c) 3)
+    ((a) 4)))
+(assert-equal? (tn) 1 (case-hashed 'b))
+(assert-equal? (tn) 1 (case-hashed 'a))
+(assert-equal? (tn) 2 (case-hashed #\a))
+(assert-equal? (tn) 2 (case-hashed -1000000))
+(assert-equal? (tn) 3 (case-hashed 1000000))
+(assert-equal? (tn) (undef) (case-hashed "a"))
+(define (case-mixed x)
+  (case x
+    ((1 "one") 'one)
+    (else 'other)))
+(assert-equal? (tn) 'one   (case-mixed 1))
+(assert-equal? (tn) 'other (case-mixed "one"))
+(define (case-malformed flag) (if flag (case 1 (1 'one)) 'ok))
+(assert-equal? (tn) 'ok (case-malformed #f))
+(assert-error  (tn) (lambda () (case-malformed #t)))
+
+(tn "binding forms")
+(define (binding-forms x)
+  (let ((a x) (b (* x 2)))
+    (let* ((c (+ a b)) (d (* c 2)))
+      (letrec ((even? (lambda (n) (if (zero? n) #t (odd? (- n 1)))))
+               (odd?  (lambda (n) (if (zero? n) #f (even? (- n 1))))))
+        (list a b c d (even? d))))))
+(assert-equal? (tn) '(1 2 3 6 #t) (binding-forms 1))
+(assert-equal? (tn) '(2 4 6 12 #t) (binding-forms 2))
+
+(tn "named let")
+(define (collect-thunks n)
+  (let loop ((i 0) (acc '()))
+    (if (< i n)
+        (loop (+ i 1) (cons (lambda () i) acc))
+        (map (lambda (thunk) (thunk)) acc))))
+(assert-equal? (tn) '(2 1 0) (collect-thunks 3))
+(assert-equal? (tn) '() (collect-thunks 0))
+
+(tn "internal definitions")
+(define (internal-defs x)
+  (define y (* x 2))
+  (define (twice) (+ y y))
+  (twice))
+(assert-equal? (tn) 4 (internal-defs 1))
+(assert-equal? (tn) 8 (internal-defs 2))
+(define (internal-defs-nested x)
+  (begin
+    (define a x)
+    (define b (lambda () (+ a 1))))
+  (list a (b)))
+(assert-equal? (tn) '(1 2) (internal-defs-nested 1))
+
+(tn "lexical addressing")
+(define (deep-refs a . rest)
+  (let ((b (+ a 1)))
+    (let* ((c (+ b 1)) (d (+ c 1)))
+      (letrec ((get (lambda (e . more)
+                      (set! a (+ a 10))
+                      (set! rest (cons e rest))
+                      (list a b c d e more rest))))
+        (get 'x 'y)))))
+(assert-equal? (tn) '(11 2 3 4 x (y) (x 0))   (deep-refs 1 0))
+(assert-equal? (tn) '(12 3 4 5 x (y) (x)) (deep-refs 2))
+(define (variadic-refs . args)
+  (lambda () args))
+(assert-equal? (tn) '(1 2) ((variadic-refs 1 2)))
+(define (shadowed-refs x)
+  (let ((x (* x 10)))
+    (let ((f (lambda (x) (+ x 1))))
+      (list x (f x)))))
+(assert-equal? (tn) '(10 11) (shadowed-refs 1))
+(define (letrec-unassigned)
+  (letrec ((a b) (b 1)) a))
+(assert-error (tn) letrec-unassigned)
+(define (eval-in-frame x)
+  (let ((y (* x 2)))
+    (eval '(set! y (+ x y)) (the-environment))
+    y))
+(if (symbol-bound? 'the-environment)
+    (assert-equal? (tn) 3 (eval-in-frame 1)))
+
+(tn "closure frames")
+(define (frame-args a b . c) (list a b c))
+(assert-equal? (tn) '(1 2 ())    (frame-args 1 2))
+(assert-equal? (tn) '(1 2 (3 4)) (frame-args 1 2 3 4))
+(assert-equal? (tn) '(1 2 (3))   (apply frame-args '(1 2 3)))
+(assert-error  (tn) (lambda () (frame-args 1)))
+;; the args are evaluated before the arity is checked
+(define (guard-arity thunk)
+  (call-with-current-continuation
+    (lambda (k)
+      (with-exception-handler (lambda (e) (k #f)) thunk))))
+(define (frame-arity-order)
+  (let ((trace '()))
+    (guard-arity
+      (lambda ()
+        (frame-args (begin (set! trace (cons 'evaled trace)) 1))))
+    trace))
+(if (symbol-bound? 'with-exception-handler)
+    (assert-equal? (tn) '(evaled) (frame-arity-order)))
+(define (frame-closures n)
+  (let loop ((i 0) (acc '()))
+    (if (= i n)
+        acc
+        (loop (+ i 1) (cons (lambda () (* i i)) acc)))))
+(assert-equal? (tn) '(4 1 0) (map (lambda (f) (f)) (frame-closures 3)))
+
+(tn "flat closures")
+(define (flat-adder n) (lambda (x) (+ x n)))
+(assert-equal? (tn) 7 ((flat-adder 3) 4))
+(define (flat-rest . args) (lambda () args))
+(assert-equal? (tn) '(1 2) ((flat-rest 1 2)))
+(define (flat-nested a)
+  (let ((b (* a 2)))
+    (lambda (c)
+      (lambda (d) (list a b c d)))))
+(assert-equal? (tn) '(1 2 3 4) (((flat-nested 1) 3) 4))
+;; assigned variables are shared with the defining frame
+(define (flat-counter)
+  (let ((n 0))
+    (cons (lambda () (set! n (+ n 1)) n)
+          (lambda () n))))
+(define flat-count (flat-counter))
+((car flat-count))
+((car flat-count))
+(assert-equal? (tn) 2 ((cdr flat-count)))
+(define (flat-late-set)
+  (let* ((x 1)
+         (get (lambda () x)))
+    (set! x 2)
+    (get)))
+(assert-equal? (tn) 2 (flat-late-set))
+(define (flat-inner-set x)
+  ((lambda () ((lambda () (set! x (* x 10))))))
+  x)
+(assert-equal? (tn) 50 (flat-inner-set 5))
+(define (flat-letrec n)
+  (letrec ((even? (lambda (i) (if (= i 0) #t (odd? (- i 1)))))
+           (odd? (lambda (i) (if (= i 0) #f (even? (- i 1))))))
+    (lambda () (even? n))))
+(assert-equal? (tn) #t ((flat-letrec 10)))
+(define (flat-defines n)
+  (define (sq) (* n n))
+  (define (get) (sq))
+  get)
+(assert-equal? (tn) 9 ((flat-defines 3)))
+;; variables assigned by the interpreter
+(define (flat-do-set)
+  (let ((x 0))
+    (let ((get (lambda () x)))
+      (do ((i 0 (+ i 1))) ((= i 3)) (set! x (+ x i)))
+      (get))))
+(assert-equal? (tn) 3 (flat-do-set))
+(define (flat-delay-set)
+  (let ((x 0))
+    (let ((get (lambda () x)))
+      (force (delay (set! x 3)))
+      (get))))
+(assert-equal? (tn) 3 (flat-delay-set))
+(define (flat-loop-closures n)
+  (let loop ((i 0) (acc '()))
+    (if (= i n)
+        (map (lambda (f) (f)) acc)
+        (let ((j (* i 10)))
+          (loop (+ i 1) (cons (lambda () (+ i j)) acc))))))
+(assert-equal? (tn) '(22 11 0) (flat-loop-closures 3))
+
+(tn "reused frames")
+(define (frame-fib n)
+  (if (< n 2)
+      n
+      (+ (frame-fib (- n 1)) (frame-fib (- n 2)))))
+(assert-equal? (tn) 610 (frame-fib 15))
+(define (frame-tak x y z)
+  (if (not (< y x))
+      z
+      (frame-tak (frame-tak (- x 1) y z)
+                 (frame-tak (- y 1) z x)
+                 (frame-tak (- z 1) x y))))
+(assert-equal? (tn) 7 (frame-tak 18 12 6))
+(define (frame-square x) (* x x))
+(define (frame-map-squares lst) (map frame-square lst))
+(assert-equal? (tn) '(1 4 9) (frame-map-squares '(1 2 3)))
+(define (frame-pair a b) (cons a b))
+(define (frame-nested a b)
+  (let ((p (frame-pair a b)))
+    (list p (frame-pair b a) a b)))
+(assert-equal? (tn) '((1 . 2) (2 . 1) 1 2) (frame-nested 1 2))
+;; escaping from an activation
+(define (frame-escape k x) (k x))
+(define (frame-escaper x)
+  (call-with-current-continuation
+    (lambda (k) (frame-escape k (* x 2)))))
+(assert-equal? (tn) 4 (frame-escaper 2))
+(assert-equal? (tn) '(1 . 2) (frame-pair 1 2))
+(define (frame-error x) (car x))
+(assert-error  (tn) (lambda () (frame-error 'not-a-pair)))
+(assert-equal? (tn) '(3 . 4) (frame-pair 3 4))
+;; an operator turned into a macro captures the frame
+(define (frame-capture x) (later-capture x))
+(define later-capture list)
+(assert-equal? (tn) '(1) (frame-capture 1))
+(define captured-thunk #f)
+(if (symbol-bound? 'define-macro)
+    (begin
+      (eval '(define-macro (later-capture v) (list 'lambda '() v))
+            (interaction-environment))
+      (set! captured-thunk (frame-capture 5))
+      (frame-capture 6)
+      (assert-equal? (tn) '(7 . 8) (frame-pair 7 8))
+      (assert-equal? (tn) 5 (captured-thunk))))
+
+(tn "loops")
+(define (do-sum n)
+  (do ((i 0 (+ i 1))
+       (acc 0 (+ acc i))
+       (k 'k))
+      ((= i n) (list acc k))))
+(assert-equal? (tn) '(45 k) (do-sum 10))
+(define (do-no-exps)
+  (do ((i 0 (+ i 1))) ((= i 3))))
+(assert-equal? (tn) (undef) (do-no-exps))
+;; steps see the values of the previous iteration
+(define (do-swap n)
+  (do ((i 0 (+ i 1))
+       (a 1 b)
+       (b 2 a))
+      ((= i n) (cons a b))))
+(assert-equal? (tn) '(2 . 1) (do-swap 3))
+;; each iteration has fresh bindings if they may be captured
+(define (do-closures n)
+  (do ((i 0 (+ i 1))
+       (acc '() (cons (lambda () i) acc)))
+      ((= i n) (map (lambda (f) (f)) acc))))
+(assert-equal? (tn) '(2 1 0) (do-closures 3))
+(define (loop-sum n)
+  (let loop ((i 0) (acc 0))
+    (cond ((= i n) acc)
+          ((odd? i) (let ((j (* i 2))) (loop (+ i 1) (+ acc j))))
+          (else (case i
+                  ((0) (loop (+ i 1) acc))
+                  (else (and #t (loop (+ i 1) (+ acc i)))))))))
+(assert-equal? (tn) 70 (loop-sum 10))
+(assert-equal? (tn) 74995000 (loop-sum 10000))
+(define (loop-nested n)
+  (let outer ((i 0) (acc '()))
+    (if (= i n)
+        (reverse acc)
+        (let inner ((j 0) (sum 0))
+          (if (> j i)
+              (outer (+ i 1) (cons sum acc))
+              (inner (+ j 1) (+ sum j)))))))
+(assert-equal? (tn) '(0 1 3 6) (loop-nested 4))
+;; the name is referred as a value or called in a non-tail position
+(define (loop-non-tail n)
+  (let loop ((i n))
+    (if (= i 0) 0 (+ 1 (loop (- i 1))))))
+(assert-equal? (tn) 5 (loop-non-tail 5))
+(define (loop-as-value)
+  (let loop ((i 0))
+    (if (procedure? loop) i 'no)))
+(assert-equal? (tn) 0 (loop-as-value))
+(define (loop-wrong-arity flag)
+  (let loop ((i 0))
+    (if (or flag (> i 0)) i (loop 1 2))))
+(assert-equal? (tn) 0 (loop-wrong-arity #t))
+(assert-error  (tn) (lambda () (loop-wrong-arity #f)))
+;; an operator turned into a macro after the compilation captures the frame
+(define (do-late-capture n)
+  (do ((i 0 (+ i 1))
+       (acc '() (cons (late-capture i) acc)))
+      ((= i n) acc)))
+(define (late-capture i) i)
+(assert-equal? (tn) '(2 1 0) (do-late-capture 3))
+(if (symbol-bound? 'define-macro)
+    (begin
+      (eval '(define-macro (late-capture i) (list 'lambda '() i))
+            (interaction-environment))
+      (assert-equal? (tn) '(2 1 0)
+                     (map (lambda (f) (f)) (do-late-capture 3)))))
+
+(tn "deferred syntax errors")
+;; malformed forms are reported when reached, as the interpreter does
+(define (malformed-if flag) (if flag (if) 'ok))
+(assert-equal? (tn) 'ok (malformed-if #f))
+(assert-error  (tn) (lambda () (malformed-if #t)))
+(define (malformed-let flag) (if flag (let ((1 2)) 3) 'ok))
+(assert-equal? (tn) 'ok (malformed-let #f))
+(assert-error  (tn) (lambda () (malformed-let #t)))
+
+(tn "quasiquote")
+(define (qq-unquote x) `(a ,x c))
+(assert-equal? (tn) '(a b c) (qq-unquote 'b))
+(assert-equal? (tn) '(a (1) c) (qq-unquote '(1)))
+(define (qq-splice x y) `(a ,@x c ,@y))
+(assert-equal? (tn) '(a 1 2 c 1 2) (qq-splice (list 1 2) (list 1 2)))
+(assert-equal? (tn) '(a c) (qq-splice '() '()))
+(define (qq-splice-last x) `(0 ,@x))
+(assert-equal? (tn) '(0 1 2) (qq-splice-last (list 1 2)))
+;; the constant rest is shared among the results
+(define (qq-rest x) `(,x b c))
+(assert-equal? (tn) '(a b c) (qq-rest 'a))
+(assert-true   (tn) (eq? (cdr (qq-rest 1)) (cdr (qq-rest 2))))
+(define (qq-dotted x) `(a . ,x))
+(assert-equal? (tn) '(a b c) (qq-dotted '(b c)))
+(assert-equal? (tn) '(a . 1) (qq-dotted 1))
+(define (qq-nested x) `(a `(b ,(c ,x))))
+(assert-equal? (tn) '(a `(b ,(c 1))) (qq-nested 1))
+(define (qq-constant) `(a (b c) #(d)))
+(assert-equal? (tn) '(a (b c) #(d)) (qq-constant))
+(assert-true   (tn) (eq? (qq-constant) (qq-constant)))
+(define (qq-vector x) `#(a ,x (,x)))
+(assert-equal? (tn) '#(a 1 (1)) (qq-vector 1))
+(define (qq-vector-splice x) `#(a ,@x b))
+(assert-equal? (tn) '#(a 1 2 b) (qq-vector-splice '(1 2)))
+(assert-equal? (tn) '#(a b) (qq-vector-splice '()))
+(define (qq-bad-splice x) `(a ,@x))
+(assert-equal? (tn) '(a 1) (qq-bad-splice '(1)))
+(assert-error  (tn) (lambda () (qq-bad-splice 1)))
+(assert-error  (tn) (lambda () (qq-bad-splice '(1 . 2))))
+
+(tn "continuations in compiled code")
+(define (find-first pred lst)
+  (call-with-current-continuation
+    (lambda (k)
+      (for-each (lambda (x) (if (pred x) (k x))) lst)
+      #f)))
+(assert-equal? (tn) 3  (find-first odd? '(2 4 3 5)))
+(assert-equal? (tn) #f (find-first odd? '(2 4 6)))
+(define (wind-trace)
+  (let ((trace '()))
+    (call-with-current-continuation
+      (lambda (k)
+        (dynamic-wind
+            (lambda () (set! trace (cons 'before trace)))
+            (lambda () (k 'escaped))
+            (lambda () (set! trace (cons 'after trace))))))
+    (reverse trace)))
+(assert-equal? (tn) '(before after) (wind-trace))
+
+(tn "proper tail calls in compiled code")
+(define (count-down n)
+  (cond ((zero? n) 'done)
+        ((odd? n) (count-down (- n 1)))
+        (else (let ((m (- n 1))) (and #t (count-down m))))))
+(assert-equal? (tn) 'done (count-down 100000))
+
+;; must be the last since the keyword is not restored
+(tn "keyword redefined after compilation")
+(define (use-later-and x) (and x 'yes))
+(assert-equal? (tn) 'yes (use-later-and #t))
+(define (and a b) (list 'proc a b))
+(assert-equal? (tn) '(proc #t yes) (use-later-and #t))
+(assert-equal? (tn) '(proc #f yes) (use-later-and #f))
+
+(total-report)
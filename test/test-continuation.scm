@@ -97,16 +97,25 @@
 		(lambda (k)
 		  (k 'ret-call/cc))))
 
-;; Call an expired continuation. Current SigScheme cause an error due to its
-;; setjmp/longjmp implementation.
-(assert-error  (tn)
-               (lambda ()
-                 (let ((res (call-with-current-continuation
-                             (lambda (k)
-                               k))))
-                   (if (procedure? res)
-                       (res 'succeeded)
-                       res))))
+;; Call an expired continuation. SigScheme cause an error due to its
+;; setjmp/longjmp implementation unless full continuations are enabled.
+(if (provided? "nested-continuation-only")
+    (assert-error  (tn)
+                   (lambda ()
+                     (let ((res (call-with-current-continuation
+                                 (lambda (k)
+                                   k))))
+                       (if (procedure? res)
+                           (res 'succeeded)
+                           res))))
+    (assert-equal? (tn)
+                   'succeeded
+                   (let ((res (call-with-current-continuation
+                               (lambda (k)
+                                 k))))
+                     (if (procedure? res)
+                         (res 'succeeded)
+                         res))))
 
 ;; "6.4 Control features" of R5RS:
 ;; The escape procedure accepts the same number of arguments as the
@@ -142,6 +151,101 @@
     (assert-true   (tn) ((call/cc (lambda (c) c))
                          procedure?)))
 
+;; re-entering continuations whose call/cc has already returned
+(define reenter-twice
+  (lambda ()
+    (let ((k #f)
+          (n 0)
+          (acc '()))
+      (set! acc (cons (+ 1 (call/cc (lambda (c) (set! k c) 1))) acc))
+      (set! n (+ n 1))
+      (if (< n 3)
+          (k (* 10 n)))
+      acc)))
+(define make-list-generator
+  (lambda (lst)
+    (let ((return #f)
+          (resume #f))
+      (lambda ()
+        (call/cc
+         (lambda (r)
+           (set! return r)
+           (if resume
+               (resume #f)
+               (begin
+                 (for-each (lambda (x)
+                             (call/cc (lambda (c)
+                                        (set! resume c)
+                                        (return x))))
+                           lst)
+                 (return 'eof)))))))))
+(define reenter-dynamic-wind
+  (lambda ()
+    (let ((k #f)
+          (n 0)
+          (trace '()))
+      (dynamic-wind
+          (lambda () (set! trace (cons 'before trace)))
+          (lambda () (call/cc (lambda (c) (set! k c))))
+          (lambda () (set! trace (cons 'after trace))))
+      (set! n (+ n 1))
+      (if (< n 3)
+          (k #f))
+      (reverse trace))))
+
+;; loops whose frames are captured through a call of a global procedure
+(define reenter-loop-k #f)
+(define reenter-loop-save!
+  (lambda (c)
+    (set! reenter-loop-k c)))
+(define reenter-do
+  (lambda ()
+    (let ((n 0)
+          (acc '()))
+      (do ((i 0 (+ i 1)))
+          ((= i 3))
+        (if (= i 0)
+            (call/cc reenter-loop-save!))
+        (set! acc (cons i acc)))
+      (set! n (+ n 1))
+      (if (< n 3)
+          (reenter-loop-k #f))
+      (reverse acc))))
+(define reenter-named-let
+  (lambda ()
+    (let ((n 0)
+          (acc '()))
+      (let loop ((i 0))
+        (if (< i 3)
+            (begin
+              (if (= i 0)
+                  (call/cc reenter-loop-save!))
+              (set! acc (cons i acc))
+              (loop (+ i 1)))))
+      (set! n (+ n 1))
+      (if (< n 3)
+          (reenter-loop-k #f))
+      (reverse acc))))
+
+(tn "call/cc re-entry")
+(if (not (provided? "nested-continuation-only"))
+    (begin
+      (assert-equal? (tn) '(21 11 2) (reenter-twice))
+      (assert-equal? (tn)
+                     '(a b c eof eof)
+                     (let* ((g (make-list-generator '(a b c)))
+                            (x1 (g))
+                            (x2 (g))
+                            (x3 (g))
+                            (x4 (g))
+                            (x5 (g)))
+                       (list x1 x2 x3 x4 x5)))
+      (assert-equal? (tn)
+                     '(before after before after before after)
+                     (reenter-dynamic-wind))
+      (assert-equal? (tn) '(0 1 2 0 1 2 0 1 2) (reenter-do))
+      (assert-equal? (tn) '(0 1 2 0 1 2 0 1 2) (reenter-named-let))))
+
 (tn "call/cc multiple values continuation")
 (assert-equal? (tn)
                '()
@@ -961,4 +961,36 @@
 (assert-error  (tn) (lambda () (f)))
 
 
+(tn "internal defintions: repeated evaluation")
+;; each evaluation of a body makes its own bindings
+(define (make-counter)
+  (define count 0)
+  (define (inc!) (set! count (+ count 1)) count)
+  inc!)
+(define counter1 (make-counter))
+(define counter2 (make-counter))
+(assert-equal? (tn) 1 (counter1))
+(assert-equal? (tn) 2 (counter1))
+(assert-equal? (tn) 1 (counter2))
+(define (f x)
+  (begin
+    (define (g) (* x 2)))
+  (define y 1)
+  (+ (g) y))
+(assert-equal? (tn) 3 (f 1))
+(assert-equal? (tn) 5 (f 2))
+(define (f x)
+  (begin
+    (display "")
+    x))
+(assert-equal? (tn) 1 (f 1))
+(assert-equal? (tn) 2 (f 2))
+(define (f)
+  (define a 1)
+  'val
+  (define b 2)
+  b)
+(assert-error  (tn) (lambda () (f)))
+(assert-error  (tn) (lambda () (f)))
+
 (total-report)
@@ -0,0 +1,120 @@
+;;  Filename : test-gc.scm
+;;  About    : unit test for the garbage collector
+;;
+;;  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+
+(define *test-track-progress* #f)
+(define tn test-name)
+
+;; Each test makes the objects survive some collections before storing new
+;; objects into them, and then checks that the stored ones survive some more
+;; collections. It catches a missing write barrier of the generational GC,
+;; and does not depend on any GC configuration.
+
+(define (gc-churn)
+  (let loop ((i 0))
+    (if (< i 50000)
+        (begin
+          (cons i i)
+          (loop (+ i 1))))))
+
+(define (gc-make-list n)
+  (let loop ((i n) (res '()))
+    (if (zero? i)
+        res
+        (loop (- i 1) (cons (number->string i) res)))))
+
+(tn "set-car! and set-cdr!")
+(define gc-pair (cons #f #f))
+(gc-churn)
+(set-car! gc-pair (gc-make-list 3))
+(set-cdr! gc-pair (list (string-copy "young")))
+(gc-churn)
+(assert-equal? (tn) '("1" "2" "3") (car gc-pair))
+(assert-equal? (tn) '("young") (cdr gc-pair))
+
+(tn "vector-set! and vector-fill!")
+(define gc-vec (make-vector 4 #f))
+(gc-churn)
+(vector-set! gc-vec 0 (gc-make-list 2))
+(vector-set! gc-vec 3 (string-copy "young"))
+(gc-churn)
+(assert-equal? (tn) '#(("1" "2") #f #f "young") gc-vec)
+(vector-fill! gc-vec (list (string-copy "filled")))
+(gc-churn)
+(assert-equal? (tn) '#(("filled") ("filled") ("filled") ("filled")) gc-vec)
+
+(tn "set! of variables")
+(define gc-global #f)
+(gc-churn)
+(set! gc-global (gc-make-list 2))
+(gc-churn)
+(assert-equal? (tn) '("1" "2") gc-global)
+(define gc-counter
+  (let ((state '()))
+    (lambda (x)
+      (set! state (cons (number->string x) state))
+      state)))
+(gc-counter 1)
+(gc-churn)
+(gc-counter 2)
+(gc-churn)
+(assert-equal? (tn) '("3" "2" "1") (gc-counter 3))
+
+(tn "growing structures")
+;; the head gets old while the tail is still being appended
+(define gc-queue (list 0))
+(let loop ((i 1) (tail gc-queue))
+  (if (<= i 2000)
+      (begin
+        (set-cdr! tail (list (number->string i)))
+        (if (zero? (remainder i 500))
+            (gc-churn))
+        (loop (+ i 1) (cdr tail)))))
+(gc-churn)
+(assert-equal? (tn) 2001 (length gc-queue))
+(assert-equal? (tn) "2000" (list-ref gc-queue 2000))
+(define gc-big (map string-copy (gc-make-list 20000)))
+(gc-churn)
+(assert-equal? (tn) "20000" (list-ref gc-big 19999))
+(define gc-table (make-vector 100 '()))
+(let loop ((i 0))
+  (if (< i 20000)
+      (let ((k (remainder i 100)))
+        (vector-set! gc-table k (cons (number->string i)
+                                      (vector-ref gc-table k)))
+        (loop (+ i 1)))))
+(gc-churn)
+(assert-equal? (tn) 200 (length (vector-ref gc-table 7)))
+(assert-equal? (tn) "19907" (car (vector-ref gc-table 7)))
+
+(total-report)
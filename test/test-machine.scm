@@ -0,0 +1,154 @@
+;;  Filename : test-machine.scm
+;;  About    : unit test for the explicit-stack evaluator
+;;
+;;  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+
+(define *test-track-progress* #f)
+(define tn test-name)
+
+;; These tests pass regardless of the engine, except the ones of deep
+;; recursion which need the machine. The test suite runs this file with
+;; --engine machine if --enable-machine is specified.
+
+(tn "procedure calls")
+(define (mc-add3 a b c) (+ a b c))
+(assert-equal? (tn) 6 (mc-add3 1 2 3))
+(assert-equal? (tn) 10 ((lambda (x) (* x 2)) 5))
+(assert-equal? (tn) 3 ((if #t + -) 1 2))
+(assert-equal? (tn) '(1 2 3) ((lambda args args) 1 2 3))
+(assert-equal? (tn) '(1 (2 3)) ((lambda (a . rest) (list a rest)) 1 2 3))
+(assert-error  (tn) (lambda () (mc-add3 1 2)))
+(assert-error  (tn) (lambda () (mc-add3 1 2 3 4)))
+(assert-error  (tn) (lambda () (1 2)))
+(assert-error  (tn) (lambda () (car)))
+
+(tn "reductions")
+(assert-equal? (tn) 10 (+ 1 2 3 4))
+(assert-equal? (tn) 0 (+))
+(assert-equal? (tn) -5 (- 5))
+(assert-true   (tn) (< 1 2 3 4))
+;; operands after a failed comparison are not evaluated
+(assert-false  (tn) (< 1 0 (car '())))
+(assert-error  (tn) (lambda () (< 0 1 (car '()))))
+
+(tn "if")
+(assert-equal? (tn) 'yes (if (= 1 1) 'yes 'no))
+(assert-equal? (tn) 'no (if (= 1 2) 'yes 'no))
+(assert-equal? (tn) 'yes (if '() 'yes 'no))
+(assert-error  (tn) (lambda () (if)))
+
+(tn "and/or")
+(assert-true   (tn) (and))
+(assert-false  (tn) (or))
+(assert-equal? (tn) 3 (and 1 2 3))
+(assert-false  (tn) (and 1 #f (car '())))
+(assert-equal? (tn) 1 (or #f 1 (car '())))
+(assert-false  (tn) (or #f #f))
+
+(tn "cond")
+(define (mc-classify x)
+  (cond ((< x 0) 'negative)
+        ((assv x '((0 . zero) (1 . one))) => cdr)
+        ((> x 100))
+        (else 'positive)))
+(assert-equal? (tn) 'negative (mc-classify -1))
+(assert-equal? (tn) 'zero (mc-classify 0))
+(assert-equal? (tn) 'one (mc-classify 1))
+(assert-true   (tn) (mc-classify 101))
+(assert-equal? (tn) 'positive (mc-classify 2))
+(assert-error  (tn) (lambda () (cond (#t => 1))))
+(assert-error  (tn) (lambda () (cond 1)))
+
+(tn "let and let*")
+(assert-equal? (tn) 3 (let ((a 1) (b 2)) (+ a b)))
+(assert-equal? (tn) 2 (let () 1 2))
+(assert-equal? (tn) '(1 2) (let* ((a 1) (b (+ a 1))) (list a b)))
+(assert-equal? (tn) 1 (let* () 1))
+(assert-equal? (tn) 2 (let ((a 1)) (let ((a 2) (b a)) a)))
+(assert-equal? (tn) 1 (let ((a 1)) (let ((a 2) (b a)) b)))
+(assert-error  (tn) (lambda () (let ((a)) a)))
+(assert-error  (tn) (lambda () (let ((a 1)))))
+
+(tn "begin")
+(assert-equal? (tn) 3 (begin 1 2 3))
+(begin
+  (define mc-defined-in-begin 1)
+  (define mc-defined-in-begin2 2))
+(assert-equal? (tn) 3 (+ mc-defined-in-begin mc-defined-in-begin2))
+(assert-error  (tn) (lambda () (begin)))
+
+(tn "map and for-each")
+(assert-equal? (tn) '(2 3 4) (map (lambda (x) (+ x 1)) '(1 2 3)))
+(assert-equal? (tn) '() (map car '()))
+(assert-equal? (tn) '(4 6) (map + '(1 2) '(3 4)))
+(define mc-sum 0)
+(for-each (lambda (x) (set! mc-sum (+ mc-sum x))) '(1 2 3))
+(assert-equal? (tn) 6 mc-sum)
+(assert-error  (tn) (lambda () (map car '((1) . 2))))
+
+(tn "continuations")
+(define (mc-find pred lst)
+  (call-with-current-continuation
+    (lambda (k)
+      (for-each (lambda (x) (if (pred x) (k x))) lst)
+      #f)))
+(assert-equal? (tn) 3 (mc-find odd? '(2 4 3 5)))
+(assert-false  (tn) (mc-find odd? '(2 4 6)))
+;; the stack is reused after escapes
+(define (mc-escape-deep n)
+  (call-with-current-continuation
+    (lambda (k)
+      (let loop ((i n))
+        (if (= i 0) (k 'escaped) (+ 1 (loop (- i 1))))))))
+(assert-equal? (tn) 'escaped (mc-escape-deep 100))
+(assert-equal? (tn) 'escaped (mc-escape-deep 100))
+(assert-equal? (tn) 6 (mc-add3 1 2 3))
+
+(define (mc-count n) (if (= n 0) 0 (+ 1 (mc-count (- n 1)))))
+(define (mc-map f lst)
+  (if (null? lst)
+      '()
+      (cons (f (car lst)) (mc-map f (cdr lst)))))
+(define (mc-iota n)
+  (let loop ((i n) (acc '()))
+    (if (= i 0) acc (loop (- i 1) (cons i acc)))))
+(if (provided? "machine")
+    (begin
+      (tn "deep recursion")
+      (assert-equal? (tn) 100000 (mc-count 100000))
+      (assert-equal? (tn) 100001
+                     (car (reverse (mc-map (lambda (x) (+ x 1))
+                                           (mc-iota 100000)))))
+      (assert-equal? (tn) 100000 (length (map (lambda (x) x)
+                                              (mc-iota 100000))))))
+
+(total-report)
@@ -252,6 +252,8 @@
 (assert-error  (tn) (lambda () (< #t #t)))
 (assert-error  (tn) (lambda () (< #f #f)))
 (assert-error  (tn) (lambda () (< '() '())))
+(assert-error  (tn) (lambda () (< 1 #t)))
+(assert-error  (tn) (lambda () (< #t 1)))
 (tn "< 2 args")
 (assert-eq?    (tn) #f (< -2 -2))
 (assert-eq?    (tn) #t (< -2 -1))
@@ -452,6 +454,10 @@
 (assert-eq?    (tn) #f (< 2 1 0 -1 1 -2))
 (assert-eq?    (tn) #f (< -2 -2 -1 -1 0 0 1 1 2 2))
 (assert-eq?    (tn) #f (< 2 2 1 1 0 0 -1 -1 -2 -2))
+(tn "< short-circuit")
+(assert-eq?    (tn) #f (< 1 0 #t))
+(assert-eq?    (tn) #f (< 1 0 (car '())))
+(assert-error  (tn) (lambda () (< 0 1 #t)))
 
 (tn "> invalid forms")
 (assert-error  (tn) (lambda () (>)))
@@ -169,4 +169,66 @@
                  (set! a (* a b))
                  (list a b)))
 
+;; escape continuations of call/ec
+(define find-first
+  (lambda (pred lst)
+    (call/ec
+     (lambda (return)
+       (for-each (lambda (x)
+                   (if (pred x)
+                       (return x)))
+                 lst)
+       #f))))
+(define escaped-ec #f)
+
+(if (symbol-bound? 'call-with-escape-continuation)
+    (begin
+      (tn "call/ec")
+      (assert-true   (tn) (procedure? call/ec))
+      (assert-error  (tn) (lambda () (call/ec)))
+      (assert-error  (tn) (lambda () (call/ec #t)))
+      (assert-equal? (tn) 'ret (call/ec (lambda (k) 'ret)))
+      (assert-equal? (tn) 'ret (call/ec (lambda (k) (k 'ret) 'not-ret)))
+      (assert-equal? (tn) -3   (find-first negative? '(54 0 37 -3 245 19)))
+      (assert-false  (tn)      (find-first negative? '(54 0 37 245 19)))
+      (assert-true   (tn) (procedure? (call/ec (lambda (k) k))))
+      ;; escape through nested call/ec
+      (assert-equal? (tn)
+                     'outer
+                     (call/ec
+                      (lambda (outer)
+                        (call/ec
+                         (lambda (inner)
+                           (set! escaped-ec inner)
+                           (outer 'outer)))
+                        'not-outer)))
+      ;; multiple values
+      (assert-equal? (tn)
+                     '(1 2)
+                     (call-with-values
+                         (lambda ()
+                           (call/ec (lambda (k) (k 1 2))))
+                       list))
+      ;; dynamic-wind
+      (assert-equal? (tn)
+                     '(before thunk after)
+                     (let ((trace '()))
+                       (call/ec
+                        (lambda (k)
+                          (dynamic-wind
+                              (lambda () (set! trace (cons 'before trace)))
+                              (lambda ()
+                                (set! trace (cons 'thunk trace))
+                                (k #f)
+                                (set! trace (cons 'not-reached trace)))
+                              (lambda () (set! trace (cons 'after trace))))))
+                       (reverse trace)))
+      ;; expired
+      (assert-error  (tn) (lambda () ((call/ec (lambda (k) k)) 'expired)))
+      (assert-error  (tn) (lambda () (escaped-ec 'expired)))
+      (assert-error  (tn) (lambda ()
+                            (call/ec
+                             (lambda (k)
+                               (escaped-ec 'expired)))))))
+
 (total-report)
@@ -706,5 +706,67 @@
 ;                              ((_ . _) 'mismatch))))
 ;                  (macro (0 1 2) (3 4))))
 
-(total-report)
+;; Repeated pattern variables are bound to vectors while matching, and
+;; rules are preselected by the length of the form.
+(define-syntax nested-reps
+  (syntax-rules ()
+    ((_ (a b ...) ...) '((a . #(b ...)) ...))))
+(assert-equal? "nested ellipses" '((1 . #(2 3)) (4 . #()) (5 . #(6)))
+               (nested-reps (1 2 3) (4) (5 6)))
+(define-syntax vector-reps
+  (syntax-rules ()
+    ((_ #(a (b c) ...)) '(a (c b) ...))))
+(assert-equal? "ellipsis in vector" '(x (2 1) (4 3))
+               (vector-reps #(x (1 2) (3 4))))
+(define-syntax by-arity
+  (syntax-rules ()
+    ((_) 'none)
+    ((_ a) 'one)
+    ((_ a b . c) 'two-or-more)
+    ((_ . a) 'dotted)))
+(assert-equal? "dispatch by length" '(none one two-or-more two-or-more)
+               (list (by-arity) (by-arity 1) (by-arity 1 2) (by-arity 1 2 3)))
+(assert-eq? "dispatch by length" 'dotted (by-arity . 1))
+(define-syntax long-table
+  (syntax-rules ()
+    ((_ (k v) ...) (list (cons 'k v) ...))))
+(let ((entries (let loop ((i 0) (acc '()))
+                 (if (= i 500)
+                     acc
+                     (loop (+ i 1) (cons (list i (* i i)) acc))))))
+  (assert-equal? "long repetition" (map (lambda (e) (cons (car e) (cadr e)))
+                                        entries)
+                 (eval (cons 'long-table entries)
+                       (interaction-environment))))
+
+;; Quoted data without pattern variables are not copied into expansions.
+(define-syntax quoted-table
+  (syntax-rules ()
+    ((_) '(a #(b c) "d" (e . f)))
+    ((_ x) '(a x))))
+(assert-equal? "quoted constant" '(a #(b c) "d" (e . f)) (quoted-table))
+(assert-equal? "quoted constant where quote is rebound"
+               '(a #(b c) "d" (e . f))
+               (let ((quote list)) (quoted-table)))
+(assert-equal? "quoted pattern variable" '(a 1) (quoted-table 1))
+
+;; Expansions are cached per use site; the cache must neither leak
+;; values between evaluations nor survive a redefinition of the macro.
+(define-syntax swap!
+  (syntax-rules ()
+    ((_ a b) (let ((tmp a)) (set! a b) (set! b tmp)))))
+(define swapped (lambda (x y) (swap! x y) (cons x y)))
+(assert-equal? "expansion reused across evaluations" '(2 . 1) (swapped 1 2))
+(assert-equal? "expansion reused across evaluations" '(4 . 3) (swapped 3 4))
 
+(define-syntax redefined-macro
+  (syntax-rules ()
+    ((_) 'old)))
+(define redefined-site (lambda () (redefined-macro)))
+(assert-eq? "use site before redefinition" 'old (redefined-site))
+(define-syntax redefined-macro
+  (syntax-rules ()
+    ((_) 'new)))
+(assert-eq? "use site after redefinition" 'new (redefined-site))
+
+(total-report)
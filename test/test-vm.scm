@@ -0,0 +1,250 @@
+;;  Filename : test-vm.scm
+;;  About    : unit test for the bytecode VM
+;;
+;;  Copyright (c) 2007-2008 SigScheme Project <uim-en AT googlegroups.com>
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+
+(define *test-track-progress* #f)
+(define tn test-name)
+
+;; These tests pass regardless of the engine, except the ones of deep
+;; recursion which need the VM. The test suite runs this file with
+;; --engine vm if --enable-vm is specified.
+
+(tn "procedure calls")
+(define (vm-add3 a b c) (+ a b c))
+(assert-equal? (tn) 6 (vm-add3 1 2 3))
+(assert-equal? (tn) 10 ((lambda (x) (* x 2)) 5))
+(assert-equal? (tn) 3 ((if #t + -) 1 2))
+(assert-equal? (tn) '(1 2 3) ((lambda args args) 1 2 3))
+(assert-equal? (tn) '(1 (2 3)) ((lambda (a . rest) (list a rest)) 1 2 3))
+(assert-equal? (tn) 6 (apply vm-add3 '(1 2 3)))
+(assert-error  (tn) (lambda () (vm-add3 1 2)))
+(assert-error  (tn) (lambda () (vm-add3 1 2 3 4)))
+(assert-error  (tn) (lambda () (1 2)))
+(assert-error  (tn) (lambda () (car)))
+
+(tn "reductions")
+(assert-equal? (tn) 10 (+ 1 2 3 4))
+(assert-equal? (tn) 0 (+))
+(assert-equal? (tn) -5 (- 5))
+(assert-true   (tn) (< 1 2 3 4))
+;; operands after a failed comparison are not evaluated
+(assert-false  (tn) (< 1 0 (car '())))
+(assert-error  (tn) (lambda () (< 0 1 (car '()))))
+
+(tn "if")
+(assert-equal? (tn) 'yes (if (= 1 1) 'yes 'no))
+(assert-equal? (tn) 'no (if (= 1 2) 'yes 'no))
+(assert-equal? (tn) 'yes (if '() 'yes 'no))
+(assert-error  (tn) (lambda () (if)))
+(assert-error  (tn) (lambda () (if (values 1 2) #t)))
+
+(tn "and/or")
+(assert-true   (tn) (and))
+(assert-false  (tn) (or))
+(assert-equal? (tn) 3 (and 1 2 3))
+(assert-false  (tn) (and 1 #f (car '())))
+(assert-equal? (tn) 1 (or #f 1 (car '())))
+(assert-false  (tn) (or #f #f))
+
+(tn "cond")
+(define (vm-classify x)
+  (cond ((< x 0) 'negative)
+        ((assv x '((0 . zero) (1 . one))) => cdr)
+        ((> x 100))
+        (else 'positive)))
+(assert-equal? (tn) 'negative (vm-classify -1))
+(assert-equal? (tn) 'zero (vm-classify 0))
+(assert-equal? (tn) 'one (vm-classify 1))
+(assert-true   (tn) (vm-classify 101))
+(assert-equal? (tn) 'positive (vm-classify 2))
+(assert-error  (tn) (lambda () (cond (#t => 1))))
+(assert-error  (tn) (lambda () (cond 1)))
+
+(tn "case")
+(define (vm-kind x)
+  (case x
+    ((1 2 3) 'small)
+    ((a b) 'symbol)
+    (else 'other)))
+(assert-equal? (tn) 'small (vm-kind 2))
+(assert-equal? (tn) 'symbol (vm-kind 'b))
+(assert-equal? (tn) 'other (vm-kind "a"))
+
+(tn "let, let* and letrec")
+(assert-equal? (tn) 3 (let ((a 1) (b 2)) (+ a b)))
+(assert-equal? (tn) 2 (let () 1 2))
+(assert-equal? (tn) '(1 2) (let* ((a 1) (b (+ a 1))) (list a b)))
+(assert-equal? (tn) 1 (let* () 1))
+(assert-equal? (tn) 1 (let ((a 1)) (let ((a 2) (b a)) b)))
+(assert-true   (tn) (letrec ((ev? (lambda (n) (if (= n 0) #t (od? (- n 1)))))
+                             (od? (lambda (n) (if (= n 0) #f (ev? (- n 1))))))
+                      (ev? 10)))
+(assert-error  (tn) (lambda () (letrec ((a b) (b 1)) a)))
+(assert-error  (tn) (lambda () (let ((a)) a)))
+(assert-error  (tn) (lambda () (let ((a 1)))))
+
+(tn "named let and do")
+(assert-equal? (tn) 55 (let loop ((i 10) (acc 0))
+                         (if (= i 0) acc (loop (- i 1) (+ acc i)))))
+(assert-equal? (tn) '(4 3 2 1 0)
+               (do ((i 0 (+ i 1))
+                    (acc '() (cons i acc)))
+                   ((= i 5) acc)))
+;; each iteration binds the variables in a new frame
+(assert-equal? (tn) '(2 1 0)
+               (map (lambda (p) (p))
+                    (do ((i 0 (+ i 1))
+                         (ps '() (cons (lambda () i) ps)))
+                        ((= i 3) ps))))
+
+(tn "frames kept in the stack")
+;; the env of a call whose arguments stay in the stack
+(define (vm-env x) (%%current-environment))
+(assert-equal? (tn) 1 (eval 'x (vm-env 1)))
+(define (vm-rest-env a . r) (%%current-environment))
+(assert-equal? (tn) '(1 (2 3)) (eval '(list a r) (vm-rest-env 1 2 3)))
+(assert-equal? (tn) '(1 2) (eval 'args ((lambda args (%%current-environment))
+                                        1 2)))
+(define (vm-same-env x)
+  (eq? (%%current-environment) (%%current-environment)))
+(assert-true   (tn) (vm-same-env 1))
+;; the assignments by the forms evaluated in the env are seen by the call
+(define (vm-set-by-eval x)
+  (eval '(set! x (+ x 1)) (%%current-environment))
+  (+ x 1))
+(assert-equal? (tn) 3 (vm-set-by-eval 1))
+(define (vm-set-by-closure x)
+  ((eval '(lambda (v) (set! x v)) (%%current-environment)) 10)
+  x)
+(assert-equal? (tn) 10 (vm-set-by-closure 1))
+;; each iteration of do has its own env
+(assert-equal? (tn) '(2 1 0)
+               (do ((i 0 (+ i 1))
+                    (acc '() (cons (%%current-environment) acc)))
+                   ((= i 3) (map (lambda (e) (eval 'i e)) acc))))
+(define (vm-sum-to n)
+  (do ((i 0 (+ i 1))
+       (acc 0 (+ acc i)))
+      ((> i n) (eval 'n (%%current-environment)) acc)))
+(assert-equal? (tn) 55 (vm-sum-to 10))
+
+(tn "internal definitions")
+(define (vm-internal x)
+  (define (twice y) (* y 2))
+  (define z 1)
+  (+ (twice x) z))
+(assert-equal? (tn) 7 (vm-internal 3))
+
+(tn "set!")
+(define vm-counter
+  (let ((n 0))
+    (lambda () (set! n (+ n 1)) n)))
+(vm-counter)
+(assert-equal? (tn) 2 (vm-counter))
+(assert-error  (tn) (lambda () (set! vm-unbound-variable 1)))
+
+(tn "quasiquote")
+(define vm-x 2)
+(assert-equal? (tn) '(1 2 3) `(1 ,vm-x 3))
+(assert-equal? (tn) '(1 2 3 4) `(1 ,@(list vm-x 3) 4))
+(assert-equal? (tn) '(1 . 2) `(1 . ,vm-x))
+(assert-equal? (tn) '#(1 2 3) `#(1 ,vm-x ,@(list 3)))
+(assert-equal? (tn) '(a `(b ,2 ,c)) `(a `(b ,,vm-x ,c)))
+
+(tn "begin")
+(assert-equal? (tn) 3 (begin 1 2 3))
+(begin
+  (define vm-defined-in-begin 1)
+  (define vm-defined-in-begin2 2))
+(assert-equal? (tn) 3 (+ vm-defined-in-begin vm-defined-in-begin2))
+(assert-error  (tn) (lambda () (begin)))
+(assert-error  (tn) (lambda () (begin (values 1 2) #t)))
+
+(tn "continuations")
+(define (vm-find pred lst)
+  (call-with-current-continuation
+    (lambda (k)
+      (for-each (lambda (x) (if (pred x) (k x))) lst)
+      #f)))
+(assert-equal? (tn) 3 (vm-find odd? '(2 4 3 5)))
+(assert-false  (tn) (vm-find odd? '(2 4 6)))
+;; the stack is reused after escapes
+(define (vm-escape-deep n)
+  (call-with-current-continuation
+    (lambda (k)
+      (let loop ((i n))
+        (if (= i 0) (k 'escaped) (+ 1 (loop (- i 1))))))))
+(assert-equal? (tn) 'escaped (vm-escape-deep 100))
+(assert-equal? (tn) 'escaped (vm-escape-deep 100))
+(assert-equal? (tn) 6 (vm-add3 1 2 3))
+
+(tn "dynamic-wind")
+(define vm-trace '())
+(define (vm-note x) (set! vm-trace (cons x vm-trace)))
+(assert-equal? (tn) 'escaped
+               (call-with-current-continuation
+                 (lambda (k)
+                   (dynamic-wind
+                       (lambda () (vm-note 'before))
+                       (lambda () (k 'escaped))
+                       (lambda () (vm-note 'after))))))
+(assert-equal? (tn) '(after before) vm-trace)
+
+(tn "multiple values")
+(assert-equal? (tn) 3 (call-with-values (lambda () (values 1 2)) +))
+
+(tn "proper tail calls")
+(define (vm-ev? n) (if (= n 0) #t (vm-od? (- n 1))))
+(define (vm-od? n) (if (= n 0) #f (vm-ev? (- n 1))))
+(assert-true   (tn) (vm-ev? 100000))
+(assert-true   (tn) (let loop ((i 100000))
+                      (cond ((= i 0) #t)
+                            (else (loop (- i 1))))))
+
+(define (vm-count n) (if (= n 0) 0 (+ 1 (vm-count (- n 1)))))
+(define (vm-map f lst)
+  (if (null? lst)
+      '()
+      (cons (f (car lst)) (vm-map f (cdr lst)))))
+(define (vm-iota n)
+  (let loop ((i n) (acc '()))
+    (if (= i 0) acc (loop (- i 1) (cons i acc)))))
+(if (provided? "vm")
+    (begin
+      (tn "deep recursion")
+      (assert-equal? (tn) 100000 (vm-count 100000))
+      (assert-equal? (tn) 100001
+                     (car (reverse (vm-map (lambda (x) (+ x 1))
+                                           (vm-iota 100000)))))))
+
+(total-report)